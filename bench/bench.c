@@ -0,0 +1,891 @@
+/** **************************************************************************
+ *
+ * @file bench.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Microbenchmarks for the hot paths of Kris.
+ *
+ * @details
+ *
+ * Each benchmark is run on a synthetic file of a given shape, which is read
+ * into a buffer the same way the editor reads files. The number of ops is
+ * grown until a run takes long enough to time, and the last run is reported
+ * as JSON on stdout. bytes_per_op is the number of bytes of text each op works
+ * over, such as the length of the line edited or the size of the file read.
+ *
+ * Usage: kris_bench [--time-ms <ms>] [--size-kb <kb>] [name filter]
+ *
+ * ************************************************************************** */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kris.h"
+
+#define BENCH_SCREEN_ROWS 48
+#define BENCH_SCREEN_COLS 160
+#define BENCH_SHORT_NEEDLE "return"
+#define BENCH_LONG_NEEDLE "  // editor is updated here, see"
+
+typedef struct BENCH_TEXT
+{
+  char *buf;                       // The text of the file
+  size_t len;                      // Number of bytes in buf
+  size_t capacity;                 // Number of bytes allocated
+} BENCH_TEXT;
+
+typedef struct BENCH
+{
+  char *name;                      // Name of the function being timed
+  char *syntax;                    // A file name to pick the highlighting, or NULL
+  size_t (*run) (size_t nops, size_t *bytes);  // Do up to nops ops and return how many
+} BENCH;
+
+typedef struct CORPUS
+{
+  char *name;                      // Name of the shape of the file
+  void (*generate) (BENCH_TEXT *text, size_t size);
+} CORPUS;
+
+static uint32_t bench_seed;
+static char bench_path[] = "/tmp/kris-bench-XXXXXX";
+static size_t bench_file_size;
+static size_t bench_sink;          // Match counts and sums, so they aren't optimised out
+
+/** **************************************************************************
+ *
+ *  @brief              Get the time from a monotonic clock
+ *
+ *  @return             The time in seconds
+ *
+ * ************************************************************************** */
+
+static double
+bench_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the next number from a xorshift generator
+ *
+ *  @param[in]          n     One more than the largest number wanted
+ *
+ *  @return             A number from 0 to n - 1
+ *
+ *  @details
+ *
+ *  The generator is seeded the same for every file, so each run of the
+ *  benchmarks works on exactly the same text.
+ *
+ * ************************************************************************** */
+
+static size_t
+bench_random (size_t n)
+{
+  bench_seed ^= bench_seed << 13;
+  bench_seed ^= bench_seed >> 17;
+  bench_seed ^= bench_seed << 5;
+
+  return bench_seed % n;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Append text to the file being generated
+ *
+ *  @param[in,out]      *text     The file being generated
+ *  @param[in]          *fmt      The format of the text
+ *  @param[in]          ...       The arguments for the format
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+bench_append (BENCH_TEXT *text, char *fmt, ...)
+{
+  int len;
+  va_list va;
+
+  va_start (va, fmt);
+  len = vsnprintf (NULL, 0, fmt, va);
+  va_end (va);
+
+  if (text->len + (size_t) len + 1 > text->capacity)
+  {
+    text->capacity = 2 * (text->len + (size_t) len + 1);
+    if (!(text->buf = realloc (text->buf, text->capacity)))
+      util_exit ("Couldn't allocate memory for a benchmark file");
+  }
+
+  va_start (va, fmt);
+  vsnprintf (&text->buf[text->len], (size_t) len + 1, fmt, va);
+  va_end (va);
+  text->len += (size_t) len;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Append a random line of C-like code
+ *
+ *  @param[in,out]      *text     The file being generated
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+bench_code_line (BENCH_TEXT *text)
+{
+  static char *names[] = {"buf", "line_len", "idx", "editor", "count", "render", "cursor", "offset"};
+  static char *types[] = {"int", "size_t", "char *", "double", "static void", "unsigned char"};
+  char *a = names[bench_random (8)];
+  char *b = names[bench_random (8)];
+
+  switch (bench_random (8))
+  {
+    case 0:
+      bench_append (text, "  if (%s == %zu && %s != NULL)", a, bench_random (1000), b);
+      break;
+    case 1:
+      bench_append (text, "    %s = %s (%s, \"%s %zu\\n\");", a, b, a, b, bench_random (100));
+      break;
+    case 2:
+      bench_append (text, "  // %s is updated here, see %s", a, b);
+      break;
+    case 3:
+      bench_append (text, "%s %s_%zu;", types[bench_random (6)], a, bench_random (50));
+      break;
+    case 4:
+      bench_append (text, "  for (%s = 0; %s < %zu; %s++)", a, a, bench_random (4096), a);
+      break;
+    case 5:
+      bench_append (text, "    return %s[%s] * %zu.%zu;", a, b, bench_random (100), bench_random (100));
+      break;
+    case 6:
+      bench_append (text, "#define %s_MAX %zu", b, bench_random (65536));
+      break;
+    default:
+      bench_append (text, "  {");
+      break;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Generate lines of C-like code
+ *
+ *  @param[in,out]      *text     The file being generated
+ *  @param[in]          size      The number of bytes wanted
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+bench_generate_code (BENCH_TEXT *text, size_t size)
+{
+  while (text->len < size)
+  {
+    bench_code_line (text);
+    bench_append (text, "\n");
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Generate very long lines of code
+ *
+ *  @param[in,out]      *text     The file being generated
+ *  @param[in]          size      The number of bytes wanted
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+bench_generate_long_lines (BENCH_TEXT *text, size_t size)
+{
+  size_t line_end;
+
+  while (text->len < size)
+  {
+    line_end = text->len + 2000 + bench_random (4000);
+    while (text->len < line_end)
+    {
+      bench_code_line (text);
+      bench_append (text, " ");
+    }
+    bench_append (text, "\n");
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Generate lines which are indented and split into
+ *                      columns with tabs
+ *
+ *  @param[in,out]      *text     The file being generated
+ *  @param[in]          size      The number of bytes wanted
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+bench_generate_tabs (BENCH_TEXT *text, size_t size)
+{
+  size_t i;
+  size_t ncols;
+
+  while (text->len < size)
+  {
+    for (i = bench_random (6); i > 0; i--)
+      bench_append (text, "\t");
+
+    ncols = 1 + bench_random (8);
+    for (i = 0; i < ncols; i++)
+      bench_append (text, "%s%zu", i ? "\t" : "", bench_random (100000));
+    bench_append (text, "\n");
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Generate code which is mostly comments
+ *
+ *  @param[in,out]      *text     The file being generated
+ *  @param[in]          size      The number of bytes wanted
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+bench_generate_comments (BENCH_TEXT *text, size_t size)
+{
+  size_t i;
+
+  while (text->len < size)
+  {
+    bench_append (text, "/*\n");
+    for (i = 5 + bench_random (20); i > 0; i--)
+      bench_append (text, " * The %zu lines after this are about \"%zu\" things\n", bench_random (100), i);
+    bench_append (text, " */\n");
+
+    for (i = bench_random (4); i > 0; i--)
+    {
+      bench_code_line (text);
+      bench_append (text, " // trailing comment %zu\n", i);
+    }
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Read the benchmark file into a new buffer and switch to
+ *                      it
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  io_load_file is called directly, rather than through buffer_switch, so no
+ *  journal or swap file is made for the benchmark file.
+ *
+ * ************************************************************************** */
+
+static void
+bench_open (void)
+{
+  size_t idx;
+
+  idx = buffer_new (bench_path);
+  io_load_file (editor.buffers[idx]);
+  editor.buffers[idx]->state = BUFFER_LOADED;
+  editor.buffers[idx]->undo.suspended++;
+  editor.buf = editor.buffers[idx];
+  editor.current = idx;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free the buffer of the benchmark file
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+bench_close (void)
+{
+  buffer_free (editor.current, FALSE);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get a line to edit for an op
+ *
+ *  @param[in]          op      The number of the op
+ *
+ *  @return             The index of a line, spread out over the buffer
+ *
+ * ************************************************************************** */
+
+static size_t
+bench_line (size_t op)
+{
+  return (op * 7919) % editor.buf->nlines;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              The benchmarks
+ *
+ *  @param[in]          nops      The number of ops to do
+ *  @param[in,out]      *bytes    Add the number of bytes of text worked over
+ *
+ *  @return             The number of ops done, which is less than nops if the
+ *                      buffer runs out of lines to work on
+ *
+ * ************************************************************************** */
+
+static size_t
+bench_io_load_file (size_t nops, size_t *bytes)
+{
+  size_t i;
+
+  bench_close ();
+  for (i = 0; i < nops; i++)
+  {
+    bench_open ();
+    bench_close ();
+  }
+  bench_open ();
+
+  *bytes = nops * bench_file_size;
+
+  return nops;
+}
+
+static size_t
+bench_io_save_file (size_t nops, size_t *bytes)
+{
+  size_t i;
+
+  /*
+   * Saving a headless buffer skips the journal and swap file, which aren't
+   * wanted next to the benchmark file
+   */
+
+  editor.buf->headless = TRUE;
+  for (i = 0; i < nops; i++)
+    io_save_file ();
+  editor.buf->headless = FALSE;
+
+  *bytes = nops * bench_file_size;
+
+  return nops;
+}
+
+static size_t
+bench_line_insert_char (size_t nops, size_t *bytes)
+{
+  size_t i;
+  size_t line;
+
+  for (i = 0; i < nops; i++)
+  {
+    line = bench_line (i);
+    line_insert_char (editor.buf, line, editor.buf->lines.len[line] / 2, 'x');
+    *bytes += editor.buf->lines.len[line];
+  }
+
+  return i;
+}
+
+static size_t
+bench_line_delete_char (size_t nops, size_t *bytes)
+{
+  size_t i;
+  size_t line;
+
+  for (i = 0; i < nops; i++)
+  {
+    line = bench_line (i);
+    *bytes += editor.buf->lines.len[line];
+    if (editor.buf->lines.len[line] > 0)
+      line_delete_char (editor.buf, line, editor.buf->lines.len[line] / 2);
+  }
+
+  return i;
+}
+
+static size_t
+bench_line_insert_line (size_t nops, size_t *bytes)
+{
+  size_t i;
+  size_t line;
+
+  for (i = 0; i < nops; i++)
+  {
+    line = bench_line (i);
+    line_add_to_text_buffer (editor.buf, line, editor.buf->lines.chars[line], editor.buf->lines.len[line]);
+    *bytes += editor.buf->lines.len[line];
+  }
+
+  return i;
+}
+
+static size_t
+bench_line_delete_line (size_t nops, size_t *bytes)
+{
+  size_t i;
+  size_t line;
+
+  for (i = 0; i < nops && editor.buf->nlines > 1; i++)
+  {
+    line = bench_line (i);
+    *bytes += editor.buf->lines.len[line];
+    line_delete_line (editor.buf, line);
+  }
+
+  return i;
+}
+
+static size_t
+bench_editor_add_to_render_buffer (size_t nops, size_t *bytes)
+{
+  size_t i;
+  size_t line;
+
+  for (i = 0; i < nops; i++)
+  {
+    line = i % editor.buf->nlines;
+    editor_add_to_render_buffer (editor.buf, line);
+    *bytes += editor.buf->lines.len[line];
+  }
+
+  return i;
+}
+
+static size_t
+bench_syntax_update_highlighting (size_t nops, size_t *bytes)
+{
+  size_t i;
+  size_t line;
+
+  for (i = 0; i < nops; i++)
+  {
+    line = i % editor.buf->nlines;
+    syntax_update_highlighting (editor.buf, line);
+    *bytes += editor.buf->lines.r_len[line];
+  }
+
+  return i;
+}
+
+static size_t
+bench_find_keyword_search (size_t nops, size_t *bytes)
+{
+  size_t i;
+
+  for (i = 0; i < nops; i++)
+  {
+    find_clear_results (editor.buf);
+    find_keyword_search (editor.buf, "return", 'n');
+  }
+  find_clear_results (editor.buf);
+
+  *bytes = nops * bench_file_size;
+
+  return nops;
+}
+
+/*
+ * Every match of a regex in one line as long as the file, where each match
+ * could carry on to the end of the line, which is quadratic if each match
+ * rescans the rest of the line
+ */
+
+static size_t
+bench_regex_long_line (size_t nops, size_t *bytes)
+{
+  size_t i;
+  size_t from;
+  size_t match_start;
+  size_t match_end;
+  size_t nmatches;
+  char *line;
+  char *error;
+  REGEX *regex;
+
+  if (!(line = malloc (bench_file_size + 1)))
+    util_exit ("Couldn't allocate memory for the long line");
+  memset (line, 'x', bench_file_size);
+  line[bench_file_size] = '\0';
+  regex = regex_compile ("x|x.*c", FALSE, &error);
+  nmatches = 0;
+
+  for (i = 0; i < nops; i++)
+  {
+    from = 0;
+    while (from <= bench_file_size && regex_search (regex, line, bench_file_size, from, &match_start, &match_end))
+    {
+      nmatches++;
+      from = match_end > match_start ? match_end : match_end + 1;
+    }
+  }
+
+  regex_free (regex);
+  free (line);
+  bench_sink += nmatches;
+  *bytes = nops * bench_file_size;
+
+  return nops;
+}
+
+/*
+ * The search kernel against strstr, searching every line of the text buffer
+ * the way find does. The short needle goes through the SSE2 filter and the
+ * long one through Two-Way
+ */
+
+static size_t
+bench_search_lines (size_t nops, size_t *bytes, char *needle, int kernel)
+{
+  size_t i;
+  size_t j;
+  size_t hay_len;
+  size_t nmatches;
+  size_t needle_len;
+  char *hay;
+  char *match;
+  SEARCH_PATTERN pattern;
+  EDITOR_LINES *lines = &editor.buf->lines;
+
+  needle_len = strlen (needle);
+  search_compile (&pattern, needle, needle_len, FALSE);
+  nmatches = 0;
+
+  for (i = 0; i < nops; i++)
+  {
+    for (j = 0; j < editor.buf->nlines; j++)
+    {
+      if (kernel)
+      {
+        hay = lines->chars[j];
+        hay_len = lines->len[j];
+        while ((match = search_next (&pattern, hay, hay_len)))
+        {
+          nmatches++;
+          hay_len -= (size_t) (match - hay) + needle_len;
+          hay = match + needle_len;
+        }
+      }
+      else
+      {
+        for (hay = lines->chars[j]; (hay = strstr (hay, needle)); hay += needle_len)
+          nmatches++;
+      }
+    }
+  }
+
+  bench_sink += nmatches;
+  *bytes = nops * bench_file_size;
+
+  return nops;
+}
+
+static size_t
+bench_search_kernel_short (size_t nops, size_t *bytes)
+{
+  return bench_search_lines (nops, bytes, BENCH_SHORT_NEEDLE, TRUE);
+}
+
+static size_t
+bench_strstr_short (size_t nops, size_t *bytes)
+{
+  return bench_search_lines (nops, bytes, BENCH_SHORT_NEEDLE, FALSE);
+}
+
+static size_t
+bench_search_kernel_long (size_t nops, size_t *bytes)
+{
+  return bench_search_lines (nops, bytes, BENCH_LONG_NEEDLE, TRUE);
+}
+
+static size_t
+bench_strstr_long (size_t nops, size_t *bytes)
+{
+  return bench_search_lines (nops, bytes, BENCH_LONG_NEEDLE, FALSE);
+}
+
+/*
+ * Scans over the whole text buffer, which only stream through the arrays of
+ * line metadata they use
+ */
+
+static size_t
+bench_scan_line_lengths (size_t nops, size_t *bytes)
+{
+  size_t i;
+  size_t j;
+  size_t total;
+
+  total = 0;
+  for (i = 0; i < nops; i++)
+    for (j = 0; j < editor.buf->nlines; j++)
+      total += editor.buf->lines.len[j];
+
+  bench_sink += total;
+  *bytes = nops * bench_file_size;
+
+  return nops;
+}
+
+static size_t
+bench_scan_memchr (size_t nops, size_t *bytes)
+{
+  size_t i;
+  size_t j;
+  size_t nfound;
+
+  nfound = 0;
+  for (i = 0; i < nops; i++)
+    for (j = 0; j < editor.buf->nlines; j++)
+      if (memchr (editor.buf->lines.chars[j], '{', editor.buf->lines.len[j]))
+        nfound++;
+
+  bench_sink += nfound;
+  *bytes = nops * bench_file_size;
+
+  return nops;
+}
+
+static size_t
+bench_syntax_highlight_buffer (size_t nops, size_t *bytes)
+{
+  size_t i;
+
+  for (i = 0; i < nops; i++)
+    syntax_highlight_buffer (editor.buf);
+
+  *bytes = nops * bench_file_size;
+
+  return nops;
+}
+
+static size_t
+bench_editor_update_screen_buffer (size_t nops, size_t *bytes)
+{
+  int j;
+  size_t i;
+  SCREEN_BUF rows[BENCH_SCREEN_ROWS + 2];
+
+  window_init ();
+  window_layout ();
+
+  for (i = 0; i < nops; i++)
+  {
+    memset (rows, 0, sizeof rows);
+    editor.win->row_offset = (i * BENCH_SCREEN_ROWS) % editor.buf->nlines;
+    editor_update_screen_buffer (rows, editor.win);
+
+    for (j = 0; j < BENCH_SCREEN_ROWS + 2; j++)
+    {
+      *bytes += rows[j].len;
+      free (rows[j].buf);
+    }
+  }
+
+  window_free (editor.root);
+  editor.root = editor.win = NULL;
+
+  return i;
+}
+
+static BENCH benches[] = {
+  {"io_load_file", NULL, bench_io_load_file},
+  {"io_save_file", NULL, bench_io_save_file},
+  {"line_insert_char", "bench.c", bench_line_insert_char},
+  {"line_delete_char", "bench.c", bench_line_delete_char},
+  {"line_insert_line", "bench.c", bench_line_insert_line},
+  {"line_delete_line", "bench.c", bench_line_delete_line},
+  {"editor_add_to_render_buffer", NULL, bench_editor_add_to_render_buffer},
+  {"syntax_update_highlighting/C", "bench.c", bench_syntax_update_highlighting},
+  {"syntax_update_highlighting/FORTRAN", "bench.f90", bench_syntax_update_highlighting},
+  {"syntax_update_highlighting/PY", "bench.py", bench_syntax_update_highlighting},
+  {"find_keyword_search", NULL, bench_find_keyword_search},
+  {"regex_long_line", NULL, bench_regex_long_line},
+  {"search_kernel/short", NULL, bench_search_kernel_short},
+  {"strstr/short", NULL, bench_strstr_short},
+  {"search_kernel/long", NULL, bench_search_kernel_long},
+  {"strstr/long", NULL, bench_strstr_long},
+  {"scan_line_lengths", NULL, bench_scan_line_lengths},
+  {"scan_memchr", NULL, bench_scan_memchr},
+  {"syntax_highlight_buffer", "bench.c", bench_syntax_highlight_buffer},
+  {"editor_update_screen_buffer", "bench.c", bench_editor_update_screen_buffer},
+};
+
+static CORPUS corpora[] = {
+  {"code", bench_generate_code},
+  {"long_lines", bench_generate_long_lines},
+  {"tabs", bench_generate_tabs},
+  {"comments", bench_generate_comments},
+};
+
+/** **************************************************************************
+ *
+ *  @brief              Time a benchmark on the benchmark file
+ *
+ *  @param[in]          *bench        The benchmark
+ *  @param[in]          *corpus       The shape of the benchmark file
+ *  @param[in]          min_time      The shortest run to report, in seconds
+ *  @param[in]          first         Bool flag for the first result printed
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Each run gets a freshly read buffer, so edits made by one run don't change
+ *  the text the next is timed on. The number of ops for the next run is
+ *  worked out from how long the last took, and a run which runs out of lines
+ *  to work on is reported as it is.
+ *
+ * ************************************************************************** */
+
+static void
+bench_time (BENCH *bench, CORPUS *corpus, double min_time, int first)
+{
+  size_t nops;
+  size_t ndone;
+  size_t bytes;
+  double start;
+  double elapsed;
+
+  for (nops = 1;; nops = (size_t) (ndone * (elapsed > 0 && min_time / elapsed < 50 ? 1.5 * min_time / elapsed : 50)))
+  {
+    bench_open ();
+    editor.buf->syntax = bench->syntax ? syntax_match (bench->syntax) : NULL;
+    if (editor.buf->syntax)
+      syntax_highlight_buffer (editor.buf);
+
+    bytes = 0;
+    start = bench_now ();
+    ndone = bench->run (nops, &bytes);
+    elapsed = bench_now () - start;
+
+    bench_close ();
+
+    if (elapsed >= min_time || ndone < nops || ndone == 0)
+      break;
+  }
+
+  printf ("%s    {\"name\": \"%s\", \"corpus\": \"%s\", \"ops\": %zu, \"ns_per_op\": %.1f, \"bytes_per_op\": %.1f}",
+          first ? "" : ",\n", bench->name, corpus->name, ndone, ndone ? elapsed * 1e9 / (double) ndone : 0.0,
+          ndone ? (double) bytes / (double) ndone : 0.0);
+  fflush (stdout);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Run every benchmark on every shape of file
+ *
+ *  @param[in]          argc    The number of command line arguments
+ *  @param[in]          argv    The command line arguments
+ *
+ *  @return             EXIT_SUCCESS or EXIT_FAILURE
+ *
+ * ************************************************************************** */
+
+int
+main (int argc, char *argv[])
+{
+  int i;
+  int fd;
+  int first;
+  size_t j;
+  size_t k;
+  size_t size;
+  double min_time;
+  char *filter;
+  BENCH_TEXT text = {NULL, 0, 0};
+
+  min_time = 0.2;
+  size = 1024 * 1024;
+  filter = NULL;
+
+  for (i = 1; i < argc; i++)
+  {
+    if (!strcmp (argv[i], "--time-ms") && i + 1 < argc)
+      min_time = atof (argv[++i]) / 1000.0;
+    else if (!strcmp (argv[i], "--size-kb") && i + 1 < argc)
+      size = (size_t) atol (argv[++i]) * 1024;
+    else if (argv[i][0] != '-')
+      filter = argv[i];
+    else
+    {
+      fprintf (stderr, "Usage: kris_bench [--time-ms <ms>] [--size-kb <kb>] [name filter]\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  editor.screen_rows = BENCH_SCREEN_ROWS;
+  editor.screen_cols = BENCH_SCREEN_COLS;
+
+  if ((fd = mkstemp (bench_path)) == -1)
+  {
+    perror ("Couldn't create the benchmark file");
+    return EXIT_FAILURE;
+  }
+
+  printf ("{\n  \"size\": %zu,\n  \"benchmarks\": [\n", size);
+
+  first = TRUE;
+  for (j = 0; j < sizeof corpora / sizeof corpora[0]; j++)
+  {
+    bench_seed = 2463534242;
+    text.len = 0;
+    corpora[j].generate (&text, size);
+    bench_file_size = text.len;
+
+    if (ftruncate (fd, 0) == -1 || lseek (fd, 0, SEEK_SET) == -1 || io_write_all (fd, text.buf, text.len) != SUCCESS)
+    {
+      perror ("Couldn't write the benchmark file");
+      unlink (bench_path);
+      return EXIT_FAILURE;
+    }
+
+    for (k = 0; k < sizeof benches / sizeof benches[0]; k++)
+    {
+      if (filter && !strstr (benches[k].name, filter))
+        continue;
+
+      bench_time (&benches[k], &corpora[j], min_time, first);
+      first = FALSE;
+    }
+  }
+
+  printf ("\n  ]\n}\n");
+
+  close (fd);
+  unlink (bench_path);
+  free (text.buf);
+  free (editor.buffers);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,452 @@
+/** **************************************************************************
+ *
+ * @file replay.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Replays a keystroke trace recorded with kris --record and measures
+ *        how long each key takes to be drawn.
+ *
+ * @details
+ *
+ * Kris is run on a pseudo-terminal, so no real terminal is needed. Each key
+ * in the trace is written to the terminal and timed until the frame it causes
+ * has been written back, which is when the cursor is shown again at the end
+ * of editor_refresh_screen. The latency and the bytes written for each frame
+ * are reported as JSON on stdout.
+ *
+ * By default each key is sent as soon as the frame for the last one has been
+ * written. With --realtime, the gaps between the keys in the trace are kept
+ * so any work the editor does while idle happens as it did when recording.
+ *
+ * The trace is replayed for real, so the files given should be copies if the
+ * trace saves anything.
+ *
+ * Usage: kris_replay [--realtime] [--kris <path>] [--rows <n>] [--cols <n>]
+ *                    <trace> [file]...
+ *
+ * ************************************************************************** */
+
+#include <errno.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kris.h"
+
+#define FRAME_END "\x1b[?25h"
+#define FRAME_TIMEOUT_MS 2000
+
+enum frame_results
+{
+  FRAME_DRAWN,
+  FRAME_TIMED_OUT,
+  FRAME_CLOSED
+};
+
+typedef struct REPLAY_KEY
+{
+  double time;                     // When the key was pressed, in seconds
+  char bytes[8];                   // The bytes of the key
+  size_t len;                      // Number of bytes in the key
+} REPLAY_KEY;
+
+typedef struct REPLAY
+{
+  REPLAY_KEY *keys;                // Every key in the trace
+  size_t nkeys;                    // Number of keys
+  size_t capacity;                 // Number of keys allocated
+  int rows, cols;                  // Size of the terminal when recorded
+} REPLAY;
+
+/** **************************************************************************
+ *
+ *  @brief              Get the time from a monotonic clock
+ *
+ *  @return             The time in seconds
+ *
+ * ************************************************************************** */
+
+static double
+replay_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Read a keystroke trace
+ *
+ *  @param[in]          *path       The trace file
+ *  @param[out]         *replay     The keys in the trace
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ * ************************************************************************** */
+
+static int
+replay_read_trace (char *path, REPLAY *replay)
+{
+  int len;
+  unsigned int byte;
+  double usec;
+  char *line;
+  char *hex;
+  size_t line_cap;
+  FILE *trace;
+  REPLAY_KEY *key;
+
+  if (!(trace = fopen (path, "r")))
+    return FAILURE;
+
+  line = NULL;
+  line_cap = 0;
+
+  while (getline (&line, &line_cap, trace) != -1)
+  {
+    if (line[0] == '#')
+    {
+      sscanf (line, "# kris trace %d %d", &replay->rows, &replay->cols);
+      continue;
+    }
+
+    if (sscanf (line, "%lf %n", &usec, &len) != 1)
+      continue;
+
+    if (replay->nkeys == replay->capacity)
+    {
+      replay->capacity = replay->capacity ? 2 * replay->capacity : 256;
+      if (!(replay->keys = realloc (replay->keys, replay->capacity * sizeof *replay->keys)))
+      {
+        perror ("Couldn't allocate memory for the trace");
+        exit (EXIT_FAILURE);
+      }
+    }
+
+    key = &replay->keys[replay->nkeys];
+    key->time = usec / 1e6;
+    key->len = 0;
+    for (hex = &line[len]; key->len < sizeof key->bytes && sscanf (hex, "%2x", &byte) == 1; hex += 2)
+      key->bytes[key->len++] = (char) byte;
+
+    if (key->len > 0)
+      replay->nkeys++;
+  }
+
+  free (line);
+  fclose (trace);
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Read from the terminal until a frame has been written
+ *
+ *  @param[in]          master      The terminal kris is running on
+ *  @param[in]          timeout     How long to wait, in seconds
+ *  @param[out]         *nbytes     The number of bytes read
+ *
+ *  @return             FRAME_DRAWN if a whole frame was read, FRAME_CLOSED if
+ *                      kris exited or FRAME_TIMED_OUT
+ *
+ *  @details
+ *
+ *  The end of the frame can be split across reads, so how much of FRAME_END
+ *  has been matched is carried over from one read to the next.
+ *
+ * ************************************************************************** */
+
+static int
+replay_wait_frame (int master, double timeout, size_t *nbytes)
+{
+  int ms;
+  size_t i;
+  size_t matched;
+  ssize_t nread;
+  double deadline;
+  char buf[65536];
+  struct pollfd output = {0, POLLIN, 0};
+
+  output.fd = master;
+  deadline = replay_now () + timeout;
+  matched = 0;
+  *nbytes = 0;
+
+  while ((ms = (int) ((deadline - replay_now ()) * 1000)) > 0)
+  {
+    if (poll (&output, 1, ms) <= 0)
+      continue;
+
+    if ((nread = read (master, buf, sizeof buf)) <= 0)
+      return FRAME_CLOSED;
+
+    *nbytes += (size_t) nread;
+    for (i = 0; i < (size_t) nread; i++)
+    {
+      if (buf[i] == FRAME_END[matched])
+        matched++;
+      else
+        matched = buf[i] == FRAME_END[0];
+
+      if (matched == sizeof FRAME_END - 1)
+      {
+        if (i + 1 < (size_t) nread)
+          *nbytes -= (size_t) nread - i - 1;
+        return FRAME_DRAWN;
+      }
+    }
+  }
+
+  return FRAME_TIMED_OUT;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Throw away anything kris writes without a key press
+ *
+ *  @param[in]          master      The terminal kris is running on
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+replay_drain (int master)
+{
+  char buf[65536];
+  struct pollfd output = {0, POLLIN, 0};
+
+  output.fd = master;
+  while (poll (&output, 1, 0) > 0 && read (master, buf, sizeof buf) > 0);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Compare two measurements for qsort
+ *
+ * ************************************************************************** */
+
+static int
+replay_compare (const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return (x > y) - (x < y);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Print the spread of some measurements as JSON
+ *
+ *  @param[in]          *name       The name of the measurement
+ *  @param[in,out]      *values     The measurements, which are sorted
+ *  @param[in]          n           The number of measurements
+ *  @param[in]          last        Bool flag for the last thing printed
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+replay_print_spread (char *name, double *values, size_t n, int last)
+{
+  size_t i;
+  double sum;
+
+  qsort (values, n, sizeof *values, replay_compare);
+
+  for (i = 0, sum = 0; i < n; i++)
+    sum += values[i];
+
+  printf ("  \"%s\": {\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f, \"mean\": %.1f}%s\n", name,
+          n ? values[(n * 50 + 99) / 100 - 1] : 0.0, n ? values[(n * 99 + 99) / 100 - 1] : 0.0,
+          n ? values[n - 1] : 0.0, n ? sum / (double) n : 0.0, last ? "" : ",");
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Replay a trace and report how long each key took
+ *
+ *  @param[in]          argc    The number of command line arguments
+ *  @param[in]          argv    The command line arguments
+ *
+ *  @return             EXIT_SUCCESS or EXIT_FAILURE
+ *
+ * ************************************************************************** */
+
+int
+main (int argc, char *argv[])
+{
+  int i;
+  int master;
+  int status;
+  int realtime;
+  int result;
+  pid_t pid;
+  size_t k;
+  size_t nbytes;
+  size_t nframes;
+  size_t nmissed;
+  double start;
+  double sent;
+  double *latency;
+  double *frame_bytes;
+  char *kris;
+  char **kris_argv;
+  REPLAY replay = {NULL, 0, 0, 24, 80};
+  struct winsize ws;
+
+  realtime = FALSE;
+  kris = "./kris";
+  ws.ws_row = 0;
+  ws.ws_col = 0;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+  {
+    if (!strcmp (argv[i], "--realtime"))
+      realtime = TRUE;
+    else if (!strcmp (argv[i], "--kris") && i + 1 < argc)
+      kris = argv[++i];
+    else if (!strcmp (argv[i], "--rows") && i + 1 < argc)
+      ws.ws_row = (unsigned short) atoi (argv[++i]);
+    else if (!strcmp (argv[i], "--cols") && i + 1 < argc)
+      ws.ws_col = (unsigned short) atoi (argv[++i]);
+    else
+      break;
+  }
+
+  if (i >= argc || argv[i][0] == '-')
+  {
+    fprintf (stderr, "Usage: kris_replay [--realtime] [--kris <path>] [--rows <n>] [--cols <n>] <trace> [file]...\n");
+    return EXIT_FAILURE;
+  }
+
+  if (replay_read_trace (argv[i], &replay) == FAILURE)
+  {
+    fprintf (stderr, "kris_replay: couldn't read %s: %s\n", argv[i], strerror (errno));
+    return EXIT_FAILURE;
+  }
+
+  /*
+   * Start kris on a terminal of the recorded size with the rest of the
+   * arguments, and wait for it to draw the first frame before typing
+   */
+
+  if (ws.ws_row == 0)
+    ws.ws_row = (unsigned short) replay.rows;
+  if (ws.ws_col == 0)
+    ws.ws_col = (unsigned short) replay.cols;
+  ws.ws_xpixel = ws.ws_ypixel = 0;
+
+  if (!(kris_argv = calloc ((size_t) (argc - i + 1), sizeof *kris_argv)))
+  {
+    perror ("Couldn't allocate memory for the arguments");
+    return EXIT_FAILURE;
+  }
+
+  kris_argv[0] = kris;
+  for (k = 1; (int) k < argc - i; k++)
+    kris_argv[k] = argv[i + (int) k];
+
+  if ((pid = forkpty (&master, NULL, NULL, &ws)) == -1)
+  {
+    perror ("Couldn't start kris on a pseudo-terminal");
+    return EXIT_FAILURE;
+  }
+
+  if (pid == 0)
+  {
+    execv (kris, kris_argv);
+    perror ("Couldn't run kris");
+    _exit (127);
+  }
+
+  if (replay_wait_frame (master, 10.0, &nbytes) != FRAME_DRAWN)
+  {
+    fprintf (stderr, "kris_replay: kris didn't draw the screen\n");
+    kill (pid, SIGKILL);
+    return EXIT_FAILURE;
+  }
+
+  /*
+   * Type each key and time how long it takes for the frame to be written
+   */
+
+  if (!(latency = malloc ((replay.nkeys + 1) * sizeof *latency))
+      || !(frame_bytes = malloc ((replay.nkeys + 1) * sizeof *frame_bytes)))
+  {
+    perror ("Couldn't allocate memory for the measurements");
+    return EXIT_FAILURE;
+  }
+
+  nframes = 0;
+  nmissed = 0;
+  start = replay_now ();
+
+  for (k = 0; k < replay.nkeys; k++)
+  {
+    if (realtime && replay.keys[k].time - replay.keys[0].time > replay_now () - start)
+      usleep ((useconds_t) ((replay.keys[k].time - replay.keys[0].time - (replay_now () - start)) * 1e6));
+
+    replay_drain (master);
+
+    sent = replay_now ();
+    if (write (master, replay.keys[k].bytes, replay.keys[k].len) != (ssize_t) replay.keys[k].len)
+      break;
+
+    result = replay_wait_frame (master, FRAME_TIMEOUT_MS / 1000.0, &nbytes);
+    if (result == FRAME_DRAWN)
+    {
+      latency[nframes] = (replay_now () - sent) * 1e6;
+      frame_bytes[nframes] = (double) nbytes;
+      nframes++;
+    }
+    else if (result == FRAME_TIMED_OUT)
+    {
+      nmissed++;
+    }
+    else
+    {
+      waitpid (pid, &status, 0);
+      pid = -1;
+      break;
+    }
+  }
+
+  /*
+   * Stop kris if the trace didn't quit it
+   */
+
+  if (pid != -1 && waitpid (pid, &status, WNOHANG) == 0)
+  {
+    kill (pid, SIGTERM);
+    waitpid (pid, &status, 0);
+  }
+  close (master);
+
+  printf ("{\n  \"keys\": %zu,\n  \"frames\": %zu,\n  \"missed\": %zu,\n", replay.nkeys, nframes, nmissed);
+  replay_print_spread ("latency_us", latency, nframes, FALSE);
+  replay_print_spread ("bytes_per_frame", frame_bytes, nframes, TRUE);
+  printf ("}\n");
+
+  free (replay.keys);
+  free (kris_argv);
+  free (latency);
+  free (frame_bytes);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,461 @@
+/** **************************************************************************
+ *
+ * @file batch.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for running a script of edits over files without a
+ *        terminal.
+ *
+ * ************************************************************************** */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Print an error for a line of a script
+ *
+ *  @param[in]          *script     The name of the script
+ *  @param[in]          lineno      The line of the script, starting at 1
+ *  @param[in]          *fmt        The format of the error message
+ *  @param[in]          ...         The arguments for the format
+ *
+ *  @return             FAILURE
+ *
+ * ************************************************************************** */
+
+static int
+batch_error (char *script, size_t lineno, char *fmt, ...)
+{
+  va_list va;
+
+  fprintf (stderr, "%s:%zu: %s: ", script, lineno, editor.buf->filename);
+  va_start (va, fmt);
+  vfprintf (stderr, fmt, va);
+  va_end (va);
+  fputc ('\n', stderr);
+
+  return FAILURE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Turn the escapes in a script argument into the chars
+ *                      they stand for
+ *
+ *  @param[in,out]      *s      The argument, which is changed in place
+ *
+ *  @return             The length of the argument afterwards
+ *
+ *  @details
+ *
+ *  \n, \t and \\ are understood, and any other char after a \ is kept as it
+ *  is, so \\1 in a regex still reaches the regex as \1.
+ *
+ * ************************************************************************** */
+
+static size_t
+batch_unescape (char *s)
+{
+  size_t i;
+  size_t len;
+
+  for (i = 0, len = 0; s[i] != '\0'; i++)
+  {
+    if (s[i] == '\\' && s[i + 1] == 'n')
+      s[len++] = '\n', i++;
+    else if (s[i] == '\\' && s[i + 1] == 't')
+      s[len++] = '\t', i++;
+    else if (s[i] == '\\' && s[i + 1] == '\\')
+      s[len++] = '\\', i++;
+    else
+      s[len++] = s[i];
+  }
+
+  s[len] = '\0';
+
+  return len;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Read a count from a script argument
+ *
+ *  @param[in]          *arg      The argument
+ *  @param[out]         *count    The count
+ *
+ *  @return             TRUE if the argument is a whole number, FALSE otherwise
+ *
+ * ************************************************************************** */
+
+static int
+batch_parse_count (char *arg, size_t *count)
+{
+  char *end;
+
+  if (arg == NULL || *arg < '0' || *arg > '9')
+    return FALSE;
+
+  errno = 0;
+  *count = strtoul (arg, &end, 10);
+
+  return errno == 0 && *end == '\0';
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Run one line of a script on the buffer being edited
+ *
+ *  @param[in]          *script       The name of the script
+ *  @param[in]          lineno        The line of the script, starting at 1
+ *  @param[in,out]      *cmd          The line, which is changed while parsing
+ *  @param[in,out]      *searched     Bool flag for the last command being a
+ *                                    search which matched
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ *  @details
+ *
+ *  The command is the first word of the line and everything after the space
+ *  following it is the argument, so text to insert can start with spaces.
+ *  A search starts at the cursor, or just after it if the last command was a
+ *  search, so searching for the same text again moves on to the next match.
+ *
+ * ************************************************************************** */
+
+static int
+batch_command (char *script, size_t lineno, char *cmd, int *searched)
+{
+  int was_searched;
+  size_t len;
+  size_t line;
+  size_t col;
+  size_t count;
+  size_t nlines;
+
+  char *arg;
+  char *with;
+  char *end;
+  char *nl;
+  char *error;
+  char delim;
+
+  EDITOR_BUFFER *buf = editor.buf;
+
+  while (*cmd == ' ' || *cmd == '\t')
+    cmd++;
+
+  if (*cmd == '\0' || *cmd == '#')
+    return SUCCESS;
+
+  arg = NULL;
+  if ((end = strchr (cmd, ' ')))
+  {
+    *end = '\0';
+    arg = end + 1;
+  }
+
+  was_searched = *searched;
+  *searched = FALSE;
+
+  if (!strcmp (cmd, "goto"))
+  {
+    /*
+     * goto <line> [col | $] puts the cursor on a line, counting from 1. A line
+     * past the end goes to just after the last line, where an insert starts a
+     * new line, and a col past the end of the line goes to the end of it
+     */
+
+    end = NULL;
+    if (arg && (end = strchr (arg, ' ')))
+      *end++ = '\0';
+
+    if (!batch_parse_count (arg, &line) || line == 0)
+      return batch_error (script, lineno, "goto needs a line number");
+
+    buf->cy = line <= buf->nlines ? line - 1 : buf->nlines;
+    len = buf->cy < buf->nlines ? buf->lines.len[buf->cy] : 0;
+
+    if (end == NULL)
+      buf->cx = 0;
+    else if (!strcmp (end, "$"))
+      buf->cx = len;
+    else if (batch_parse_count (end, &col) && col > 0)
+      buf->cx = col - 1 <= len ? col - 1 : len;
+    else
+      return batch_error (script, lineno, "goto needs a column number or $");
+  }
+  else if (!strcmp (cmd, "insert"))
+  {
+    /*
+     * insert <text> inserts before the cursor and leaves the cursor after the
+     * text
+     */
+
+    if (arg == NULL || (len = batch_unescape (arg)) == 0)
+      return batch_error (script, lineno, "insert needs some text");
+
+    if (buf->cy == buf->nlines)
+      line_add_to_text_buffer (buf, buf->nlines, "", 0);
+
+    line_insert_text (buf, buf->cy, buf->cx, arg, len);
+
+    for (end = arg; (nl = strchr (end, '\n')); end = nl + 1)
+      buf->cy++;
+    buf->cx = end == arg ? buf->cx + len : len - (size_t) (end - arg);
+  }
+  else if (!strcmp (cmd, "delete"))
+  {
+    /*
+     * delete <count> deletes chars from the cursor on, where the end of a line
+     * counts as one, and delete line [count] deletes whole lines
+     */
+
+    if (arg && !strncmp (arg, "line", 4) && (arg[4] == '\0' || arg[4] == ' '))
+    {
+      count = 1;
+      if (arg[4] == ' ' && (!batch_parse_count (&arg[5], &count) || count == 0))
+        return batch_error (script, lineno, "delete line needs a number of lines");
+
+      while (count-- > 0 && buf->cy < buf->nlines)
+        line_delete_line (buf, buf->cy);
+      buf->cx = 0;
+    }
+    else if (batch_parse_count (arg, &count) && count > 0)
+    {
+      if (buf->cy < buf->nlines)
+        line_delete_text (buf, buf->cy, buf->cx, count);
+    }
+    else
+    {
+      return batch_error (script, lineno, "delete needs a number of chars or line");
+    }
+  }
+  else if (!strcmp (cmd, "search"))
+  {
+    /*
+     * search <text> moves the cursor to the start of the next match, and stops
+     * the script if there isn't one
+     */
+
+    if (arg == NULL || (len = batch_unescape (arg)) == 0 || strchr (arg, '\n'))
+      return batch_error (script, lineno, "search needs some text on one line");
+
+    line = buf->cy;
+    col = buf->cx + (was_searched ? 1 : 0);
+    if (line >= buf->nlines || !find_next_match (buf, arg, &line, &col, &error))
+    {
+      if (error)
+        return batch_error (script, lineno, "invalid regex: %s", error);
+      return batch_error (script, lineno, "no match for \"%s\"", arg);
+    }
+
+    buf->cy = line;
+    buf->cx = col;
+    *searched = TRUE;
+  }
+  else if (!strcmp (cmd, "replace"))
+  {
+    /*
+     * replace /old/new/ replaces every match in the buffer. Any char can be
+     * used instead of /, and the last one can be left off
+     */
+
+    if (arg == NULL || (delim = *arg) == '\0' || !(with = strchr (arg + 1, delim)))
+      return batch_error (script, lineno, "replace needs /old/new/");
+
+    *with++ = '\0';
+    if ((end = strchr (with, delim)))
+      *end = '\0';
+
+    arg++;
+    if (batch_unescape (arg) == 0 || strchr (arg, '\n'))
+      return batch_error (script, lineno, "replace needs some text on one line to replace");
+    batch_unescape (with);
+    if (strchr (with, '\n'))
+      return batch_error (script, lineno, "the replacement can't contain a new line");
+
+    if (find_replace_all (buf, arg, with, &nlines, &error) == NO_MATCH)
+      return batch_error (script, lineno, "invalid regex: %s", error);
+  }
+  else if (!strcmp (cmd, "set"))
+  {
+    /*
+     * set regex|icase|word on|off changes the search modes used by search and
+     * replace
+     */
+
+    end = NULL;
+    if (arg && (end = strchr (arg, ' ')))
+      *end++ = '\0';
+
+    if (end == NULL || (strcmp (end, "on") && strcmp (end, "off")))
+      return batch_error (script, lineno, "set needs a mode and on or off");
+
+    if (!strcmp (arg, "regex"))
+      buf->search.regex = !strcmp (end, "on");
+    else if (!strcmp (arg, "icase"))
+      buf->search.icase = !strcmp (end, "on");
+    else if (!strcmp (arg, "word"))
+      buf->search.word = !strcmp (end, "on");
+    else
+      return batch_error (script, lineno, "unknown search mode %s", arg);
+  }
+  else if (!strcmp (cmd, "save"))
+  {
+    /*
+     * save [file] writes the buffer to its file, or to another file which is
+     * then the file of the buffer
+     */
+
+    if (arg && *arg)
+    {
+      free (buf->filename);
+      if (!(buf->filename = strdup (arg)))
+        util_exit ("Couldn't allocate memory for a file name");
+    }
+
+    if (io_save_file () != SUCCESS)
+      return batch_error (script, lineno, "couldn't save: %s", strerror (errno));
+  }
+  else
+  {
+    return batch_error (script, lineno, "unknown command %s", cmd);
+  }
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Run a script of edits over some files
+ *
+ *  @param[in]          *script     The name of the script file
+ *  @param[in]          nfiles      The number of files to edit
+ *  @param[in]          **files     The names of the files to edit
+ *
+ *  @return             EXIT_SUCCESS if the script ran to the end for every
+ *                      file, EXIT_FAILURE otherwise
+ *
+ *  @details
+ *
+ *  This uses the same text buffer and edit functions as the editor, so a
+ *  script gives the same file as making the edits by hand, but nothing is
+ *  drawn and there is no undo log, journal or swap file. The files are all
+ *  read in on the worker pool to start with, then the script is run over each
+ *  in turn and the buffer is freed. A file is only written by the save
+ *  command, and if a command fails the rest of the script is skipped for that
+ *  file and the error is printed to stderr.
+ *
+ * ************************************************************************** */
+
+int
+batch_run (char *script, int nfiles, char **files)
+{
+  int i;
+  int status;
+  int searched;
+  size_t j;
+  size_t ncmds;
+  size_t cmds_cap;
+  size_t line_cap;
+  ssize_t line_len;
+
+  char *line;
+  char **cmds;
+  FILE *script_file;
+
+  editor.headless = TRUE;
+
+  if (!(script_file = fopen (script, "r")))
+  {
+    fprintf (stderr, "kris: couldn't open script %s: %s\n", script, strerror (errno));
+    return EXIT_FAILURE;
+  }
+
+  cmds = NULL;
+  ncmds = cmds_cap = 0;
+  line = NULL;
+  line_cap = 0;
+
+  /*
+   * Read in the script once, then each file gets its own copy of each line
+   * as parsing changes it
+   */
+
+  while ((line_len = getline (&line, &line_cap, script_file)) != -1)
+  {
+    while (line_len > 0 && (line[line_len - 1] == '\n' || line[line_len - 1] == '\r'))
+      line[--line_len] = '\0';
+
+    if (ncmds == cmds_cap)
+    {
+      cmds_cap = cmds_cap ? 2 * cmds_cap : 16;
+      if (!(cmds = realloc (cmds, cmds_cap * sizeof *cmds)))
+        util_exit ("Couldn't allocate memory for the script");
+    }
+
+    if (!(cmds[ncmds++] = strdup (line)))
+      util_exit ("Couldn't allocate memory for the script");
+  }
+
+  free (line);
+  fclose (script_file);
+
+  for (i = 0; i < nfiles; i++)
+    if (buffer_find (files[i]) == NO_MATCH)
+      buffer_load (buffer_new (files[i]));
+
+  /*
+   * Run the script over each file in the order given
+   */
+
+  status = EXIT_SUCCESS;
+  while (editor.nbuffers > 0)
+  {
+    if (!buffer_switch (0))
+    {
+      fprintf (stderr, "kris: couldn't open %s: %s\n", editor.buf->filename, strerror (editor.buf->load_error));
+      status = EXIT_FAILURE;
+    }
+    else
+    {
+      editor.buf->undo.suspended++;
+      searched = FALSE;
+
+      for (j = 0; j < ncmds; j++)
+      {
+        if (!(line = strdup (cmds[j])))
+          util_exit ("Couldn't allocate memory for the script");
+
+        if (batch_command (script, j + 1, line, &searched) != SUCCESS)
+        {
+          status = EXIT_FAILURE;
+          free (line);
+          break;
+        }
+
+        free (line);
+      }
+    }
+
+    buffer_free (0, FALSE);
+  }
+
+  for (j = 0; j < ncmds; j++)
+    free (cmds[j]);
+  free (cmds);
+  free (editor.buffers);
+  editor.buffers = NULL;
+  editor.buffers_capacity = 0;
+
+  return status;
+}
@@ -0,0 +1,392 @@
+/** **************************************************************************
+ *
+ * @file buffer.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for keeping a list of open buffers, opening files in them
+ *        and switching between them.
+ *
+ * ************************************************************************** */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Add a new buffer to the list of buffers
+ *
+ *  @param[in]          *filename     The file the buffer is for, or NULL for
+ *                                    an empty buffer
+ *
+ *  @return             The index of the new buffer
+ *
+ *  @details
+ *
+ *  The buffer is made by buffer_create, and is headless when running a script.
+ *  The file isn't read until the buffer is loaded or first switched to, so a
+ *  buffer which is never looked at only costs the memory of the struct. The
+ *  syntax highlighting rules are not copied into the buffer, it points into
+ *  the table of rules shared by every buffer.
+ *
+ * ************************************************************************** */
+
+size_t
+buffer_new (char *filename)
+{
+  EDITOR_BUFFER *buf;
+
+  if (editor.nbuffers == editor.buffers_capacity)
+  {
+    editor.buffers_capacity = editor.buffers_capacity ? 2 * editor.buffers_capacity : 8;
+    if (!(editor.buffers = realloc (editor.buffers, editor.buffers_capacity * sizeof *editor.buffers)))
+      util_exit ("Couldn't allocate memory for the buffer list");
+  }
+
+  buf = buffer_create (filename);
+  buf->headless = editor.headless;
+  buf->hl_timed = editor.hud.enabled;
+  editor.buffers[editor.nbuffers] = buf;
+
+  return editor.nbuffers++;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the buffer for a file
+ *
+ *  @param[in]          *filename     The name of the file
+ *
+ *  @return             The index of the buffer, or NO_MATCH if the file isn't
+ *                      open
+ *
+ * ************************************************************************** */
+
+size_t
+buffer_find (char *filename)
+{
+  size_t i;
+
+  for (i = 0; i < editor.nbuffers; i++)
+    if (editor.buffers[i]->filename && !strcmp (editor.buffers[i]->filename, filename))
+      return i;
+
+  return NO_MATCH;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start reading the file of a buffer in the background
+ *
+ *  @param[in]          idx     The index of the buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The file is read and highlighted on the worker pool. Nothing else touches
+ *  the buffer until it is switched to, which waits for the read to finish.
+ *
+ * ************************************************************************** */
+
+void
+buffer_load (size_t idx)
+{
+  EDITOR_BUFFER *buf = editor.buffers[idx];
+
+  if (buf->state != BUFFER_UNLOADED)
+    return;
+
+  buf->state = BUFFER_LOADING;
+  pool_submit (&buf->load, io_load_file, buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Make a buffer the one being edited
+ *
+ *  @param[in]          idx     The index of the buffer
+ *
+ *  @return             FALSE if the file of the buffer had to be read and
+ *                      couldn't be, TRUE otherwise
+ *
+ *  @details
+ *
+ *  Switching is only changing a pointer, as everything belonging to a buffer
+ *  is kept in its struct. If the buffer hasn't been switched to before, this
+ *  waits for its file to be read in, starting the read if it hasn't been
+ *  already. A file which doesn't exist yet keeps its name, so it's created
+ *  when saved.
+ *
+ * ************************************************************************** */
+
+int
+buffer_switch (size_t idx)
+{
+  int finish;
+  EDITOR_BUFFER *buf = editor.buffers[idx];
+
+  if (buf->state == BUFFER_UNLOADED)
+    buffer_load (idx);
+
+  if ((finish = buf->state == BUFFER_LOADING))
+  {
+    pool_wait (&buf->load);
+    buf->state = BUFFER_LOADED;
+  }
+
+  editor.current = idx;
+  editor.buf = buf;
+  if (editor.win)
+    editor.win->buf = buf;
+
+  return finish ? io_finish_load () : TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Switch to the next or previous buffer
+ *
+ *  @param[in]          step      1 for the next buffer, -1 for the previous
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+buffer_next (int step)
+{
+  if (editor.nbuffers < 2)
+  {
+    editor_set_status_message ("There is only one buffer open");
+    return;
+  }
+
+  if (step > 0)
+    buffer_switch ((editor.current + 1) % editor.nbuffers);
+  else
+    buffer_switch ((editor.current + editor.nbuffers - 1) % editor.nbuffers);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free everything belonging to a buffer
+ *
+ *  @param[in]          idx       The index of the buffer
+ *  @param[in]          discard   Bool flag for deleting the journal and swap
+ *                                file of the buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The buffer is removed from the list and freed by buffer_destroy. If it was the buffer being edited,
+ *  editor.buf is set to NULL and another buffer has to be switched to before
+ *  editing can carry on.
+ *
+ * ************************************************************************** */
+
+void
+buffer_free (size_t idx, int discard)
+{
+  EDITOR_BUFFER *buf = editor.buffers[idx];
+
+  memmove (&editor.buffers[idx], &editor.buffers[idx + 1], (editor.nbuffers - idx - 1) * sizeof *editor.buffers);
+  editor.nbuffers--;
+
+  if (editor.buf == buf)
+    editor.buf = NULL;
+  else if (editor.current > idx)
+    editor.current--;
+
+  buffer_destroy (buf, discard);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Count the buffers with unsaved changes
+ *
+ *  @return             The number of modified buffers
+ *
+ * ************************************************************************** */
+
+size_t
+buffer_count_modified (void)
+{
+  size_t i;
+  size_t nmodified = 0;
+
+  for (i = 0; i < editor.nbuffers; i++)
+    if (editor.buffers[i]->modified)
+      nmodified++;
+
+  return nmodified;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Flush the journal and autosave every loaded buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Edits to a buffer which has been switched away from still have to reach
+ *  its journal and swap file, so this ticks every buffer and not only the
+ *  one being edited.
+ *
+ * ************************************************************************** */
+
+void
+buffer_tick (void)
+{
+  size_t i;
+
+  for (i = 0; i < editor.nbuffers; i++)
+  {
+    if (editor.buffers[i]->state != BUFFER_LOADED)
+      continue;
+
+    journal_tick (editor.buffers[i]);
+    swap_tick (editor.buffers[i]);
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Show the list of buffers in the status bar
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Each buffer is shown with its number, and the one being edited is marked
+ *  with a *. Buffers with unsaved changes are marked with a +, and buffers
+ *  which haven't been switched to yet show whether their file is still being
+ *  read.
+ *
+ * ************************************************************************** */
+
+void
+buffer_list (void)
+{
+  int len;
+  size_t i;
+  char *state;
+  char list[sizeof editor.status_msg];
+  EDITOR_BUFFER *buf;
+
+  len = 0;
+  for (i = 0; i < editor.nbuffers && len < (int) sizeof list; i++)
+  {
+    buf = editor.buffers[i];
+
+    if (buf->state == BUFFER_UNLOADED)
+      state = " (not loaded)";
+    else if (buf->state == BUFFER_LOADING && !pool_group_done (&buf->load))
+      state = " (loading)";
+    else if (buf->state == BUFFER_LOADING)
+      state = " (ready)";
+    else
+      state = "";
+
+    len += snprintf (&list[len], sizeof list - (size_t) len, "%s%zu:%s%s%s%s", i ? " | " : "", i + 1,
+                     i == editor.current ? "*" : "", buf->filename ? buf->filename : "[No File]",
+                     buf->modified ? "+" : "", state);
+  }
+
+  editor_set_status_message ("%s", list);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Finish loading the file of the buffer being edited
+ *
+ *  @return             TRUE if the file could be read, FALSE otherwise
+ *
+ *  @details
+ *
+ *  This is done on the main thread once io_load_file has finished, as big
+ *  files are indexed for searching and any unsaved edits left in the file's
+ *  journal or swap file are offered for recovery, which needs the user. A
+ *  script has no user and is only run once over the file, so none of that is
+ *  done then.
+ *
+ *  A file which doesn't exist yet is a new file, which is created when it's
+ *  saved. It gets a journal and swap file like any other, so what's typed
+ *  before the first save isn't lost. A script can't create files this way, as
+ *  a missing file is more likely to be a typo.
+ *
+ * ************************************************************************** */
+
+int
+io_finish_load (void)
+{
+  if (editor.buf->load_error && (editor.buf->load_error != ENOENT || editor.buf->headless))
+  {
+    editor_set_status_message ("Couldn't open file %s: %s", editor.buf->filename,
+                               strerror (editor.buf->load_error));
+    return FALSE;
+  }
+
+  if (editor.buf->headless)
+    return TRUE;
+
+  if (editor.buf->load_error == ENOENT)
+    editor_set_status_message ("New file %s", editor.buf->filename);
+
+  /*
+   * Big files are likely to be searched a lot, so start indexing them
+   */
+
+  if (editor.buf->nlines >= TRIGRAM_AUTO_MIN_LINES)
+    trigram_enable (editor.buf);
+
+  journal_open (editor.buf, editor.buf->filename, journal_prompt);
+  swap_open (editor.buf, editor.buf->filename, swap_prompt);
+
+  return TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Open a file in a buffer and switch to it
+ *
+ *  @param[in]          *filename     The name of the file to open
+ *
+ *  @return             TRUE if the file was opened, FALSE otherwise
+ *
+ *  @details
+ *
+ *  If the file is already open then its buffer is switched to, so the cursor
+ *  and any unsaved changes are kept. Otherwise the file is read into a new
+ *  buffer, which is thrown away again if the file can't be read.
+ *
+ * ************************************************************************** */
+
+int
+io_open_file (char *filename)
+{
+  size_t idx;
+  size_t prev;
+
+  if ((idx = buffer_find (filename)) != NO_MATCH)
+    return buffer_switch (idx);
+
+  prev = editor.current;
+  idx = buffer_new (filename);
+
+  if (buffer_switch (idx))
+    return TRUE;
+
+  buffer_switch (prev);
+  buffer_free (idx, FALSE);
+
+  return FALSE;
+}
@@ -0,0 +1,349 @@
+/** **************************************************************************
+ *
+ * @file command.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for running commands typed into the status bar.
+ *
+ * ************************************************************************** */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Turn the trigram index on or off
+ *
+ *  @param[in]          *arg     "on", "off" or an empty string to show the
+ *                               state of the index
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+command_index (char *arg)
+{
+  char stats[160];
+
+  if (!strcmp (arg, "on"))
+  {
+    trigram_enable (editor.buf);
+  }
+  else if (!strcmp (arg, "off"))
+  {
+    trigram_disable (editor.buf);
+  }
+  else if (arg[0] != '\0')
+  {
+    editor_set_status_message ("Usage: index [on | off]");
+    return;
+  }
+
+  trigram_stats (editor.buf, stats, sizeof stats);
+  editor_set_status_message ("%s", stats);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Show the memory used by the text buffer
+ *
+ *  @param[in]          *arg     A category, such as render, or an empty
+ *                               string to show every category
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The statistics of the trigram index are shown by the index command.
+ *
+ * ************************************************************************** */
+
+static void
+command_stats (char *arg)
+{
+  char stats[160];
+
+  if (memory_stats (arg, stats, sizeof stats) == FAILURE)
+  {
+    editor_set_status_message ("Usage: stats [chars | render | syn_hl | lines | screen | search | undo]");
+    return;
+  }
+
+  editor_set_status_message ("%s", stats);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              List the open buffers or switch to one
+ *
+ *  @param[in]          *arg     The number of the buffer to switch to, or an
+ *                               empty string to list the buffers
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+command_buffer (char *arg)
+{
+  char *end;
+  unsigned long idx;
+
+  if (arg[0] == '\0')
+  {
+    buffer_list ();
+    return;
+  }
+
+  idx = strtoul (arg, &end, 10);
+  if (*end != '\0' || idx == 0 || idx > editor.nbuffers)
+  {
+    editor_set_status_message ("Usage: buffer [1 to %zu]", editor.nbuffers);
+    return;
+  }
+
+  buffer_switch ((size_t) idx - 1);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Open a file in a new buffer
+ *
+ *  @param[in]          *arg     The name of the file
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+command_open (char *arg)
+{
+  if (arg[0] == '\0')
+  {
+    editor_set_status_message ("Usage: open <file>");
+    return;
+  }
+
+  io_open_file (arg);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Split the window being edited into two stacked windows
+ *
+ *  @param[in]          *arg     Unused
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+command_split (char *arg)
+{
+  (void) arg;
+
+  window_split (WINDOW_STACKED);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Split the window being edited into two windows side by
+ *                      side
+ *
+ *  @param[in]          *arg     Unused
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+command_vsplit (char *arg)
+{
+  (void) arg;
+
+  window_split (WINDOW_SIDE_BY_SIDE);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Close the window being edited
+ *
+ *  @param[in]          *arg     Unused
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+command_close (char *arg)
+{
+  (void) arg;
+
+  window_close ();
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Search every file under the current directory
+ *
+ *  @param[in]          *arg     The text to search for
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+command_grep (char *arg)
+{
+  grep_directory (arg);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Set the memory limit of the undo history
+ *
+ *  @param[in]          *arg     The limit in MB, or an empty string to show
+ *                               the state of the undo history
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  When the limit is lowered, the oldest undo steps are thrown away the next
+ *  time the text buffer is changed.
+ *
+ * ************************************************************************** */
+
+static void
+command_undo (char *arg)
+{
+  char *end;
+  char stats[160];
+  unsigned long limit;
+
+  if (arg[0] != '\0')
+  {
+    limit = strtoul (arg, &end, 10);
+    if (*end != '\0' || limit == 0 || limit > SIZE_MAX >> 20)
+    {
+      editor_set_status_message ("Usage: undo [limit in MB]");
+      return;
+    }
+    editor.buf->undo.memory_cap = (size_t) limit << 20;
+  }
+
+  undo_stats (editor.buf, stats, sizeof stats);
+  editor_set_status_message ("%s", stats);
+}
+
+#ifdef KRIS_TRACE
+/** **************************************************************************
+ *
+ *  @brief              Write the trace events recorded so far to the trace
+ *                      file
+ *
+ *  @param[in]          *arg     Unused
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+command_trace (char *arg)
+{
+  char *path;
+
+  (void) arg;
+
+  if (!(path = getenv ("KRIS_TRACE_FILE")))
+    path = TRACE_DEFAULT_FILE;
+
+  if (trace_dump () == SUCCESS)
+    editor_set_status_message ("Wrote the trace to %s", path);
+  else
+    editor_set_status_message ("Couldn't write the trace");
+}
+#endif
+
+static const struct
+{
+  char *name;                      // The name of the command
+  void (*func) (char *arg);        // The function which runs the command
+} commands[] = {
+  {"buffer", command_buffer},
+  {"close", command_close},
+  {"grep", command_grep},
+  {"hud", hud_toggle},
+  {"index", command_index},
+  {"open", command_open},
+  {"split", command_split},
+  {"stats", command_stats},
+#ifdef KRIS_TRACE
+  {"trace", command_trace},
+#endif
+  {"undo", command_undo},
+  {"vsplit", command_vsplit},
+};
+
+/** **************************************************************************
+ *
+ *  @brief              Prompt for a command and run it
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  A command is a name, optionally followed by a space and an argument. The
+ *  commands are,
+ *    - buffer [n]          list the open buffers or switch to buffer n
+ *    - close               close the window being edited
+ *    - grep <text>         search every file under the current directory
+ *    - hud [on | off]      show timings and memory use in the message bar
+ *    - index [on | off]    turn the trigram index on or off
+ *    - open <file>         open a file in a new buffer
+ *    - split               split the window into two, one above the other
+ *    - stats [category]    show the memory used by the text buffer
+ *    - trace               write the trace events so far, in KRIS_TRACE builds
+ *    - undo [limit in MB]  set the memory limit of the undo history
+ *    - vsplit              split the window into two, side by side
+ *
+ * ************************************************************************** */
+
+void
+command_prompt (void)
+{
+  size_t i;
+  size_t name_len;
+
+  char *arg;
+  char *input;
+
+  if ((input = io_status_bar_prompt ("Command: %s (buffer [n] | close | grep <text> | hud | index [on | off] | open <file> | split | stats [category] | undo [MB] | vsplit)", NULL)) == NULL)
+    return;
+
+  name_len = strcspn (input, " ");
+  arg = &input[name_len];
+  while (*arg == ' ')
+    arg++;
+
+  for (i = 0; i < sizeof commands / sizeof commands[0]; i++)
+  {
+    if (strlen (commands[i].name) == name_len && !strncmp (commands[i].name, input, name_len))
+    {
+      commands[i].func (arg);
+      break;
+    }
+  }
+
+  if (i == sizeof commands / sizeof commands[0])
+    editor_set_status_message ("Unknown command: %s", input);
+
+  free (input);
+}
@@ -10,7 +10,6 @@
  *
  * ************************************************************************** */
 
-#include <ctype.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -19,126 +18,6 @@
 
 #include "kris.h"
 
-/** **************************************************************************
- *
- *  @brief              Append a string to the end of the screen buffer
- *
- *  @param[in,out]      *sb     The screen buffer to append the string to
- *  @param[in]          *s      The string to append to the screen buffer
- *  @param[in]          len     The len of the string *s
- *
- *  @return             void
- *
- *  @details
- *
- *  This function appends a correctly formatted string to the screen buffer,
- *  where the string has the number of chars given by len. This is generally
- *  called to write a line of the render(?) array to the screen buffer.
- *
- * ************************************************************************** */
-
-void
-editor_add_to_screen_buf (SCREEN_BUF *sb, char *s, size_t len)
-{
-  char *new;
-
-  /*
-   * Allocate more memory for screen buffer and then append the string s
-   * to the end of the screen buffer
-   */
-
-  if (!(new = realloc (sb->buf, sb->len + len)))
-  {
-    util_exit ("Couldn't allocate memory for screen buffer");
-  }
-  else  // else is used here to stop the compiler for complaining about unint vars
-  {
-    memcpy (&new[sb->len], s, len);
-    sb->buf = new;
-    sb->len += len;
-  }
-}
-
-/** **************************************************************************
- *
- *  @brief              Add a line to the render buffer which will be displayed
- *                      to the screen
- *
- *  @param[in,out]      *line     The line which is being updated by the function
- *
- *  @return             void
- *
- *  @details
- *
- *  This function simply copies the text buffer for a line into the render buffer
- *  for the line, whilst appropriately converting the tab characters into the
- *  correct number of spaces as defined by the constant TAB_WIDTH. The render
- *  array is then terminated, and the syntax highlighting updated.
- *
- * ************************************************************************** */
-
-void
-editor_add_to_render_buffer (EDITOR_LINE *line)
-{
-  int ntabs;
-
-  size_t i;
-  size_t ii;
-
-  /*
-   * Count the number of tab characters in the text buffer
-   */
-
-  ntabs = 0;
-  for (i = 0; i < line->len; i++)
-  {
-    if (line->chars[i] == '\t')
-    {
-      ntabs++;
-    }
-  }
-  /*
-   * Allocate enough space for render -- note that line->len already counts 1
-   * space for each tab character, so we only need to account for 7 more spaces
-   * where we are assuming that tabs are 8 spaces
-   *  TODO: allow tab spaces to be changed from 8 to 4, etc
-   */
-
-  free (line->render);
-  line->render = malloc (line->len + (TAB_WIDTH - 1) * ntabs + 1);
-
-  /*
-   * Copy the characters in the text buffer to the render buffer
-   */
-
-  ii = 0;
-  for (i = 0; i < line->len; i++)
-  {
-    /*
-     * Now convert tab characters into the appropriate number of spaces
-     */
-
-    if (line->chars[i] == '\t')
-    {
-      line->render[ii++] = ' ';
-      while (ii % TAB_WIDTH != 0)
-        line->render[ii++] = ' ';
-    }
-    else
-    {
-      line->render[ii++] = line->chars[i];
-    }
-  }
-
-  /*
-   * Terminate the string and then update the syntax higlighting
-   */
-
-  line->render[ii] = '\0';
-  line->r_len = ii;
-  syntax_update_highlighting (line);
-}
-
 /** **************************************************************************
  *
  *  @brief              Insert a char main control function
@@ -163,11 +42,11 @@ editor_insert_char (int c)
    * the text buffer
    */
 
-  if (editor.cy == editor.nlines)
-    line_add_to_text_buffer (editor.nlines, "", 0);
+  if (editor.buf->cy == editor.buf->nlines)
+    line_add_to_text_buffer (editor.buf, editor.buf->nlines, "", 0);
 
-  line_insert_char (&editor.lines[editor.cy], editor.cx, c);
-  editor.cx++;
+  line_insert_char (editor.buf, editor.buf->cy, editor.buf->cx, c);
+  editor.buf->cx++;
 }
 
 /** **************************************************************************
@@ -179,34 +58,30 @@ editor_insert_char (int c)
  *  @details
  *
  *  Deletes a character by calling the line_delete_char function. If the cursor
- *  is placed at the first character on a line, then that line is appended to
- *  the previous line in the text buffer. Otherwise, a simple character is
- *  removed.
+ *  is placed at the first character on a line, then the new line before it is
+ *  deleted, which joins the line onto the previous line in the text buffer.
+ *  Otherwise, a simple character is removed.
  *
  * ************************************************************************** */
 
 void
 editor_delete_char (void)
 {
-  EDITOR_LINE *line;
-
   /*
    * There is nothing to delete if the cursor is positioned at the very first
    * or very last char, hence return without editing anything
    */
 
-  if (editor.cy == editor.nlines)
+  if (editor.buf->cy == editor.buf->nlines)
     return;
 
-  if (editor.cx == 0 && editor.cy == 0)
+  if (editor.buf->cx == 0 && editor.buf->cy == 0)
     return;
 
-  line = &editor.lines[editor.cy];
-
-  if (editor.cx > 0)
+  if (editor.buf->cx > 0)
   {
-    line_delete_char (line, editor.cx - 1);
-    editor.cx--;
+    line_delete_char (editor.buf, editor.buf->cy, editor.buf->cx - 1);
+    editor.buf->cx--;
   }
 
   /*
@@ -216,10 +91,9 @@ editor_delete_char (void)
 
   else
   {
-    editor.cx = (int) editor.lines[editor.cy - 1].len;
-    line_add_string_to_text_buffer (&editor.lines[editor.cy - 1], line->chars, line->len);
-    line_delete_line (editor.cy);
-    editor.cy--;
+    editor.buf->cx = editor.buf->lines.len[editor.buf->cy - 1];
+    line_delete_text (editor.buf, editor.buf->cy - 1, editor.buf->cx, 1);
+    editor.buf->cy--;
   }
 }
 
@@ -240,34 +114,27 @@ editor_delete_char (void)
 void
 editor_insert_new_line (void)
 {
-  EDITOR_LINE *line;
-
   /*
-   * If at the start of a line, i.e. char 0 of the line, then append a row
-   * above the current line
+   * If below the last line, then append a new row to the text buffer
    */
 
-  if (editor.cx == 0)
+  if (editor.buf->cy == editor.buf->nlines)
   {
-    line_add_to_text_buffer (editor.cy, "", 0);
+    line_add_to_text_buffer (editor.buf, editor.buf->cy, "", 0);
   }
 
   /*
-   * Otherwise the line is split into two the create two new rows
+   * Otherwise the line is split into two at the cursor, which adds an empty
+   * line above when the cursor is at the start of the line
    */
 
   else
   {
-    line = &editor.lines[editor.cy];
-    line_add_to_text_buffer (editor.cy + 1, &line->chars[editor.cx], line->len - editor.cx);
-    line = &editor.lines[editor.cy];
-    line->len = (size_t) editor.cx;
-    line->chars[line->len] = '\0';
-    editor_add_to_render_buffer (line);
+    line_insert_text (editor.buf, editor.buf->cy, editor.buf->cx, "\n", 1);
   }
 
-  editor.cy++;
-  editor.cx = 0;
+  editor.buf->cy++;
+  editor.buf->cx = 0;
 }
 
 /** **************************************************************************
@@ -303,49 +170,145 @@ editor_set_status_message (char *fmt, ...)
   editor.status_msg_time = time (NULL);
 }
 
+/** **************************************************************************
+ *
+ *  @brief              Show a message from util_message in the message bar
+ *
+ *  @param[in]          *message    The message
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+editor_show_message (const char *message)
+{
+  editor_set_status_message ("%s", message);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Append to the status bar text
+ *
+ *  @param[in,out]      *status   The status bar text
+ *  @param[in]          size      The size of status
+ *  @param[in]          len       The length of status so far
+ *  @param[in]          *fmt      The format of the text to append
+ *  @param[in]          ...       The arguments for fmt
+ *
+ *  @return             The new length of status
+ *
+ *  @details
+ *
+ *  Text which doesn't fit is cut off, and the length returned is what's
+ *  really in status rather than what snprintf wanted to write.
+ *
+ * ************************************************************************** */
+
+static int
+editor_status_append (char *status, size_t size, int len, char *fmt, ...)
+{
+  int n;
+  va_list ap;
+
+  va_start (ap, fmt);
+  n = vsnprintf (&status[len], size - (size_t) len, fmt, ap);
+  va_end (ap);
+
+  if (n < 0)
+    return len;
+
+  return (size_t) len + (size_t) n < size ? len + n : (int) size - 1;
+}
+
 /** **************************************************************************
  *
  *  @brief              Write the status bar for filename and line number to
  *                      screen buffer
  *
  *  @param[in,out]      sb       The screen buffer to update the status bar to
+ *  @param[in]          *win     The window the status bar is for
  *
  *  @return             void
  *
  *  @details
  *
  *  This writes the status bar to (hopefully) the end of the screen buffer. It
- *  is written in inverted colours to help make it stand out.
+ *  is written in inverted colours to help make it stand out, and dimmed for
+ *  the windows which aren't being edited.
  *
  * ************************************************************************** */
 
 void
-editor_update_status_message (SCREEN_BUF *sb)
+editor_update_status_message (SCREEN_BUF *sb, WINDOW *win)
 {
   int r_len;
   int status_len;
 
   size_t line_len;
 
-  char status[80];
+  char status[120];
   char line_num[80];
-
+  char nth[32];
+  char total[32];
+  EDITOR_BUFFER *buf = win->buf;
 
   /*
    * Switch to inverted colours to make the status message stand out
    */
 
-  editor_add_to_screen_buf (sb, "\x1b[7m", 4);
+  if (win == editor.win)
+    editor_add_to_screen_buf (sb, "\x1b[7m", 4);
+  else
+    editor_add_to_screen_buf (sb, "\x1b[2;7m", 6);
 
   /*
    * Add the name of the file and the number of lines in the file
    */
 
-  status_len = snprintf (status, sizeof status, "%.20s - %d lines %s", editor.filename ? editor.filename : "[No File]",
-                         editor.nlines, editor.modified ? "(modified)" : "");
+  status_len = editor_status_append (status, sizeof status, 0, "%.20s - %zu lines %s",
+                                     buf->filename ? buf->filename : "[No File]", buf->nlines,
+                                     buf->modified ? "(modified)" : "");
+
+  /*
+   * Add which buffer this is when there's more than one
+   */
+
+  if (editor.nbuffers > 1 && win == editor.win)
+    status_len = editor_status_append (status, sizeof status, status_len, " [%zu/%zu]", editor.current + 1,
+                            editor.nbuffers);
+
+  /*
+   * Add the match count whilst searching
+   */
 
-  if (status_len > editor.screen_cols)
-    status_len = editor.screen_cols;
+  if (buf->search.active && buf->search.regex)
+    status_len = editor_status_append (status, sizeof status, status_len, " | regex");
+  if (buf->search.active && buf->search.icase)
+    status_len = editor_status_append (status, sizeof status, status_len, " | any case");
+  if (buf->search.active && buf->search.word)
+    status_len = editor_status_append (status, sizeof status, status_len, " | word");
+
+  if (buf->search.active && buf->search.error)
+  {
+    status_len = editor_status_append (status, sizeof status, status_len, " | %s", buf->search.error);
+  }
+  else if (buf->search.active && buf->search.nresults)
+  {
+    if (buf->search.current == NO_MATCH)
+    {
+      status_len = editor_status_append (status, sizeof status, status_len, " | no matches");
+    }
+    else
+    {
+      util_format_count (nth, sizeof nth, buf->search.current + 1);
+      util_format_count (total, sizeof total, buf->search.results[buf->search.nresults - 1].nmatches);
+      status_len = editor_status_append (status, sizeof status, status_len, " | match %s / %s", nth, total);
+    }
+  }
+
+  if (status_len > win->width)
+    status_len = win->width;
 
   editor_add_to_screen_buf (sb, status, (size_t) status_len);
 
@@ -353,8 +316,9 @@ editor_update_status_message (SCREEN_BUF *sb)
    *  Add the current line number the cursor is positioned on
    */
 
-  r_len = snprintf (line_num, sizeof line_num, "%s | %d/%d", editor.syntax ? editor.syntax->filetype : "Unknown file type",
-                    editor.cy + 1, editor.nlines);
+  r_len = editor_status_append (line_num, sizeof line_num, 0, "%s | %zu/%zu | byte %zu",
+                                buf->syntax ? buf->syntax->filetype : "Unknown file type", win->cy + 1, buf->nlines,
+                                offset_line_to_byte (buf, win->cy) + (win->cy < buf->nlines ? win->cx : 0));
 
   /*
    * Append white space to the screen of the status message to keep drawing
@@ -362,9 +326,9 @@ editor_update_status_message (SCREEN_BUF *sb)
    */
 
   line_len = (size_t) status_len;
-  while (line_len < editor.screen_cols)
+  while (line_len < win->width)
   {
-    if (editor.screen_cols - line_len == r_len)
+    if (win->width - line_len == r_len)
     {
       editor_add_to_screen_buf (sb, line_num, (size_t) r_len);
       break;
@@ -381,7 +345,6 @@ editor_update_status_message (SCREEN_BUF *sb)
    */
 
   editor_add_to_screen_buf (sb, "\x1b[m", 3);
-  editor_add_to_screen_buf (sb, "\r\n", 2);
 }
 
 /** **************************************************************************
@@ -399,12 +362,18 @@ editor_update_status_message (SCREEN_BUF *sb)
  *  Kris only refreshes when a character is processed, the message will stay up
  *  for longer than 5 seconds until a character is processes.
  *
+ *  When the HUD is on, it is drawn at the right of the message bar and the
+ *  message is cut short to make room for it.
+ *
  * ************************************************************************** */
 
 void
 editor_update_message_bar (SCREEN_BUF *sb)
 {
   size_t msg_len;
+  size_t hud_len;
+  size_t line_len;
+  char hud[160];
 
   /*
    * This will clear the message bar
@@ -418,17 +387,33 @@ editor_update_message_bar (SCREEN_BUF *sb)
    */
 
   msg_len = strlen (editor.status_msg);
+  if (time (NULL) - editor.status_msg_time >= 5)
+    msg_len = 0;
+
+  if ((hud_len = hud_format (hud, sizeof hud)) > (size_t) editor.screen_cols)
+    hud_len = (size_t) editor.screen_cols;
 
-  if (msg_len > editor.screen_cols)
-    msg_len = (size_t) editor.screen_cols;
+  if (msg_len + hud_len > editor.screen_cols)
+    msg_len = (size_t) editor.screen_cols - hud_len;
 
   /*
    * If the message has been up for less than 5 seconds, then append the message
    * to the screen buffer
    */
 
-  if (msg_len && time (NULL) - editor.status_msg_time < 5)
+  if (msg_len)
     editor_add_to_screen_buf (sb, editor.status_msg, msg_len);
+
+  /*
+   * Pad the message out so the HUD is against the right edge
+   */
+
+  if (hud_len)
+  {
+    for (line_len = msg_len; line_len + hud_len < editor.screen_cols; line_len++)
+      editor_add_to_screen_buf (sb, " ", 1);
+    editor_add_to_screen_buf (sb, hud, hud_len);
+  }
 }
 
 /** **************************************************************************
@@ -451,247 +436,171 @@ void editor_scroll_text_buffer (void)
    * Update the cusor to be in the correct position of the render array
    */
 
-  editor.rx = 0;
-  if (editor.cy < editor.nlines)
-    editor.rx = util_convert_cx_to_rx (&editor.lines[editor.cy], editor.cx);
+  editor.buf->rx = 0;
+  if (editor.buf->cy < editor.buf->nlines)
+    editor.buf->rx = util_convert_cx_to_rx (editor.buf, editor.buf->cy, editor.buf->cx);
 
   /*
-   * Check the cursor is within the bounds of the terminal window
+   * Check the cursor is within the bounds of the window being edited
    */
 
-  if (editor.cy < editor.row_offset)
-    editor.row_offset = editor.cy;
+  if (editor.buf->cy < editor.buf->row_offset)
+    editor.buf->row_offset = editor.buf->cy;
 
-  if (editor.cy >= editor.row_offset + editor.screen_rows)
-    editor.row_offset = editor.cy - editor.screen_rows + 1;
+  if (editor.buf->cy >= editor.buf->row_offset + window_rows ())
+    editor.buf->row_offset = editor.buf->cy - window_rows () + 1;
 
   /*
    * Update the offset variable which controls the level of scroll in the
    * screen buffer, text buffer, etc
    */
 
-  if (editor.rx < editor.col_offset)
-    editor.col_offset = editor.rx;
+  if (editor.buf->rx < editor.buf->col_offset)
+    editor.buf->col_offset = editor.buf->rx;
 
-  if (editor.rx > editor.col_offset + editor.screen_cols)
-    editor.col_offset = editor.rx - editor.screen_cols + 1;
+  if (editor.win->width > 0 && editor.buf->rx >= editor.buf->col_offset + (size_t) editor.win->width)
+    editor.buf->col_offset = editor.buf->rx - (size_t) editor.win->width + 1;
 }
 
 /** **************************************************************************
  *
- *  @brief              Update the entire screen buffer with the text buffer
+ *  @brief              Draw a window, and each window it is split into
  *
- *  @param[in,out]      sb    This is screen buffer variable to write to
+ *  @param[in,out]      *rows   The screen buffer of each row of the screen
+ *  @param[in]          *win    The window to draw
  *
  *  @return             void
  *
  *  @details
  *
- *  The screen buffer is updated by looping over the number of rows of terminal
- *  which are being used to render the editor. This function thus indexes to the
- *  correct level of indexing for the required amount of scroll and then loops
- *  over each line and appends each line character by character, whilst taking
- *  into account any possible syntax highlighting.
+ *  The top or left half is drawn before the other half, so the windows along
+ *  each screen row are added to it from left to right.
  *
  * ************************************************************************** */
 
-void
-editor_update_screen_buffer (SCREEN_BUF *sb)
+static void
+editor_draw_window (SCREEN_BUF *rows, WINDOW *win)
 {
-  int iline;
-  int padding;
-  int char_colour;
-  int current_colour;
+  int i;
 
-  size_t i;
-  size_t line_len;
-  size_t buf_len;
-  size_t col_len;
-  size_t welcome_len;
-  size_t file_row;
-
-  char *c;
-  char symbol;
-  char welcome[80];
-  char tmpbuf[16];
-  unsigned char *hl;
-
-  for (iline = 0; iline < editor.screen_rows; iline++)
+  if (win->split == WINDOW_LEAF)
   {
-    /*
-     * Index the line to offset for the current level of scroll in the file
-     */
+    editor_update_screen_buffer (rows, win);
+    editor_update_status_message (&rows[win->top + win->height - 1], win);
+    return;
+  }
 
-    file_row = (size_t) iline + editor.row_offset;
+  editor_draw_window (rows, win->child[0]);
 
-    /*
-     * If the rendered line is more than the number of lines in the text buffer,
-     * then render a ~ to indicate that the line is empty
-     */
+  if (win->split == WINDOW_SIDE_BY_SIDE)
+  {
+    for (i = 0; i < win->height; i++)
+      editor_add_to_screen_buf (&rows[win->top + i], "\x1b[7m \x1b[m", 8);
+  }
 
-    if (file_row >= editor.nlines)
-    {
-      /*
-       * If there are no lines in the text buffer, then write a welcome message
-       */
-
-      if (iline == editor.screen_rows / 5 && editor.nlines == 0)
-      {
-        welcome_len = (size_t ) snprintf (welcome, sizeof (welcome), "Kris editor -- version %s", VERSION);
-
-        if (welcome_len > editor.screen_cols)
-          welcome_len = (size_t) editor.screen_cols;
-
-        if ((padding = (int) (editor.screen_cols - welcome_len) / 2))
-        {
-          editor_add_to_screen_buf (sb, "~", 1);
-          padding--;
-        }
-
-        while (padding--)
-          editor_add_to_screen_buf (sb, " ", 1);
-
-        editor_add_to_screen_buf (sb, welcome, (size_t) welcome_len);
-      }
-      else
-      {
-        editor_add_to_screen_buf (sb, "~", 1);
-      }
-    }
+  editor_draw_window (rows, win->child[1]);
+}
 
-    /*
-     * Else, add a line of the text buffer to the screen buffer char by char
-     */
+/** **************************************************************************
+ *
+ *  @brief              Forget what is on the screen, so it is all redrawn
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This has to be done whenever something other than editor_refresh_screen
+ *  draws on the screen, or the screen changes size.
+ *
+ * ************************************************************************** */
 
-    else
-    {
-      line_len = editor.lines[file_row].r_len - editor.col_offset;
-
-      if (line_len < 0)
-        line_len = 0;
-
-      if (line_len > editor.screen_cols)
-        line_len = (size_t) editor.screen_cols;
-
-      c = &editor.lines[file_row].render[editor.col_offset];
-      hl = &editor.lines[file_row].syn_hl[editor.col_offset];
-      current_colour = -1;
-
-      /*
-       * This loop iterates over each char in the render array, and then processes
-       * each character individually for syntax highlighting or special characters
-       */
-
-      for (i = 0; i < line_len; i++)
-      {
-        /*
-         * This is to allow the editor to handle control sequences (non-printable
-         * characters) a bit better
-         */
-
-        if ( iscntrl (c[i]))
-        {
-          symbol = (char) ((c[i] <= 26) ? '@' + c[i] : '?');
-          editor_add_to_screen_buf (sb, "\x1b[7m", 4);
-          editor_add_to_screen_buf (sb, &symbol, 1);
-          editor_add_to_screen_buf (sb, "\x1b[m", 3);
-
-          /*
-           * If there is no current colour, renable normal text formatting
-           */
-
-          if (current_colour != -1)
-          {
-            col_len = (size_t) snprintf (tmpbuf, sizeof tmpbuf, "\x1b[%dm", current_colour);
-            editor_add_to_screen_buf (sb, tmpbuf, col_len);
-          }
-        }
-
-        /*
-         * Append normal text escape character to the screen buffer
-         */
-
-        else if (hl[i] == HL_NORMAL)
-        {
-          if (current_colour != -1)
-          {
-            editor_add_to_screen_buf (sb, "\x1b[39m", 5);
-            current_colour = -1;
-          }
-
-          editor_add_to_screen_buf (sb, &c[i], 1);
-        }
-
-        /*
-         * Append the syntax highlighting escape characters to the screen buffer
-         */
-
-        else
-        {
-          char_colour = syntax_get_colour (hl[i]);
-
-          if (char_colour != current_colour)
-          {
-            current_colour = char_colour;
-            buf_len = (size_t) snprintf (tmpbuf, sizeof tmpbuf, "\x1b[%dm", char_colour);
-            editor_add_to_screen_buf (sb, tmpbuf, buf_len);
-          }
-
-          editor_add_to_screen_buf (sb, &c[i], 1);
-        }
-      }
-
-      editor_add_to_screen_buf (sb, "\x1b[39m", 5);
-    }
+void
+editor_damage_all (void)
+{
+  int i;
 
-    /*
-     * Append a new line character to the screen buffer
-     */
+  for (i = 0; i < editor.frame_rows; i++)
+    free (editor.frame[i].buf);
 
-    editor_add_to_screen_buf (sb, "\x1b[K", 3);
-    editor_add_to_screen_buf (sb, "\r\n", 2);
-  }
+  free (editor.frame);
+  editor.frame = NULL;
+  editor.frame_rows = 0;
 }
 
 /** **************************************************************************
  *
- *  @brief              Refresh the entire editor screen -- redraw everything
+ *  @brief              Refresh the editor screen
  *
  *  @return             void
  *
  *  @details
  *
- *  This function redraws the entire editor screen. This includes when a
- *  character in the text buffer has been moved, when the cursor has been moved
- *  or even when the terminal has been resized.
+ *  Every row of the screen is drawn into its own screen buffer, but only the
+ *  rows which are different to when the screen was last refreshed are written
+ *  to the terminal. So typing in a window showing a buffer which is also
+ *  shown in another window only repaints the row being typed on in both, and
+ *  the status bars.
  *
  * ************************************************************************** */
 
 void
 editor_refresh_screen (void)
 {
+  int i;
+  int nrows;
   char buf[32];
   SCREEN_BUF sb = SBUF_INIT;
+  SCREEN_BUF *rows;
+  TRACE_SCOPE (__func__);
 
+  hud_frame_begin ();
   editor_scroll_text_buffer ();
+  window_save ();
+
+  /*
+   * Draw every row of the windows and the message bar
+   */
+
+  nrows = editor.screen_rows + 2;
+  if (!(rows = calloc ((size_t) nrows, sizeof *rows)))
+    util_exit ("Couldn't allocate memory for the screen");
+
+  editor_draw_window (rows, editor.root);
+  editor_update_message_bar (&rows[nrows - 1]);
 
   /*
-   * Reset the VT100 mode and place the cursor into the home position
-   * and write the editor rows and status to the screen buffer
+   * Hide the cursor and write out the rows which have changed. If the screen
+   * has changed size then it's cleared and everything is written
    */
 
   editor_add_to_screen_buf (&sb, "\x1b[?25l", 6);
-  editor_add_to_screen_buf (&sb, "\x1b[H", 3);
-  editor_update_screen_buffer (&sb);
-  editor_update_status_message (&sb);
-  editor_update_message_bar (&sb);
+  if (editor.frame_rows != nrows)
+  {
+    editor_damage_all ();
+    editor_add_to_screen_buf (&sb, "\x1b[2J", 4);
+  }
+
+  for (i = 0; i < nrows; i++)
+  {
+    if (editor.frame && editor.frame[i].len == rows[i].len && !memcmp (editor.frame[i].buf, rows[i].buf, rows[i].len))
+      continue;
+
+    snprintf (buf, sizeof buf, "\x1b[%d;1H", i + 1);
+    editor_add_to_screen_buf (&sb, buf, strlen (buf));
+    editor_add_to_screen_buf (&sb, rows[i].buf, rows[i].len);
+  }
+
+  editor_damage_all ();
+  editor.frame = rows;
+  editor.frame_rows = nrows;
 
   /*
-   * Reposition the cursor in the terminal window
+   * Reposition the cursor in the window being edited
    */
 
-  snprintf (buf, sizeof buf, "\x1b[%d;%dH", (editor.cy - editor.row_offset) + 1, (editor.rx - editor.col_offset) + 1);
-  editor_add_to_screen_buf (&sb, buf, (int) strlen (buf));
+  snprintf (buf, sizeof buf, "\x1b[%zu;%zuH", (size_t) editor.win->top + (editor.buf->cy - editor.buf->row_offset) + 1,
+            (size_t) editor.win->left + (editor.buf->rx - editor.buf->col_offset) + 1);
+  editor_add_to_screen_buf (&sb, buf, strlen (buf));
 
   /*
    * Enable set mode in the terminal (VT100 again) and write out the entire
@@ -699,6 +608,7 @@ editor_refresh_screen (void)
    */
 
   editor_add_to_screen_buf (&sb, "\x1b[?25h", 6);
+  hud_frame_end (sb.len);
   write (STDOUT_FILENO, sb.buf, sb.len);
 
   free (sb.buf);
@@ -15,198 +15,913 @@
 
 #include "kris.h"
 
+typedef struct FIND_SHARD
+{
+  EDITOR_BUFFER *buf;              // The buffer to search
+  SEARCH_PATTERN *pattern;         // The query to search for
+  REGEX *regex;                    // The regex query to search for, or NULL
+  SEARCH_RESULT *prev;             // The result set to narrow, or NULL
+  size_t *lines;                   // The candidate lines to search, or NULL
+  size_t start, end;               // The range of candidates to search
+  SEARCH_MATCH *matches;           // The matches found in the range
+  size_t nmatches;                 // The number of matches found
+  size_t capacity;                 // The number of matches allocated
+} FIND_SHARD;
+
+typedef struct FIND_BUF
+{
+  char *buf;                       // The text built so far
+  size_t len;                      // The length of the text
+  size_t capacity;                 // The number of bytes allocated
+} FIND_BUF;
+
 /** **************************************************************************
  *
- *  @brief             Search for a keyword within the text buffer
+ *  @brief              Empty the cache of match spans in the viewport
  *
- *  @param[in]          *query   A query message?
- *  @param[in]          key      The variable for a key press?
+ *  @param[in,out]      *buf      The buffer
  *
  *  @return             void
  *
  *  @details
  *
- *  I can't really remember how this works right now.
+ *  This has to be called whenever the result set on the top of the stack
+ *  changes. The slots are kept allocated for the next search.
+ *
+ * ************************************************************************** */
+
+static void
+find_overlay_invalidate (EDITOR_BUFFER *buf)
+{
+  size_t i;
+  MATCH_OVERLAY *overlay = &buf->search.overlay;
+
+  for (i = 0; i < overlay->nrows; i++)
+  {
+    overlay->rows[i].line = NO_MATCH;
+    overlay->rows[i].nspans = 0;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free all of the cached search results
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
  *
- *  This function iterates over each line in the text buffer and uses the function
- *  strstr to query if the substring query is in the current line of the text
- *  buffer. If it is, then this location is recorded and the cursor is moved to
- *  this string and it is also highlighted.
+ *  Pops every result set off of the search result stack and frees them. This
+ *  is called when the search prompt is closed, as the text buffer may be edited
+ *  before the next search.
  *
  * ************************************************************************** */
 
 void
-find_keyword_search (char *query, int key)
+find_clear_results (EDITOR_BUFFER *buf)
 {
-  EDITOR_LINE *line;
-
   size_t i;
+  SEARCH_STATE *search = &buf->search;
+
+  for (i = 0; i < search->nresults; i++)
+  {
+    free (search->results[i].query);
+    free (search->results[i].matches);
+  }
+
+  free (search->results);
+  search->results = NULL;
+  search->nresults = 0;
+  search->capacity = 0;
+  search->current = NO_MATCH;
+  find_overlay_invalidate (buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add a match to the matches found by a shard
+ *
+ *  @param[in,out]      *shard    The shard which found the match
+ *  @param[in]          line      The line the match is on
+ *  @param[in]          col       The column in chars the match starts at
+ *  @param[in]          len       The length of the match in chars
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+find_add_match (FIND_SHARD *shard, size_t line, size_t col, size_t len)
+{
+  if (shard->nmatches == shard->capacity)
+  {
+    shard->capacity = shard->capacity ? shard->capacity * 2 : 64;
+    if (!(shard->matches = realloc (shard->matches, shard->capacity * sizeof (*shard->matches))))
+      util_exit ("Couldn't allocate memory for search matches");
+  }
+
+  shard->matches[shard->nmatches].line = line;
+  shard->matches[shard->nmatches].col = col;
+  shard->matches[shard->nmatches].len = len;
+  shard->nmatches++;
+}
 
-  int current;
-  static int last_match = -1;
-  static int direction = 1;
-  static int saved_hl_line;
+/** **************************************************************************
+ *
+ *  @brief              Check if a match is a whole word
+ *
+ *  @param[in]          *chars    The line the match is in
+ *  @param[in]          len       The length of the line
+ *  @param[in]          start     Where the match starts
+ *  @param[in]          end       Where the match ends
+ *
+ *  @return             TRUE if the match is a whole word, otherwise FALSE
+ *
+ *  @details
+ *
+ *  A match is a whole word if it isn't joined onto other text at either end,
+ *  using the same separators as the syntax highlighting. An end of the match
+ *  which is itself a separator doesn't need one next to it, so searching for
+ *  "(x" still finds "f(x)".
+ *
+ * ************************************************************************** */
+
+static int
+find_is_word (char *chars, size_t len, size_t start, size_t end)
+{
+  if (start > 0 && start < len && !is_separator ((unsigned char) chars[start - 1])
+      && !is_separator ((unsigned char) chars[start]))
+    return FALSE;
 
+  if (end > 0 && end < len && !is_separator ((unsigned char) chars[end - 1]) && !is_separator ((unsigned char) chars[end]))
+    return FALSE;
+
+  return TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the next match of a query in a line
+ *
+ *  @param[in]          *buf            The buffer to search
+ *  @param[in]          *pattern        The plain text query, used if regex is
+ *                                      NULL
+ *  @param[in]          *regex          The regex query, or NULL
+ *  @param[in]          line            The line to search
+ *  @param[in]          from            Where to start searching from, which
+ *                                      must be 0 for the first call for a line
+ *  @param[out]         *match_start    Where the match starts
+ *  @param[out]         *match_end      Where the match ends
+ *
+ *  @return             TRUE if there is a match, otherwise FALSE
+ *
+ *  @details
+ *
+ *  In whole word mode, matches which aren't whole words are skipped over by
+ *  searching again from the next char.
+ *
+ * ************************************************************************** */
+
+static int
+find_next_in_line (EDITOR_BUFFER *buf, SEARCH_PATTERN *pattern, REGEX *regex, size_t line, size_t from,
+                   size_t *match_start, size_t *match_end)
+{
+  size_t len;
+  char *chars;
   char *match;
-  static char *saved_hl = NULL;
+
+  chars = buf->lines.chars[line];
+  len = buf->lines.len[line];
+
+  while (from <= len)
+  {
+    if (regex)
+    {
+      if (!regex_search (regex, chars, len, from, match_start, match_end))
+        return FALSE;
+    }
+    else
+    {
+      if (!(match = search_next (pattern, &chars[from], len - from)))
+        return FALSE;
+      *match_start = (size_t) (match - chars);
+      *match_end = *match_start + pattern->len;
+    }
+
+    if (!buf->search.word || find_is_word (chars, len, *match_start, *match_end))
+      return TRUE;
+
+    from = *match_start + 1;
+  }
+
+  return FALSE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Search a range of the candidate lines for a query
+ *
+ *  @param[in,out]      *arg     The FIND_SHARD describing the range to search
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is run by the worker threads. If there is a previous result set, the
+ *  range is a range of its matches and each distinct line in the range is
+ *  searched. A line with several matches can straddle two shards, so it is
+ *  only searched by the shard its first match falls in. If there is a list of
+ *  candidate lines, the range is a range of that list. Otherwise the range is
+ *  a range of lines in the text buffer. Every non-overlapping match in each
+ *  line is recorded, so the matches come out sorted. After an empty regex
+ *  match, the search carries on from the next char.
+ *
+ * ************************************************************************** */
+
+static void
+find_search_shard (void *arg)
+{
+  size_t i;
+  size_t line;
+  size_t from;
+  size_t match_start;
+  size_t match_end;
+
+  FIND_SHARD *shard = arg;
+  SEARCH_RESULT *prev = shard->prev;
+
+  for (i = shard->start; i < shard->end; i++)
+  {
+    if (prev)
+    {
+      line = prev->matches[i].line;
+      if (i > 0 && prev->matches[i - 1].line == line)
+        continue;
+    }
+    else if (shard->lines)
+    {
+      line = shard->lines[i];
+    }
+    else
+    {
+      line = i;
+    }
+
+    from = 0;
+    while (find_next_in_line (shard->buf, shard->pattern, shard->regex, line, from, &match_start, &match_end))
+    {
+      find_add_match (shard, line, match_start, match_end - match_start);
+      from = match_end > match_start ? match_end : match_end + 1;
+    }
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Push the result set for a query onto the result stack
+ *
+ *  @param[in,out]      *buf      The buffer to search
+ *  @param[in]          *query    The query to find the matches for
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Any line which contains query must also contain every prefix of query.
+ *  Therefore, only the lines in the result set on the top of the stack, which
+ *  is for a prefix of query, need to be searched. If the stack is empty, every
+ *  line in the text buffer is searched, unless the trigram index can narrow
+ *  down the lines which might contain the query.
+ *
+ *  The candidates are split into shards which are searched in parallel by the
+ *  worker pool. Each shard's matches are sorted, so joining the shards together
+ *  in order gives a sorted index of every match.
+ *
+ *  In regex mode, each shard compiles its own copy of the regex, as the DFA
+ *  is built as the regex runs and so can't be shared between threads. If the
+ *  regex is invalid, an empty result set is pushed and the error is kept to
+ *  be shown in the status bar.
+ *
+ * ************************************************************************** */
+
+static void
+find_push_result (EDITOR_BUFFER *buf, char *query)
+{
+  size_t i;
+  size_t nshards;
+  size_t ncandidates;
+  size_t nmatches;
+  size_t *lines;
+
+  char *error;
+
+  REGEX *regex;
+  POOL_GROUP group = POOL_GROUP_INIT;
+  FIND_SHARD shards[POOL_MAX_THREADS];
+  SEARCH_PATTERN pattern;
+  SEARCH_RESULT *prev;
+  SEARCH_RESULT *result;
+  SEARCH_STATE *search = &buf->search;
+
+  if (search->nresults == search->capacity)
+  {
+    search->capacity = search->capacity ? search->capacity * 2 : 16;
+    search->results = realloc (search->results, search->capacity * sizeof (*search->results));
+  }
+
+  prev = search->nresults ? &search->results[search->nresults - 1] : NULL;
+  ncandidates = prev ? prev->nmatches : buf->nlines;
+  search_compile (&pattern, query, strlen (query), search->icase);
+  search->error = NULL;
+  regex = NULL;
+  lines = NULL;
+
+  if (search->regex && (regex = regex_compile (query, search->icase, &error)) == NULL)
+  {
+    search->error = error;
+    ncandidates = 0;
+  }
+
+  if (!prev && !search->regex)
+    lines = trigram_candidates (buf, query, strlen (query), &ncandidates);
 
   /*
-   * If there is a previous highlight, then return the original highlight colour
+   * Split the candidates into shards, but don't bother with threads unless
+   * there is a decent amount of work for each thread
    */
 
-  if (saved_hl)
+  nshards = ncandidates / FIND_SHARD_MIN_LINES + 1;
+  if (nshards > pool_size ())
+    nshards = pool_size ();
+
+  for (i = 0; i < nshards; i++)
   {
-    memcpy (editor.lines[saved_hl_line].syn_hl, saved_hl, editor.lines[saved_hl_line].r_len);
-    free (saved_hl);
-    saved_hl = NULL;
+    shards[i] = (FIND_SHARD) {buf, &pattern, NULL, prev, lines, ncandidates * i / nshards,
+                              ncandidates * (i + 1) / nshards, NULL, 0, 0};
+    if (regex)
+      shards[i].regex = i == 0 ? regex : regex_compile (query, search->icase, &error);
+    if (nshards > 1)
+      pool_submit (&group, find_search_shard, &shards[i]);
+    else
+      find_search_shard (&shards[i]);
   }
 
+  pool_wait (&group);
+  free (lines);
+
   /*
-   * Process the key press - enter or escape will return without doing anything
+   * Join the matches from each shard together
    */
 
-  if (key == '\r' || key == '\x1b')
+  nmatches = 0;
+  for (i = 0; i < nshards; i++)
   {
-    last_match = -1;
-    direction = 1;
+    nmatches += shards[i].nmatches;
+    regex_free (shards[i].regex);
+  }
+
+  result = &search->results[search->nresults++];
+  result->query = strdup (query);
+  result->nmatches = 0;
+
+  if (nshards == 1)
+  {
+    result->matches = shards[0].matches;
+    result->nmatches = shards[0].nmatches;
     return;
   }
 
-  /*
-   * Search forwards in the file
-   */
+  result->matches = malloc ((nmatches ? nmatches : 1) * sizeof (*result->matches));
+  for (i = 0; i < nshards; i++)
+  {
+    memcpy (&result->matches[result->nmatches], shards[i].matches, shards[i].nmatches * sizeof (*shards[i].matches));
+    result->nmatches += shards[i].nmatches;
+    free (shards[i].matches);
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the result stack to match the current query
+ *
+ *  @param[in,out]      *buf      The buffer to search
+ *  @param[in]          *query    The current search query
+ *
+ *  @return             The result set for query
+ *
+ *  @details
+ *
+ *  Result sets are popped off of the stack until the query on the top of the
+ *  stack is a prefix of the current query, so deleting chars from the query
+ *  returns to an earlier result set without searching again. If the query has
+ *  been extended, a narrowed result set is pushed onto the stack.
+ *
+ *  A regex doesn't have this property, i.e. "ab?" matches lines which "ab"
+ *  does not, and neither do whole words, i.e. "foobar" is a whole word where
+ *  "foo" is not. So in these modes there is only one result set for the query.
+ *
+ * ************************************************************************** */
 
-  else if (key == ARROW_RIGHT || key == ARROW_DOWN)
+static SEARCH_RESULT *
+find_update_results (EDITOR_BUFFER *buf, char *query)
+{
+  size_t nresults;
+  SEARCH_RESULT *top;
+  SEARCH_STATE *search = &buf->search;
+
+  nresults = search->nresults;
+
+  while (search->nresults)
   {
-    direction = 1;
+    top = &search->results[search->nresults - 1];
+    if (search->regex || search->word ? !strcmp (top->query, query)
+                                      : !strncmp (top->query, query, strlen (top->query)))
+      break;
+
+    free (top->query);
+    free (top->matches);
+    search->nresults--;
   }
 
-  /*
-   * Search backwards in the file
-   */
+  if (search->nresults == 0 || strcmp (search->results[search->nresults - 1].query, query) != 0)
+    find_push_result (buf, query);
+
+  if (search->nresults != nresults)
+    find_overlay_invalidate (buf);
+
+  return &search->results[search->nresults - 1];
+}
 
-  else if (key == ARROW_LEFT || key == ARROW_UP)
+/** **************************************************************************
+ *
+ *  @brief              Find the first match at or after a position
+ *
+ *  @param[in]          *result     The result set to search in
+ *  @param[in]          line        The line of the position
+ *  @param[in]          col         The column of the position
+ *
+ *  @return             The index of the match, wrapping around to the first
+ *                      match if there are none after the position
+ *
+ *  @details
+ *
+ *  The matches are sorted by line and then column, so this is a binary search.
+ *
+ * ************************************************************************** */
+
+static size_t
+find_match_index (SEARCH_RESULT *result, size_t line, size_t col)
+{
+  size_t lo;
+  size_t hi;
+  size_t mid;
+  SEARCH_MATCH *match;
+
+  lo = 0;
+  hi = result->nmatches;
+  while (lo < hi)
   {
-    direction = -1;
+    mid = lo + (hi - lo) / 2;
+    match = &result->matches[mid];
+    if (match->line < line || (match->line == line && match->col < col))
+      lo = mid + 1;
+    else
+      hi = mid;
   }
 
+  return lo < result->nmatches ? lo : 0;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the render columns of the search matches on a line
+ *
+ *  @param[in,out]      *buf      The buffer the line is in
+ *  @param[in]          line      The line to get the matches for
+ *  @param[in]          nrows     The number of rows the buffer is drawn in
+ *  @param[out]         **rx      The start and end render column of each match
+ *
+ *  @return             The number of matches on the line
+ *
+ *  @details
+ *
+ *  This is called for each line in the viewport as the screen is drawn, and
+ *  the matches are drawn over the syntax highlighting. The spans are cached in
+ *  a slot for each line, and there are at least as many slots as rows being
+ *  drawn, so scrolling only works out the spans for the lines which have come into
+ *  view. The render columns are found in a single pass over the line, rather
+ *  than converting each match separately.
+ *
+ * ************************************************************************** */
+
+size_t
+find_overlay_spans (EDITOR_BUFFER *buf, size_t line, size_t nrows, size_t **rx)
+{
+  size_t i;
+  size_t j;
+  size_t col;
+  size_t cur_rx;
+  size_t first;
+  size_t nspans;
+  size_t bound;
+
+  char *chars;
+
+  OVERLAY_ROW *row;
+  SEARCH_RESULT *result;
+  SEARCH_STATE *search = &buf->search;
+  MATCH_OVERLAY *overlay = &search->overlay;
+
+  if (!search->active || search->nresults == 0 || search->error)
+    return 0;
+
   /*
-   * Any other key will search forwards in the file
+   * Make sure there is a slot for every line being drawn
    */
 
-  else
+  if (overlay->nrows < nrows)
   {
-    last_match = -1;
-    direction = 1;
+    if (!(overlay->rows = realloc (overlay->rows, nrows * sizeof (*overlay->rows))))
+      util_exit ("Couldn't allocate memory for the match overlay");
+    memset (&overlay->rows[overlay->nrows], 0, (nrows - overlay->nrows) * sizeof (*overlay->rows));
+    overlay->nrows = nrows;
+    find_overlay_invalidate (buf);
   }
 
+  row = &overlay->rows[line % overlay->nrows];
+  *rx = row->rx;
+  if (row->line == line)
+    return row->nspans;
+
   /*
-   * Set last match to be the line where the query was last matched
+   * Find the line's matches in the index and convert them to render columns
    */
 
-   if (last_match == -1)
-    direction = 1;
+  result = &search->results[search->nresults - 1];
+  first = find_match_index (result, line, 0);
+  for (nspans = 0; first + nspans < result->nmatches && result->matches[first + nspans].line == line; nspans++);
 
-   current = last_match;
-
-  for (i = 0; i < editor.nlines; i++)
+  if (nspans > row->capacity)
   {
-    /*
-     * Increment current line search counter
-     */
+    row->capacity = nspans;
+    if (!(row->rx = realloc (row->rx, 2 * row->capacity * sizeof (*row->rx))))
+      util_exit ("Couldn't allocate memory for the match overlay");
+  }
 
-   current += direction;
+  chars = buf->lines.chars[line];
+  col = 0;
+  cur_rx = 0;
 
-    if (current == -1)
-    {
-      current = editor.nlines - 1;
-    }
-    else if (current == editor.nlines)
+  for (i = 0; i < 2 * nspans; i++)
+  {
+    j = first + i / 2;
+    bound = result->matches[j].col + (i % 2 ? result->matches[j].len : 0);
+    for (; col < bound; col++)
     {
-      current = 0;
+      if (chars[col] == '\t')
+        cur_rx += (TAB_WIDTH - 1) - (cur_rx % TAB_WIDTH);
+      cur_rx++;
     }
+    row->rx[i] = cur_rx;
+  }
 
-    /*
-     * Use strstr to check if the query substring is on the current row. If it
-     * isn't, then strstr returns NULL. To find the index, we can do some
-     * pointer arithmetic
-     */
-
-    line = &editor.lines[current];
-    match = strstr (line->render, query);
+  row->line = line;
+  row->nspans = nspans;
+  *rx = row->rx;
 
-    if (match)
-    {
-      last_match = current;
-      editor.cy = current;
-      editor.cx = util_convert_rx_to_cx (line, (int) (match - line->render));
-      editor.row_offset = editor.nlines;
-
-      /*
-       * Set the matched substrings to be HL_MATCH colour
-       */
-
-      saved_hl_line = current;
-      saved_hl = malloc (line->r_len);
-      memcpy (saved_hl, line->syn_hl, line->r_len);
-      memset (&line->syn_hl[match - line->render], HL_MATCH, strlen (query));
-      break;
-    }
-  }
+  return nspans;
 }
 
 /** **************************************************************************
  *
- *  @brief              The main find control function for finding a string
+ *  @brief             Search for a keyword within the text buffer
+ *
+ *  @param[in,out]      *buf     The buffer
+ *  @param[in]          *query   The query string typed into the prompt
+ *  @param[in]          key      The key which was just pressed in the prompt
  *
  *  @return             void
  *
  *  @details
  *
- *  This is the main control function of the string searching feature. The status
- *  bar is updated using io_status_bar_prompt and find_keyword_search is used
- *  to call this function recursively until the users wants to exit the
- *  search feature.
+ *  This is called by the search prompt after each key press. The index of
+ *  matches for the query is kept up to date with find_update_results, so typing
+ *  only searches the lines which matched the query before the last char was
+ *  added. The search is done on the raw chars of each line, rather than the
+ *  render array, using the search kernel in search.c.
+ *
+ *  When the query changes, the cursor is moved to the first match after where
+ *  the cursor was when the search started. The arrow keys step through the
+ *  index of matches. Every match on the screen is highlighted by the overlay
+ *  drawn in editor_update_screen_buffer. Ctrl-R toggles between searching for
+ *  the query as plain text and as a regex, Ctrl-K toggles ignoring case and
+ *  Ctrl-W toggles only matching whole words.
  *
  * ************************************************************************** */
 
 void
-find (void)
+find_keyword_search (EDITOR_BUFFER *buf, char *query, int key)
 {
-  int saved_cx;
-  int saved_cy;
-  int saved_col_offset;
-  int saved_row_offset;
-
-  char *query;
+  SEARCH_RESULT *result;
+  SEARCH_STATE *search = &buf->search;
 
   /*
-   * Save the original position of the cursor and text buffer before search
+   * Process the key press - enter or escape will return without doing anything
    */
 
-  saved_cx = editor.cx;
-  saved_cy = editor.cy;
-  saved_col_offset = editor.col_offset;
-  saved_row_offset = editor.row_offset;
+  if (key == '\r' || key == '\x1b')
+  {
+    find_clear_results (buf);
+    return;
+  }
+
+  if (key == CTRL_KEY ('r') || key == CTRL_KEY ('k') || key == CTRL_KEY ('w'))
+  {
+    if (key == CTRL_KEY ('r'))
+      search->regex = !search->regex;
+    else if (key == CTRL_KEY ('k'))
+      search->icase = !search->icase;
+    else
+      search->word = !search->word;
+    find_clear_results (buf);
+  }
+
+  if (query[0] == '\0')
+  {
+    find_clear_results (buf);
+    search->error = NULL;
+    return;
+  }
+
+  result = find_update_results (buf, query);
+  if (result->nmatches == 0)
+  {
+    search->current = NO_MATCH;
+    return;
+  }
 
   /*
-   * Set status bar prompt and call to keyword search function
+   * Step forwards or backwards through the matches with the arrow keys, any
+   * other key will search forwards from where the search started
    */
 
-  if ((query = io_status_bar_prompt ("Search: %s (ESC to cancel | Arrows keys to search)", find_keyword_search)))
+  if ((key == ARROW_RIGHT || key == ARROW_DOWN) && search->current != NO_MATCH)
+  {
+    search->current = (search->current + 1) % result->nmatches;
+  }
+  else if ((key == ARROW_LEFT || key == ARROW_UP) && search->current != NO_MATCH)
+  {
+    search->current = (search->current == 0 ? result->nmatches : search->current) - 1;
+  }
+  else
+  {
+    search->current = find_match_index (result, search->origin_y, search->origin_x);
+  }
+
+  buf->cy = result->matches[search->current].line;
+  buf->cx = result->matches[search->current].col;
+  buf->row_offset = buf->nlines;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Append text to a growable buffer
+ *
+ *  @param[in,out]      *out     The buffer to append to
+ *  @param[in]          *s       The text to append
+ *  @param[in]          len      The length of s
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+find_buf_append (FIND_BUF *out, char *s, size_t len)
+{
+  if (len == 0)
+    return;
+
+  if (out->len + len > out->capacity)
   {
-    free (query);
+    out->capacity = (out->len + len) * 2;
+    if (!(out->buf = realloc (out->buf, out->capacity)))
+      util_exit ("Couldn't allocate memory for replacing text");
   }
 
+  memcpy (&out->buf[out->len], s, len);
+  out->len += len;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Replace every match in a line
+ *
+ *  @param[in,out]      *buf        The buffer
+ *  @param[in]          line        The line to replace matches in
+ *  @param[in]          *pattern    The plain text query, used if regex is NULL
+ *  @param[in]          *regex      The regex query, or NULL
+ *  @param[in]          *with       The replacement text
+ *  @param[in]          with_len    The length of the replacement text
+ *  @param[in,out]      *out        Scratch space for building the new line
+ *
+ *  @return             The number of matches which were replaced
+ *
+ *  @details
+ *
+ *  The new line is built up in out, one match at a time, and is only written
+ *  back if there were any matches. This way, each line which is changed is
+ *  rendered and highlighted once no matter how many matches it has.
+ *
+ * ************************************************************************** */
+
+static size_t
+find_replace_line (EDITOR_BUFFER *buf, size_t line, SEARCH_PATTERN *pattern, REGEX *regex, char *with, size_t with_len,
+                   FIND_BUF *out)
+{
+  size_t len;
+  size_t last;
+  size_t from;
+  size_t nreplaced;
+  size_t match_start;
+  size_t match_end;
+
+  char *chars;
+
+  chars = buf->lines.chars[line];
+  len = buf->lines.len[line];
+  out->len = 0;
+  last = 0;
+  from = 0;
+  nreplaced = 0;
+
+  while (from <= len && find_next_in_line (buf, pattern, regex, line, from, &match_start, &match_end))
+  {
+    find_buf_append (out, &chars[last], match_start - last);
+    find_buf_append (out, with, with_len);
+    last = match_end;
+    from = match_end > match_start ? match_end : match_end + 1;
+    nreplaced++;
+  }
+
+  if (nreplaced == 0)
+    return 0;
+
+  find_buf_append (out, &chars[last], len - last);
+  line_set_text (buf, line, out->buf, out->len);
+
+  return nreplaced;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Replace every match of a query in the text buffer
+ *
+ *  @param[in,out]      *buf        The buffer
+ *  @param[in]          *query      The text or regex to search for
+ *  @param[in]          *with       The replacement text
+ *  @param[out]         *nlines     The number of lines which were changed
+ *  @param[out]         **error     Why the regex is invalid, if it is
+ *
+ *  @return             The number of matches replaced, or NO_MATCH if the
+ *                      query is an invalid regex
+ *
+ *  @details
+ *
+ *  The search modes of the text buffer are used for the query, and the
+ *  replacement is inserted as plain text. Every line is searched once, and
+ *  each line with a match is rewritten in one go. All of the replacements are
+ *  one undo step.
+ *
+ * ************************************************************************** */
+
+size_t
+find_replace_all (EDITOR_BUFFER *buf, char *query, char *with, size_t *nlines, char **error)
+{
+  size_t i;
+  size_t nfound;
+  size_t nreplaced;
+
+  REGEX *regex;
+  SEARCH_PATTERN pattern;
+  FIND_BUF out = {NULL, 0, 0};
+
+  regex = NULL;
+  if (buf->search.regex && (regex = regex_compile (query, buf->search.icase, error)) == NULL)
+    return NO_MATCH;
+  search_compile (&pattern, query, strlen (query), buf->search.icase);
+
   /*
-   * Restore original cursor position upon escape exit of find
+   * Replace the matches in each line
    */
 
-  else
+  nreplaced = 0;
+  *nlines = 0;
+  undo_begin_group (buf);
+  for (i = 0; i < buf->nlines; i++)
   {
-    editor.cx = saved_cx;
-    editor.cy = saved_cy;
-    editor.col_offset = saved_col_offset;
-    editor.row_offset = saved_row_offset;
+    if ((nfound = find_replace_line (buf, i, &pattern, regex, with, strlen (with), &out)))
+    {
+      nreplaced += nfound;
+      (*nlines)++;
+    }
   }
+  undo_end_group (buf);
+
+  if (buf->cy < buf->nlines && buf->cx > buf->lines.len[buf->cy])
+    buf->cx = buf->lines.len[buf->cy];
+
+  regex_free (regex);
+  free (out.buf);
+
+  return nreplaced;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find every match of a query in a buffer
+ *
+ *  @param[in,out]      *buf        The buffer to search
+ *  @param[in]          *query      The query to search for
+ *  @param[out]         **matches   The matches, sorted by line and column
+ *  @param[out]         **error     Why the regex is invalid, if it is
+ *
+ *  @return             The number of matches
+ *
+ *  @details
+ *
+ *  The search modes of the text buffer are used for the query. The matches
+ *  are kept on the search result stack, so they belong to the text buffer and
+ *  a query which extends the last one only searches the lines it matched. The
+ *  results have to be cleared with find_clear_results once the text buffer is
+ *  edited.
+ *
+ * ************************************************************************** */
+
+size_t
+find_all_matches (EDITOR_BUFFER *buf, char *query, SEARCH_MATCH **matches, char **error)
+{
+  SEARCH_RESULT *result;
+
+  result = find_update_results (buf, query);
+  *matches = result->matches;
+  *error = buf->search.error;
+
+  return result->nmatches;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the next match of a query from a position
+ *
+ *  @param[in]          *buf        The buffer
+ *  @param[in]          *query      The text or regex to search for
+ *  @param[in,out]      *line       The line to start from, and the line of
+ *                                  the match
+ *  @param[in,out]      *col        The char to start from, and the char the
+ *                                  match starts at
+ *  @param[out]         **error     Why the regex is invalid, if it is
+ *
+ *  @return             TRUE if there is a match, otherwise FALSE
+ *
+ *  @details
+ *
+ *  The search modes of the text buffer are used for the query. A match can
+ *  start at the starting position, and the search stops at the end of the
+ *  text buffer rather than wrapping around.
+ *
+ * ************************************************************************** */
+
+int
+find_next_match (EDITOR_BUFFER *buf, char *query, size_t *line, size_t *col, char **error)
+{
+  int found;
+  size_t i;
+  size_t from;
+  size_t match_start;
+  size_t match_end;
+
+  REGEX *regex;
+  SEARCH_PATTERN pattern;
+
+  *error = NULL;
+  regex = NULL;
+  if (buf->search.regex && (regex = regex_compile (query, buf->search.icase, error)) == NULL)
+    return FALSE;
+  search_compile (&pattern, query, strlen (query), buf->search.icase);
+
+  found = FALSE;
+  for (i = *line, from = *col; i < buf->nlines && !found; i++, from = 0)
+  {
+    if ((found = find_next_in_line (buf, &pattern, regex, i, from, &match_start, &match_end)))
+    {
+      *line = i;
+      *col = match_start;
+    }
+  }
+
+  regex_free (regex);
+
+  return found;
 }
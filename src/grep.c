@@ -0,0 +1,772 @@
+/** **************************************************************************
+ *
+ * @file grep.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for searching every file in a directory tree.
+ *
+ * ************************************************************************** */
+
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "kris.h"
+
+typedef struct GREP_MATCH
+{
+  char *path;                      // The file the match is in
+  size_t line;                     // The line the match is on
+  size_t col;                      // The column in chars the match starts at
+  char *text;                      // Part of the line around the match
+  size_t text_col;                 // The column the match starts at in text
+} GREP_MATCH;
+
+typedef struct GREP_IGNORE
+{
+  char *pattern;                   // The glob to match paths against
+  size_t base_len;                 // Length of the directory of the .gitignore
+  int dir_only;                    // Bool flag for only matching directories
+  int anchored;                    // Bool flag for matching the whole path
+} GREP_IGNORE;
+
+typedef struct GREP_WALK
+{
+  GREP_IGNORE *rules;              // The ignore rules for the current directory
+  size_t nrules;                   // Number of rules in use
+  size_t capacity;                 // Number of rules allocated
+} GREP_WALK;
+
+static struct
+{
+  pthread_mutex_t lock;            // Protects everything below
+  GREP_MATCH *matches;             // The matches found so far
+  size_t nmatches;                 // Number of matches found
+  size_t capacity;                 // Number of matches allocated
+  size_t nfiles;                   // Number of files searched
+  size_t nfiles_matched;           // Number of files with a match
+  int cancel;                      // Bool flag for stopping the search
+  int truncated;                   // Bool flag for hitting GREP_MAX_MATCHES
+  char *query;                     // The string being searched for
+  SEARCH_PATTERN pattern;          // The compiled query
+  POOL_GROUP group;                // The walk and every file search
+} grep = {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 0, FALSE, FALSE, NULL, {0}, POOL_GROUP_INIT};
+
+/** **************************************************************************
+ *
+ *  @brief              Check if the search has been cancelled
+ *
+ *  @return             TRUE if the search has been cancelled
+ *
+ * ************************************************************************** */
+
+static int
+grep_cancelled (void)
+{
+  int cancel;
+
+  pthread_mutex_lock (&grep.lock);
+  cancel = grep.cancel;
+  pthread_mutex_unlock (&grep.lock);
+
+  return cancel;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Copy the part of a line around a match for display
+ *
+ *  @param[out]         *match      The match to set the text for
+ *  @param[in]          *line       The start of the line
+ *  @param[in]          line_len    The length of the line
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Long lines are cut down to GREP_MAX_LINE_LEN chars, starting a little
+ *  before the match. Control chars, including tabs, are replaced with spaces
+ *  so the text can be drawn without converting it into a render array.
+ *
+ * ************************************************************************** */
+
+static void
+grep_copy_text (GREP_MATCH *match, char *line, size_t line_len)
+{
+  size_t i;
+  size_t start;
+  size_t len;
+
+  start = match->col > GREP_MAX_LINE_LEN / 4 ? match->col - GREP_MAX_LINE_LEN / 4 : 0;
+  len = line_len - start > GREP_MAX_LINE_LEN ? GREP_MAX_LINE_LEN : line_len - start;
+
+  if (!(match->text = malloc (len + 1)))
+    util_exit ("Couldn't allocate memory for a grep match");
+
+  for (i = 0; i < len; i++)
+  {
+    match->text[i] = (char) ((unsigned char) line[start + i] < ' ' || line[start + i] == 127 ? ' ' : line[start + i]);
+  }
+
+  match->text[len] = '\0';
+  match->text_col = match->col - start;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Search a file for the query
+ *
+ *  @param[in]          *arg     The path of the file, which is free'd or kept
+ *                               by the matches
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is run by the worker threads. The file is mapped into memory and the
+ *  whole file is searched with one call to the search kernel. Files with a
+ *  NUL byte near the start are assumed to be binary and are skipped. Only the
+ *  first match on each line is kept, and line numbers are worked out by
+ *  counting new lines between matches. The matches for the file are added to
+ *  the results in one go, so each file's matches are next to each other.
+ *
+ * ************************************************************************** */
+
+static void
+grep_search_file (void *arg)
+{
+  int fd;
+  size_t i;
+  size_t size;
+  size_t line;
+  size_t pos;
+  size_t counted;
+  size_t line_start;
+  size_t line_end;
+  size_t nlocal;
+
+  char *path = arg;
+  char *data;
+  char *p;
+
+  struct stat st;
+
+  SEARCH_MATCHES found = {NULL, 0, 0};
+  GREP_MATCH *local;
+
+  if (grep_cancelled () || (fd = open (path, O_RDONLY)) == -1)
+  {
+    free (path);
+    return;
+  }
+
+  if (fstat (fd, &st) == -1 || !S_ISREG (st.st_mode) || st.st_size == 0)
+  {
+    close (fd);
+    free (path);
+    return;
+  }
+
+  size = (size_t) st.st_size;
+  data = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+
+  if (data == MAP_FAILED)
+  {
+    free (path);
+    return;
+  }
+
+  if (memchr (data, '\0', size < GREP_BINARY_CHECK ? size : GREP_BINARY_CHECK))
+  {
+    munmap (data, size);
+    free (path);
+    pthread_mutex_lock (&grep.lock);
+    grep.nfiles++;
+    pthread_mutex_unlock (&grep.lock);
+    return;
+  }
+
+  madvise (data, size, MADV_SEQUENTIAL);
+  search_all (&grep.pattern, data, size, &found);
+
+  /*
+   * Turn the byte positions into lines and columns
+   */
+
+  if (!(local = malloc ((found.npos ? found.npos : 1) * sizeof (*local))))
+    util_exit ("Couldn't allocate memory for grep matches");
+
+  nlocal = 0;
+  line = 0;
+  counted = 0;
+  line_end = 0;
+
+  for (i = 0; i < found.npos; i++)
+  {
+    pos = found.pos[i];
+    if (nlocal && pos < line_end)
+      continue;
+
+    for (; (p = memchr (&data[counted], '\n', pos - counted)); counted = (size_t) (p - data) + 1)
+      line++;
+    counted = pos;
+
+    for (line_start = pos; line_start > 0 && data[line_start - 1] != '\n'; line_start--);
+    p = memchr (&data[pos], '\n', size - pos);
+    line_end = p ? (size_t) (p - data) : size;
+
+    local[nlocal].path = path;
+    local[nlocal].line = line;
+    local[nlocal].col = pos - line_start;
+    grep_copy_text (&local[nlocal], &data[line_start], line_end - line_start);
+    nlocal++;
+  }
+
+  munmap (data, size);
+  free (found.pos);
+
+  /*
+   * Add the file's matches to the results
+   */
+
+  pthread_mutex_lock (&grep.lock);
+
+  grep.nfiles++;
+  if (nlocal && grep.nmatches + nlocal > GREP_MAX_MATCHES)
+  {
+    grep.truncated = TRUE;
+    grep.cancel = TRUE;
+    for (i = 0; i < nlocal; i++)
+      free (local[i].text);
+    nlocal = 0;
+  }
+
+  if (nlocal)
+  {
+    if (grep.nmatches + nlocal > grep.capacity)
+    {
+      grep.capacity = (grep.nmatches + nlocal) * 2;
+      if (!(grep.matches = realloc (grep.matches, grep.capacity * sizeof (*grep.matches))))
+        util_exit ("Couldn't allocate memory for grep matches");
+    }
+    memcpy (&grep.matches[grep.nmatches], local, nlocal * sizeof (*local));
+    grep.nmatches += nlocal;
+    grep.nfiles_matched++;
+  }
+
+  pthread_mutex_unlock (&grep.lock);
+
+  if (nlocal == 0)
+    free (path);
+  free (local);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Read the rules from a .gitignore file
+ *
+ *  @param[in,out]      *walk     The walk to add the rules to
+ *  @param[in]          *dir      The directory the .gitignore is in
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Blank lines, comments and negated rules are skipped. A leading / or a / in
+ *  the middle anchors the rule to the directory of the .gitignore, and a
+ *  trailing / means the rule only matches directories.
+ *
+ * ************************************************************************** */
+
+static void
+grep_read_ignore (GREP_WALK *walk, char *dir)
+{
+  char *line;
+  char *pattern;
+  char path[PATH_MAX];
+  size_t line_cap;
+  ssize_t len;
+  FILE *file;
+  GREP_IGNORE *rule;
+
+  snprintf (path, sizeof path, "%s%s.gitignore", dir, dir[0] ? "/" : "");
+  if (!(file = fopen (path, "r")))
+    return;
+
+  line = NULL;
+  line_cap = 0;
+
+  while ((len = getline (&line, &line_cap, file)) != -1)
+  {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' '))
+      line[--len] = '\0';
+    if (len == 0 || line[0] == '#' || line[0] == '!')
+      continue;
+
+    if (walk->nrules == walk->capacity)
+    {
+      walk->capacity = walk->capacity ? walk->capacity * 2 : 16;
+      if (!(walk->rules = realloc (walk->rules, walk->capacity * sizeof (*walk->rules))))
+        util_exit ("Couldn't allocate memory for ignore rules");
+    }
+
+    rule = &walk->rules[walk->nrules++];
+    rule->base_len = strlen (dir);
+    rule->dir_only = line[len - 1] == '/';
+    if (rule->dir_only)
+      line[--len] = '\0';
+
+    pattern = line[0] == '/' ? &line[1] : line;
+    rule->anchored = strchr (line, '/') != NULL;
+    rule->pattern = strdup (pattern);
+  }
+
+  free (line);
+  fclose (file);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Check if a path is ignored by a .gitignore
+ *
+ *  @param[in]          *walk     The walk with the rules in scope
+ *  @param[in]          *path     The path, relative to where the walk started
+ *  @param[in]          *name     The last component of the path
+ *  @param[in]          is_dir    Bool flag for the path being a directory
+ *
+ *  @return             TRUE if the path should be skipped
+ *
+ * ************************************************************************** */
+
+static int
+grep_is_ignored (GREP_WALK *walk, char *path, char *name, int is_dir)
+{
+  size_t i;
+  char *relative;
+  GREP_IGNORE *rule;
+
+  for (i = 0; i < walk->nrules; i++)
+  {
+    rule = &walk->rules[i];
+    if (rule->dir_only && !is_dir)
+      continue;
+
+    if (rule->anchored)
+    {
+      relative = rule->base_len ? &path[rule->base_len + 1] : path;
+      if (!fnmatch (rule->pattern, relative, FNM_PATHNAME))
+        return TRUE;
+    }
+    else if (!fnmatch (rule->pattern, name, 0))
+    {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Walk a directory, queueing a search for each file
+ *
+ *  @param[in,out]      *walk     The ignore rules in scope
+ *  @param[in]          *dir      The directory to walk, "" for the start
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Hidden files and directories are skipped, as are symbolic links so the
+ *  walk can't loop. The rules from a directory's .gitignore only apply while
+ *  walking that directory.
+ *
+ * ************************************************************************** */
+
+static void
+grep_walk_dir (GREP_WALK *walk, char *dir)
+{
+  int is_dir;
+  size_t i;
+  size_t nrules;
+  char *path;
+
+  DIR *d;
+  struct dirent *entry;
+  struct stat st;
+
+  if (grep_cancelled () || !(d = opendir (dir[0] ? dir : ".")))
+    return;
+
+  nrules = walk->nrules;
+  grep_read_ignore (walk, dir);
+
+  while ((entry = readdir (d)) && !grep_cancelled ())
+  {
+    if (entry->d_name[0] == '.')
+      continue;
+
+    if (!(path = malloc (strlen (dir) + strlen (entry->d_name) + 2)))
+      util_exit ("Couldn't allocate memory for a path");
+    sprintf (path, "%s%s%s", dir, dir[0] ? "/" : "", entry->d_name);
+
+    if (entry->d_type == DT_UNKNOWN)
+    {
+      if (lstat (path, &st) == -1)
+      {
+        free (path);
+        continue;
+      }
+      entry->d_type = S_ISDIR (st.st_mode) ? DT_DIR : S_ISREG (st.st_mode) ? DT_REG : DT_LNK;
+    }
+
+    is_dir = entry->d_type == DT_DIR;
+    if ((!is_dir && entry->d_type != DT_REG) || grep_is_ignored (walk, path, entry->d_name, is_dir))
+    {
+      free (path);
+      continue;
+    }
+
+    if (is_dir)
+    {
+      grep_walk_dir (walk, path);
+      free (path);
+    }
+    else
+    {
+      pool_submit (&grep.group, grep_search_file, path);
+    }
+  }
+
+  closedir (d);
+
+  for (i = nrules; i < walk->nrules; i++)
+    free (walk->rules[i].pattern);
+  walk->nrules = nrules;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Walk the current directory from a worker thread
+ *
+ *  @param[in]          *unused    Required by pool_submit
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+grep_walk (void *unused)
+{
+  GREP_WALK walk = {NULL, 0, 0};
+
+  (void) unused;
+
+  grep_walk_dir (&walk, "");
+  free (walk.rules);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Stop the search and free the results
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+grep_finish (void)
+{
+  size_t i;
+
+  pthread_mutex_lock (&grep.lock);
+  grep.cancel = TRUE;
+  pthread_mutex_unlock (&grep.lock);
+
+  pool_wait (&grep.group);
+
+  for (i = 0; i < grep.nmatches; i++)
+  {
+    if (i + 1 == grep.nmatches || grep.matches[i + 1].path != grep.matches[i].path)
+      free (grep.matches[i].path);
+    free (grep.matches[i].text);
+  }
+
+  free (grep.matches);
+  free (grep.query);
+  grep.matches = NULL;
+  grep.nmatches = grep.capacity = 0;
+  grep.query = NULL;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Draw the list of matches
+ *
+ *  @param[in]          selected    The index of the selected match
+ *  @param[in]          top         The index of the match at the top
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Each match is drawn as path:line: text, with the match highlighted and the
+ *  selected match in inverted colours. The status bar shows the progress of
+ *  the search.
+ *
+ * ************************************************************************** */
+
+static void
+grep_draw (size_t selected, size_t top)
+{
+  int i;
+  int len;
+  int done;
+  size_t cols;
+  size_t text_len;
+  size_t match_end;
+
+  char buf[PATH_MAX + 64];
+  char count[32];
+  char nfiles[32];
+
+  GREP_MATCH *match;
+  SCREEN_BUF sb = SBUF_INIT;
+
+  done = pool_group_done (&grep.group);
+  cols = (size_t) editor.screen_cols;
+
+  editor_add_to_screen_buf (&sb, "\x1b[?25l\x1b[H", 9);
+  pthread_mutex_lock (&grep.lock);
+
+  for (i = 0; i < editor.screen_rows; i++)
+  {
+    if (top + (size_t) i < grep.nmatches)
+    {
+      match = &grep.matches[top + (size_t) i];
+      if (top + (size_t) i == selected)
+        editor_add_to_screen_buf (&sb, "\x1b[7m", 4);
+
+      len = snprintf (buf, sizeof buf, "%s:%zu: ", match->path, match->line + 1);
+      if ((size_t) len > cols)
+        len = (int) cols;
+      editor_add_to_screen_buf (&sb, buf, (size_t) len);
+
+      /*
+       * Add as much of the text as fits, with the match highlighted
+       */
+
+      text_len = strlen (match->text);
+      if (text_len > cols - (size_t) len)
+        text_len = cols - (size_t) len;
+      match_end = match->text_col + strlen (grep.query);
+
+      if (match->text_col < text_len)
+      {
+        editor_add_to_screen_buf (&sb, match->text, match->text_col);
+        len = snprintf (buf, sizeof buf, "\x1b[%dm", syntax_get_colour (HL_MATCH));
+        editor_add_to_screen_buf (&sb, buf, (size_t) len);
+        editor_add_to_screen_buf (&sb, &match->text[match->text_col],
+                                  (match_end < text_len ? match_end : text_len) - match->text_col);
+        editor_add_to_screen_buf (&sb, "\x1b[39m", 5);
+        if (match_end < text_len)
+          editor_add_to_screen_buf (&sb, &match->text[match_end], text_len - match_end);
+      }
+      else
+      {
+        editor_add_to_screen_buf (&sb, match->text, text_len);
+      }
+
+      editor_add_to_screen_buf (&sb, "\x1b[m", 3);
+    }
+    else if (top + (size_t) i == 0 && done)
+    {
+      editor_add_to_screen_buf (&sb, "No matches", 10);
+    }
+
+    editor_add_to_screen_buf (&sb, "\x1b[K\r\n", 5);
+  }
+
+  /*
+   * The status bar shows how far the search has got
+   */
+
+  util_format_count (count, sizeof count, grep.nmatches);
+  util_format_count (nfiles, sizeof nfiles, grep.nfiles);
+  len = snprintf (buf, sizeof buf, "grep: %.40s | %s matches in %s files%s", grep.query, count, nfiles,
+                  grep.truncated ? " (stopped at the limit)" : done ? "" : " | searching...");
+  pthread_mutex_unlock (&grep.lock);
+
+  if ((size_t) len > cols)
+    len = (int) cols;
+
+  editor_add_to_screen_buf (&sb, "\x1b[7m", 4);
+  editor_add_to_screen_buf (&sb, buf, (size_t) len);
+  while ((size_t) len++ < cols)
+    editor_add_to_screen_buf (&sb, " ", 1);
+  editor_add_to_screen_buf (&sb, "\x1b[m\r\n\x1b[K", 8);
+
+  len = snprintf (buf, sizeof buf, "Arrows to move | Enter to open | ESC to close");
+  editor_add_to_screen_buf (&sb, buf, (size_t) len > cols ? cols : (size_t) len);
+  editor_add_to_screen_buf (&sb, "\x1b[?25h", 6);
+
+  write (STDOUT_FILENO, sb.buf, sb.len);
+  free (sb.buf);
+  editor_damage_all ();
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Search every file under the current directory
+ *
+ *  @param[in]          *query     The string to search for
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The directory is walked and the files are searched on the worker pool,
+ *  while the matches are shown in a list which updates as they come in. The
+ *  list can be scrolled through while the search is running. Pressing enter
+ *  opens the file of the selected match at the match.
+ *
+ * ************************************************************************** */
+
+void
+grep_directory (char *query)
+{
+  int c;
+  int done;
+  int redraw;
+  int drawn_done;
+  size_t top;
+  size_t page;
+  size_t line;
+  size_t col;
+  size_t nfiles;
+  size_t nmatches;
+  size_t selected;
+  size_t drawn_nfiles;
+
+  char *path;
+
+  struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+
+  if (query[0] == '\0')
+  {
+    editor_set_status_message ("Usage: grep <text>");
+    return;
+  }
+
+  grep.query = strdup (query);
+  grep.cancel = FALSE;
+  grep.truncated = FALSE;
+  grep.nfiles = 0;
+  grep.nfiles_matched = 0;
+  search_compile (&grep.pattern, grep.query, strlen (grep.query), FALSE);
+  pool_submit (&grep.group, grep_walk, NULL);
+
+  selected = 0;
+  top = 0;
+  path = NULL;
+  redraw = TRUE;
+  drawn_done = FALSE;
+  drawn_nfiles = 0;
+
+  while (TRUE)
+  {
+    page = editor.screen_rows > 0 ? (size_t) editor.screen_rows : 1;
+    if (selected < top)
+      top = selected;
+    if (selected >= top + page)
+      top = selected - page + 1;
+
+    /*
+     * Check every so often for new matches while waiting for a key press, so
+     * the matches appear as they are found. The list is only drawn again when
+     * it has changed
+     */
+
+    pthread_mutex_lock (&grep.lock);
+    nmatches = grep.nmatches;
+    nfiles = grep.nfiles;
+    pthread_mutex_unlock (&grep.lock);
+
+    done = pool_group_done (&grep.group);
+    if (redraw || nfiles != drawn_nfiles || done != drawn_done)
+    {
+      grep_draw (selected, top);
+      drawn_nfiles = nfiles;
+      drawn_done = done;
+      redraw = FALSE;
+    }
+
+    if (poll (&input, 1, GREP_REDRAW_MS) <= 0)
+      continue;
+
+    c = kp_read_keypress ();
+    redraw = TRUE;
+
+    if (c == '\x1b' || c == CTRL_KEY ('q'))
+      break;
+
+    switch (c)
+    {
+      case ARROW_UP:
+        selected -= selected > 0;
+        break;
+      case ARROW_DOWN:
+        selected += selected + 1 < nmatches;
+        break;
+      case PAGE_UP:
+        selected = selected > page ? selected - page : 0;
+        break;
+      case PAGE_DOWN:
+        selected = selected + page < nmatches ? selected + page : (nmatches ? nmatches - 1 : 0);
+        break;
+      case HOME_KEY:
+        selected = 0;
+        break;
+      case END_KEY:
+        selected = nmatches ? nmatches - 1 : 0;
+        break;
+      default:
+        break;
+    }
+
+    if (c == '\r' && selected < nmatches)
+    {
+      pthread_mutex_lock (&grep.lock);
+      path = strdup (grep.matches[selected].path);
+      line = grep.matches[selected].line;
+      col = grep.matches[selected].col;
+      pthread_mutex_unlock (&grep.lock);
+      break;
+    }
+  }
+
+  grep_finish ();
+
+  if (path && io_open_file (path))
+  {
+    editor.buf->cy = line < editor.buf->nlines ? line : 0;
+    editor.buf->cx = editor.buf->nlines ? col : 0;
+  }
+
+  free (path);
+}
@@ -13,10 +13,29 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "kris.h"
 #include "syntax.h"
 
+/** **************************************************************************
+ *
+ *  @brief              Get the time from a monotonic clock
+ *
+ *  @return             The time in seconds
+ *
+ * ************************************************************************** */
+
+static double
+syntax_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 /** **************************************************************************
  *
  *  @brief              Return true if the char passed is considered a separator
@@ -71,28 +90,27 @@ syntax_get_colour (int hl)
 
 /** **************************************************************************
  *
- *  @brief              Match the file type and syntax highlighting
+ *  @brief              Find the syntax highlighting rules for a file
  *
- *  @return             void
+ *  @param[in]          *filename     The name of the file, or NULL
+ *
+ *  @return             The rules from the syntax highlighting database, or NULL
+ *                      if the file type isn't known
  *
  *  @details
  *
- *  Figures out the file type from the filename and either sets the syntax
- *  highlighting as NULL or sets it appropriately from the syntax highlighting
- *  database. If the syntax highlighting it set, then the syntax highlighting is
- *  updated. This means the file type can be changed and the syntax highlighting
- *  will be updated.
+ *  The rules are returned from the database rather than copied, so every
+ *  buffer of the same file type shares them.
  *
  * ************************************************************************** */
 
-void
-syntax_select_highlighting (void)
+SYNTAX *
+syntax_match (char *filename)
 {
   int is_ext;
 
   size_t i;
   size_t j;
-  size_t k;
 
   char *file_ext;
 
@@ -101,12 +119,11 @@ syntax_select_highlighting (void)
    * of the file
    */
 
-  editor.syntax = NULL;
-  if (editor.filename == NULL)
-    return;
+  if (filename == NULL)
+    return NULL;
 
   // TODO: this might fail if the filename has multiple periods in it
-  file_ext = strrchr (editor.filename, '.');
+  file_ext = strrchr (filename, '.');
 
   /*
    * Attempt to match the file extension with one in the synthax highlight
@@ -124,41 +141,61 @@ syntax_select_highlighting (void)
 
       is_ext = (HLDB[i].filematch[j][0] == '.');
 
-      /*
-       * Set the editor syntax and update all of the lines
-       */
-
       if ((is_ext && file_ext && !strcmp (file_ext, HLDB[i].filematch[j])) ||
-                                                            (!is_ext && strstr (editor.filename, HLDB[i].filematch[j])))
-      {
-        editor.syntax = &HLDB[i];
-
-        for (k = 0; k < editor.nlines; k++)
-          syntax_update_highlighting (&editor.lines[k]);
+                                                            (!is_ext && strstr (filename, HLDB[i].filematch[j])))
+        return &HLDB[i];
 
-        return;
-      }
       j++;
     }
   }
+
+  return NULL;
 }
 
 /** **************************************************************************
  *
- *  @brief              Update the syntax highlight array for a single line
+ *  @brief              Match the file type and syntax highlighting
  *
- *  @param[in]          *line      The line to update syntax highlighting for
+ *  @param[in,out]      *buf      The buffer
  *
  *  @return             void
  *
  *  @details
  *
- *  TODO fill out the documentation - I have no clue how this works anymore lole
+ *  Figures out the file type from the filename and either sets the syntax
+ *  highlighting as NULL or sets it appropriately from the syntax highlighting
+ *  database. If the syntax highlighting it set, then the syntax highlighting is
+ *  updated. This means the file type can be changed and the syntax highlighting
+ *  will be updated.
  *
  * ************************************************************************** */
 
 void
-syntax_update_highlighting (EDITOR_LINE *line)
+syntax_select_highlighting (EDITOR_BUFFER *buf)
+{
+  if ((buf->syntax = syntax_match (buf->filename)))
+    syntax_highlight_buffer (buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the syntax highlight array for a single line
+ *
+ *  @param[in]          *buf       The buffer the line is in
+ *  @param[in]          idx        The index of the line to update syntax
+ *                                 highlighting for
+ *
+ *  @return             TRUE if the multi line comment state at the end of the
+ *                      line changed, otherwise FALSE
+ *
+ *  @details
+ *
+ *  TODO fill out the documentation - I have no clue how this works anymore lole
+ *
+ * ************************************************************************** */
+
+static int
+syntax_highlight_line (EDITOR_BUFFER *buf, size_t idx)
 {
   int prev_sep;
   int in_string;
@@ -172,7 +209,9 @@ syntax_update_highlighting (EDITOR_LINE *line)
   char *mcs;
   char *mce;
   char *pp;
+  char *render;
   unsigned char prev_hl;
+  unsigned char *hl;
 
   size_t i;
   size_t j;
@@ -181,26 +220,29 @@ syntax_update_highlighting (EDITOR_LINE *line)
   size_t mce_len;
   size_t key_len;
   size_t pp_len;
+  size_t r_len;
 
   /*
    * Allocate space for syntax highlight array and initialise to no highlighting
    */
 
-  line->syn_hl = realloc (line->syn_hl, line->r_len);
-  memset (line->syn_hl, HL_NORMAL, line->r_len);
+  r_len = buf->lines.r_len[idx];
+  render = buf->lines.render[idx];
+  hl = buf->lines.syn_hl[idx] = realloc (buf->lines.syn_hl[idx], r_len);
+  memset (hl, HL_NORMAL, r_len);
 
-  if (editor.syntax == NULL)
-    return;
+  if (buf->syntax == NULL)
+    return FALSE;
 
   /*
    * Just aliases for various strings and the length of these strings
    */
 
-  keywords = editor.syntax->keywords;
-  scs = editor.syntax->single_line_comment;
-  mcs = editor.syntax->ml_comment_start;
-  mce = editor.syntax->ml_comment_end;
-  pp = editor.syntax->pre_processor;
+  keywords = buf->syntax->keywords;
+  scs = buf->syntax->single_line_comment;
+  mcs = buf->syntax->ml_comment_start;
+  mce = buf->syntax->ml_comment_end;
+  pp = buf->syntax->pre_processor;
   scs_len = scs ? strlen (scs) : 0;
   mcs_len = mcs ? strlen (mcs) : 0;
   mce_len = mce ? strlen (mce) : 0;
@@ -216,12 +258,12 @@ syntax_update_highlighting (EDITOR_LINE *line)
   i = 0;
   prev_sep = TRUE;
   in_string = FALSE;
-  in_comment = (line->idx > 0 && editor.lines[line->idx - 1].hl_open_comment);
+  in_comment = (idx > 0 && buf->lines.hl_open_comment[idx - 1]);
 
-  while (i < line->r_len)
+  while (i < r_len)
   {
-    c = line->render[i];
-    prev_hl = (i > 0) ? line->syn_hl[i - 1] : HL_NORMAL;
+    c = render[i];
+    prev_hl = (i > 0) ? hl[i - 1] : HL_NORMAL;
 
     /*
      * Process for preprocessor directives
@@ -229,9 +271,9 @@ syntax_update_highlighting (EDITOR_LINE *line)
 
     if (pp_len && !in_string && !in_comment)
     {
-      if (!strncmp (&line->render[i], pp, pp_len))
+      if (!strncmp (&render[i], pp, pp_len))
       {
-        memset (&line->syn_hl[i], HL_PREPROCESS, line->r_len - i);
+        memset (&hl[i], HL_PREPROCESS, r_len - i);
         break;
       }
     }
@@ -242,14 +284,14 @@ syntax_update_highlighting (EDITOR_LINE *line)
 
     if (scs_len && !in_string && !in_comment)
     {
-      if (!strncmp (&line->render[i], scs, scs_len))
+      if (!strncmp (&render[i], scs, scs_len))
       {
-        memset (&line->syn_hl[i], HL_COMMENT, line->r_len - i);
+        memset (&hl[i], HL_COMMENT, r_len - i);
         break;
       }
-      else if (line->render[i] == 'c' && i == 0 && !strcmp (editor.syntax->filetype, "FORTRAN"))  // Awful f77 thing
+      else if (render[i] == 'c' && i == 0 && !strcmp (buf->syntax->filetype, "FORTRAN"))  // Awful f77 thing
       {
-        memset (&line->syn_hl[i], HL_COMMENT, line->r_len - i);
+        memset (&hl[i], HL_COMMENT, r_len - i);
         break;
       }
     }
@@ -262,10 +304,10 @@ syntax_update_highlighting (EDITOR_LINE *line)
     {
       if (in_comment)
       {
-        line->syn_hl[i] = HL_ML_COMMENT;
-        if (!strncmp (&line->render[i], mce, mce_len))
+        hl[i] = HL_ML_COMMENT;
+        if (!strncmp (&render[i], mce, mce_len))
         {
-          memset (&line->syn_hl[i], HL_ML_COMMENT, mce_len);
+          memset (&hl[i], HL_ML_COMMENT, mce_len);
           i += mce_len;
           in_comment = FALSE;
           prev_sep = TRUE;
@@ -276,9 +318,9 @@ syntax_update_highlighting (EDITOR_LINE *line)
           continue;
         }
       }
-      else if (!strncmp (&line->render[i], mcs, mce_len))
+      else if (!strncmp (&render[i], mcs, mce_len))
       {
-        memset (&line->syn_hl[i], HL_ML_COMMENT, mcs_len);
+        memset (&hl[i], HL_ML_COMMENT, mcs_len);
         i+= mcs_len;
         in_comment = TRUE;
         continue;
@@ -289,18 +331,18 @@ syntax_update_highlighting (EDITOR_LINE *line)
      * Process for strings, can be enclosed by " or '
      */
 
-    if (editor.syntax->flags & HL_HIGHLIGHT_STRINGS)
+    if (buf->syntax->flags & HL_HIGHLIGHT_STRINGS)
     {
       if (in_string)
       {
         // Deal with escape sequences for quotes
-        if (c == '\\' && i + 1 < line->r_len)
+        if (c == '\\' && i + 1 < r_len)
         {
-          line->syn_hl[i + 1] = HL_STRING;
+          hl[i + 1] = HL_STRING;
           i += 2;
           continue;
         }
-        line->syn_hl[i] = HL_STRING;
+        hl[i] = HL_STRING;
         if (c == in_string)
           in_string = FALSE;
         i++;
@@ -313,7 +355,7 @@ syntax_update_highlighting (EDITOR_LINE *line)
         {
           // Save the value so we know if to close around another " or '
           in_string = c;
-          line->syn_hl[i] = HL_STRING;
+          hl[i] = HL_STRING;
           i++;
           continue;
         }
@@ -324,13 +366,13 @@ syntax_update_highlighting (EDITOR_LINE *line)
      * Process for numbers not part of strings or variable names
      */
 
-    if (editor.syntax->flags & HL_HIGHLIGHT_NUMBERS)
+    if (buf->syntax->flags & HL_HIGHLIGHT_NUMBERS)
     {
       // The 2nd OR is for decimal numbers and 3rd is for scientific numbers
       if ((isdigit (c) && (prev_sep || prev_hl == HL_NUMBER)) ||
                                                (c == '.' && prev_hl == HL_NUMBER) || (c == 'e' && prev_hl == HL_NUMBER))
       {
-        line->syn_hl[i] = HL_NUMBER;
+        hl[i] = HL_NUMBER;
         i++;
         prev_sep = FALSE;
         continue;
@@ -356,9 +398,9 @@ syntax_update_highlighting (EDITOR_LINE *line)
           key_len--;
 
         // Keywords require a separator before and after
-        if (!strncmp (&line->render[i], keywords[j], key_len) && is_separator (line->render[i + key_len]))
+        if (!strncmp (&render[i], keywords[j], key_len) && is_separator (render[i + key_len]))
         {
-          memset (&line->syn_hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, key_len);
+          memset (&hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, key_len);
           i += key_len;
           break;
         }
@@ -375,13 +417,82 @@ syntax_update_highlighting (EDITOR_LINE *line)
   }
 
   /*
-   * Track to see if the ml comment has been closed.. if not make a recursive
-   * call to update the next line until the ml comment is closed
+   * Track to see if the ml comment has been closed or opened
    */
 
-  changed = (line->hl_open_comment != in_comment);
-  line->hl_open_comment = in_comment;
+  changed = (buf->lines.hl_open_comment[idx] != in_comment);
+  buf->lines.hl_open_comment[idx] = (unsigned char) in_comment;
+
+  return changed;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the syntax highlighting for a line and any lines
+ *                      after it which are affected by a multi line comment
+ *
+ *  @param[in,out]      *buf       The buffer
+ *  @param[in]          idx        The index of the line to update syntax
+ *                                 highlighting for
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The line is highlighted and, if it has opened or closed a multi line
+ *  comment, the following lines are updated until the multi line comment state
+ *  stops changing. This is done in a loop rather than by recursion, as the
+ *  cascade can run over the entire text buffer. When the HUD is on, the time
+ *  taken and the number of lines highlighted are added up in the buffer for
+ *  it to show.
+ *
+ * ************************************************************************** */
+
+void
+syntax_update_highlighting (EDITOR_BUFFER *buf, size_t idx)
+{
+  size_t nlines;
+  double start;
+  TRACE_SCOPE (__func__);
+
+  start = buf->hl_timed ? syntax_now () : 0;
+
+  nlines = 1;
+  while (syntax_highlight_line (buf, idx) && idx + 1 < buf->nlines)
+  {
+    idx++;
+    nlines++;
+  }
+
+  if (buf->hl_timed)
+  {
+    buf->hl_time += syntax_now () - start;
+    buf->hl_lines += nlines;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the syntax highlighting of every line in a buffer
+ *
+ *  @param[in]          *buf       The buffer to highlight
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The lines are done in order, so the multi line comment state is carried
+ *  from each line to the next and every line is only highlighted once. This
+ *  only uses the buffer passed in, so it's safe to run on a worker thread on
+ *  a buffer which isn't being edited.
+ *
+ * ************************************************************************** */
+
+void
+syntax_highlight_buffer (EDITOR_BUFFER *buf)
+{
+  size_t i;
 
-  if (changed && line->idx + 1 < editor.nlines)
-    syntax_update_highlighting (&editor.lines[line->idx + 1]);
+  for (i = 0; i < buf->nlines; i++)
+    syntax_highlight_line (buf, i);
 }
@@ -0,0 +1,207 @@
+/** **************************************************************************
+ *
+ * @file hud.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for timing the editor and showing the timings in the
+ *        message bar.
+ *
+ * ************************************************************************** */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Get the time from a monotonic clock
+ *
+ *  @return             The time in seconds
+ *
+ * ************************************************************************** */
+
+static double
+hud_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Turn the HUD on or off
+ *
+ *  @param[in]          *arg     "on", "off" or an empty string to toggle
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+hud_toggle (char *arg)
+{
+  size_t i;
+
+  if (!strcmp (arg, "on"))
+    editor.hud.enabled = TRUE;
+  else if (!strcmp (arg, "off"))
+    editor.hud.enabled = FALSE;
+  else if (arg[0] == '\0')
+    editor.hud.enabled = !editor.hud.enabled;
+  else
+    editor_set_status_message ("Usage: hud [on | off]");
+
+  for (i = 0; i < editor.nbuffers; i++)
+    editor.buffers[i]->hl_timed = editor.hud.enabled;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start timing a refresh of the screen
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The highlighting done since the last refresh was for the last edit, so it
+ *  is taken from the buffers and shown from now on. A refresh without any
+ *  highlighting keeps showing the last edit which had some.
+ *
+ * ************************************************************************** */
+
+void
+hud_frame_begin (void)
+{
+  size_t i;
+  size_t hl_lines;
+  double hl_time;
+  HUD *hud = &editor.hud;
+
+  if (!hud->enabled)
+    return;
+
+  hud->frame_start = hud_now ();
+
+  hl_time = 0;
+  hl_lines = 0;
+  for (i = 0; i < editor.nbuffers; i++)
+  {
+    hl_time += editor.buffers[i]->hl_time;
+    hl_lines += editor.buffers[i]->hl_lines;
+    editor.buffers[i]->hl_time = 0;
+    editor.buffers[i]->hl_lines = 0;
+  }
+
+  if (hl_lines > 0)
+  {
+    hud->hl_time = hl_time;
+    hud->hl_lines = hl_lines;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Finish timing a refresh of the screen
+ *
+ *  @param[in]          nbytes    The number of bytes written to the terminal
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+hud_frame_end (size_t nbytes)
+{
+  if (!editor.hud.enabled)
+    return;
+
+  editor.hud.frame_time = hud_now () - editor.hud.frame_start;
+  editor.hud.frame_bytes = nbytes;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the size of the heap into a string
+ *
+ *  @param[out]         *buf      The string to write to
+ *  @param[in]          size      The size of buf
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Only glibc can be asked how big the heap is, so with other C libraries the
+ *  heap is shown as n/a.
+ *
+ * ************************************************************************** */
+
+static void
+hud_heap (char *buf, size_t size)
+{
+#ifdef __GLIBC__
+  struct mallinfo2 info = mallinfo2 ();
+
+  snprintf (buf, size, "%.1fM", (double) (info.uordblks + info.hblkhd) / (1 << 20));
+#else
+  snprintf (buf, size, "n/a");
+#endif
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the HUD into a string
+ *
+ *  @param[out]         *buf      The string to write to
+ *  @param[in]          size      The size of buf
+ *
+ *  @return             The length of the HUD, or 0 if it's off
+ *
+ *  @details
+ *
+ *  The heap is the total glibc has handed out. It is split into the chars of
+ *  the text buffer being edited, its undo log, its trigram index and its
+ *  search matches, which are all cheap to count. The rest of the heap is the
+ *  per line arrays, render and highlighting arrays, screen buffers and
+ *  everything else.
+ *
+ * ************************************************************************** */
+
+size_t
+hud_format (char *buf, size_t size)
+{
+  int len;
+  size_t i;
+  size_t search;
+  char heap[16];
+  HUD *hud = &editor.hud;
+  SEARCH_STATE *state = &editor.buf->search;
+
+  if (!hud->enabled)
+    return 0;
+
+  hud_heap (heap, sizeof heap);
+
+  search = 0;
+  for (i = 0; i < state->nresults; i++)
+    search += state->results[i].nmatches * sizeof *state->results[i].matches;
+
+  len = snprintf (buf, size, "frame %.2fms %zuB | hl %.2fms %zu ln | heap %s: text %.1f undo %.1f idx %.1f find %.1f",
+                  hud->frame_time * 1e3, hud->frame_bytes, hud->hl_time * 1e3, hud->hl_lines, heap,
+                  (double) offset_line_to_byte (editor.buf, editor.buf->nlines) / (1 << 20),
+                  (double) editor.buf->undo.memory / (1 << 20), (double) editor.buf->trigrams.memory / (1 << 20),
+                  (double) search / (1 << 20));
+
+  return len < 0 ? 0 : (size_t) len < size ? (size_t) len : size - 1;
+}
@@ -14,6 +14,8 @@
 
 #include "kris.h"
 
+EDITOR_CONFIG editor;
+
 /** **************************************************************************
  *
  *  @brief              Initialise the editor the basic editor variables
@@ -22,9 +24,10 @@
  *
  *  @details
  *
- *  Initialises a bunch of variables for the editor global variable. Also uses
- *  the library function signal to listen out for signals for when the terminal
- *  size changes, so Kris is able to resize with the terminal.
+ *  Initialises a bunch of variables for the editor global variable, and shows
+ *  the messages from util_message in the message bar. Also uses the library
+ *  function signal to listen out for signals for when the terminal size
+ *  changes, so Kris is able to resize with the terminal.
  *
  * ************************************************************************** */
 
@@ -33,30 +36,33 @@
 void
 editor_init (void)
 {
-  int unused = 0;  // This var is unused but passed for signal
-
   /*
    * Set a initial values for the editor configuration
    */
 
-  editor.cx = 0;
-  editor.cy = 0;
-  editor.rx = 0;
-  editor.row_offset = 0;
-  editor.col_offset = 0;
-  editor.nlines = 0;
-  editor.lines = NULL;
-  editor.filename = NULL;
-  editor.modified = FALSE;
+  editor.buffers = NULL;
+  editor.nbuffers = 0;
+  editor.buffers_capacity = 0;
+  editor.root = editor.win = NULL;
+  editor.frame = NULL;
+  editor.frame_rows = 0;
   editor.status_msg[0] = '\0';
   editor.status_msg_time = 0;
-  editor.syntax = NULL;
+  util_on_message (editor_show_message);
+
+  /*
+   * Start with one empty buffer, which a file can be read into
+   */
+
+  buffer_switch (buffer_new (NULL));
+  window_init ();
 
   /*
    * Get the size of the terminal window and use signal to monitor if the
-   * terminal window changes in size to update the size on the fly
+   * terminal window changes in size, so the size is updated before the next
+   * refresh
    */
 
-  terminal_update_size (unused);
-  signal (SIGWINCH, terminal_update_size);
+  terminal_update_size ();
+  signal (SIGWINCH, terminal_on_resize);
 }
@@ -10,7 +10,6 @@
  *
  * ************************************************************************** */
 
-#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -22,149 +21,43 @@
 
 /** **************************************************************************
  *
- *  @brief              Display a prompt in the status bar, and input text
+ *  @brief              Read a file into a buffer and highlight it
  *
- *  @param[in]          *prompt_msg    The prompt message to display in the
- *                                     status bar
- *  @param[in]          *callback (char *, int)   A function pointer for a function
- *                                                to recursively call until something
- *                                                causes it to exit
+ *  @param[in,out]      *arg     The buffer to read the file of
  *
- *  @return             char *buf      Returns whatever is usually returned by
- *                                     the callback function as a string
- *
- *  @details
- *
- *  This function will continuously iterate adding characters to the status
- *  message buff and call to the callback function with this buff. This will
- *  generally update the status bar and this function acts as a sort of prompt
- *  for when searching for substrings or inputting file names for saving the
- *  text buffer.
- *
- * ************************************************************************** */
-
-char *
-io_status_bar_prompt (char *prompt_msg, void (*callback) (char *, int))
-{
-  int c;
-  char *buf;
-  size_t buf_len;
-  size_t buf_size;
-
-  buf_len = 0;
-  buf_size = 128;
-  buf = malloc (buf_size);
-  buf[0] = '\0';
-
-  while (TRUE)
-  {
-    editor_set_status_message (prompt_msg, buf);
-    editor_refresh_screen ();
-
-    c = kp_read_keypress ();
-
-    /*
-     * Allow user to delete in the status prompt
-     */
-
-    if (c == DEL_KEY || c == CTRL_KEY ('h') || c == BACK_SPACE)
-    {
-      if (buf_len != 0)
-        buf[--buf_len] = '\0';
-    }
-
-    /*
-     * Cancel and return if escape is pressed
-     */
-
-    else if (c == '\x1b')
-    {
-      editor_set_status_message ("");
-      if (callback) callback (buf, c);
-      free (buf);
-      return NULL;
-    }
-
-    /*
-     * Return buf if enter is pressed
-     */
-
-    else if (c == '\r')
-    {
-      if (buf_len != 0)
-      {
-        editor_set_status_message ("");
-        if (callback) callback (buf, c);
-        return buf;
-      }
-    }
-
-    /*
-     * If not a control sequence add chars to buf
-     */
-
-    else if (!iscntrl (c) && c < 128)
-    {
-      if (buf_len == buf_size - 1)
-      {
-        buf_size *= 2;
-        buf = realloc (buf, buf_size);
-      }
-
-      buf[buf_len++] = (char) c;
-      buf[buf_len] = '\0';
-    }
-
-    if (callback) callback (buf, c);
-  }
-}
-
-/** **************************************************************************
- *
- *  @brief              Open a file and read into the text buffer
- *
- *  @param[in]          *filename     The name of the file to read in
- *
- *  @return             TRUE if the file could be read, FALSE otherwise
+ *  @return             void
  *
  *  @details
  *
- *  This function attempts to open a file and read its contents into the text
- *  buffer a line at a time. This function will also update the syntax
- *  highlighting depending on the file extension of the file.
- *
- *  TRUE is returned the file could be opened, otherwise FALSE is returned.
+ *  This runs on a worker thread, so only the buffer passed in is touched and
+ *  nothing is recorded in the undo log or journal. The file is read a line at
+ *  a time straight into the line arrays, and once it's all in the lines are
+ *  rendered and the syntax highlighting is worked out from the file
+ *  extension, unless the buffer is headless as nothing is displayed. If the file
+ *  can't be opened, errno is kept in load_error.
  *
  * ************************************************************************** */
 
-int
-io_read_file (char *filename)
+void
+io_load_file (void *arg)
 {
   char *line;
-
+  size_t idx;
   size_t line_cap;
-
   ssize_t line_len;
-
   FILE *input_file;
+  EDITOR_BUFFER *buf = arg;
+  EDITOR_LINES *lines = &buf->lines;
+  TRACE_SCOPE (__func__);
 
-  free (editor.filename);
-  editor.filename = strdup (filename);
-
-  /*
-   * Open the file and update the syntax highlighting
-   */
+  buf->syntax = syntax_match (buf->filename);
 
-  if (!(input_file = fopen (filename, "r")))
+  if (!(input_file = fopen (buf->filename, "r")))
   {
-    errno = 0;
-    editor.filename = NULL;
-    editor_set_status_message ("Couldn't open file %s: %s", editor.filename, strerror (errno));
-    return FALSE;
+    buf->load_error = errno;
+    return;
   }
 
-  syntax_select_highlighting ();
-
   /*
    * Read in EACH line of the input file and append to the text buffer
    */
@@ -172,10 +65,8 @@ io_read_file (char *filename)
   line = NULL;
   line_cap = 0;
 
-  while (getline (&line, &line_cap, input_file) != -1)
+  while ((line_len = getline (&line, &line_cap, input_file)) != -1)
   {
-    line_len = strlen (line);
-
     /*
      * Strip off the return or new line chars and add to the text buffer
      */
@@ -183,23 +74,37 @@ io_read_file (char *filename)
     while (line_len > 0 && (line[line_len - 1] == '\n' || line[line_len - 1] == '\r'))
       line_len--;
 
-    line_add_to_text_buffer (editor.nlines, line, (size_t) line_len);
+    idx = buf->nlines;
+    line_reserve (lines, idx + 1);
+    if (!(lines->chars[idx] = malloc ((size_t) line_len + 1)))
+      util_exit ("Couldn't allocate memory for the text buffer");
+
+    memcpy (lines->chars[idx], line, (size_t) line_len);
+    lines->chars[idx][line_len] = '\0';
+    lines->len[idx] = (size_t) line_len;
+    lines->render[idx] = NULL;
+    lines->syn_hl[idx] = NULL;
+    lines->hl_open_comment[idx] = FALSE;
+    lines->trigram_id[idx] = 0;
+    lines->changed_gen[idx] = lines->generation;
+    if (!buf->headless)
+      editor_render_line (buf, idx);
+    buf->nlines++;
   }
 
   free (line);
+  fclose (input_file);
 
-  if (fclose (input_file))
-    util_exit ("Couldn't close input file");
-
-  editor.modified = FALSE;
-
-  return TRUE;
+  buf->offsets.stale = TRUE;
+  if (!buf->headless)
+    syntax_highlight_buffer (buf);
 }
 
 /** **************************************************************************
  *
  *  @brief              Convert the array of text buffers into strings
  *
+ *  @param[in]          *buf        The buffer
  *  @param[out]         buf_len     The size of the text buffer written in bytes
  *
  *  @return             char *      The text buffer as one string
@@ -208,18 +113,18 @@ io_read_file (char *filename)
  *
  *  Converts the text buffer into one string for writing. This is done by
  *  counting the total number of characters in the entire of the text buffer
- *  and then copies each line of the text buffer to the buffer buf. Each line
+ *  and then copies each line of the text buffer to the string text. Each line
  *  is separated by a new line character.
  *
  * ************************************************************************** */
 
 char *
-io_convert_elines_to_string (size_t *buf_len)
+io_convert_elines_to_string (EDITOR_BUFFER *buf, size_t *buf_len)
 {
   size_t i;
   size_t tot_len;
 
-  char *buf;
+  char *text;
   char *p;
 
   /*
@@ -228,8 +133,8 @@ io_convert_elines_to_string (size_t *buf_len)
 
   tot_len = 0;
 
-  for (i = 0; i < editor.nlines; i++)
-    tot_len += editor.lines[i].len + 1;
+  for (i = 0; i < buf->nlines; i++)
+    tot_len += buf->lines.len[i] + 1;
 
   *buf_len = tot_len;
 
@@ -238,79 +143,113 @@ io_convert_elines_to_string (size_t *buf_len)
    * line character at the end of each row
    */
 
-  p = buf = malloc (tot_len);
-  for (i = 0; i < editor.nlines; i++)
+  p = text = malloc (tot_len);
+  for (i = 0; i < buf->nlines; i++)
   {
-    memcpy (p, editor.lines[i].chars, editor.lines[i].len);
-    p += editor.lines[i].len;
+    memcpy (p, buf->lines.chars[i], buf->lines.len[i]);
+    p += buf->lines.len[i];
     *p = '\n';
     p++;
   }
 
-  return buf;
+  return text;
 }
 
 /** **************************************************************************
  *
- *  @brief              Save the current text buffer to file
+ *  @brief              Write an entire buffer to a file descriptor
  *
- *  @return             void
+ *  @param[in]          file_desc   The file descriptor to write to
+ *  @param[in]          *buf        The buffer to write
+ *  @param[in]          buf_len     The number of bytes to write
+ *
+ *  @return             SUCCESS or FAILURE
  *
  *  @details
  *
- *  This function prompts the user for a filename, and sets the syntax highlighting
- *  appropriately. The text buffer is then converted into one large string and
- *  is written to file. If for some reason it cannot be written to file, then
- *  the user is prompted but the editor does not exit.
+ *  A single call to write is not guaranteed to write everything, and on Linux
+ *  will write at most ~2 GB in one go, so keep writing until the whole buffer
+ *  has been written.
  *
  * ************************************************************************** */
 
-void
-io_save_file (void)
+int
+io_write_all (int file_desc, char *buf, size_t buf_len)
 {
-  char *buf;
-  int file_desc;
-  size_t buf_len;
-
-  /*
-   * Prompt for filename and set syntax highlighting
-   */
+  ssize_t nwritten;
 
-  if (editor.filename == NULL)
+  while (buf_len > 0)
   {
-    editor.filename = io_status_bar_prompt ("Save as: %s", NULL);
-    if (editor.filename == NULL)
+    if ((nwritten = write (file_desc, buf, buf_len)) == -1)
     {
-      editor_set_status_message ("Save aborted");
-      return;
+      if (errno == EINTR)
+        continue;
+      return FAILURE;
     }
 
-    syntax_select_highlighting ();
+    buf += nwritten;
+    buf_len -= (size_t) nwritten;
   }
 
-  /*
-   * Retrieve the text buffer in the form of strings, create the file in 0644
-   * mode and then write to file
-   */
+  return SUCCESS;
+}
 
-  buf = io_convert_elines_to_string (&buf_len);
-  if (((file_desc = open (editor.filename, O_RDWR | O_CREAT, 0644)) != -1))
-  {
-    if (ftruncate (file_desc, (off_t) buf_len) != -1)
-    {
-      if (write (file_desc, buf, buf_len) == buf_len)
-      {
-        close (file_desc);
-        free (buf);
-        editor.modified = FALSE;
-        editor_set_status_message ("%d bytes written to disk", buf_len);
-        return;
-      }
-    }
+/** **************************************************************************
+ *
+ *  @brief              Write a buffer to its file
+ *
+ *  @param[in,out]      *buf        The buffer
+ *  @param[out]         *buf_len    The number of bytes written
+ *
+ *  @return             SUCCESS, or FAILURE with errno set
+ *
+ *  @details
+ *
+ *  The text buffer is converted into one large string and written to the
+ *  file, which is created in 0644 mode if need be. The file is synced to disk
+ *  before the journal and swap file are emptied, so the edits are always in
+ *  one or the other. A headless buffer has no journal or swap file.
+ *
+ * ************************************************************************** */
+
+int
+io_write_file (EDITOR_BUFFER *buf, size_t *buf_len)
+{
+  int error;
+  int file_desc;
+  char *text;
+  TRACE_SCOPE (__func__);
+
+  text = io_convert_elines_to_string (buf, buf_len);
 
+  error = 0;
+  if ((file_desc = open (buf->filename, O_RDWR | O_CREAT, 0644)) == -1)
+  {
+    error = errno;
+  }
+  else
+  {
+    if (ftruncate (file_desc, (off_t) *buf_len) == -1 || io_write_all (file_desc, text, *buf_len) == FAILURE
+        || fsync (file_desc) == -1)
+      error = errno;
     close (file_desc);
   }
 
-  editor_set_status_message ("Can't save file. I/O error: %s", strerror (errno));
-  free (buf);
+  free (text);
+
+  if (error)
+  {
+    errno = error;
+    return FAILURE;
+  }
+
+  buf->modified = FALSE;
+  undo_mark_saved (buf);
+  if (!buf->headless)
+  {
+    journal_saved (buf, buf->filename, *buf_len);
+    swap_saved (buf, buf->filename, *buf_len);
+  }
+
+  return SUCCESS;
 }
@@ -0,0 +1,583 @@
+/** **************************************************************************
+ *
+ * @file journal.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for keeping a journal of unsaved edits on disk, so they
+ *        can be recovered if the editor dies.
+ *
+ * ************************************************************************** */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kris.h"
+
+/*
+ * A journal is a header followed by records. The header is JOURNAL_MAGIC and
+ * the size of the file when the journal was started. Each record is a type
+ * byte, then the line, column and length as uint64_t and, for inserts, the
+ * text inserted
+ */
+
+#define JOURNAL_MAGIC "KRISJNL1"
+#define JOURNAL_HEADER_LEN (sizeof JOURNAL_MAGIC - 1 + sizeof (uint64_t))
+#define JOURNAL_RECORD_LEN (1 + 3 * sizeof (uint64_t))
+
+/** **************************************************************************
+ *
+ *  @brief              Get the time in seconds from a monotonic clock
+ *
+ *  @return             The time in seconds
+ *
+ * ************************************************************************** */
+
+static double
+journal_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Append bytes to a record buffer
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          *data     The bytes to append
+ *  @param[in]          len       The number of bytes
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+journal_append (JOURNAL_BUF *buf, void *data, size_t len)
+{
+  if (buf->len + len > buf->capacity)
+  {
+    buf->capacity = buf->len + len > 2 * buf->capacity ? buf->len + len : 2 * buf->capacity;
+    if (!(buf->data = realloc (buf->data, buf->capacity)))
+      util_exit ("Couldn't allocate memory for the journal");
+  }
+
+  memcpy (&buf->data[buf->len], data, len);
+  buf->len += len;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the records handed to the writer to disk
+ *
+ *  @param[in]          *arg      The journal to write
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This runs on a worker thread. The main thread doesn't touch the writing
+ *  buffer or the file until the job has finished.
+ *
+ * ************************************************************************** */
+
+static void
+journal_write (void *arg)
+{
+  JOURNAL *journal = arg;
+
+  if (io_write_all (journal->fd, journal->writing.data, journal->writing.len) == FAILURE
+      || fdatasync (journal->fd) == -1)
+    journal->failed = errno;
+
+  journal->writing.len = 0;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Hand the pending records to the writer
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Nothing is done if the writer is still busy with the last batch, as the
+ *  records will be picked up by the next flush.
+ *
+ * ************************************************************************** */
+
+static void
+journal_flush (EDITOR_BUFFER *buf)
+{
+  JOURNAL_BUF swap;
+  JOURNAL *journal = &buf->journal;
+
+  if (journal->pending.len == 0 || !pool_group_done (&journal->group))
+    return;
+
+  swap = journal->writing;
+  journal->writing = journal->pending;
+  journal->pending = swap;
+  journal->last = NO_MATCH;
+  journal->last_flush = journal_now ();
+
+  pool_submit (&journal->group, journal_write, journal);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write out every record and wait for it to reach disk
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+journal_sync (EDITOR_BUFFER *buf)
+{
+  JOURNAL *journal = &buf->journal;
+
+  pool_wait (&journal->group);
+  journal_flush (buf);
+  pool_wait (&journal->group);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start the journal file again from an empty header
+ *
+ *  @param[in,out]      *buf         The buffer
+ *  @param[in]          file_size    The size of the file on disk
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+journal_reset (EDITOR_BUFFER *buf, size_t file_size)
+{
+  uint64_t size = file_size;
+  char header[JOURNAL_HEADER_LEN];
+  JOURNAL *journal = &buf->journal;
+
+  memcpy (header, JOURNAL_MAGIC, sizeof JOURNAL_MAGIC - 1);
+  memcpy (&header[sizeof JOURNAL_MAGIC - 1], &size, sizeof size);
+
+  journal->pending.len = 0;
+  journal->last = NO_MATCH;
+
+  if (ftruncate (journal->fd, 0) == -1 || io_write_all (journal->fd, header, sizeof header) == FAILURE)
+    journal->failed = errno;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Apply the records in a journal to the text buffer
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          *data     The records
+ *  @param[in]          len       The number of bytes of records
+ *
+ *  @return             The number of records applied
+ *
+ *  @details
+ *
+ *  Replay stops at the first record which doesn't fit the text buffer, or
+ *  which was only partly written when the editor died. The records are not
+ *  put into the undo log, so the recovered text is where undo starts from.
+ *
+ *  Making the first line of an empty file isn't journalled, as there is no
+ *  line before it to attach it to, so it's made here before the records which
+ *  go on it.
+ *
+ * ************************************************************************** */
+
+static size_t
+journal_replay (EDITOR_BUFFER *buf, char *data, size_t len)
+{
+  int fd;
+  char type;
+  size_t pos;
+  size_t nreplayed;
+  uint64_t fields[3];
+  JOURNAL *journal = &buf->journal;
+
+  /*
+   * The edits being replayed are already in the journal, so they mustn't be
+   * recorded again
+   */
+
+  fd = journal->fd;
+  journal->fd = -1;
+  nreplayed = 0;
+  buf->undo.suspended++;
+
+  if (buf->nlines == 0 && len >= JOURNAL_RECORD_LEN)
+    line_add_to_text_buffer (buf, 0, "", 0);
+
+  for (pos = 0; pos + JOURNAL_RECORD_LEN <= len; pos += JOURNAL_RECORD_LEN)
+  {
+    type = data[pos];
+    memcpy (fields, &data[pos + 1], sizeof fields);
+    if (fields[0] >= buf->nlines || (type != UNDO_INSERT && type != UNDO_DELETE))
+      break;
+
+    if (type == UNDO_INSERT)
+    {
+      if (fields[2] > len - pos - JOURNAL_RECORD_LEN)
+        break;
+      line_insert_text (buf, fields[0], fields[1], &data[pos + JOURNAL_RECORD_LEN], fields[2]);
+      pos += fields[2];
+    }
+    else
+    {
+      line_delete_text (buf, fields[0], fields[1], fields[2]);
+    }
+
+    buf->cy = fields[0];
+    buf->cx = fields[1] <= buf->lines.len[fields[0]] ? fields[1] : buf->lines.len[fields[0]];
+    nreplayed++;
+  }
+
+  buf->undo.suspended--;
+  journal->fd = fd;
+  undo_clear (buf);
+  buf->undo.saved = NO_MATCH;
+
+  return nreplayed;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start journalling edits to a file
+ *
+ *  @param[in,out]      *buf          The buffer
+ *  @param[in]          *filename     The file in the text buffer
+ *  @param[in]          *recover (char *, int)    A function to ask whether to
+ *                                                replay an old journal for the
+ *                                                file, which is told if the
+ *                                                file has changed since, or
+ *                                                NULL to never replay one
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  If there's already a journal for the file, the editor died with unsaved
+ *  edits, so recover is asked whether to replay them. If they are replayed,
+ *  new records are added onto the end of the journal, so it still holds every
+ *  edit since the file was last saved. Otherwise the journal is started again.
+ *
+ * ************************************************************************** */
+
+void
+journal_open (EDITOR_BUFFER *buf, char *filename, int (*recover) (char *, int))
+{
+  char *data;
+  size_t nreplayed;
+  uint64_t file_size;
+  struct stat file_stat;
+  struct stat journal_stat;
+  JOURNAL *journal = &buf->journal;
+
+  journal_close (buf, FALSE);
+
+  journal->path = util_hidden_path (filename, JOURNAL_SUFFIX);
+  if ((journal->fd = open (journal->path, O_RDWR | O_CREAT | O_APPEND, 0600)) == -1)
+  {
+    util_message ("Couldn't open the journal %s: %s", journal->path, strerror (errno));
+    free (journal->path);
+    journal->path = NULL;
+    return;
+  }
+
+  journal->failed = 0;
+  journal->last_flush = journal_now ();
+
+  if (stat (filename, &file_stat) == -1)
+    file_stat.st_size = 0;
+
+  /*
+   * Read in an old journal, if there is one with any records
+   */
+
+  data = NULL;
+  if (fstat (journal->fd, &journal_stat) == 0 && (size_t) journal_stat.st_size > JOURNAL_HEADER_LEN)
+  {
+    if (!(data = malloc ((size_t) journal_stat.st_size)))
+      util_exit ("Couldn't allocate memory for the journal");
+
+    if (pread (journal->fd, data, (size_t) journal_stat.st_size, 0) != journal_stat.st_size
+        || memcmp (data, JOURNAL_MAGIC, sizeof JOURNAL_MAGIC - 1))
+    {
+      free (data);
+      data = NULL;
+    }
+  }
+
+  if (!data)
+  {
+    journal_reset (buf, (size_t) file_stat.st_size);
+    return;
+  }
+
+  /*
+   * Ask whether to replay the journal, saying if the file has changed since
+   * it was written
+   */
+
+  memcpy (&file_size, &data[sizeof JOURNAL_MAGIC - 1], sizeof file_size);
+  if (!recover || !recover (filename, file_size != (uint64_t) file_stat.st_size))
+  {
+    free (data);
+    journal_reset (buf, (size_t) file_stat.st_size);
+    return;
+  }
+
+  nreplayed = journal_replay (buf, &data[JOURNAL_HEADER_LEN], (size_t) journal_stat.st_size - JOURNAL_HEADER_LEN);
+  util_message ("Recovered %zu edits from %s", nreplayed, journal->path);
+
+  free (data);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Try to join an edit onto the last pending record
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          type      UNDO_INSERT or UNDO_DELETE
+ *  @param[in]          line      The line the edit starts on
+ *  @param[in]          col       The column the edit starts at
+ *  @param[in]          *text     The text inserted
+ *  @param[in]          len       The number of chars inserted or deleted
+ *
+ *  @return             TRUE if the edit was joined onto the last record
+ *
+ *  @details
+ *
+ *  Typing carries on from the end of the last insert, as long as it didn't
+ *  split a line. Delete removes text from where the last delete was and
+ *  backspace removes the text just before it, which is always on the same
+ *  line as the last delete.
+ *
+ * ************************************************************************** */
+
+static int
+journal_coalesce (EDITOR_BUFFER *buf, int type, size_t line, size_t col, char *text, size_t len)
+{
+  char *last;
+  uint64_t fields[3];
+  JOURNAL *journal = &buf->journal;
+
+  if (journal->last == NO_MATCH)
+    return FALSE;
+
+  last = &journal->pending.data[journal->last];
+  memcpy (fields, &last[1], sizeof fields);
+  if (last[0] != type || fields[0] != line)
+    return FALSE;
+
+  if (type == UNDO_INSERT && fields[1] + fields[2] == col && !memchr (&last[JOURNAL_RECORD_LEN], '\n', fields[2]))
+  {
+    fields[2] += len;
+    memcpy (&last[1], fields, sizeof fields);
+    journal_append (&journal->pending, text, len);
+    return TRUE;
+  }
+
+  if (type == UNDO_DELETE && (fields[1] == col || col + len == fields[1]))
+  {
+    fields[1] = col;
+    fields[2] += len;
+    memcpy (&last[1], fields, sizeof fields);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Record an edit to the text buffer in the journal
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          type      UNDO_INSERT or UNDO_DELETE
+ *  @param[in]          line      The line the edit starts on
+ *  @param[in]          col       The column the edit starts at
+ *  @param[in]          *text     The text inserted, which isn't needed for
+ *                                deletes
+ *  @param[in]          len       The number of chars inserted or deleted
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The record is only added to the pending records in memory, which are
+ *  written to disk by a worker every JOURNAL_FLUSH_MS, so an edit never waits
+ *  for the disk.
+ *
+ * ************************************************************************** */
+
+void
+journal_record (EDITOR_BUFFER *buf, int type, size_t line, size_t col, char *text, size_t len)
+{
+  char record[JOURNAL_RECORD_LEN];
+  uint64_t fields[3];
+  JOURNAL *journal = &buf->journal;
+
+  if (journal->fd == -1 || len == 0)
+    return;
+
+  if (!journal_coalesce (buf, type, line, col, text, len))
+  {
+    fields[0] = line;
+    fields[1] = col;
+    fields[2] = len;
+    record[0] = (char) type;
+    memcpy (&record[1], fields, sizeof fields);
+
+    journal->last = journal->pending.len;
+    journal_append (&journal->pending, record, sizeof record);
+    if (type == UNDO_INSERT)
+      journal_append (&journal->pending, text, len);
+  }
+
+  journal_tick (buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the pending records if it's time to
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is called after every edit and while waiting for a key press, so the
+ *  journal is at most about JOURNAL_FLUSH_MS behind the text buffer.
+ *
+ * ************************************************************************** */
+
+void
+journal_tick (EDITOR_BUFFER *buf)
+{
+  JOURNAL *journal = &buf->journal;
+
+  if (journal->fd == -1)
+    return;
+
+  if (journal->failed && pool_group_done (&journal->group))
+  {
+    util_message ("Couldn't write the journal %s: %s", journal->path, strerror (journal->failed));
+    journal->failed = 0;
+  }
+
+  if (journal_now () - journal->last_flush >= JOURNAL_FLUSH_MS / 1000.0)
+    journal_flush (buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start the journal again after the file is saved
+ *
+ *  @param[in,out]      *buf          The buffer
+ *  @param[in]          *filename     The file which was saved
+ *  @param[in]          file_size     The size of the saved file
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Every edit in the journal is now in the file, so the journal is emptied.
+ *  If the file was saved under a new name, the journal moves with it.
+ *
+ * ************************************************************************** */
+
+void
+journal_saved (EDITOR_BUFFER *buf, char *filename, size_t file_size)
+{
+  char *path;
+  JOURNAL *journal = &buf->journal;
+
+  path = util_hidden_path (filename, JOURNAL_SUFFIX);
+  if (journal->fd == -1 || strcmp (path, journal->path))
+  {
+    journal_close (buf, TRUE);
+    journal->path = path;
+    if ((journal->fd = open (journal->path, O_RDWR | O_CREAT | O_APPEND, 0600)) == -1)
+    {
+      util_message ("Couldn't open the journal %s: %s", journal->path, strerror (errno));
+      free (journal->path);
+      journal->path = NULL;
+      return;
+    }
+    journal->last_flush = journal_now ();
+  }
+  else
+  {
+    free (path);
+    pool_wait (&journal->group);
+  }
+
+  journal_reset (buf, file_size);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Stop journalling edits
+ *
+ *  @param[in,out]      *buf       The buffer
+ *  @param[in]          discard    TRUE to delete the journal even if there are
+ *                                 unsaved edits
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Every pending record is written out first. The journal is deleted unless
+ *  the text buffer has unsaved edits in it, as then the journal is how they
+ *  get recovered.
+ *
+ * ************************************************************************** */
+
+void
+journal_close (EDITOR_BUFFER *buf, int discard)
+{
+  JOURNAL *journal = &buf->journal;
+
+  if (journal->fd == -1)
+    return;
+
+  if (discard || !buf->modified)
+  {
+    pool_wait (&journal->group);
+    unlink (journal->path);
+  }
+  else
+  {
+    journal_sync (buf);
+  }
+
+  close (journal->fd);
+  free (journal->path);
+  free (journal->pending.data);
+  free (journal->writing.data);
+  *journal = (JOURNAL) {-1, NULL, {NULL, 0, 0}, {NULL, 0, 0}, NO_MATCH, 0, 0, POOL_GROUP_INIT};
+}
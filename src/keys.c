@@ -11,6 +11,7 @@
  * ************************************************************************** */
 
 #include <errno.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -35,42 +36,41 @@
 void
 kp_move_cursor (int key)
 {
+  int on_line;
   size_t line_len;
 
-  EDITOR_LINE *line;
-
   /*
-   * Create a line for the case where the cursor is on the last line
+   * Check for the case where the cursor is on the last line
    */
 
-  line = (editor.cy >= editor.nlines) ? NULL : &editor.lines[editor.cy];
+  on_line = editor.buf->cy < editor.buf->nlines;
 
   switch (key)
   {
     case ARROW_UP:
-      if (editor.cy != 0)
-        editor.cy--;
+      if (editor.buf->cy != 0)
+        editor.buf->cy--;
       break;
     case ARROW_DOWN:
-      if (editor.cy < editor.nlines)
-        editor.cy++;
+      if (editor.buf->cy < editor.buf->nlines)
+        editor.buf->cy++;
       break;
     case ARROW_RIGHT:
-      if (line && editor.cx < line->len)
-        editor.cx++;
-      else if (line && editor.cx == line->len)  // Go to next line
+      if (on_line && editor.buf->cx < editor.buf->lines.len[editor.buf->cy])
+        editor.buf->cx++;
+      else if (on_line && editor.buf->cx == editor.buf->lines.len[editor.buf->cy])  // Go to next line
       {
-        editor.cy++;
-        editor.cx = 0;
+        editor.buf->cy++;
+        editor.buf->cx = 0;
       }
       break;
     case ARROW_LEFT:
-      if (editor.cx != 0)
-        editor.cx--;
-      else if (editor.cy > 0)  // Go to previous line
+      if (editor.buf->cx != 0)
+        editor.buf->cx--;
+      else if (editor.buf->cy > 0)  // Go to previous line
       {
-        editor.cy--;
-        editor.cx = (int) editor.lines[editor.cy].len;
+        editor.buf->cy--;
+        editor.buf->cx = editor.buf->lines.len[editor.buf->cy];
       }
       break;
     default:
@@ -81,16 +81,68 @@ kp_move_cursor (int key)
    * Snap the cursor to the end of a shorter line
    */
 
-  line = (editor.cy >= editor.nlines) ? NULL : &editor.lines[editor.cy];
-  line_len = line ? line->len : 0;
+  line_len = (editor.buf->cy < editor.buf->nlines) ? editor.buf->lines.len[editor.buf->cy] : 0;
 
-  if (editor.cx > line_len)
-    editor.cx = (int) line_len;
+  if (editor.buf->cx > line_len)
+    editor.buf->cx = line_len;
 }
 
 /** **************************************************************************
  *
- *  @brief              Read a key press from the terminal
+ *  @brief              Do background work while waiting for a key press
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Work is done in short slices until there is none left or a key has been
+ *  pressed, so the editor still responds straight away. If the terminal has
+ *  changed size, the screen is drawn again at the new size.
+ *
+ * ************************************************************************** */
+
+static void
+kp_idle (void)
+{
+  struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+
+  if (terminal_resize ())
+    editor_refresh_screen ();
+
+  buffer_tick ();
+  while (trigram_build_slice (editor.buf) && poll (&input, 1, 0) == 0);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Read a byte of input from the terminal
+ *
+ *  @param[out]         *c      The byte read
+ *
+ *  @return             The return value of read
+ *
+ *  @details
+ *
+ *  Each byte is passed on to the keystroke recorder, so it can be written to
+ *  the trace along with the rest of the key.
+ *
+ * ************************************************************************** */
+
+static ssize_t
+kp_read_byte (char *c)
+{
+  ssize_t nread;
+
+  if ((nread = read (STDIN_FILENO, c, 1)) == 1)
+    record_byte (*c);
+
+  return nread;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Read a key press from the terminal and work out which
+ *                      key it was
  *
  *  @return             int   A integer representing an ASCII character
  *
@@ -103,8 +155,8 @@ kp_move_cursor (int key)
  *
  * ************************************************************************** */
 
-int
-kp_read_keypress (void)
+static int
+kp_decode_keypress (void)
 {
   ssize_t nread;
 
@@ -115,10 +167,11 @@ kp_read_keypress (void)
    * Read in a single char from the terminal
    */
 
-  while ((nread = read (STDIN_FILENO, &c, 1)) != 1)
+  while ((nread = kp_read_byte (&c)) != 1)
   {
     if (nread == -1 && errno != EAGAIN)
       util_exit ("Too many chars read in at once, expected 1 char");
+    kp_idle ();
   }
 
   /*
@@ -128,9 +181,9 @@ kp_read_keypress (void)
 
   if (c == '\x1b')
   {
-    if (read (STDIN_FILENO, &seq[0], 1) != 1)
+    if (kp_read_byte (&seq[0]) != 1)
       return '\x1b';
-    if (read (STDIN_FILENO, &seq[1], 1) != 1)
+    if (kp_read_byte (&seq[1]) != 1)
       return '\x1b';
 
     /*
@@ -141,7 +194,7 @@ kp_read_keypress (void)
     {
       if (seq[1] >= '0' && seq[1] <= '9')
       {
-        if (read (STDIN_FILENO, &seq[2], 1) != 1)
+        if (kp_read_byte (&seq[2]) != 1)
           return '\x1b';
 
         if (seq[2] == '~')
@@ -205,6 +258,30 @@ kp_read_keypress (void)
   return c;
 }
 
+/** **************************************************************************
+ *
+ *  @brief              Read a key press from the terminal
+ *
+ *  @return             int   A integer representing an ASCII character
+ *
+ *  @details
+ *
+ *  The bytes of the key are recorded as one keystroke, if keystrokes are
+ *  being recorded.
+ *
+ * ************************************************************************** */
+
+int
+kp_read_keypress (void)
+{
+  int c;
+
+  c = kp_decode_keypress ();
+  record_key ();
+
+  return c;
+}
+
 /** **************************************************************************
  *
  *  @brief              Process a key input from the terminal
@@ -227,8 +304,20 @@ kp_process_keypress (void)
   int c;
   int nreps;
   static int quit_times = QUIT_TIMES;
+  TRACE_SCOPE (__func__);
+
+  c = kp_read_keypress ();
+
+  /*
+   * Runs of typing and deleting are undone in one go, so anything else, such
+   * as moving the cursor, ends the current undo step
+   */
 
-  switch (c = kp_read_keypress ())
+  if (!(c == '\r' || c == '\t' || c == BACK_SPACE || c == DEL_KEY || c == CTRL_KEY ('h') ||
+        (c >= ' ' && c < BACK_SPACE)))
+    undo_seal (editor.buf);
+
+  switch (c)
   {
     /*
      * Append a new line
@@ -243,13 +332,15 @@ kp_process_keypress (void)
      */
 
     case CTRL_KEY ('q'):
-      if (editor.modified && quit_times > 0)
+      if (buffer_count_modified () > 0 && quit_times > 0)
       {
-        editor_set_status_message ("File has unsaved changes, press Ctrl-Q %d more times to quit without saving",
-                                   quit_times);
+        editor_set_status_message ("%zu file(s) have unsaved changes, press Ctrl-Q %d more times to quit without saving",
+                                   buffer_count_modified (), quit_times);
         quit_times--;
         return;
       }
+      while (editor.nbuffers > 0)
+        buffer_free (editor.nbuffers - 1, TRUE);
       util_reset_display ();
       exit (SUCCESS);
 
@@ -269,16 +360,72 @@ kp_process_keypress (void)
       find ();
       break;
 
+    /*
+     * Replace every match of a keyword in the text buffer
+     */
+
+    case CTRL_KEY ('r'):
+      find_replace ();
+      break;
+
+    /*
+     * Undo and redo the last change to the text buffer
+     */
+
+    case CTRL_KEY ('z'):
+      undo_undo (editor.buf);
+      break;
+
+    case CTRL_KEY ('y'):
+      undo_redo (editor.buf);
+      break;
+
+    /*
+     * Run a command typed into the status bar
+     */
+
+    case CTRL_KEY ('e'):
+      command_prompt ();
+      break;
+
+    /*
+     * Switch to the next or previous buffer
+     */
+
+    case CTRL_KEY ('n'):
+      buffer_next (1);
+      break;
+
+    case CTRL_KEY ('p'):
+      buffer_next (-1);
+      break;
+
+    /*
+     * Move to the next window
+     */
+
+    case CTRL_KEY ('o'):
+      window_next ();
+      break;
+
+    /*
+     * Go to a line, byte offset or percentage through the text buffer
+     */
+
+    case CTRL_KEY ('g'):
+      offset_goto ();
+      break;
+
     /*
      * Navigate using HOME and END keys for end and start of column
      */
 
     case HOME_KEY:
-      editor.cx = 0;
+      editor.buf->cx = 0;
       break;
     case END_KEY:
-      if (editor.cy < editor.nlines)
-        editor.cx = (int) editor.lines[editor.cy].len;
+      if (editor.buf->cy < editor.buf->nlines)
+        editor.buf->cx = editor.buf->lines.len[editor.buf->cy];
       break;
 
     /*
@@ -288,14 +435,14 @@ kp_process_keypress (void)
     case PAGE_UP:
     case PAGE_DOWN:
       if (c == PAGE_UP)
-        editor.cy = editor.row_offset;
+        editor.buf->cy = editor.buf->row_offset;
       else
       {
-        editor.cy = editor.row_offset + editor.screen_rows - 1;
-        if (editor.cy > editor.nlines)
-          editor.cy = editor.nlines;
+        editor.buf->cy = editor.buf->row_offset + window_rows () - 1;
+        if (editor.buf->cy > editor.buf->nlines)
+          editor.buf->cy = editor.buf->nlines;
       }
-      nreps = editor.screen_rows;
+      nreps = (int) window_rows ();
       while (nreps--)
         kp_move_cursor (c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
       break;
@@ -11,7 +11,9 @@
  * ************************************************************************** */
 
 #include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "kris.h"
 
@@ -28,32 +30,78 @@
  *  @details
  *
  *  This is the main function of Kris. It initialises the terminal and basic
- *  editor variables and will either create a new text buffer or read one in
- *  from file.
+ *  editor variables and will either create a new text buffer or read in each
+ *  file given on the command line.
  *
  *  The function then performs a loop where the screen is refreshed after
  *  some keyboard input has been refreshed. This happens each time a character
  *  is input, which means Kris updates on a char by char basis.
  *
+ *  kris --batch script file... runs a script of edits over the files instead,
+ *  without touching the terminal.
+ *
+ *  kris --record trace file... edits the files as normal, and records each
+ *  key pressed with the time it was pressed so the session can be replayed.
+ *
  * ************************************************************************** */
 
 int
 main (int argc, char *argv[])
 {
+  int i;
+  int first;
   int file_found;
+  char *record_path;
+
+  if (argc >= 2 && !strcmp (argv[1], "--batch"))
+  {
+    if (argc < 4)
+    {
+      fprintf (stderr, "Usage: kris --batch <script> <file>...\n");
+      return EXIT_FAILURE;
+    }
+
+    return batch_run (argv[2], argc - 3, &argv[3]);
+  }
+
+  first = 1;
+  record_path = NULL;
+  if (argc >= 3 && !strcmp (argv[1], "--record"))
+  {
+    record_path = argv[2];
+    first = 3;
+  }
 
   terminal_init ();
   editor_init ();
 
+  if (record_path && record_open (record_path) == FAILURE)
+    util_exit ("Couldn't open the keystroke trace");
+
+  /*
+   * Every file gets its own buffer and they're all read in on the worker
+   * pool. The first one is shown as soon as it's been read, and the rest carry
+   * on in the background. The empty buffer from editor_init isn't needed then
+   */
+
   file_found = FALSE;
-  if (argc >= 2)
-    file_found = io_read_file (argv[1]);
+  if (first < argc)
+  {
+    for (i = first; i < argc; i++)
+      if (buffer_find (argv[i]) == NO_MATCH)
+        buffer_load (buffer_new (argv[i]));
+
+    file_found = buffer_switch (1);
+    buffer_free (0, FALSE);
+  }
 
-  if (file_found)
-    editor_set_status_message ("HELP: Ctrl-S to save | Ctrl-F to find | Ctrl-Q to quit");
+  if (file_found && editor.status_msg[0] == '\0')
+    editor_set_status_message ("HELP: Ctrl-S save | Ctrl-F find | Ctrl-R replace | Ctrl-Z undo | Ctrl-G go to | Ctrl-E command | Ctrl-N/P next file | Ctrl-Q quit");
 
   while (TRUE)
   {
+    TRACE_BEGIN ("main_loop");
+    terminal_resize ();
     editor_refresh_screen ();
     kp_process_keypress ();
     if (errno != 0)
@@ -61,6 +109,7 @@ main (int argc, char *argv[])
       util_exit ("Unknown error :-(");
       return EXIT_FAILURE;
     }
+    TRACE_END ("main_loop");
   }
 
   return EXIT_SUCCESS;
@@ -15,8 +15,11 @@
 
 #include <time.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <termios.h>
 
+#include "libkris.h"
+
 /* **************************************************************************
  *
  * Constant macro definitions
@@ -30,18 +33,118 @@
 #define VERSION "2.0.0"
 #define TAB_WIDTH 8
 #define QUIT_TIMES 1
+#define NO_MATCH ((size_t) -1)
+#define SEARCH_TWO_WAY_MIN 32
+#define FIND_SHARD_MIN_LINES 65536
+#define REGEX_DFA_MEMORY_CAP (2 << 20)
+#define REGEX_SCAN_FACTOR 4
+#define TRIGRAM_BUCKET_BITS 18
+#define TRIGRAM_AUTO_MIN_LINES (1 << 20)
+#define TRIGRAM_SLICE_MS 10
+#define TRIGRAM_SLICE_LINES 256
+#define POOL_MAX_THREADS 64
+#define UNDO_MEMORY_CAP (64 << 20)
+#define JOURNAL_SUFFIX ".kris-journal"
+#define JOURNAL_FLUSH_MS 500
+#define SWAP_SUFFIX ".kris-swap"
+#define SWAP_INTERVAL_MS 4000
+#define SWAP_WRITE_RATE (8 << 20)
+#define SWAP_WRITE_CHUNK (64 << 10)
+#define GREP_MAX_MATCHES 1000000
+#define GREP_MAX_LINE_LEN 256
+#define GREP_BINARY_CHECK 8192
+#define GREP_REDRAW_MS 100
+#define MEMORY_NCATEGORIES 7
 
 // This is some magical bitshifting macro for control sequences
 #define CTRL_KEY(k) ((k) & 0x1f)
 // Screen buffer initialisation buffer
 #define SBUF_INIT {0, NULL}
+// Worker pool job group initialisation
+#define POOL_GROUP_INIT {0}
+/*
+ * Trace events for profiling, which are only recorded when built with the
+ * KRIS_TRACE option and otherwise compile to nothing. TRACE_SCOPE begins an
+ * event which ends when the function or block it is in returns
+ */
+
+#ifdef KRIS_TRACE
+#define TRACE_RING_SIZE (1 << 16)
+#define TRACE_DEFAULT_FILE "kris-trace.json"
+#define TRACE_BEGIN(name) trace_event (name, 'B')
+#define TRACE_END(name) trace_event (name, 'E')
+#define TRACE_SCOPE(name) const char *trace_scope __attribute__ ((cleanup (trace_scope_end))) = trace_scope_begin (name)
+#else
+#define TRACE_BEGIN(name)
+#define TRACE_END(name)
+#define TRACE_SCOPE(name)
+#endif
 
 /* **************************************************************************
  *
  * Data structures
  *
- * EDITOR_LINE:
- *  Contains all of the data types required to store a text line in memory.
+ * EDITOR_LINES:
+ *  Contains all of the data types required to store the text lines in memory.
+ *  The line metadata is stored as parallel arrays, indexed by line number, so
+ *  whole-buffer scans only stream through the fields they actually use. The
+ *  generation is moved on by each autosave, so the lines changed since the
+ *  last autosave are the ones with a changed_gen equal to generation.
+ *
+ * LINE_OFFSETS:
+ *  A Fenwick tree over the line lengths, used to convert between line numbers
+ *  and byte offsets into the text buffer.
+ *
+ * TRIGRAM_LIST:
+ *  A sorted posting list of the ids of the lines containing a trigram.
+ *
+ * TRIGRAM_INDEX:
+ *  An index of the lines each trigram appears in, used to find the lines
+ *  which might match a search query without scanning every line.
+ *
+ * REGEX:
+ *  A compiled regular expression, which is private to regex.c.
+ *
+ * SEARCH_PATTERN:
+ *  A needle which has been prepared for the substring search kernel.
+ *
+ * SEARCH_MATCHES:
+ *  A growable array of match positions found by the search kernel.
+ *
+ * SEARCH_RESULT:
+ *  A sorted index of every match of a search query in the text buffer.
+ *
+ * OVERLAY_ROW:
+ *  The render columns of the search matches on a line.
+ *
+ * MATCH_OVERLAY:
+ *  A cache of the OVERLAY_ROW for each line in the viewport, drawn on top of
+ *  the syntax highlighting.
+ *
+ * SEARCH_STATE:
+ *  A stack of search results, one for each prefix of the current query, and
+ *  the match the cursor is currently on.
+ *
+ * UNDO_OP:
+ *  A run of text which was inserted into or deleted from the text buffer.
+ *
+ * UNDO_LOG:
+ *  The edits made to the text buffer, which can be undone and redone.
+ *
+ * POOL_GROUP:
+ *  A group of jobs submitted to the worker pool which can be waited on.
+ *
+ * JOURNAL_BUF:
+ *  A buffer of journal records.
+ *
+ * JOURNAL:
+ *  The journal of the edits made to a text buffer since it was last saved.
+ *
+ * SWAP_MOVE:
+ *  A block of lines which were moved up or down by an insert or delete.
+ *
+ * SWAP_FILE:
+ *  The swap file the changed lines of a text buffer are autosaved to.
  *
  * SCREEN_BUF:
  *  Contains all of the data required to render the text buffers
@@ -49,20 +152,205 @@
  * SYNTAX:
  *  Contains all of the data required to track syntax highlighting
  *
+ * EDITOR_BUFFER:
+ *  Contains all of the data for one open file. A buffer isn't read until it
+ *  is loaded, which is done on the worker pool.
+ *
+ * WINDOW:
+ *  A region of the screen. A window is either split in two, stacked or side
+ *  by side, or shows a buffer. Windows showing the same buffer share its text,
+ *  render and highlight arrays and each only has its own cursor and scroll.
+ *
+ * HUD:
+ *  Timings of the last frame and edit, shown in the message bar.
+ *
+ * MEMORY_STATS:
+ *  The memory used by the text buffer being edited, split into categories.
+ *
  * EDITOR_CONFIG:
- *  Contains all of the data for the editor.
+ *  Contains all of the data for the editor which isn't specific to a buffer,
+ *  i.e. the terminal, the windows and the list of buffers.
  *
  * ************************************************************************** */
 
-typedef struct EDITOR_LINE
+typedef struct EDITOR_LINES
+{
+  size_t capacity;                 // Number of line slots allocated
+  size_t *len;                     // Length of each char array
+  size_t *r_len;                   // Length of each render array
+  char **chars;                    // The raw chars read in
+  char **render;                   // The chars which are displayed (spaces instead of tab)
+  unsigned char **syn_hl;          // The syntax highlighting
+  unsigned char *hl_open_comment;  // Bool flag for an unclosed multi line comment
+  uint32_t *trigram_id;            // Id in the trigram index, 0 if not indexed
+  size_t *changed_gen;             // The generation each line last changed in
+  size_t generation;               // The generation of changes being made now
+} EDITOR_LINES;
+
+typedef struct LINE_OFFSETS
+{
+  size_t *tree;                    // Fenwick tree of line lengths, 1-indexed
+  size_t size;                     // Number of lines in the tree
+  size_t capacity;                 // Number of tree nodes allocated
+  int stale;                       // Bool flag for the tree needing a rebuild
+} LINE_OFFSETS;
+
+typedef struct TRIGRAM_LIST
+{
+  uint32_t *ids;                   // Ids of the lines, in increasing order
+  size_t nids;                     // Number of ids in the list
+  size_t capacity;                 // Number of ids allocated
+} TRIGRAM_LIST;
+
+typedef struct TRIGRAM_INDEX
+{
+  int enabled;                     // Bool flag for the index being kept
+  TRIGRAM_LIST *lists;             // Posting list for each trigram bucket
+  size_t *id_line;                 // The line each id is for, NO_MATCH if retired
+  uint32_t *id_count;              // Number of postings for each id
+  size_t nids;                     // Number of ids given out, including 0
+  size_t ids_capacity;             // Number of ids allocated
+  size_t build_pos;                // Lines before this have been indexed
+  size_t npostings;                // Number of postings in every list
+  size_t ndead;                    // Number of postings for retired ids
+  size_t memory;                   // Bytes allocated for the index
+  double build_time;               // Seconds spent building the index
+} TRIGRAM_INDEX;
+
+typedef struct REGEX REGEX;
+
+typedef struct SEARCH_PATTERN
+{
+  char *needle;                    // The string to search for
+  size_t len;                      // Length of the needle
+  int icase;                       // Bool flag for ignoring the case of letters
+  size_t ms;                       // Two-Way critical position
+  size_t period;                   // Two-Way shift after a full match
+  size_t mem0;                     // Two-Way memory for periodic needles
+  size_t shift[256];               // Two-Way bad char shift table
+  unsigned char byteset[32];       // Bit set of the bytes in the needle
+} SEARCH_PATTERN;
+
+typedef struct SEARCH_MATCHES
+{
+  size_t *pos;                     // Byte positions of the matches
+  size_t npos;                     // Number of matches
+  size_t capacity;                 // Number of positions allocated
+} SEARCH_MATCHES;
+
+typedef struct SEARCH_RESULT
+{
+  char *query;                     // The query for this result set
+  SEARCH_MATCH *matches;           // Matches sorted by line and column
+  size_t nmatches;                 // Number of matches
+} SEARCH_RESULT;
+
+typedef struct OVERLAY_ROW
+{
+  size_t line;                     // The line in this slot, or NO_MATCH
+  size_t nspans;                   // Number of matches on the line
+  size_t capacity;                 // Number of spans allocated
+  size_t *rx;                      // Start and end render column of each match
+} OVERLAY_ROW;
+
+typedef struct MATCH_OVERLAY
+{
+  OVERLAY_ROW *rows;               // Slots for each line, indexed by line % nrows
+  size_t nrows;                    // Number of slots
+} MATCH_OVERLAY;
+
+typedef struct SEARCH_STATE
+{
+  SEARCH_RESULT *results;          // Stack of results for each query prefix
+  size_t nresults;                 // Number of result sets on the stack
+  size_t capacity;                 // Number of result sets allocated
+  size_t current;                  // Index of the current match, or NO_MATCH
+  size_t origin_x, origin_y;       // Cursor position when the search started
+  int active;                      // Bool flag for the search prompt being open
+  int regex;                       // Bool flag for the query being a regex
+  int icase;                       // Bool flag for ignoring the case of letters
+  int word;                        // Bool flag for only matching whole words
+  char *error;                     // Why the regex query is invalid, or NULL
+  MATCH_OVERLAY overlay;           // Matches to highlight in the viewport
+} SEARCH_STATE;
+
+typedef void (*POOL_FUNC) (void *arg);
+
+typedef struct UNDO_OP
 {
-  int idx;             // Line number
-  size_t len, r_len;   // Length of the char and render arrays
-  char *chars;         // The raw chars read in
-  char *render;        // The chars which are displayed (spaces instead of tab)
-  unsigned char *syn_hl;   // The syntax highlighting
-  int hl_open_comment; // The line index of where an multi line comment starts
-} EDITOR_LINE;
+  int type;                        // UNDO_INSERT or UNDO_DELETE
+  size_t line, col;                // Where the text starts
+  size_t end_line, end_col;        // Where the text ends
+  char *text;                      // The text, which can contain new lines
+  size_t len;                      // Length of the text
+  size_t capacity;                 // Number of bytes allocated for the text
+  size_t group;                    // Ops in the same group are undone together
+} UNDO_OP;
+
+typedef struct UNDO_LOG
+{
+  UNDO_OP *ops;                    // The ops, oldest first
+  size_t nops;                     // Number of ops in the log
+  size_t capacity;                 // Number of ops allocated
+  size_t current;                  // Number of ops applied, the rest can be redone
+  size_t saved;                    // current when the file was saved, or NO_MATCH
+  size_t memory;                   // Bytes used by the ops
+  size_t memory_cap;               // Bytes the ops can use before old ones go
+  size_t group;                    // The group of the newest op
+  int depth;                       // Nesting depth of undo_begin_group
+  int sealed;                      // Bool flag for not joining onto the last op
+  int suspended;                   // Don't record edits when this is non-zero
+} UNDO_LOG;
+
+typedef struct POOL_GROUP
+{
+  size_t pending;                  // Number of jobs which haven't finished
+} POOL_GROUP;
+
+typedef struct JOURNAL_BUF
+{
+  char *data;                      // The records
+  size_t len;                      // Number of bytes of records
+  size_t capacity;                 // Number of bytes allocated
+} JOURNAL_BUF;
+
+typedef struct JOURNAL
+{
+  int fd;                          // The journal file, or -1 if there isn't one
+  char *path;                      // The path of the journal file
+  JOURNAL_BUF pending;             // Records not yet handed to the writer
+  JOURNAL_BUF writing;             // Records being written by the writer
+  size_t last;                     // Offset of the last record in pending, or NO_MATCH
+  int failed;                      // errno of the last failed write, or 0
+  double last_flush;               // When pending was last handed over
+  POOL_GROUP group;                // The writer
+} JOURNAL;
+
+typedef struct SWAP_MOVE
+{
+  uint64_t dest;                   // Where the lines were moved to
+  uint64_t src;                    // Where the lines were moved from
+  uint64_t nmove;                  // The number of lines moved
+} SWAP_MOVE;
+
+typedef struct SWAP_FILE
+{
+  int fd;                          // The swap file, or -1 if there isn't one
+  char *path;                      // The path of the swap file
+  size_t base_size;                // Size of the file the deltas apply to
+  size_t file_size;                // Number of bytes in the swap file
+  SWAP_MOVE *moves;                // Lines moved since the last autosave
+  size_t nmoves;                   // Number of moves
+  size_t moves_capacity;           // Number of moves allocated
+  char *delta;                     // The delta being written
+  size_t delta_len;                // Number of bytes in the delta
+  size_t delta_capacity;           // Number of bytes allocated
+  int full;                        // Bool flag for writing every line next time
+  int rewrite;                     // Bool flag for the writer to start the file again
+  int failed;                      // errno of the last failed write, or 0
+  double last_save;                // When the last autosave was started
+  POOL_GROUP group;                // The writer
+} SWAP_FILE;
 
 typedef struct SCREEN_BUF
 {
@@ -82,24 +370,82 @@ typedef struct SYNTAX
   int flags;                   // Highlighting flags
 } SYNTAX;
 
-typedef struct EDITOR_CONFIG
+typedef struct EDITOR_BUFFER
 {
-  EDITOR_LINE *lines;
+  EDITOR_LINES lines;              // The text buffer
+  LINE_OFFSETS offsets;            // Byte offset of each line
+  TRIGRAM_INDEX trigrams;          // Trigram index of the lines for searching
+  SEARCH_STATE search;             // Cached search results
+  UNDO_LOG undo;                   // Edits which can be undone
+  JOURNAL journal;                 // Journal of the unsaved edits
+  SWAP_FILE swap;                  // Swap file of the changed lines
   char *filename;                  // Filename of the text buffer
-  int modified;                    // Bool flag to indicate if file modified
-  char status_msg[80];             // Status message for the editor
+  size_t modified;                 // Bool flag to indicate if file modified
+  size_t cx, cy;                   // Cursor x and y location
+  size_t rx;                       // Cursor location in render array
+  size_t nlines;                   // Number of lines in text buffer
+  size_t row_offset, col_offset;   // Row and col offset for scrolling
+  SYNTAX *syntax;                  // Syntax highlighting data, shared by buffers
+  int state;                       // BUFFER_UNLOADED, BUFFER_LOADING or BUFFER_LOADED
+  int load_error;                  // errno if the file couldn't be read, or 0
+  POOL_GROUP load;                 // The worker reading the file
+  int headless;                    // Bool flag for not rendering or highlighting the lines
+  int hl_timed;                    // Bool flag for timing the highlighting, for the HUD
+  double hl_time;                  // Seconds spent highlighting since the HUD last took it
+  size_t hl_lines;                 // Lines highlighted since the HUD last took them
+} EDITOR_BUFFER;
+
+typedef struct WINDOW
+{
+  EDITOR_BUFFER *buf;              // The buffer shown, if not split
+  size_t cx, cy;                   // Cursor x and y location
+  size_t row_offset, col_offset;   // Row and col offset for scrolling
+  int split;                       // WINDOW_LEAF, WINDOW_STACKED or WINDOW_SIDE_BY_SIDE
+  struct WINDOW *parent;           // The window this is half of, or NULL
+  struct WINDOW *child[2];         // The top or left half and the other half
+  int top, left;                   // Position on the screen
+  int height, width;               // Size on the screen, including the status bar
+} WINDOW;
+
+typedef struct HUD
+{
+  int enabled;                     // Bool flag for showing the HUD
+  double frame_start;              // When the refresh being timed started
+  double frame_time;               // Seconds taken to build the last frame
+  size_t frame_bytes;              // Bytes written to the terminal for the last frame
+  double hl_time;                  // Seconds spent highlighting for the last edit
+  size_t hl_lines;                 // Lines highlighted for the last edit
+} HUD;
+
+typedef struct MEMORY_STATS
+{
+  size_t bytes[MEMORY_NCATEGORIES];    // Bytes allocated for each category
+  size_t nobjects[MEMORY_NCATEGORIES]; // Number of allocations in each category
+  size_t total;                        // Bytes allocated for every category
+  size_t file_size;                    // Bytes in the text buffer
+} MEMORY_STATS;
+
+typedef struct EDITOR_CONFIG
+{
+  EDITOR_BUFFER *buf;              // The buffer being edited
+  EDITOR_BUFFER **buffers;         // Every open buffer
+  size_t nbuffers;                 // Number of open buffers
+  size_t current;                  // Index of the buffer being edited
+  WINDOW *root;                    // The window covering the whole screen
+  WINDOW *win;                     // The window being edited
+  SCREEN_BUF *frame;               // Each screen row as last drawn, or NULL
+  int frame_rows;                  // Number of rows in frame
+  size_t buffers_capacity;         // Number of buffers allocated
+  char status_msg[160];            // Status message for the editor
   time_t status_msg_time;          // Used to check when status message updated
-  int cx, cy;                      // Cursor x and y location
-  int rx;                          // Cursor location in render array
-  int nlines;                      // Number of lines in text buffer
-  int row_offset, col_offset;      // Row and col offset for scrolling
   int screen_cols, screen_rows;    // Number of rows and cols for terminal
+  int headless;                    // Bool flag for running a script without a terminal
+  HUD hud;                         // Timings shown in the message bar
   struct termios curr_term_attr;   // Raw terminal attributes
   struct termios orig_term_attr;   // Original terminal attributes
-  SYNTAX *syntax;                  // Syntax highlighting data
 } EDITOR_CONFIG;
 
-EDITOR_CONFIG editor;
+extern EDITOR_CONFIG editor;
 
 /* **************************************************************************
  *
@@ -108,8 +454,17 @@ EDITOR_CONFIG editor;
  * keymap:
  *  Maps key presses to internal numbers
  *
- * syntax_highlight_colours:
- *  Maps syntax highlighting types to internal numbers
+ * window_splits:
+ *  How a window is divided
+ *
+ * buffer_states:
+ *  How far through being read in a buffer is
+ *
+ * undo_op_types:
+ *  The types of edit recorded in the undo log and the journal
+ *
+ * memory_categories:
+ *  What the memory counted by memory_count is used for
  *
  * ************************************************************************** */
 
@@ -127,17 +482,35 @@ enum keymap
   DEL_KEY     = 1008
 };
 
-enum syntax_highlight_colours
-{
-  HL_NORMAL     = 0,
-  HL_NUMBER     = 1,
-  HL_MATCH      = 2,
-  HL_STRING     = 3,
-  HL_COMMENT    = 4,
-  HL_KEYWORD1   = 5,
-  HL_KEYWORD2   = 6,
-  HL_ML_COMMENT = 7,
-  HL_PREPROCESS = 8
+enum window_splits
+{
+  WINDOW_LEAF         = 0,
+  WINDOW_STACKED      = 1,
+  WINDOW_SIDE_BY_SIDE = 2
+};
+
+enum buffer_states
+{
+  BUFFER_UNLOADED = 0,
+  BUFFER_LOADING  = 1,
+  BUFFER_LOADED   = 2
+};
+
+enum undo_op_types
+{
+  UNDO_INSERT = 0,
+  UNDO_DELETE = 1
+};
+
+enum memory_categories
+{
+  MEMORY_CHARS       = 0,
+  MEMORY_RENDER      = 1,
+  MEMORY_SYN_HL      = 2,
+  MEMORY_LINE_ARRAYS = 3,
+  MEMORY_SCREEN      = 4,
+  MEMORY_SEARCH      = 5,
+  MEMORY_UNDO        = 6
 };
 
 
@@ -147,51 +520,183 @@ enum syntax_highlight_colours
  *
  * ************************************************************************** */
 
+// B
+int batch_run (char *script, int nfiles, char **files);
+size_t buffer_count_modified (void);
+EDITOR_BUFFER *buffer_create (char *filename);
+void buffer_destroy (EDITOR_BUFFER *buf, int discard);
+size_t buffer_find (char *filename);
+void buffer_free (size_t idx, int discard);
+void buffer_list (void);
+void buffer_load (size_t idx);
+size_t buffer_new (char *filename);
+void buffer_next (int step);
+int buffer_switch (size_t idx);
+void buffer_tick (void);
+
+// C
+void command_prompt (void);
+
 // E
+void editor_add_to_screen_buf (SCREEN_BUF *sb, char *s, size_t len);
+void editor_damage_all (void);
 void editor_delete_char (void);
 void editor_init (void);
 void editor_insert_char (int c);
 void editor_insert_new_line (void);
 void editor_refresh_screen (void);
+void editor_render_line (EDITOR_BUFFER *buf, size_t idx);
 void editor_set_status_message (char *fmt, ...);
-void editor_add_to_render_buffer (EDITOR_LINE *line);
+void editor_show_message (const char *message);
+void editor_update_screen_buffer (SCREEN_BUF *rows, WINDOW *win);
+void editor_add_to_render_buffer (EDITOR_BUFFER *buf, size_t idx);
 
 // F
 void find (void);
+size_t find_all_matches (EDITOR_BUFFER *buf, char *query, SEARCH_MATCH **matches, char **error);
+void find_clear_results (EDITOR_BUFFER *buf);
+void find_keyword_search (EDITOR_BUFFER *buf, char *query, int key);
+int find_next_match (EDITOR_BUFFER *buf, char *query, size_t *line, size_t *col, char **error);
+size_t find_overlay_spans (EDITOR_BUFFER *buf, size_t line, size_t nrows, size_t **rx);
+void find_replace (void);
+size_t find_replace_all (EDITOR_BUFFER *buf, char *query, char *with, size_t *nlines, char **error);
+
+// G
+void grep_directory (char *query);
+
+// H
+void hud_frame_begin (void);
+void hud_frame_end (size_t nbytes);
+size_t hud_format (char *buf, size_t size);
+void hud_toggle (char *arg);
 
 // I
-int io_read_file (char *filename);
-void io_save_file (void);
+int io_finish_load (void);
+void io_load_file (void *arg);
+int io_open_file (char *filename);
+int io_save_file (void);
+int io_write_all (int file_desc, char *buf, size_t buf_len);
+int io_write_file (EDITOR_BUFFER *buf, size_t *buf_len);
 char *io_status_bar_prompt (char *prompt_msg, void (*callback) (char *, int));
+int is_separator (int c);
+
+// J
+void journal_close (EDITOR_BUFFER *buf, int discard);
+void journal_open (EDITOR_BUFFER *buf, char *filename, int (*recover) (char *, int));
+int journal_prompt (char *filename, int changed);
+void journal_record (EDITOR_BUFFER *buf, int type, size_t line, size_t col, char *text, size_t len);
+void journal_saved (EDITOR_BUFFER *buf, char *filename, size_t file_size);
+void journal_tick (EDITOR_BUFFER *buf);
 
 // K
 void kp_process_keypress (void);
 int kp_read_keypress (void);
 
 // L
-void line_add_string_to_text_buffer (EDITOR_LINE *dest_line, char *src,
-                                     size_t append_len);
-void line_add_to_text_buffer (int insert_index, char *s, size_t line_len);
-void line_delete_char (EDITOR_LINE *line, int insert_idx);
-void line_delete_line (int idx);
-void line_insert_char (EDITOR_LINE *line, int insert_idx, int c);
+void line_add_string_to_text_buffer (EDITOR_BUFFER *buf, size_t idx, char *src, size_t append_len);
+void line_add_to_text_buffer (EDITOR_BUFFER *buf, size_t insert_index, char *s, size_t line_len);
+void line_delete_char (EDITOR_BUFFER *buf, size_t idx, size_t insert_idx);
+void line_delete_text (EDITOR_BUFFER *buf, size_t idx, size_t col, size_t len);
+void line_delete_line (EDITOR_BUFFER *buf, size_t idx);
+void line_insert_char (EDITOR_BUFFER *buf, size_t idx, size_t insert_idx, int c);
+void line_insert_text (EDITOR_BUFFER *buf, size_t idx, size_t col, char *s, size_t len);
+void line_reserve (EDITOR_LINES *lines, size_t nlines);
+void line_set_text (EDITOR_BUFFER *buf, size_t idx, char *s, size_t len);
+void line_truncate (EDITOR_BUFFER *buf, size_t idx, size_t new_len);
+
+// M
+void memory_count (MEMORY_STATS *stats);
+int memory_stats (char *category, char *buf, size_t buf_size);
+
+// O
+size_t offset_byte_to_line (EDITOR_BUFFER *buf, size_t offset, size_t *col);
+void offset_goto (void);
+void offset_invalidate (EDITOR_BUFFER *buf);
+size_t offset_line_to_byte (EDITOR_BUFFER *buf, size_t idx);
+void offset_update_line (EDITOR_BUFFER *buf, size_t idx, size_t old_len, size_t new_len);
+
+// P
+int pool_group_done (POOL_GROUP *group);
+size_t pool_size (void);
+void pool_submit (POOL_GROUP *group, POOL_FUNC func, void *arg);
+void pool_wait (POOL_GROUP *group);
+
+// R
+void record_byte (char c);
+void record_key (void);
+int record_open (char *path);
+REGEX *regex_compile (char *pattern, int icase, char **error);
+void regex_free (REGEX *re);
+int regex_search (REGEX *re, char *text, size_t len, size_t from, size_t *match_start, size_t *match_end);
 
 // S
+size_t search_all (SEARCH_PATTERN *pattern, char *hay, size_t hay_len, SEARCH_MATCHES *matches);
+void search_compile (SEARCH_PATTERN *pattern, char *needle, size_t len, int icase);
+char *search_next (SEARCH_PATTERN *pattern, char *hay, size_t hay_len);
+void swap_close (EDITOR_BUFFER *buf, int discard);
+void swap_move_lines (EDITOR_BUFFER *buf, size_t dest, size_t src, size_t nmove);
+void swap_open (EDITOR_BUFFER *buf, char *filename, int (*restore) (char *, int));
+int swap_prompt (char *filename, int changed);
+void swap_saved (EDITOR_BUFFER *buf, char *filename, size_t file_size);
+void swap_tick (EDITOR_BUFFER *buf);
 int syntax_get_colour (int hl);
-void syntax_select_highlighting (void);
-void syntax_update_highlighting (EDITOR_LINE *line);
+void syntax_highlight_buffer (EDITOR_BUFFER *buf);
+SYNTAX *syntax_match (char *filename);
+void syntax_select_highlighting (EDITOR_BUFFER *buf);
+void syntax_update_highlighting (EDITOR_BUFFER *buf, size_t idx);
 
 // T
 void terminal_init (void);
 int terminal_get_cursor_position (int *nrows, int *ncols);
-void terminal_update_size (int unused);
+void terminal_on_resize (int unused);
+int terminal_resize (void);
+void terminal_update_size (void);
+#ifdef KRIS_TRACE
+int trace_dump (void);
+void trace_event (const char *name, char phase);
+const char *trace_scope_begin (const char *name);
+void trace_scope_end (const char **name);
+#endif
+int trigram_build_slice (EDITOR_BUFFER *buf);
+size_t *trigram_candidates (EDITOR_BUFFER *buf, char *query, size_t len, size_t *ncandidates);
+void trigram_delete_line (EDITOR_BUFFER *buf, size_t idx);
+void trigram_disable (EDITOR_BUFFER *buf);
+void trigram_enable (EDITOR_BUFFER *buf);
+void trigram_insert_line (EDITOR_BUFFER *buf, size_t idx);
+void trigram_move_lines (EDITOR_BUFFER *buf, size_t dest, size_t nmove);
+void trigram_stats (EDITOR_BUFFER *buf, char *out, size_t out_size);
+void trigram_update_line (EDITOR_BUFFER *buf, size_t idx);
 
 // U
+void undo_begin_group (EDITOR_BUFFER *buf);
+void undo_clear (EDITOR_BUFFER *buf);
+void undo_end_group (EDITOR_BUFFER *buf);
+void undo_mark_saved (EDITOR_BUFFER *buf);
+void undo_record (EDITOR_BUFFER *buf, int type, size_t line, size_t col, char *text, size_t len);
+void undo_redo (EDITOR_BUFFER *buf);
+void undo_seal (EDITOR_BUFFER *buf);
+void undo_stats (EDITOR_BUFFER *buf, char *out, size_t out_size);
+void undo_undo (EDITOR_BUFFER *buf);
 void util_clean_memory (void);
-int util_convert_cx_to_rx (EDITOR_LINE *line, int cx);
-int util_convert_rx_to_cx (EDITOR_LINE *line, int rx);
+size_t util_convert_cx_to_rx (EDITOR_BUFFER *buf, size_t idx, size_t cx);
+size_t util_convert_rx_to_cx (EDITOR_BUFFER *buf, size_t idx, size_t rx);
 void util_exit (char *s);
-void util_free_line (EDITOR_LINE *line);
+void util_format_count (char *buf, size_t buf_size, size_t count);
+void util_free_line (EDITOR_BUFFER *buf, size_t idx);
+char *util_hidden_path (char *filename, char *suffix);
+void util_message (char *fmt, ...);
+void util_on_fatal (void (*handler) (const char *message));
+void util_on_message (void (*handler) (const char *message));
 void util_reset_display (void);
 
+// W
+void window_close (void);
+void window_free (WINDOW *win);
+void window_init (void);
+void window_layout (void);
+void window_next (void);
+size_t window_rows (void);
+void window_save (void);
+void window_split (int split);
+
 #endif
@@ -0,0 +1,456 @@
+/** **************************************************************************
+ *
+ * @file libkris.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief The API of libkris, for using the text buffer, highlighting and
+ *        search of Kris without a terminal.
+ *
+ * @details
+ *
+ * Reading, searching, drawing and editing a buffer work on the buffer they
+ * are given, through the same code the editor uses for typing. libkris is
+ * only the core of the editor, so buffers made here aren't in any list of
+ * open buffers, they have no journal, swap file or undo log, and nothing
+ * touches the terminal.
+ *
+ * ************************************************************************** */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Forget the search results of a buffer, once it has
+ *                      been edited
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+kris_edited (KRIS_BUFFER *buf)
+{
+  if (buf->search.nresults > 0)
+    find_clear_results (buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Make sure a buffer has a line
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+kris_first_line (KRIS_BUFFER *buf)
+{
+  if (buf->nlines == 0)
+    line_add_to_text_buffer (buf, 0, "", 0);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Create an empty buffer
+ *
+ *  @param[in]          *filename     A file name to pick the syntax
+ *                                    highlighting from, or NULL for none
+ *
+ *  @return             The buffer
+ *
+ *  @details
+ *
+ *  The file isn't read, only its name is used, so kris_buffer_new ("log.py")
+ *  is highlighted as Python.
+ *
+ * ************************************************************************** */
+
+KRIS_BUFFER *
+kris_buffer_new (const char *filename)
+{
+  EDITOR_BUFFER *buf;
+
+  buf = buffer_create (NULL);
+  buf->syntax = filename ? syntax_match ((char *) filename) : NULL;
+  buf->undo.suspended++;
+
+  return buf;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Read a file into a new buffer
+ *
+ *  @param[in]          *filename     The file to read
+ *
+ *  @return             The buffer, or NULL with errno set if the file couldn't
+ *                      be read
+ *
+ *  @details
+ *
+ *  The file is read, rendered and highlighted before this returns.
+ *
+ * ************************************************************************** */
+
+KRIS_BUFFER *
+kris_buffer_open (const char *filename)
+{
+  int load_error;
+  EDITOR_BUFFER *buf;
+
+  buf = buffer_create ((char *) filename);
+  io_load_file (buf);
+  buf->state = BUFFER_LOADED;
+  buf->undo.suspended++;
+
+  if ((load_error = buf->load_error))
+  {
+    buffer_destroy (buf, FALSE);
+    errno = load_error;
+    return NULL;
+  }
+
+  return buf;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free a buffer
+ *
+ *  @param[in]          *buf      The buffer
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+kris_buffer_free (KRIS_BUFFER *buf)
+{
+  buffer_destroy (buf, FALSE);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the number of lines in a buffer
+ *
+ *  @param[in]          *buf      The buffer
+ *
+ *  @return             The number of lines
+ *
+ * ************************************************************************** */
+
+size_t
+kris_buffer_nlines (KRIS_BUFFER *buf)
+{
+  return buf->nlines;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the chars of a line
+ *
+ *  @param[in]          *buf      The buffer
+ *  @param[in]          line      The line
+ *  @param[out]         *len      The number of chars
+ *
+ *  @return             The chars, which end in a NUL, or NULL if there is no
+ *                      such line
+ *
+ * ************************************************************************** */
+
+const char *
+kris_buffer_line (KRIS_BUFFER *buf, size_t line, size_t *len)
+{
+  if (line >= buf->nlines)
+    return NULL;
+
+  *len = buf->lines.len[line];
+
+  return buf->lines.chars[line];
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the render of a line, with tabs expanded
+ *
+ *  @param[in]          *buf      The buffer
+ *  @param[in]          line      The line
+ *  @param[out]         *len      The number of render columns
+ *
+ *  @return             The render, or NULL if there is no such line
+ *
+ * ************************************************************************** */
+
+const char *
+kris_buffer_render (KRIS_BUFFER *buf, size_t line, size_t *len)
+{
+  if (line >= buf->nlines)
+    return NULL;
+
+  *len = buf->lines.r_len[line];
+
+  return buf->lines.render[line];
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the syntax highlighting of a line
+ *
+ *  @param[in]          *buf      The buffer
+ *  @param[in]          line      The line
+ *
+ *  @return             A syntax_highlight_colours for each column of the
+ *                      render of the line, or NULL if there is no such line
+ *
+ * ************************************************************************** */
+
+const unsigned char *
+kris_buffer_highlight (KRIS_BUFFER *buf, size_t line)
+{
+  if (line >= buf->nlines)
+    return NULL;
+
+  return buf->lines.syn_hl[line];
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the terminal colour of a syntax highlighting type
+ *
+ *  @param[in]          hl        One of syntax_highlight_colours
+ *
+ *  @return             The SGR foreground colour, such as 31 for red
+ *
+ * ************************************************************************** */
+
+int
+kris_highlight_colour (int hl)
+{
+  return syntax_get_colour (hl);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add text to the end of a buffer
+ *
+ *  @param[in]          *buf      The buffer
+ *  @param[in]          *text     The text, where each new line char starts a
+ *                                new line
+ *  @param[in]          len       The length of text
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The text is added to the end of the last line, so text which ends in a new
+ *  line leaves an empty last line for the next text to go on.
+ *
+ * ************************************************************************** */
+
+void
+kris_buffer_append (KRIS_BUFFER *buf, const char *text, size_t len)
+{
+  kris_first_line (buf);
+  line_insert_text (buf, buf->nlines - 1, buf->lines.len[buf->nlines - 1], (char *) text, len);
+  kris_edited (buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Insert text into a buffer
+ *
+ *  @param[in]          *buf      The buffer
+ *  @param[in]          line      The line to insert into
+ *  @param[in]          col       The char to insert before
+ *  @param[in]          *text     The text, where each new line char splits
+ *                                the line
+ *  @param[in]          len       The length of text
+ *
+ *  @return             SUCCESS, or FAILURE if there is no such position
+ *
+ * ************************************************************************** */
+
+int
+kris_buffer_insert (KRIS_BUFFER *buf, size_t line, size_t col, const char *text, size_t len)
+{
+  if (line >= (buf->nlines ? buf->nlines : 1) || col > (buf->nlines ? buf->lines.len[line] : 0))
+    return FAILURE;
+
+  kris_first_line (buf);
+  line_insert_text (buf, line, col, (char *) text, len);
+  kris_edited (buf);
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Delete text from a buffer
+ *
+ *  @param[in]          *buf      The buffer
+ *  @param[in]          line      The line to delete from
+ *  @param[in]          col       The first char to delete
+ *  @param[in]          len       The number of chars to delete, where the end
+ *                                of each line counts as one char
+ *
+ *  @return             SUCCESS, or FAILURE if there is no such position
+ *
+ * ************************************************************************** */
+
+int
+kris_buffer_delete (KRIS_BUFFER *buf, size_t line, size_t col, size_t len)
+{
+  if (line >= buf->nlines || col > buf->lines.len[line])
+    return FAILURE;
+
+  line_delete_text (buf, line, col, len);
+  kris_edited (buf);
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find every match of a query in a buffer
+ *
+ *  @param[in]          *buf        The buffer
+ *  @param[in]          *query      The query
+ *  @param[in]          flags       KRIS_SEARCH_REGEX, KRIS_SEARCH_ICASE and
+ *                                  KRIS_SEARCH_WORD or'd together
+ *  @param[out]         **matches   The matches, sorted by line and column
+ *  @param[out]         **error     Why the regex is invalid, or NULL
+ *
+ *  @return             The number of matches
+ *
+ *  @details
+ *
+ *  The matches belong to the buffer and are valid until the next search or
+ *  edit. Until the buffer is edited, a query which extends the last one with
+ *  the same flags only searches the lines the last one matched.
+ *
+ * ************************************************************************** */
+
+size_t
+kris_buffer_search (KRIS_BUFFER *buf, const char *query, int flags, const SEARCH_MATCH **matches,
+                    const char **error)
+{
+  int regex;
+  int icase;
+  int word;
+  size_t nmatches;
+  char *why;
+  SEARCH_MATCH *found;
+  SEARCH_STATE *search = &buf->search;
+
+  regex = (flags & KRIS_SEARCH_REGEX) != 0;
+  icase = (flags & KRIS_SEARCH_ICASE) != 0;
+  word = (flags & KRIS_SEARCH_WORD) != 0;
+  if (regex != search->regex || icase != search->icase || word != search->word)
+  {
+    search->regex = regex;
+    search->icase = icase;
+    search->word = word;
+    find_clear_results (buf);
+  }
+
+  found = NULL;
+  why = NULL;
+  nmatches = query[0] != '\0' ? find_all_matches (buf, (char *) query, &found, &why) : 0;
+  *matches = found;
+  *error = why;
+
+  return nmatches;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Draw some lines of a buffer as they'd be shown in the
+ *                      terminal
+ *
+ *  @param[in]          *buf          The buffer
+ *  @param[in]          first_line    The line to draw at the top
+ *  @param[in]          nrows         The number of rows to draw
+ *  @param[in]          ncols         The number of columns to draw
+ *  @param[out]         *len          The length of the drawing
+ *
+ *  @return             The rows, with the highlighting as escape codes and
+ *                      each row ending in a new line, which has to be freed
+ *
+ *  @details
+ *
+ *  The rows are drawn the same way as a window of the editor, but without its
+ *  status bar.
+ *
+ * ************************************************************************** */
+
+char *
+kris_buffer_draw (KRIS_BUFFER *buf, size_t first_line, int nrows, int ncols, size_t *len)
+{
+  int i;
+  SCREEN_BUF out = SBUF_INIT;
+  SCREEN_BUF *rows;
+  WINDOW win;
+
+  if (nrows < 1 || ncols < 1)
+    return NULL;
+
+  if (!(rows = calloc ((size_t) nrows, sizeof *rows)))
+    util_exit ("Couldn't allocate memory for the screen buffer");
+
+  memset (&win, 0, sizeof win);
+  win.buf = buf;
+  win.split = WINDOW_LEAF;
+  win.row_offset = first_line;
+  win.height = nrows + 1;
+  win.width = ncols;
+
+  editor_update_screen_buffer (rows, &win);
+
+  for (i = 0; i < nrows; i++)
+  {
+    editor_add_to_screen_buf (&out, rows[i].buf, rows[i].len);
+    editor_add_to_screen_buf (&out, "\n", 1);
+    free (rows[i].buf);
+  }
+  free (rows);
+
+  editor_add_to_screen_buf (&out, "", 1);
+  *len = out.len - 1;
+
+  return out.buf;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Set the function called when libkris runs out of
+ *                      memory
+ *
+ *  @param[in]          *handler    The function, which is given the error
+ *                                  message, or NULL for none
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  libkris can't carry on without the memory, so once the handler returns the
+ *  message is printed and the program exits. The handler can save any work of
+ *  the program first, but mustn't call libkris.
+ *
+ * ************************************************************************** */
+
+void
+kris_on_fatal (void (*handler) (const char *message))
+{
+  util_on_fatal (handler);
+}
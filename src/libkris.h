@@ -0,0 +1,106 @@
+/** **************************************************************************
+ *
+ * @file libkris.h
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief The API of libkris, the text buffer, highlighting and search engine
+ *        of Kris, which can be used without a terminal.
+ *
+ * @details
+ *
+ * A KRIS_BUFFER holds the lines of some text, the render of each line, with
+ * tabs expanded, and the syntax highlighting of each char of the render. The
+ * render and highlighting are kept up to date as the text is edited.
+ *
+ * Buffers don't share any state, so different buffers can be used from
+ * different threads at the same time, but calls for the same buffer have to
+ * be made one at a time. Searches use worker threads of their own, which are
+ * shared by every buffer, but these have finished by the time the search
+ * returns.
+ *
+ * Lines and columns count from 0, and columns count chars rather than render
+ * columns. Pointers into a buffer are valid until it is next changed.
+ *
+ * If memory runs out, the handler set with kris_on_fatal is called before
+ * the message is printed and the program exits.
+ *
+ * ************************************************************************** */
+
+#ifndef KRIS_LIBKRIS_H
+#define KRIS_LIBKRIS_H
+
+#include <stddef.h>
+
+#define KRIS_SEARCH_REGEX 1
+#define KRIS_SEARCH_ICASE 2
+#define KRIS_SEARCH_WORD 4
+
+/* **************************************************************************
+ *
+ * Data structures
+ *
+ * KRIS_BUFFER:
+ *  Some text being worked on, which is opaque.
+ *
+ * SEARCH_MATCH:
+ *  The position of a search match in the text buffer.
+ *
+ * ************************************************************************** */
+
+typedef struct EDITOR_BUFFER KRIS_BUFFER;
+
+typedef struct SEARCH_MATCH
+{
+  size_t line;                     // The line the match is on
+  size_t col;                      // The column in chars the match starts at
+  size_t len;                      // The length of the match in chars
+} SEARCH_MATCH;
+
+/* **************************************************************************
+ *
+ * Enumerators
+ *
+ * syntax_highlight_colours:
+ *  Maps syntax highlighting types to internal numbers
+ *
+ * ************************************************************************** */
+
+enum syntax_highlight_colours
+{
+  HL_NORMAL     = 0,
+  HL_NUMBER     = 1,
+  HL_MATCH      = 2,
+  HL_STRING     = 3,
+  HL_COMMENT    = 4,
+  HL_KEYWORD1   = 5,
+  HL_KEYWORD2   = 6,
+  HL_ML_COMMENT = 7,
+  HL_PREPROCESS = 8
+};
+
+/* **************************************************************************
+ *
+ * Functions
+ *
+ * ************************************************************************** */
+
+void kris_buffer_append (KRIS_BUFFER *buf, const char *text, size_t len);
+int kris_buffer_delete (KRIS_BUFFER *buf, size_t line, size_t col, size_t len);
+char *kris_buffer_draw (KRIS_BUFFER *buf, size_t first_line, int nrows, int ncols, size_t *len);
+void kris_buffer_free (KRIS_BUFFER *buf);
+const unsigned char *kris_buffer_highlight (KRIS_BUFFER *buf, size_t line);
+int kris_buffer_insert (KRIS_BUFFER *buf, size_t line, size_t col, const char *text, size_t len);
+const char *kris_buffer_line (KRIS_BUFFER *buf, size_t line, size_t *len);
+KRIS_BUFFER *kris_buffer_new (const char *filename);
+size_t kris_buffer_nlines (KRIS_BUFFER *buf);
+KRIS_BUFFER *kris_buffer_open (const char *filename);
+const char *kris_buffer_render (KRIS_BUFFER *buf, size_t line, size_t *len);
+size_t kris_buffer_search (KRIS_BUFFER *buf, const char *query, int flags, const SEARCH_MATCH **matches,
+                           const char **error);
+int kris_highlight_colour (int hl);
+void kris_on_fatal (void (*handler) (const char *message));
+
+#endif  // KRIS_LIBKRIS_H
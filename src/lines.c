@@ -15,10 +15,181 @@
 
 #include "kris.h"
 
+/** **************************************************************************
+ *
+ *  @brief              Make sure the line arrays can hold at least nlines
+ *
+ *  @param[in,out]      *lines      The line arrays to grow
+ *  @param[in]          nlines      The number of lines the text buffer needs to
+ *                                  be able to hold
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Each of the parallel line arrays in lines is grown to the same
+ *  capacity. The capacity is doubled each time so appending lines, i.e. when
+ *  reading in a file, does not reallocate the arrays for every single line.
+ *
+ * ************************************************************************** */
+
+void
+line_reserve (EDITOR_LINES *lines, size_t nlines)
+{
+  size_t capacity;
+
+  if (nlines <= lines->capacity)
+    return;
+
+  capacity = lines->capacity ? lines->capacity : 64;
+  while (capacity < nlines)
+    capacity *= 2;
+
+  lines->len = realloc (lines->len, capacity * sizeof (*lines->len));
+  lines->r_len = realloc (lines->r_len, capacity * sizeof (*lines->r_len));
+  lines->chars = realloc (lines->chars, capacity * sizeof (*lines->chars));
+  lines->render = realloc (lines->render, capacity * sizeof (*lines->render));
+  lines->syn_hl = realloc (lines->syn_hl, capacity * sizeof (*lines->syn_hl));
+  lines->hl_open_comment = realloc (lines->hl_open_comment, capacity * sizeof (*lines->hl_open_comment));
+  lines->trigram_id = realloc (lines->trigram_id, capacity * sizeof (*lines->trigram_id));
+  lines->changed_gen = realloc (lines->changed_gen, capacity * sizeof (*lines->changed_gen));
+
+  if (!lines->len || !lines->r_len || !lines->chars || !lines->render || !lines->syn_hl || !lines->hl_open_comment ||
+      !lines->trigram_id || !lines->changed_gen)
+    util_exit ("Couldn't allocate memory for the text buffer");
+
+  lines->capacity = capacity;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Shift the line arrays to open or close a gap
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          dest      The line index to move the lines to
+ *  @param[in]          src       The line index to move the lines from
+ *  @param[in]          nmove     The number of lines to move
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Moves nmove lines starting at src to dest in every one of the parallel
+ *  line arrays.
+ *
+ * ************************************************************************** */
+
+static void
+line_move (EDITOR_BUFFER *buf, size_t dest, size_t src, size_t nmove)
+{
+  EDITOR_LINES *lines = &buf->lines;
+
+  memmove (&lines->len[dest], &lines->len[src], nmove * sizeof (*lines->len));
+  memmove (&lines->r_len[dest], &lines->r_len[src], nmove * sizeof (*lines->r_len));
+  memmove (&lines->chars[dest], &lines->chars[src], nmove * sizeof (*lines->chars));
+  memmove (&lines->render[dest], &lines->render[src], nmove * sizeof (*lines->render));
+  memmove (&lines->syn_hl[dest], &lines->syn_hl[src], nmove * sizeof (*lines->syn_hl));
+  memmove (&lines->hl_open_comment[dest], &lines->hl_open_comment[src], nmove * sizeof (*lines->hl_open_comment));
+  memmove (&lines->trigram_id[dest], &lines->trigram_id[src], nmove * sizeof (*lines->trigram_id));
+  memmove (&lines->changed_gen[dest], &lines->changed_gen[src], nmove * sizeof (*lines->changed_gen));
+  trigram_move_lines (buf, dest, nmove);
+  swap_move_lines (buf, dest, src, nmove);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Fill in an empty line slot
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          idx       The index of the slot
+ *  @param[in]          *s        The text of the line
+ *  @param[in]          len       The length of s
+ *  @param[in]          *tail     More text to add to the end of the line
+ *  @param[in]          tail_len  The length of tail
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The line is not rendered, as lines after it might not have been filled in
+ *  yet.
+ *
+ * ************************************************************************** */
+
+static void
+line_init (EDITOR_BUFFER *buf, size_t idx, char *s, size_t len, char *tail, size_t tail_len)
+{
+  EDITOR_LINES *lines = &buf->lines;
+
+  if (!(lines->chars[idx] = malloc (len + tail_len + 1)))
+    util_exit ("Couldn't allocate memory for a line");
+
+  memcpy (lines->chars[idx], s, len);
+  if (tail_len > 0)
+    memcpy (&lines->chars[idx][len], tail, tail_len);
+  lines->chars[idx][len + tail_len] = '\0';
+  lines->len[idx] = len + tail_len;
+  lines->r_len[idx] = 0;
+  lines->render[idx] = NULL;
+  lines->syn_hl[idx] = NULL;
+  lines->hl_open_comment[idx] = FALSE;
+  lines->changed_gen[idx] = lines->generation;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Render a range of lines
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          first     The first line to render
+ *  @param[in]          last      The last line to render
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The lines are rendered from the bottom up, as highlighting a line can carry
+ *  on into the next line when a multi line comment is opened or closed, and
+ *  the next line must have been rendered for that.
+ *
+ * ************************************************************************** */
+
+static void
+line_render_range (EDITOR_BUFFER *buf, size_t first, size_t last)
+{
+  size_t i;
+
+  for (i = last + 1; i > first; i--)
+    editor_add_to_render_buffer (buf, i - 1);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Record an edit in the journal and the undo log
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          type      UNDO_INSERT or UNDO_DELETE
+ *  @param[in]          line      The line the edit starts on
+ *  @param[in]          col       The column the edit starts at
+ *  @param[in]          *text     The text inserted or deleted
+ *  @param[in]          len       The number of chars inserted or deleted
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+line_record (EDITOR_BUFFER *buf, int type, size_t line, size_t col, char *text, size_t len)
+{
+  journal_record (buf, type, line, col, text, len);
+  undo_record (buf, type, line, col, text, len);
+}
+
 /** **************************************************************************
  *
  *  @brief              Append a line of text to the text buffer in editor_config
  *
+ *  @param[in,out]      *buf            The buffer
  *  @param[in]          insert_index    The line index of where to insert the new
  *                                      line
  *  @param[in]          *s              The buffer to append to the text buffer
@@ -28,171 +199,459 @@
  *
  *  @details
  *
- *  Adds some text to the text buffer. This is done by allocating extra memory
- *  to hold an extra line and the current line and lines afterwards in the text
- *  buffer are shifted downward by one. The new line is then appended into the
- *  text buffer on the line given by insert_index. The render buffer is then
+ *  Adds some text to the text buffer. This is done by making sure there is
+ *  space to hold an extra line and the current line and lines afterwards in the
+ *  text buffer are shifted downward by one. The new line is then appended into
+ *  the text buffer on the line given by insert_index. The render buffer is then
  *  updated as well as the total number of lines.
  *
  * ************************************************************************** */
 
 void
-line_add_to_text_buffer (int insert_index, char *s, size_t line_len)
+line_add_to_text_buffer (EDITOR_BUFFER *buf, size_t insert_index, char *s, size_t line_len)
 {
-  int i;
+  char *text;
+  EDITOR_LINES *lines = &buf->lines;
 
-  if (insert_index < 0 || insert_index > editor.nlines)
+  if (insert_index > buf->nlines)
     return;
 
   /*
-   * Allocate extra space, shift the lines down by 1 and insert new line
+   * Record the new line as a new line char and the text, either at the end of
+   * the line before or before the line it pushes down. The very first line in
+   * the text buffer isn't recorded, as there is no line to attach it to
+   */
+
+  if (buf->nlines > 0 && !buf->undo.suspended)
+  {
+    if (!(text = malloc (line_len + 1)))
+      util_exit ("Couldn't allocate memory for the undo log");
+
+    if (insert_index > 0)
+    {
+      text[0] = '\n';
+      memcpy (&text[1], s, line_len);
+      line_record (buf, UNDO_INSERT, insert_index - 1, lines->len[insert_index - 1], text, line_len + 1);
+    }
+    else
+    {
+      memcpy (text, s, line_len);
+      text[line_len] = '\n';
+      line_record (buf, UNDO_INSERT, 0, 0, text, line_len + 1);
+    }
+
+    free (text);
+  }
+
+  /*
+   * Make space for another line and shift the lines down by 1
    */
 
-  editor.lines = realloc (editor.lines, (editor.nlines + 1) * sizeof (EDITOR_LINE));
-  memmove (&editor.lines[insert_index + 1], &editor.lines[insert_index],
-           sizeof (EDITOR_LINE) * (editor.nlines - insert_index));
-  for (i = insert_index + 1; i <= editor.nlines; i++)
-    editor.lines[i].idx++;
-  editor.lines[insert_index].idx = insert_index;
+  line_reserve (lines, buf->nlines + 1);
+  line_move (buf, insert_index + 1, insert_index, buf->nlines - insert_index);
 
   /*
    * Append text to the new text line
    */
 
-  editor.lines[insert_index].len = line_len;
-  editor.lines[insert_index].chars = malloc (line_len + 1);
-  memcpy (editor.lines[insert_index].chars, s, line_len);
-  editor.lines[insert_index].chars[line_len] = '\0';
+  lines->len[insert_index] = line_len;
+  lines->chars[insert_index] = malloc (line_len + 1);
+  memcpy (lines->chars[insert_index], s, line_len);
+  lines->chars[insert_index][line_len] = '\0';
 
   /*
-   * Update the render buffer
+   * Update total number of lines and the render buffer
    */
 
-  editor.lines[insert_index].r_len = 0;
-  editor.lines[insert_index].render = NULL;
-  editor.lines[insert_index].syn_hl = NULL;
-  editor.lines[insert_index].hl_open_comment = 0;
-  editor_add_to_render_buffer (&editor.lines[insert_index]);
+  lines->r_len[insert_index] = 0;
+  lines->render[insert_index] = NULL;
+  lines->syn_hl[insert_index] = NULL;
+  lines->hl_open_comment[insert_index] = FALSE;
+  lines->changed_gen[insert_index] = lines->generation;
+  buf->nlines++;
+  offset_invalidate (buf);
+  trigram_insert_line (buf, insert_index);
+  editor_add_to_render_buffer (buf, insert_index);
 
   /*
-   * Update total number of lines and number of modified lines
+   * Update number of modified lines
    */
 
-  editor.nlines++;
-  editor.modified++;
+  buf->modified++;
 }
 
 /** **************************************************************************
  *
- *  @brief              Insert a char into the text buffer array
+ *  @brief              Insert text into the text buffer
  *
- *  @param[in, out]     *line           The line in the text buffer to update
- *  @param[in]          insert_idx      The index of where to insert the character
- *  @param[in]          c               An integer representation of an ASCII
- *                                      character to insert
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          idx       The index of the line to insert into
+ *  @param[in]          col       The index of the char to insert before
+ *  @param[in]          *s        The text to insert, where each new line char
+ *                                splits the line
+ *  @param[in]          len       The length of s
  *
  *  @return             void
  *
  *  @details
  *
- *  This function operates similar to line_add_to_text_buffer in that extra
- *  memory is allocated, for a single line in the text buffer this time, and
- *  then a character c is inserted into the line at insert_idx. Finally, the
- *  render buffer is updated with the line.
+ *  Every insert into the text buffer comes through here, so this is where it
+ *  is recorded in the journal and the undo log. If the text has new lines in it, all of the
+ *  new lines are made in one go, moving the lines after them once no matter
+ *  how many lines there are. The end of line idx is moved to the end of the
+ *  last new line. Only the lines which have changed are rendered.
  *
  * ************************************************************************** */
 
 void
-line_insert_char (EDITOR_LINE *line, int insert_idx, int c)
+line_insert_text (EDITOR_BUFFER *buf, size_t idx, size_t col, char *s, size_t len)
 {
-  if (insert_idx < 0 || insert_idx > line->len)
-    insert_idx = (int) line->len;
+  size_t i;
+  size_t nnew;
+  size_t old_len;
+  size_t seg_len;
+
+  char *nl;
+  char *seg;
+
+  EDITOR_LINES *lines = &buf->lines;
+
+  old_len = lines->len[idx];
+  if (col > old_len)
+    col = old_len;
+
+  line_record (buf, UNDO_INSERT, idx, col, s, len);
 
   /*
-   * Allocate more memory, shift chars right by 1 and insert new char
+   * Text on one line is inserted into the line
    */
 
-  line->chars = realloc (line->chars, line->len + 2);
-  memmove (&line->chars[insert_idx + 1], &line->chars[insert_idx], line->len - insert_idx + 1);
-  line->len++;
-  line->chars[insert_idx] = (char) c;
-  editor.modified++;
-  editor_add_to_render_buffer (line);
+  if (!(nl = memchr (s, '\n', len)))
+  {
+    if (!(lines->chars[idx] = realloc (lines->chars[idx], old_len + len + 1)))
+      util_exit ("Couldn't allocate memory for a line");
+
+    memmove (&lines->chars[idx][col + len], &lines->chars[idx][col], old_len - col + 1);
+    memcpy (&lines->chars[idx][col], s, len);
+    lines->len[idx] = old_len + len;
+    lines->changed_gen[idx] = lines->generation;
+    offset_update_line (buf, idx, old_len, old_len + len);
+    trigram_update_line (buf, idx);
+    buf->modified++;
+    editor_add_to_render_buffer (buf, idx);
+    return;
+  }
+
+  /*
+   * Otherwise, open a gap for the new lines and fill them in. The last new
+   * line gets the end of line idx, so it is filled in first
+   */
+
+  nnew = 0;
+  for (seg = nl; seg; seg = memchr (seg + 1, '\n', len - (size_t) (seg + 1 - s)))
+    nnew++;
+
+  line_reserve (lines, buf->nlines + nnew);
+  line_move (buf, idx + 1 + nnew, idx + 1, buf->nlines - idx - 1);
+  buf->nlines += nnew;
+
+  seg = nl + 1;
+  for (i = idx + 1; i <= idx + nnew; i++)
+  {
+    nl = i < idx + nnew ? memchr (seg, '\n', len - (size_t) (seg - s)) : &s[len];
+    seg_len = (size_t) (nl - seg);
+    if (i < idx + nnew)
+      line_init (buf, i, seg, seg_len, NULL, 0);
+    else
+      line_init (buf, i, seg, seg_len, &lines->chars[idx][col], old_len - col);
+    seg = nl + 1;
+  }
+
+  seg_len = (size_t) ((char *) memchr (s, '\n', len) - s);
+  if (!(lines->chars[idx] = realloc (lines->chars[idx], col + seg_len + 1)))
+    util_exit ("Couldn't allocate memory for a line");
+
+  memcpy (&lines->chars[idx][col], s, seg_len);
+  lines->chars[idx][col + seg_len] = '\0';
+  lines->len[idx] = col + seg_len;
+  lines->changed_gen[idx] = lines->generation;
+
+  offset_invalidate (buf);
+  trigram_update_line (buf, idx);
+  for (i = idx + 1; i <= idx + nnew; i++)
+    trigram_insert_line (buf, i);
+
+  buf->modified++;
+  line_render_range (buf, idx, idx + nnew);
 }
 
 /** **************************************************************************
  *
- *  @brief              Delete a char in a text buffer array
+ *  @brief              Delete text from the text buffer
  *
- *  @param[in, out]     *line
- *  @param[in]          insert_idx
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          idx       The index of the line to delete from
+ *  @param[in]          col       The index of the first char to delete
+ *  @param[in]          len       The number of chars to delete, where the end
+ *                                of each line counts as one char
  *
  *  @return             void
  *
  *  @details
  *
- *  Deletes a character in a line in the text buffer. This is done essentially
- *  by shifting the line from insert_idx to the left.
- *
- *  TODO: memmove might not reallocate memory to be smaller
+ *  Every delete from the text buffer comes through here, so this is where it
+ *  is recorded in the journal and the undo log. Deleting past the end of a line joins the next
+ *  line onto it. When several lines are joined, the lines after them are
+ *  moved once no matter how many lines are removed.
  *
  * ************************************************************************** */
 
 void
-line_delete_char (EDITOR_LINE *line, int insert_idx)
+line_delete_text (EDITOR_BUFFER *buf, size_t idx, size_t col, size_t len)
 {
-  if (insert_idx < 0 || insert_idx > line->len)
+  size_t i;
+  size_t copied;
+  size_t end;
+  size_t end_col;
+  size_t left;
+  size_t old_len;
+  size_t tail_len;
+
+  char *text;
+
+  EDITOR_LINES *lines = &buf->lines;
+
+  old_len = lines->len[idx];
+  if (col > old_len)
+    col = old_len;
+
+  /*
+   * Find where the deleted text ends, stopping at the end of the buffer
+   */
+
+  end = idx;
+  end_col = col;
+  left = len;
+  while (left > lines->len[end] - end_col && end + 1 < buf->nlines)
+  {
+    left -= lines->len[end] - end_col + 1;
+    end++;
+    end_col = 0;
+  }
+  if (left > lines->len[end] - end_col)
+  {
+    len -= left - (lines->len[end] - end_col);
+    left = lines->len[end] - end_col;
+  }
+  end_col += left;
+
+  /*
+   * Text on one line is cut out of the line
+   */
+
+  if (end == idx)
+  {
+    line_record (buf, UNDO_DELETE, idx, col, &lines->chars[idx][col], len);
+    memmove (&lines->chars[idx][col], &lines->chars[idx][end_col], old_len - end_col + 1);
+    lines->len[idx] = old_len - (end_col - col);
+    lines->changed_gen[idx] = lines->generation;
+    offset_update_line (buf, idx, old_len, lines->len[idx]);
+    trigram_update_line (buf, idx);
+    buf->modified++;
+    editor_add_to_render_buffer (buf, idx);
     return;
+  }
 
   /*
-   * Essentially just moving every char to the left
+   * Otherwise, the text being deleted is copied out for the undo log, then
+   * the end of the last line is joined onto line idx and the lines in between
+   * are removed
    */
 
-  memmove (&line->chars[insert_idx], &line->chars[insert_idx + 1], line->len - insert_idx);
-  line->len--;
-  editor.modified++;
-  editor_add_to_render_buffer (line);
+  text = NULL;
+  if (!buf->undo.suspended)
+  {
+    if (!(text = malloc (len)))
+      util_exit ("Couldn't allocate memory for the undo log");
+
+    copied = old_len - col;
+    memcpy (text, &lines->chars[idx][col], copied);
+    for (i = idx + 1; i <= end; i++)
+    {
+      text[copied++] = '\n';
+      tail_len = i < end ? lines->len[i] : end_col;
+      memcpy (&text[copied], lines->chars[i], tail_len);
+      copied += tail_len;
+    }
+  }
+
+  line_record (buf, UNDO_DELETE, idx, col, text, len);
+  free (text);
+
+  tail_len = lines->len[end] - end_col;
+  if (!(lines->chars[idx] = realloc (lines->chars[idx], col + tail_len + 1)))
+    util_exit ("Couldn't allocate memory for a line");
+
+  memcpy (&lines->chars[idx][col], &lines->chars[end][end_col], tail_len);
+  lines->chars[idx][col + tail_len] = '\0';
+  lines->len[idx] = col + tail_len;
+  lines->changed_gen[idx] = lines->generation;
+
+  for (i = end; i > idx; i--)
+  {
+    util_free_line (buf, i);
+    trigram_delete_line (buf, i);
+  }
+
+  line_move (buf, idx + 1, end + 1, buf->nlines - end - 1);
+  buf->nlines -= end - idx;
+
+  offset_invalidate (buf);
+  trigram_update_line (buf, idx);
+  buf->modified++;
+  editor_add_to_render_buffer (buf, idx);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Insert a char into the text buffer array
+ *
+ *  @param[in,out]      *buf            The buffer
+ *  @param[in]          idx             The index of the line in the text buffer
+ *                                      to update
+ *  @param[in]          insert_idx      The index of where to insert the character
+ *  @param[in]          c               An integer representation of an ASCII
+ *                                      character to insert
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+line_insert_char (EDITOR_BUFFER *buf, size_t idx, size_t insert_idx, int c)
+{
+  char ch = (char) c;
+
+  line_insert_text (buf, idx, insert_idx, &ch, 1);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Delete a char in a text buffer array
+ *
+ *  @param[in,out]      *buf            The buffer
+ *  @param[in]          idx             The index of the line in the text buffer
+ *  @param[in]          insert_idx      The index of the char to delete
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+line_delete_char (EDITOR_BUFFER *buf, size_t idx, size_t insert_idx)
+{
+  if (insert_idx >= buf->lines.len[idx])
+    return;
+
+  line_delete_text (buf, idx, insert_idx, 1);
 }
 
 /** **************************************************************************
  *
  *  @brief              Append a string to the end of a line
  *
- *  @param[in, out]    *dest_line    The line to append *src to
+ *  @param[in,out]     *buf          The buffer
+ *  @param[in]         idx           The index of the line to append *src to
  *  @param[in]         *src          The string which is being appended to
- *                                   *dest_line
+ *                                   the line
  *  @param[in]         append_len    The length of the *src string
  *
  *  @return             void
  *
+ * ************************************************************************** */
+
+void
+line_add_string_to_text_buffer (EDITOR_BUFFER *buf, size_t idx, char *src, size_t append_len)
+{
+  line_insert_text (buf, idx, buf->lines.len[idx], src, append_len);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Replace the entire contents of a line
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          idx       The index of the line to replace
+ *  @param[in]          *s        The new contents of the line
+ *  @param[in]          len       The length of s
+ *
+ *  @return             void
+ *
  *  @details
  *
- *  This function allocate more memory for the line in the text buffer and then
- *  uses memcpy to append the string *src to the end of *dest_line. The render
- *  buffer is then updated.
+ *  This is used for edits which change many chars in a line at once, such as
+ *  replacing every match in the line, so the line is only rendered and
+ *  highlighted once rather than after every char. The old and new text are
+ *  recorded as one undo step.
  *
  * ************************************************************************** */
 
 void
-line_add_string_to_text_buffer (EDITOR_LINE *dest_line, char *src, size_t append_len)
+line_set_text (EDITOR_BUFFER *buf, size_t idx, char *s, size_t len)
 {
-  /*
-   * Allocate more memory and shift lines to fit in the appended string
-   */
+  size_t old_len = buf->lines.len[idx];
+
+  undo_begin_group (buf);
+  line_record (buf, UNDO_DELETE, idx, 0, buf->lines.chars[idx], old_len);
+  line_record (buf, UNDO_INSERT, idx, 0, s, len);
+  undo_end_group (buf);
+
+  if (!(buf->lines.chars[idx] = realloc (buf->lines.chars[idx], len + 1)))
+    util_exit ("Couldn't allocate memory for a line");
+
+  memcpy (buf->lines.chars[idx], s, len);
+  buf->lines.chars[idx][len] = '\0';
+  buf->lines.len[idx] = len;
+  buf->lines.changed_gen[idx] = buf->lines.generation;
+  offset_update_line (buf, idx, old_len, len);
+  trigram_update_line (buf, idx);
+  buf->modified++;
+  editor_add_to_render_buffer (buf, idx);
+}
 
-  dest_line->chars = realloc (dest_line->chars, dest_line->len + append_len + 1);
-  memcpy (&dest_line->chars[dest_line->len], src, append_len);
-  dest_line->len += append_len;
-  dest_line->chars[dest_line->len] = '\0';
-  editor.modified++;
-  editor_add_to_render_buffer (dest_line);
+/** **************************************************************************
+ *
+ *  @brief              Cut a line short
+ *
+ *  @param[in,out]      *buf        The buffer
+ *  @param[in]          idx         The index of the line to truncate
+ *  @param[in]          new_len     The new length of the line
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Removes every char from new_len onwards from the line.
+ *
+ * ************************************************************************** */
+
+void
+line_truncate (EDITOR_BUFFER *buf, size_t idx, size_t new_len)
+{
+  size_t len = buf->lines.len[idx];
+
+  if (new_len >= len)
+    return;
+
+  line_delete_text (buf, idx, new_len, len - new_len);
 }
 
 /** **************************************************************************
  *
  *  @brief              Free the memory of a line
  *
- *  @param[in]          *line      The line to free from memory
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          idx       The index of the line to free from memory
  *
  *  @return             void
  *
@@ -204,48 +663,128 @@ line_add_string_to_text_buffer (EDITOR_LINE *dest_line, char *src, size_t append
  * ************************************************************************** */
 
 void
-util_free_line (EDITOR_LINE *line)
+util_free_line (EDITOR_BUFFER *buf, size_t idx)
 {
-  free (line->chars);
-  free (line->render);
-  free (line->syn_hl);
+  free (buf->lines.chars[idx]);
+  free (buf->lines.render[idx]);
+  free (buf->lines.syn_hl[idx]);
 }
 
 /** **************************************************************************
  *
  *  @brief              Delete an entire line
  *
+ *  @param[in,out]      *buf     The buffer
  *  @param[in]          idx      The index number of the line to delete
  *
  *  @return             void
  *
  *  @details
  *
- *  The line is free'd from memory and then all subsequent lines are shifted by
- *  backwards in memory and their index's are updated.
- *
- *  TODO: memmove might not reallocate memory to be smaller
+ *  The line is deleted along with the new line before it, or after it for the
+ *  first line, using line_delete_text so it can be undone. The last line left
+ *  in the text buffer is emptied rather than removed, so there is always a
+ *  line for the undo log to put the text back into.
  *
  * ************************************************************************** */
 
 void
-line_delete_line (int idx)
+line_delete_line (EDITOR_BUFFER *buf, size_t idx)
 {
-  int i;
-
-  if (idx < 0 || idx > editor.nlines)
+  if (idx >= buf->nlines)
     return;
 
-  /*
-   * Freeing line idx and then shift the other lines
-   */
+  if (idx > 0)
+    line_delete_text (buf, idx - 1, buf->lines.len[idx - 1], buf->lines.len[idx] + 1);
+  else if (buf->nlines > 1)
+    line_delete_text (buf, 0, 0, buf->lines.len[0] + 1);
+  else
+    line_delete_text (buf, 0, 0, buf->lines.len[0]);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Make a buffer
+ *
+ *  @param[in]          *filename     The file the buffer is for, or NULL for
+ *                                    an empty buffer
+ *
+ *  @return             The buffer
+ *
+ *  @details
+ *
+ *  The buffer isn't in the list of open buffers, buffer_new adds it there.
+ *  The file isn't read and a buffer for a file is left BUFFER_UNLOADED.
+ *
+ * ************************************************************************** */
 
-  util_free_line (&editor.lines[idx]);
-  memmove (&editor.lines[idx], &editor.lines[idx + 1], sizeof (EDITOR_LINE) * (editor.nlines - idx - 1));
+EDITOR_BUFFER *
+buffer_create (char *filename)
+{
+  EDITOR_BUFFER *buf;
 
-  for (i = idx; i < editor.nlines - 1; i++)
-    editor.lines[idx].idx--;
+  if (!(buf = calloc (1, sizeof *buf)))
+    util_exit ("Couldn't allocate memory for a buffer");
 
-  editor.nlines--;
-  editor.modified++;
+  buf->search.current = NO_MATCH;
+  buf->undo.memory_cap = UNDO_MEMORY_CAP;
+  buf->journal.fd = -1;
+  buf->journal.last = NO_MATCH;
+  buf->swap.fd = -1;
+
+  if (filename && !(buf->filename = strdup (filename)))
+    util_exit ("Couldn't allocate memory for a file name");
+
+  buf->state = filename ? BUFFER_UNLOADED : BUFFER_LOADED;
+
+  return buf;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free everything belonging to a buffer
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          discard   Bool flag for deleting the journal and swap
+ *                                file of the buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This waits for the file to finish being read before freeing anything. The
+ *  buffer has to have been taken out of the list of open buffers already.
+ *
+ * ************************************************************************** */
+
+void
+buffer_destroy (EDITOR_BUFFER *buf, int discard)
+{
+  size_t i;
+
+  pool_wait (&buf->load);
+
+  for (i = 0; i < buf->nlines; i++)
+    util_free_line (buf, i);
+
+  free (buf->filename);
+  free (buf->lines.len);
+  free (buf->lines.r_len);
+  free (buf->lines.chars);
+  free (buf->lines.render);
+  free (buf->lines.syn_hl);
+  free (buf->lines.hl_open_comment);
+  free (buf->lines.trigram_id);
+  free (buf->lines.changed_gen);
+  free (buf->offsets.tree);
+  trigram_disable (buf);
+  undo_clear (buf);
+  journal_close (buf, discard);
+  swap_close (buf, discard);
+  find_clear_results (buf);
+
+  for (i = 0; i < buf->search.overlay.nrows; i++)
+    free (buf->search.overlay.rows[i].rx);
+  free (buf->search.overlay.rows);
+  free (buf);
 }
@@ -0,0 +1,210 @@
+/** **************************************************************************
+ *
+ * @file memory.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for counting the memory used by a text buffer.
+ *
+ * @details
+ *
+ * The memory is counted by walking the text buffer and asking glibc how big
+ * each allocation really is, rather than by keeping a count as things are
+ * allocated and freed, so the count can't drift from what's allocated. The
+ * heap glibc has handed out which isn't in any category is shown as other,
+ * which is where a leak would show up. With other C libraries, the size each
+ * allocation was asked for is counted instead and other isn't shown.
+ *
+ * ************************************************************************** */
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "kris.h"
+
+static const char *memory_names[MEMORY_NCATEGORIES] = {
+  "chars", "render", "syn_hl", "lines", "screen", "search", "undo",
+};
+
+/** **************************************************************************
+ *
+ *  @brief              Add an allocation to a category
+ *
+ *  @param[in,out]      *stats     The memory counted so far
+ *  @param[in]          category   The category the allocation is in
+ *  @param[in]          *ptr       The allocation, or NULL
+ *  @param[in]          size       The size the allocation was asked for
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  With glibc, each allocation is counted as the size glibc gave it plus the
+ *  size of the header glibc keeps in front of it, which is the cost of many
+ *  small allocations. Otherwise it is counted as the size asked for.
+ *
+ * ************************************************************************** */
+
+static void
+memory_add (MEMORY_STATS *stats, int category, void *ptr, size_t size)
+{
+  size_t bytes;
+
+  if (ptr == NULL)
+    return;
+
+#ifdef __GLIBC__
+  bytes = malloc_usable_size (ptr) + sizeof (size_t);
+  (void) size;
+#else
+  bytes = size;
+#endif
+  stats->bytes[category] += bytes;
+  stats->nobjects[category]++;
+  stats->total += bytes;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Count the memory used by the text buffer being edited
+ *
+ *  @param[out]         *stats     The memory used by each category
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The line arrays are the arrays of line metadata and the line offsets. The
+ *  screen is the frame of screen rows, which is shared by every buffer. The
+ *  file size is the number of chars plus a new line for each line.
+ *
+ * ************************************************************************** */
+
+void
+memory_count (MEMORY_STATS *stats)
+{
+  size_t i;
+  EDITOR_LINES *lines = &editor.buf->lines;
+  SEARCH_STATE *search = &editor.buf->search;
+  UNDO_LOG *undo = &editor.buf->undo;
+
+  memset (stats, 0, sizeof *stats);
+
+  for (i = 0; i < editor.buf->nlines; i++)
+  {
+    memory_add (stats, MEMORY_CHARS, lines->chars[i], lines->len[i] + 1);
+    memory_add (stats, MEMORY_RENDER, lines->render[i], lines->r_len[i] + 1);
+    memory_add (stats, MEMORY_SYN_HL, lines->syn_hl[i], lines->r_len[i]);
+    stats->file_size += lines->len[i] + 1;
+  }
+
+  memory_add (stats, MEMORY_LINE_ARRAYS, lines->len, lines->capacity * sizeof *lines->len);
+  memory_add (stats, MEMORY_LINE_ARRAYS, lines->r_len, lines->capacity * sizeof *lines->r_len);
+  memory_add (stats, MEMORY_LINE_ARRAYS, lines->chars, lines->capacity * sizeof *lines->chars);
+  memory_add (stats, MEMORY_LINE_ARRAYS, lines->render, lines->capacity * sizeof *lines->render);
+  memory_add (stats, MEMORY_LINE_ARRAYS, lines->syn_hl, lines->capacity * sizeof *lines->syn_hl);
+  memory_add (stats, MEMORY_LINE_ARRAYS, lines->hl_open_comment, lines->capacity * sizeof *lines->hl_open_comment);
+  memory_add (stats, MEMORY_LINE_ARRAYS, lines->trigram_id, lines->capacity * sizeof *lines->trigram_id);
+  memory_add (stats, MEMORY_LINE_ARRAYS, lines->changed_gen, lines->capacity * sizeof *lines->changed_gen);
+  memory_add (stats, MEMORY_LINE_ARRAYS, editor.buf->offsets.tree,
+              editor.buf->offsets.capacity * sizeof *editor.buf->offsets.tree);
+
+  memory_add (stats, MEMORY_SCREEN, editor.frame, (size_t) editor.frame_rows * sizeof *editor.frame);
+  for (i = 0; editor.frame != NULL && i < (size_t) editor.frame_rows; i++)
+    memory_add (stats, MEMORY_SCREEN, editor.frame[i].buf, editor.frame[i].len);
+
+  memory_add (stats, MEMORY_SEARCH, search->results, search->capacity * sizeof *search->results);
+  for (i = 0; i < search->nresults; i++)
+  {
+    memory_add (stats, MEMORY_SEARCH, search->results[i].query, strlen (search->results[i].query) + 1);
+    memory_add (stats, MEMORY_SEARCH, search->results[i].matches,
+                search->results[i].nmatches * sizeof *search->results[i].matches);
+  }
+  memory_add (stats, MEMORY_SEARCH, search->overlay.rows, search->overlay.nrows * sizeof *search->overlay.rows);
+  for (i = 0; i < search->overlay.nrows; i++)
+    memory_add (stats, MEMORY_SEARCH, search->overlay.rows[i].rx,
+                2 * search->overlay.rows[i].capacity * sizeof *search->overlay.rows[i].rx);
+
+  memory_add (stats, MEMORY_UNDO, undo->ops, undo->capacity * sizeof *undo->ops);
+  for (i = 0; i < undo->nops; i++)
+    memory_add (stats, MEMORY_UNDO, undo->ops[i].text, undo->ops[i].capacity);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the memory used by the text buffer being edited
+ *                      into a string
+ *
+ *  @param[in]          *category  The name of a category, or an empty string
+ *                                 for every category
+ *  @param[out]         *buf       The string to write to
+ *  @param[in]          buf_size   The size of buf
+ *
+ *  @return             SUCCESS, or FAILURE if there is no such category
+ *
+ *  @details
+ *
+ *  Every category is shown in MB, with the total as a ratio of the file size,
+ *  and with glibc the rest of the heap is shown as other.
+ *  A single category is shown with its number of allocations, the average
+ *  size of an allocation and its ratio of the file size.
+ *
+ * ************************************************************************** */
+
+int
+memory_stats (char *category, char *buf, size_t buf_size)
+{
+  int i;
+  int len;
+  double ratio;
+  char nobjects[32];
+  MEMORY_STATS stats;
+#ifdef __GLIBC__
+  size_t heap;
+  struct mallinfo2 info;
+#endif
+
+  memory_count (&stats);
+
+  if (category[0] != '\0')
+  {
+    for (i = 0; i < MEMORY_NCATEGORIES; i++)
+      if (!strcmp (category, memory_names[i]))
+        break;
+
+    if (i == MEMORY_NCATEGORIES)
+      return FAILURE;
+
+    util_format_count (nobjects, sizeof nobjects, stats.nobjects[i]);
+    ratio = stats.file_size ? (double) stats.bytes[i] / stats.file_size : 0;
+    snprintf (buf, buf_size, "Memory: %s %.1f MB in %s allocations, %.0f bytes each, %.2fx the file", memory_names[i],
+              (double) stats.bytes[i] / (1 << 20), nobjects,
+              stats.nobjects[i] ? (double) stats.bytes[i] / stats.nobjects[i] : 0, ratio);
+
+    return SUCCESS;
+  }
+
+  ratio = stats.file_size ? (double) stats.total / stats.file_size : 0;
+
+  len = snprintf (buf, buf_size, "Memory: %.1f MB, %.2fx the %.1f MB file |", (double) stats.total / (1 << 20), ratio,
+                  (double) stats.file_size / (1 << 20));
+  for (i = 0; i < MEMORY_NCATEGORIES && len >= 0 && (size_t) len < buf_size; i++)
+    len += snprintf (&buf[len], buf_size - (size_t) len, " %s %.1f", memory_names[i],
+                     (double) stats.bytes[i] / (1 << 20));
+
+#ifdef __GLIBC__
+  info = mallinfo2 ();
+  heap = info.uordblks + info.hblkhd;
+  if (len >= 0 && (size_t) len < buf_size)
+    snprintf (&buf[len], buf_size - (size_t) len, " | other %.1f",
+              (double) (heap > stats.total ? heap - stats.total : 0) / (1 << 20));
+#endif
+
+  return SUCCESS;
+}
@@ -0,0 +1,214 @@
+/** **************************************************************************
+ *
+ * @file offset.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for converting between line numbers and byte offsets.
+ *
+ * ************************************************************************** */
+
+#include <stdlib.h>
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Mark the byte offset index as out of date
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  When a line is inserted or deleted, every line after it changes position
+ *  in the index. This is no cheaper than rebuilding the index, so it is simply
+ *  marked as stale and is rebuilt the next time it is queried.
+ *
+ * ************************************************************************** */
+
+void
+offset_invalidate (EDITOR_BUFFER *buf)
+{
+  buf->offsets.stale = TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Rebuild the byte offset index from the line lengths
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The index is a Fenwick tree over the length of each line, including the
+ *  new line character which is written at the end of each line. The tree is
+ *  built in place in O(n) by pushing each node's partial sum up to its parent.
+ *
+ * ************************************************************************** */
+
+static void
+offset_rebuild (EDITOR_BUFFER *buf)
+{
+  size_t i;
+  size_t parent;
+  LINE_OFFSETS *offsets = &buf->offsets;
+
+  if (offsets->capacity < buf->nlines + 1)
+  {
+    offsets->capacity = buf->lines.capacity + 1;
+    if (!(offsets->tree = realloc (offsets->tree, offsets->capacity * sizeof (*offsets->tree))))
+      util_exit ("Couldn't allocate memory for the byte offset index");
+  }
+
+  offsets->tree[0] = 0;
+  for (i = 1; i <= buf->nlines; i++)
+    offsets->tree[i] = buf->lines.len[i - 1] + 1;
+
+  for (i = 1; i <= buf->nlines; i++)
+  {
+    parent = i + (i & -i);
+    if (parent <= buf->nlines)
+      offsets->tree[parent] += offsets->tree[i];
+  }
+
+  offsets->size = buf->nlines;
+  offsets->stale = FALSE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the index after the length of a line changes
+ *
+ *  @param[in,out]      *buf       The buffer
+ *  @param[in]          idx        The index of the line which has changed
+ *  @param[in]          old_len    The previous length of the line
+ *  @param[in]          new_len    The new length of the line
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Adds the change in line length to each node of the Fenwick tree covering
+ *  the line, which is O(log n). The difference is added using unsigned
+ *  arithmetic, which wraps around correctly when the line has got shorter.
+ *
+ * ************************************************************************** */
+
+void
+offset_update_line (EDITOR_BUFFER *buf, size_t idx, size_t old_len, size_t new_len)
+{
+  size_t i;
+  LINE_OFFSETS *offsets = &buf->offsets;
+
+  if (offsets->stale || idx >= offsets->size)
+    return;
+
+  for (i = idx + 1; i <= offsets->size; i += i & -i)
+    offsets->tree[i] += new_len - old_len;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the byte offset of the start of a line
+ *
+ *  @param[in,out]      *buf       The buffer
+ *  @param[in]          idx        The index of the line
+ *
+ *  @return             The byte offset of the first char of the line
+ *
+ *  @details
+ *
+ *  Sums the lengths of all of the lines before idx using the Fenwick tree. If
+ *  idx is the number of lines, then the size of the entire text buffer is
+ *  returned.
+ *
+ * ************************************************************************** */
+
+size_t
+offset_line_to_byte (EDITOR_BUFFER *buf, size_t idx)
+{
+  size_t i;
+  size_t offset;
+
+  if (buf->offsets.stale || buf->offsets.size != buf->nlines)
+    offset_rebuild (buf);
+
+  if (idx > buf->nlines)
+    idx = buf->nlines;
+
+  offset = 0;
+  for (i = idx; i > 0; i -= i & -i)
+    offset += buf->offsets.tree[i];
+
+  return offset;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the line and column for a byte offset
+ *
+ *  @param[in,out]      *buf       The buffer
+ *  @param[in]          offset     The byte offset into the text buffer
+ *  @param[out]         *col       The column of the byte offset in the line
+ *
+ *  @return             The index of the line containing the byte offset
+ *
+ *  @details
+ *
+ *  Walks down the Fenwick tree to find the last line which starts at or before
+ *  offset. An offset which points at the new line character at the end of a
+ *  line gives a column one past the last char, and an offset past the end of
+ *  the text buffer is clamped to the end of the last line.
+ *
+ * ************************************************************************** */
+
+size_t
+offset_byte_to_line (EDITOR_BUFFER *buf, size_t offset, size_t *col)
+{
+  size_t idx;
+  size_t step;
+
+  if (buf->offsets.stale || buf->offsets.size != buf->nlines)
+    offset_rebuild (buf);
+
+  if (buf->nlines == 0)
+  {
+    *col = 0;
+    return 0;
+  }
+
+  step = 1;
+  while (step <= buf->nlines / 2)
+    step *= 2;
+
+  idx = 0;
+  for (; step > 0; step /= 2)
+  {
+    if (idx + step <= buf->nlines && buf->offsets.tree[idx + step] <= offset)
+    {
+      idx += step;
+      offset -= buf->offsets.tree[idx];
+    }
+  }
+
+  /*
+   * idx is now the number of lines which end before offset, so the offset
+   * is in line idx unless it is past the end of the text buffer
+   */
+
+  if (idx == buf->nlines)
+  {
+    idx = buf->nlines - 1;
+    offset = buf->lines.len[idx];
+  }
+
+  *col = offset > buf->lines.len[idx] ? buf->lines.len[idx] : offset;
+
+  return idx;
+}
@@ -0,0 +1,289 @@
+/** **************************************************************************
+ *
+ * @file pool.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief A pool of worker threads for running jobs in parallel.
+ *
+ * ************************************************************************** */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "kris.h"
+
+typedef struct POOL_JOB
+{
+  POOL_FUNC func;                  // The function to run
+  void *arg;                       // The argument to pass to func
+  POOL_GROUP *group;               // The group the job belongs to
+  struct POOL_JOB *next;           // The next job in the queue
+} POOL_JOB;
+
+static struct
+{
+  pthread_mutex_t lock;            // Protects everything in the pool
+  pthread_cond_t work;             // Signalled when a job is queued
+  pthread_cond_t done;             // Signalled when a job finishes
+  POOL_JOB *head;                  // The front of the job queue
+  POOL_JOB *tail;                  // The back of the job queue
+  size_t nthreads;                 // The number of worker threads
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/** **************************************************************************
+ *
+ *  @brief              Run a job and mark it as finished in its group
+ *
+ *  @param[in]          *job     The job to run, which is free'd
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The pool lock must not be held when this is called.
+ *
+ * ************************************************************************** */
+
+static void
+pool_run_job (POOL_JOB *job)
+{
+  POOL_GROUP *group = job->group;
+
+  job->func (job->arg);
+  free (job);
+
+  pthread_mutex_lock (&pool.lock);
+  group->pending--;
+  pthread_cond_broadcast (&pool.done);
+  pthread_mutex_unlock (&pool.lock);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              The main loop for a worker thread
+ *
+ *  @param[in]          *unused    Required by pthread_create
+ *
+ *  @return             NULL, but this never returns
+ *
+ *  @details
+ *
+ *  Waits for a job to be queued, takes it off of the front of the queue and
+ *  runs it, forever.
+ *
+ * ************************************************************************** */
+
+static void *
+pool_worker (void *unused)
+{
+  POOL_JOB *job;
+
+  (void) unused;
+
+  while (TRUE)
+  {
+    pthread_mutex_lock (&pool.lock);
+    while (pool.head == NULL)
+      pthread_cond_wait (&pool.work, &pool.lock);
+
+    job = pool.head;
+    pool.head = job->next;
+    if (pool.head == NULL)
+      pool.tail = NULL;
+    pthread_mutex_unlock (&pool.lock);
+
+    pool_run_job (job);
+  }
+
+  return NULL;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start the worker threads
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  One worker is started for each online CPU. The threads are detached, as
+ *  they live until the editor exits. This is only ever run once, the first
+ *  time a job is submitted.
+ *
+ * ************************************************************************** */
+
+static void
+pool_start (void)
+{
+  long ncpus;
+  size_t i;
+  pthread_t thread;
+
+  ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+  if (ncpus < 1)
+    ncpus = 1;
+  if (ncpus > POOL_MAX_THREADS)
+    ncpus = POOL_MAX_THREADS;
+
+  for (i = 0; i < (size_t) ncpus; i++)
+  {
+    if (pthread_create (&thread, NULL, pool_worker, NULL) != 0)
+      break;
+    pthread_detach (thread);
+    pool.nthreads++;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the number of worker threads in the pool
+ *
+ *  @return             The number of worker threads
+ *
+ *  @details
+ *
+ *  This is used to decide how many pieces to split work into.
+ *
+ * ************************************************************************** */
+
+size_t
+pool_size (void)
+{
+  pthread_once (&pool_once, pool_start);
+  return pool.nthreads ? pool.nthreads : 1;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Queue a job to be run by a worker thread
+ *
+ *  @param[in,out]      *group    The group to add the job to
+ *  @param[in]          func      The function to run
+ *  @param[in]          *arg      The argument to pass to func
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The job is added to the back of the queue and will be run by the next free
+ *  worker. pool_wait or pool_group_done can be used with group to find out
+ *  when all of the jobs in the group have finished. If there are no worker
+ *  threads, the job is run straight away.
+ *
+ * ************************************************************************** */
+
+void
+pool_submit (POOL_GROUP *group, POOL_FUNC func, void *arg)
+{
+  POOL_JOB *job;
+
+  pthread_once (&pool_once, pool_start);
+
+  if (!(job = malloc (sizeof (*job))))
+    util_exit ("Couldn't allocate memory for a worker job");
+
+  job->func = func;
+  job->arg = arg;
+  job->group = group;
+  job->next = NULL;
+
+  pthread_mutex_lock (&pool.lock);
+  group->pending++;
+
+  if (pool.nthreads == 0)
+  {
+    pthread_mutex_unlock (&pool.lock);
+    pool_run_job (job);
+    return;
+  }
+
+  if (pool.tail)
+    pool.tail->next = job;
+  else
+    pool.head = job;
+  pool.tail = job;
+
+  pthread_cond_signal (&pool.work);
+  pthread_mutex_unlock (&pool.lock);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Check if all of the jobs in a group have finished
+ *
+ *  @param[in]          *group    The group to check
+ *
+ *  @return             TRUE if every job has finished, otherwise FALSE
+ *
+ * ************************************************************************** */
+
+int
+pool_group_done (POOL_GROUP *group)
+{
+  int done;
+
+  pthread_mutex_lock (&pool.lock);
+  done = group->pending == 0;
+  pthread_mutex_unlock (&pool.lock);
+
+  return done;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Wait for all of the jobs in a group to finish
+ *
+ *  @param[in]          *group    The group to wait for
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Rather than sleeping while jobs from the group are still queued, the
+ *  calling thread takes them off of the queue and runs them itself. This way,
+ *  the group always finishes even if every worker is busy with long running
+ *  jobs from another group.
+ *
+ * ************************************************************************** */
+
+void
+pool_wait (POOL_GROUP *group)
+{
+  POOL_JOB *job;
+  POOL_JOB *prev;
+
+  pthread_mutex_lock (&pool.lock);
+
+  while (group->pending)
+  {
+    prev = NULL;
+    for (job = pool.head; job && job->group != group; job = job->next)
+      prev = job;
+
+    if (job)
+    {
+      if (prev)
+        prev->next = job->next;
+      else
+        pool.head = job->next;
+      if (pool.tail == job)
+        pool.tail = prev;
+
+      pthread_mutex_unlock (&pool.lock);
+      pool_run_job (job);
+      pthread_mutex_lock (&pool.lock);
+    }
+    else
+    {
+      pthread_cond_wait (&pool.done, &pool.lock);
+    }
+  }
+
+  pthread_mutex_unlock (&pool.lock);
+}
@@ -0,0 +1,487 @@
+/** **************************************************************************
+ *
+ * @file prompt.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions which prompt the user in the status bar, i.e. to search,
+ *        save a file under a new name or recover unsaved edits.
+ *
+ * ************************************************************************** */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Display a prompt in the status bar, and input text
+ *
+ *  @param[in]          *prompt_msg    The prompt message to display in the
+ *                                     status bar
+ *  @param[in]          *callback (char *, int)   A function pointer for a function
+ *                                                to recursively call until something
+ *                                                causes it to exit
+ *
+ *  @return             char *buf      Returns whatever is usually returned by
+ *                                     the callback function as a string
+ *
+ *  @details
+ *
+ *  This function will continuously iterate adding characters to the status
+ *  message buff and call to the callback function with this buff. This will
+ *  generally update the status bar and this function acts as a sort of prompt
+ *  for when searching for substrings or inputting file names for saving the
+ *  text buffer.
+ *
+ * ************************************************************************** */
+
+char *
+io_status_bar_prompt (char *prompt_msg, void (*callback) (char *, int))
+{
+  int c;
+  char *buf;
+  size_t buf_len;
+  size_t buf_size;
+
+  buf_len = 0;
+  buf_size = 128;
+  buf = malloc (buf_size);
+  buf[0] = '\0';
+
+  while (TRUE)
+  {
+    editor_set_status_message (prompt_msg, buf);
+    editor_refresh_screen ();
+
+    c = kp_read_keypress ();
+
+    /*
+     * Allow user to delete in the status prompt
+     */
+
+    if (c == DEL_KEY || c == CTRL_KEY ('h') || c == BACK_SPACE)
+    {
+      if (buf_len != 0)
+        buf[--buf_len] = '\0';
+    }
+
+    /*
+     * Cancel and return if escape is pressed
+     */
+
+    else if (c == '\x1b')
+    {
+      editor_set_status_message ("");
+      if (callback) callback (buf, c);
+      free (buf);
+      return NULL;
+    }
+
+    /*
+     * Return buf if enter is pressed
+     */
+
+    else if (c == '\r')
+    {
+      if (buf_len != 0)
+      {
+        editor_set_status_message ("");
+        if (callback) callback (buf, c);
+        return buf;
+      }
+    }
+
+    /*
+     * If not a control sequence add chars to buf
+     */
+
+    else if (!iscntrl (c) && c < 128)
+    {
+      if (buf_len == buf_size - 1)
+      {
+        buf_size *= 2;
+        buf = realloc (buf, buf_size);
+      }
+
+      buf[buf_len++] = (char) c;
+      buf[buf_len] = '\0';
+    }
+
+    if (callback) callback (buf, c);
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Search the buffer being edited after each key press in
+ *                      the search prompt
+ *
+ *  @param[in]          *query   The query string typed into the prompt
+ *  @param[in]          key      The key which was just pressed in the prompt
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+find_prompt_key (char *query, int key)
+{
+  find_keyword_search (editor.buf, query, key);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              The main find control function for finding a string
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is the main control function of the string searching feature. The status
+ *  bar is updated using io_status_bar_prompt and find_prompt_key is used
+ *  to call this function recursively until the users wants to exit the
+ *  search feature.
+ *
+ * ************************************************************************** */
+
+void
+find (void)
+{
+  size_t saved_cx;
+  size_t saved_cy;
+  size_t saved_col_offset;
+  size_t saved_row_offset;
+
+  char *query;
+
+  /*
+   * Save the original position of the cursor and text buffer before search
+   */
+
+  saved_cx = editor.buf->cx;
+  saved_cy = editor.buf->cy;
+  saved_col_offset = editor.buf->col_offset;
+  saved_row_offset = editor.buf->row_offset;
+
+  /*
+   * Set status bar prompt and call to keyword search function
+   */
+
+  editor.buf->search.active = TRUE;
+  editor.buf->search.current = NO_MATCH;
+  editor.buf->search.error = NULL;
+  editor.buf->search.origin_x = saved_cx;
+  editor.buf->search.origin_y = saved_cy;
+
+  query = io_status_bar_prompt ("Search: %s (ESC | Arrows | Ctrl-R regex | Ctrl-K case | Ctrl-W word)", find_prompt_key);
+  editor.buf->search.active = FALSE;
+
+  if (query)
+  {
+    free (query);
+  }
+
+  /*
+   * Restore original cursor position upon escape exit of find
+   */
+
+  else
+  {
+    editor.buf->cx = saved_cx;
+    editor.buf->cy = saved_cy;
+    editor.buf->col_offset = saved_col_offset;
+    editor.buf->row_offset = saved_row_offset;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Replace every match of a query in the text buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The query is typed into the same prompt as find, so the matches are
+ *  highlighted as it is typed and the same keys toggle the search modes. The
+ *  replacement is then prompted for, and every match is replaced by
+ *  find_replace_all.
+ *
+ * ************************************************************************** */
+
+void
+find_replace (void)
+{
+  size_t saved_cx;
+  size_t saved_cy;
+  size_t saved_col_offset;
+  size_t saved_row_offset;
+  size_t nlines;
+  size_t nreplaced;
+
+  char *query;
+  char *with;
+  char *error;
+  char count[32];
+  char line_count[32];
+
+  saved_cx = editor.buf->cx;
+  saved_cy = editor.buf->cy;
+  saved_col_offset = editor.buf->col_offset;
+  saved_row_offset = editor.buf->row_offset;
+
+  editor.buf->search.active = TRUE;
+  editor.buf->search.current = NO_MATCH;
+  editor.buf->search.error = NULL;
+  editor.buf->search.origin_x = saved_cx;
+  editor.buf->search.origin_y = saved_cy;
+
+  query = io_status_bar_prompt ("Replace: %s (ESC | Ctrl-R regex | Ctrl-K case | Ctrl-W word)", find_prompt_key);
+  editor.buf->search.active = FALSE;
+
+  editor.buf->cx = saved_cx;
+  editor.buf->cy = saved_cy;
+  editor.buf->col_offset = saved_col_offset;
+  editor.buf->row_offset = saved_row_offset;
+
+  if (query == NULL)
+    return;
+
+  if ((with = io_status_bar_prompt ("With: %s (ESC to cancel)", NULL)) == NULL)
+  {
+    free (query);
+    return;
+  }
+
+  if ((nreplaced = find_replace_all (editor.buf, query, with, &nlines, &error)) == NO_MATCH)
+  {
+    editor_set_status_message ("Invalid regex: %s", error);
+    free (query);
+    free (with);
+    return;
+  }
+
+  util_format_count (count, sizeof count, nreplaced);
+  util_format_count (line_count, sizeof line_count, nlines);
+  editor_set_status_message ("Replaced %s matches on %s lines", count, line_count);
+
+  free (query);
+  free (with);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Prompt for a line, byte offset or percentage and move
+ *                      the cursor there
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The input is interpreted as,
+ *    - 60%         a percentage of the way through the file, in bytes
+ *    - @73418112   a byte offset into the file, 0x prefixed hex also works
+ *    - 1024        a line number, starting from 1
+ *  Commas and underscores are ignored so numbers can be pasted straight from
+ *  a log or error message.
+ *
+ * ************************************************************************** */
+
+void
+offset_goto (void)
+{
+  size_t i;
+  size_t j;
+  size_t col;
+  size_t len;
+  size_t line;
+  size_t offset;
+
+  double percent;
+
+  char *end;
+  char *input;
+
+  if ((input = io_status_bar_prompt ("Go to: %s (line | N% | @offset)", NULL)) == NULL)
+    return;
+
+  /*
+   * Strip out white space and digit separators
+   */
+
+  for (i = j = 0; input[i]; i++)
+  {
+    if (input[i] != ',' && input[i] != '_' && !isspace ((unsigned char) input[i]))
+      input[j++] = input[i];
+  }
+  input[j] = '\0';
+  len = j;
+
+  if (len == 0 || editor.buf->nlines == 0)
+  {
+    free (input);
+    return;
+  }
+
+  /*
+   * Figure out the line and column to go to from the input
+   */
+
+  if (input[len - 1] == '%')
+  {
+    percent = strtod (input, &end);
+    if (end != &input[len - 1] || percent < 0 || percent > 100)
+    {
+      editor_set_status_message ("Invalid percentage: %s", input);
+      free (input);
+      return;
+    }
+    offset = (size_t) ((double) offset_line_to_byte (editor.buf, editor.buf->nlines) * percent / 100.0);
+    line = offset_byte_to_line (editor.buf, offset, &col);
+  }
+  else if (input[0] == '@' || !strncmp (input, "0x", 2))
+  {
+    offset = strtoull (input[0] == '@' ? &input[1] : input, &end, 0);
+    if (*end != '\0')
+    {
+      editor_set_status_message ("Invalid byte offset: %s", input);
+      free (input);
+      return;
+    }
+    line = offset_byte_to_line (editor.buf, offset, &col);
+  }
+  else
+  {
+    line = strtoull (input, &end, 10);
+    if (*end != '\0' || line == 0)
+    {
+      editor_set_status_message ("Invalid line number: %s", input);
+      free (input);
+      return;
+    }
+    line = line > editor.buf->nlines ? editor.buf->nlines - 1 : line - 1;
+    col = 0;
+  }
+
+  editor.buf->cy = line;
+  editor.buf->cx = col;
+
+  free (input);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Save the current text buffer to file
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ *  @details
+ *
+ *  This function prompts the user for a filename if the buffer doesn't have
+ *  one yet, and sets the syntax highlighting appropriately. The buffer is then
+ *  written by io_write_file. If for some reason it cannot be written to file,
+ *  then the user is told but the editor does not exit.
+ *
+ * ************************************************************************** */
+
+int
+io_save_file (void)
+{
+  size_t buf_len;
+
+  /*
+   * Prompt for filename and set syntax highlighting
+   */
+
+  if (editor.buf->filename == NULL)
+  {
+    editor.buf->filename = io_status_bar_prompt ("Save as: %s", NULL);
+    if (editor.buf->filename == NULL)
+    {
+      editor_set_status_message ("Save aborted");
+      return FAILURE;
+    }
+
+    syntax_select_highlighting (editor.buf);
+  }
+
+  if (io_write_file (editor.buf, &buf_len) == FAILURE)
+  {
+    editor_set_status_message ("Can't save file. I/O error: %s", strerror (errno));
+    return FAILURE;
+  }
+
+  editor_set_status_message ("%zu bytes written to disk", buf_len);
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Ask whether to recover the unsaved edits in an old
+ *                      journal
+ *
+ *  @param[in]          *filename    The file the journal is for
+ *  @param[in]          changed      Bool flag for the file having changed
+ *                                   since the journal was written
+ *
+ *  @return             TRUE to replay the journal, FALSE to discard it
+ *
+ * ************************************************************************** */
+
+int
+journal_prompt (char *filename, int changed)
+{
+  int recover;
+  char *answer;
+  char prompt[256];
+
+  snprintf (prompt, sizeof prompt, "Found unsaved edits to %s%s. Recover them? (y/n): %%s", filename,
+            changed ? ", but the file has changed since" : "");
+
+  answer = io_status_bar_prompt (prompt, NULL);
+  if (!(recover = answer && (answer[0] == 'y' || answer[0] == 'Y')))
+    editor_set_status_message ("Unsaved edits discarded");
+
+  free (answer);
+
+  return recover;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Ask whether to restore an old swap file
+ *
+ *  @param[in]          *filename    The file the swap file is for
+ *  @param[in]          changed      Bool flag for the file having changed
+ *                                   since the swap file was written
+ *
+ *  @return             TRUE to restore the swap file, FALSE to discard it
+ *
+ * ************************************************************************** */
+
+int
+swap_prompt (char *filename, int changed)
+{
+  int restore;
+  char *answer;
+  char prompt[256];
+
+  snprintf (prompt, sizeof prompt, "Found an autosave of %s%s. Restore it? (y/n): %%s", filename,
+            changed ? ", but the file has changed since" : "");
+
+  answer = io_status_bar_prompt (prompt, NULL);
+  if (!(restore = answer && (answer[0] == 'y' || answer[0] == 'Y')))
+    editor_set_status_message ("Autosave discarded");
+
+  free (answer);
+
+  return restore;
+}
@@ -0,0 +1,154 @@
+/** **************************************************************************
+ *
+ * @file record.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for recording keystrokes to a trace file, which can be
+ *        replayed by kris_replay to measure latency.
+ *
+ * @details
+ *
+ * The trace is a text file. The first line gives the size of the terminal,
+ * and every line after is one key as the number of microseconds since the
+ * recording started, then the bytes of the key in hex,
+ *
+ *    # kris trace 24 80
+ *    1520339 6a
+ *    1712004 1b5b41
+ *
+ * ************************************************************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "kris.h"
+
+static struct
+{
+  FILE *file;                      // The trace being written, or NULL
+  double start;                    // When the recording started
+  double key_time;                 // When the first byte of the key was read
+  char key[8];                     // The bytes of the key being read
+  size_t key_len;                  // Number of bytes in key
+} record = {NULL, 0, 0, {0}, 0};
+
+/** **************************************************************************
+ *
+ *  @brief              Get the time from a monotonic clock
+ *
+ *  @return             The time in seconds
+ *
+ * ************************************************************************** */
+
+static double
+record_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Stop recording and close the trace
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+record_close (void)
+{
+  if (record.file == NULL)
+    return;
+
+  fclose (record.file);
+  record.file = NULL;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start recording keystrokes to a trace
+ *
+ *  @param[in]          *path     The file to write the trace to
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ *  @details
+ *
+ *  The terminal size is written first, so the trace can be replayed on a
+ *  terminal of the same size. The trace is closed at exit.
+ *
+ * ************************************************************************** */
+
+int
+record_open (char *path)
+{
+  if (!(record.file = fopen (path, "w")))
+    return FAILURE;
+
+  fprintf (record.file, "# kris trace %d %d\n", editor.screen_rows + 2, editor.screen_cols);
+  record.start = record_now ();
+  atexit (record_close);
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add a byte read from the terminal to the key being
+ *                      read
+ *
+ *  @param[in]          c     The byte read
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+record_byte (char c)
+{
+  if (record.file == NULL || record.key_len == sizeof record.key)
+    return;
+
+  if (record.key_len == 0)
+    record.key_time = record_now ();
+
+  record.key[record.key_len++] = c;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the key which has been read to the trace
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The trace is flushed after every key, so a session which ends in a crash
+ *  can still be replayed up to the crash.
+ *
+ * ************************************************************************** */
+
+void
+record_key (void)
+{
+  size_t i;
+
+  if (record.file == NULL || record.key_len == 0)
+    return;
+
+  fprintf (record.file, "%.0f ", (record.key_time - record.start) * 1e6);
+  for (i = 0; i < record.key_len; i++)
+    fprintf (record.file, "%02x", (unsigned char) record.key[i]);
+  fputc ('\n', record.file);
+  fflush (record.file);
+
+  record.key_len = 0;
+}
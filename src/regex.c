@@ -0,0 +1,1584 @@
+/** **************************************************************************
+ *
+ * @file regex.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief A regular expression engine which never backtracks.
+ *
+ * ************************************************************************** */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+/*
+ * The regex is parsed into a tree of nodes, which is then compiled into two
+ * Thompson NFA programs: one for the regex and one for the regex reversed.
+ * The programs are run as DFAs which are built lazily, a state at a time, as
+ * they are needed. Each state is a set of NFA instructions, so a DFA step is a
+ * single table lookup once the transition has been seen before.
+ *
+ * Finding every match in a line runs the forward DFA from each place a match
+ * starts, which can scan to the end of the line each time. Once a line has
+ * been scanned too many times over, the ends of the matches are all found in
+ * one pass of the reversed program instead, so a line is always searched in
+ * linear time.
+ */
+
+enum regex_node_type
+{
+  NODE_CLASS,
+  NODE_EMPTY,
+  NODE_CONCAT,
+  NODE_ALT,
+  NODE_STAR,
+  NODE_PLUS,
+  NODE_QUEST
+};
+
+enum regex_op
+{
+  OP_CLASS,
+  OP_SPLIT,
+  OP_JMP,
+  OP_MATCH
+};
+
+typedef struct REGEX_NODE
+{
+  int type;                        // The type of node
+  size_t cls;                      // The char class for NODE_CLASS
+  struct REGEX_NODE *left;         // The first child
+  struct REGEX_NODE *right;        // The second child for CONCAT and ALT
+} REGEX_NODE;
+
+typedef struct REGEX_INST
+{
+  int op;                          // The instruction type
+  size_t arg;                      // The char class, or jump target
+  size_t arg2;                     // The second target of a split
+} REGEX_INST;
+
+typedef struct REGEX_PROG
+{
+  REGEX_INST *inst;                // The instructions
+  size_t ninst;                    // The number of instructions
+} REGEX_PROG;
+
+typedef struct REGEX_THREAD
+{
+  size_t pc;                       // The instruction the thread is at
+  size_t origin;                   // Where the thread started
+} REGEX_THREAD;
+
+typedef struct DFA_STATE
+{
+  size_t pcs;                      // Offset of the state's NFA set in the pool
+  size_t npcs;                     // The number of NFA instructions in the set
+  int match;                       // Bool flag for a matching state
+  int next[256];                   // The next state for each byte, or -1
+} DFA_STATE;
+
+typedef struct REGEX_DFA
+{
+  REGEX *re;                       // The regex the DFA belongs to
+  REGEX_PROG *prog;                // The program the DFA runs
+  int unanchored;                  // Bool flag to restart the program each step
+  DFA_STATE *states;               // The states built so far
+  size_t nstates, capacity;        // Number of states used and allocated
+  size_t *pool;                    // The NFA sets for every state
+  size_t npool, pool_capacity;     // Size of the NFA set pool
+  int *table;                      // Hash table of states by NFA set
+  size_t table_size;               // Number of hash table slots
+  size_t memory;                   // Approximate memory used by the DFA
+  size_t *stack;                   // Scratch space for computing new states
+  size_t *set;                     // Scratch space for computing new states
+  size_t *from;                    // Scratch space for computing new states
+  size_t *seen;                    // Generation each instruction was last seen
+  size_t generation;               // The current generation for seen
+} REGEX_DFA;
+
+struct REGEX
+{
+  unsigned char (*classes)[32];    // Bit sets of each char class
+  size_t nclasses;                 // The number of char classes
+  REGEX_NODE *nodes;               // The parse tree node pool
+  size_t nnodes, max_nodes;        // Number of nodes used and allocated
+  REGEX_PROG forward;              // The program for the regex
+  REGEX_PROG reverse;              // The program for the reversed regex
+  REGEX_DFA *fwd_dfa;              // Anchored DFA for the longest match
+  REGEX_DFA *rev_dfa;              // DFA for finding where matches start
+  int anchor_start;                // Bool flag for a leading ^
+  int anchor_end;                  // Bool flag for a trailing $
+  int icase;                       // Bool flag for ignoring the case of letters
+  char *prefix;                    // A literal every match starts with
+  size_t prefix_len;               // The length of the literal prefix
+  SEARCH_PATTERN prefix_pattern;   // The literal prefix for the search kernel
+  unsigned char *starts;           // Bit set of where matches start in a line
+  size_t starts_size;              // The number of bytes allocated for starts
+  size_t starts_lo;                // No matches start before this position
+  size_t *ends;                    // The end of the longest match from each position
+  size_t ends_size;                // The number of ends allocated
+  int have_ends;                   // Bool flag for ends being found for the line
+  size_t scanned;                  // Bytes the forward DFA has scanned in the line
+  REGEX_THREAD *threads;           // Scratch space for finding the ends
+  size_t *stack;                   // Scratch space for finding the ends
+  size_t *seen;                    // Generation each instruction was last seen
+  size_t generation;               // The current generation for seen
+  char *pattern;                   // The pattern being parsed
+  size_t pos;                      // The parser's position in the pattern
+  size_t end;                      // The end of the pattern to parse
+  char *error;                     // A parse error, or NULL
+};
+
+#define DFA_UNKNOWN -1
+
+/* **************************************************************************
+ *
+ * Parsing
+ *
+ * ************************************************************************** */
+
+/** **************************************************************************
+ *
+ *  @brief              Allocate a new node in the parse tree
+ *
+ *  @param[in,out]      *re       The regex being parsed
+ *  @param[in]          type      The type of the node
+ *  @param[in]          *left     The first child of the node
+ *  @param[in]          *right    The second child of the node
+ *
+ *  @return             The new node
+ *
+ *  @details
+ *
+ *  The nodes come from a pool which is big enough for any tree the pattern can
+ *  produce, so pointers to nodes stay valid.
+ *
+ * ************************************************************************** */
+
+static REGEX_NODE *
+regex_new_node (REGEX *re, int type, REGEX_NODE *left, REGEX_NODE *right)
+{
+  REGEX_NODE *node = &re->nodes[re->nnodes++];
+
+  node->type = type;
+  node->cls = 0;
+  node->left = left;
+  node->right = right;
+
+  return node;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Create a new, empty, char class
+ *
+ *  @param[in,out]      *re       The regex being parsed
+ *
+ *  @return             The index of the new class
+ *
+ * ************************************************************************** */
+
+static size_t
+regex_new_class (REGEX *re)
+{
+  if (!(re->classes = realloc (re->classes, (re->nclasses + 1) * sizeof (*re->classes))))
+    util_exit ("Couldn't allocate memory for a regex");
+  memset (re->classes[re->nclasses], 0, sizeof (*re->classes));
+
+  return re->nclasses++;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add a byte to a char class
+ *
+ *  @param[in,out]      *re       The regex being parsed
+ *  @param[in]          cls       The class to add to
+ *  @param[in]          c         The byte to add
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+regex_class_add (REGEX *re, size_t cls, unsigned char c)
+{
+  re->classes[cls][c / 8] |= (unsigned char) (1 << (c % 8));
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add the other case of each letter in a char class
+ *
+ *  @param[in,out]      *re       The regex being parsed
+ *  @param[in]          cls       The class to fold
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This does nothing unless the regex ignores case. It must be done before a
+ *  class is negated, so [^a] excludes both a and A.
+ *
+ * ************************************************************************** */
+
+static void
+regex_class_fold (REGEX *re, size_t cls)
+{
+  int c;
+
+  if (!re->icase)
+    return;
+
+  for (c = 'a'; c <= 'z'; c++)
+  {
+    if (re->classes[cls][c / 8] & (1 << (c % 8)) || re->classes[cls][(c - 0x20) / 8] & (1 << ((c - 0x20) % 8)))
+    {
+      regex_class_add (re, cls, (unsigned char) c);
+      regex_class_add (re, cls, (unsigned char) (c - 0x20));
+    }
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add a shorthand class such as \d to a char class
+ *
+ *  @param[in,out]      *re       The regex being parsed
+ *  @param[in]          cls       The class to add to
+ *  @param[in]          c         The letter of the shorthand, i.e. d, w or s
+ *
+ *  @return             TRUE if c is a shorthand class, otherwise FALSE
+ *
+ *  @details
+ *
+ *  The upper case version of a shorthand is the complement of the lower case
+ *  version, i.e. \D is everything which isn't a digit.
+ *
+ * ************************************************************************** */
+
+static int
+regex_class_add_shorthand (REGEX *re, size_t cls, char c)
+{
+  int i;
+  int in;
+  int negate = (c == 'D' || c == 'W' || c == 'S');
+
+  if (!strchr ("dDwWsS", c) || c == '\0')
+    return FALSE;
+
+  for (i = 0; i < 256; i++)
+  {
+    switch (c)
+    {
+      case 'd':
+      case 'D':
+        in = (i >= '0' && i <= '9');
+        break;
+      case 'w':
+      case 'W':
+        in = (i >= '0' && i <= '9') || (i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') || i == '_';
+        break;
+      default:
+        in = (i == ' ' || i == '\t' || i == '\n' || i == '\r' || i == '\f' || i == '\v');
+        break;
+    }
+
+    if (in != negate)
+      re->classes[cls][i / 8] |= (unsigned char) (1 << (i % 8));
+  }
+
+  return TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Convert the char after a \ into the byte it stands for
+ *
+ *  @param[in]          c     The escaped char
+ *
+ *  @return             The byte
+ *
+ * ************************************************************************** */
+
+static unsigned char
+regex_escape (char c)
+{
+  switch (c)
+  {
+    case 't': return '\t';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    default: return (unsigned char) c;
+  }
+}
+
+static REGEX_NODE *regex_parse_alt (REGEX *re);
+
+/** **************************************************************************
+ *
+ *  @brief              Parse a bracketed char class, i.e. [a-z_]
+ *
+ *  @param[in,out]      *re       The regex being parsed, positioned after the [
+ *
+ *  @return             The class node, or NULL on error
+ *
+ * ************************************************************************** */
+
+static REGEX_NODE *
+regex_parse_class (REGEX *re)
+{
+  int i;
+  int negate;
+  size_t cls;
+  unsigned char lo;
+  unsigned char hi;
+  REGEX_NODE *node;
+
+  cls = regex_new_class (re);
+  negate = FALSE;
+
+  if (re->pos < re->end && re->pattern[re->pos] == '^')
+  {
+    negate = TRUE;
+    re->pos++;
+  }
+
+  /*
+   * A ] straight after the [ or [^ is a literal ]
+   */
+
+  if (re->pos < re->end && re->pattern[re->pos] == ']')
+  {
+    regex_class_add (re, cls, ']');
+    re->pos++;
+  }
+
+  while (re->pos < re->end && re->pattern[re->pos] != ']')
+  {
+    lo = (unsigned char) re->pattern[re->pos++];
+
+    if (lo == '\\' && re->pos < re->end)
+    {
+      if (regex_class_add_shorthand (re, cls, re->pattern[re->pos]))
+      {
+        re->pos++;
+        continue;
+      }
+      lo = regex_escape (re->pattern[re->pos++]);
+    }
+
+    hi = lo;
+    if (re->pos + 1 < re->end && re->pattern[re->pos] == '-' && re->pattern[re->pos + 1] != ']')
+    {
+      re->pos++;
+      hi = (unsigned char) re->pattern[re->pos++];
+      if (hi == '\\' && re->pos < re->end)
+        hi = regex_escape (re->pattern[re->pos++]);
+      if (hi < lo)
+      {
+        re->error = "Invalid range in []";
+        return NULL;
+      }
+    }
+
+    for (i = lo; i <= hi; i++)
+      regex_class_add (re, cls, (unsigned char) i);
+  }
+
+  if (re->pos >= re->end)
+  {
+    re->error = "Missing ]";
+    return NULL;
+  }
+  re->pos++;
+  regex_class_fold (re, cls);
+
+  if (negate)
+  {
+    for (i = 0; i < 32; i++)
+      re->classes[cls][i] = (unsigned char) ~re->classes[cls][i];
+  }
+
+  node = regex_new_node (re, NODE_CLASS, NULL, NULL);
+  node->cls = cls;
+
+  return node;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Parse a single atom: a char, class or group
+ *
+ *  @param[in,out]      *re       The regex being parsed
+ *
+ *  @return             The atom's node, or NULL on error
+ *
+ * ************************************************************************** */
+
+static REGEX_NODE *
+regex_parse_atom (REGEX *re)
+{
+  int i;
+  char c;
+  REGEX_NODE *node;
+
+  c = re->pattern[re->pos++];
+
+  switch (c)
+  {
+    case '(':
+      node = regex_parse_alt (re);
+      if (node == NULL)
+        return NULL;
+      if (re->pos >= re->end || re->pattern[re->pos] != ')')
+      {
+        re->error = "Missing )";
+        return NULL;
+      }
+      re->pos++;
+      return node;
+    case '[':
+      return regex_parse_class (re);
+    case '*':
+    case '+':
+    case '?':
+      re->error = "Nothing to repeat";
+      return NULL;
+    default:
+      break;
+  }
+
+  node = regex_new_node (re, NODE_CLASS, NULL, NULL);
+  node->cls = regex_new_class (re);
+
+  if (c == '.')
+  {
+    for (i = 0; i < 256; i++)
+      regex_class_add (re, node->cls, (unsigned char) i);
+  }
+  else if (c == '\\')
+  {
+    if (re->pos >= re->end)
+    {
+      re->error = "Trailing \\";
+      return NULL;
+    }
+    c = re->pattern[re->pos++];
+    if (!regex_class_add_shorthand (re, node->cls, c))
+      regex_class_add (re, node->cls, regex_escape (c));
+  }
+  else
+  {
+    regex_class_add (re, node->cls, (unsigned char) c);
+  }
+
+  regex_class_fold (re, node->cls);
+
+  return node;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Parse an atom followed by any number of * + or ?
+ *
+ *  @param[in,out]      *re       The regex being parsed
+ *
+ *  @return             The node, or NULL on error
+ *
+ * ************************************************************************** */
+
+static REGEX_NODE *
+regex_parse_repeat (REGEX *re)
+{
+  char c;
+  REGEX_NODE *node;
+
+  if ((node = regex_parse_atom (re)) == NULL)
+    return NULL;
+
+  while (re->pos < re->end)
+  {
+    c = re->pattern[re->pos];
+    if (c == '*')
+      node = regex_new_node (re, NODE_STAR, node, NULL);
+    else if (c == '+')
+      node = regex_new_node (re, NODE_PLUS, node, NULL);
+    else if (c == '?')
+      node = regex_new_node (re, NODE_QUEST, node, NULL);
+    else
+      break;
+    re->pos++;
+  }
+
+  return node;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Parse a sequence of repeats
+ *
+ *  @param[in,out]      *re       The regex being parsed
+ *
+ *  @return             The node, or NULL on error
+ *
+ * ************************************************************************** */
+
+static REGEX_NODE *
+regex_parse_concat (REGEX *re)
+{
+  REGEX_NODE *node;
+  REGEX_NODE *next;
+
+  node = regex_new_node (re, NODE_EMPTY, NULL, NULL);
+
+  while (re->pos < re->end && re->pattern[re->pos] != '|' && re->pattern[re->pos] != ')')
+  {
+    if ((next = regex_parse_repeat (re)) == NULL)
+      return NULL;
+    node = node->type == NODE_EMPTY ? next : regex_new_node (re, NODE_CONCAT, node, next);
+  }
+
+  return node;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Parse alternatives separated by |
+ *
+ *  @param[in,out]      *re       The regex being parsed
+ *
+ *  @return             The node, or NULL on error
+ *
+ * ************************************************************************** */
+
+static REGEX_NODE *
+regex_parse_alt (REGEX *re)
+{
+  REGEX_NODE *node;
+  REGEX_NODE *next;
+
+  if ((node = regex_parse_concat (re)) == NULL)
+    return NULL;
+
+  while (re->pos < re->end && re->pattern[re->pos] == '|')
+  {
+    re->pos++;
+    if ((next = regex_parse_concat (re)) == NULL)
+      return NULL;
+    node = regex_new_node (re, NODE_ALT, node, next);
+  }
+
+  return node;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the literal string every match must start with
+ *
+ *  @param[in,out]      *re       The regex
+ *  @param[in]          *node     The root of the parse tree
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Walks down the left hand side of the concatenations at the start of the
+ *  regex, collecting single byte classes. The prefix lets the search kernel
+ *  skip lines, and parts of lines, where a match can't start.
+ *
+ * ************************************************************************** */
+
+static void
+regex_extract_prefix (REGEX *re, REGEX_NODE *node)
+{
+  int i;
+  int c;
+  int nbits;
+  size_t nconcat;
+  REGEX_NODE *stack[64];
+  REGEX_NODE *leaf;
+
+  /*
+   * Flatten the left leaning concatenations into a list of leaves
+   */
+
+  nconcat = 0;
+  while (node->type == NODE_CONCAT && nconcat < sizeof stack / sizeof stack[0] - 1)
+  {
+    stack[nconcat++] = node->right;
+    node = node->left;
+  }
+  stack[nconcat++] = node;
+
+  re->prefix = malloc (nconcat + 1);
+  re->prefix_len = 0;
+
+  while (nconcat)
+  {
+    leaf = stack[--nconcat];
+    if (leaf->type != NODE_CLASS)
+      break;
+
+    nbits = 0;
+    c = 0;
+    for (i = 0; i < 256 && nbits < 3; i++)
+    {
+      if (re->classes[leaf->cls][i / 8] & (1 << (i % 8)))
+      {
+        c = i;
+        nbits++;
+      }
+    }
+
+    /*
+     * When ignoring case, a letter's class holds both cases, and the last one
+     * found is the lower case letter
+     */
+
+    if (nbits != 1 && !(re->icase && nbits == 2 && c >= 'a' && c <= 'z'
+                        && re->classes[leaf->cls][(c - 0x20) / 8] & (1 << ((c - 0x20) % 8))))
+      break;
+
+    re->prefix[re->prefix_len++] = (char) c;
+  }
+
+  re->prefix[re->prefix_len] = '\0';
+  search_compile (&re->prefix_pattern, re->prefix, re->prefix_len, re->icase);
+}
+
+/* **************************************************************************
+ *
+ * Compiling to NFA programs
+ *
+ * ************************************************************************** */
+
+/** **************************************************************************
+ *
+ *  @brief              Append an instruction to a program
+ *
+ *  @param[in,out]      *prog     The program
+ *  @param[in]          op        The instruction type
+ *  @param[in]          arg       The first argument
+ *  @param[in]          arg2      The second argument
+ *
+ *  @return             The index of the new instruction
+ *
+ * ************************************************************************** */
+
+static size_t
+regex_emit (REGEX_PROG *prog, int op, size_t arg, size_t arg2)
+{
+  prog->inst[prog->ninst].op = op;
+  prog->inst[prog->ninst].arg = arg;
+  prog->inst[prog->ninst].arg2 = arg2;
+
+  return prog->ninst++;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Compile a parse tree node into program instructions
+ *
+ *  @param[in,out]      *prog      The program
+ *  @param[in]          *node      The node to compile
+ *  @param[in]          reverse    Bool flag to compile the reversed regex
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The reversed regex is the same, except that the order of concatenations is
+ *  swapped. It matches the reverse of anything the regex matches.
+ *
+ * ************************************************************************** */
+
+static void
+regex_compile_node (REGEX_PROG *prog, REGEX_NODE *node, int reverse)
+{
+  size_t split;
+  size_t jmp;
+  size_t start;
+
+  switch (node->type)
+  {
+    case NODE_CLASS:
+      regex_emit (prog, OP_CLASS, node->cls, 0);
+      break;
+    case NODE_CONCAT:
+      regex_compile_node (prog, reverse ? node->right : node->left, reverse);
+      regex_compile_node (prog, reverse ? node->left : node->right, reverse);
+      break;
+    case NODE_ALT:
+      split = regex_emit (prog, OP_SPLIT, 0, 0);
+      prog->inst[split].arg = prog->ninst;
+      regex_compile_node (prog, node->left, reverse);
+      jmp = regex_emit (prog, OP_JMP, 0, 0);
+      prog->inst[split].arg2 = prog->ninst;
+      regex_compile_node (prog, node->right, reverse);
+      prog->inst[jmp].arg = prog->ninst;
+      break;
+    case NODE_STAR:
+      split = regex_emit (prog, OP_SPLIT, 0, 0);
+      prog->inst[split].arg = prog->ninst;
+      regex_compile_node (prog, node->left, reverse);
+      regex_emit (prog, OP_JMP, split, 0);
+      prog->inst[split].arg2 = prog->ninst;
+      break;
+    case NODE_PLUS:
+      start = prog->ninst;
+      regex_compile_node (prog, node->left, reverse);
+      split = regex_emit (prog, OP_SPLIT, start, 0);
+      prog->inst[split].arg2 = prog->ninst;
+      break;
+    case NODE_QUEST:
+      split = regex_emit (prog, OP_SPLIT, 0, 0);
+      prog->inst[split].arg = prog->ninst;
+      regex_compile_node (prog, node->left, reverse);
+      prog->inst[split].arg2 = prog->ninst;
+      break;
+    default:
+      break;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Compile a parse tree into a program
+ *
+ *  @param[out]         *prog      The program
+ *  @param[in]          *root      The root of the parse tree
+ *  @param[in]          max_inst   The most instructions the program can need
+ *  @param[in]          reverse    Bool flag to compile the reversed regex
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+regex_compile_prog (REGEX_PROG *prog, REGEX_NODE *root, size_t max_inst, int reverse)
+{
+  prog->inst = malloc (max_inst * sizeof (*prog->inst));
+  prog->ninst = 0;
+  regex_compile_node (prog, root, reverse);
+  regex_emit (prog, OP_MATCH, 0, 0);
+}
+
+/* **************************************************************************
+ *
+ * The lazy DFA
+ *
+ * ************************************************************************** */
+
+/** **************************************************************************
+ *
+ *  @brief              Create a lazy DFA for a program
+ *
+ *  @param[in]          *re            The regex
+ *  @param[in]          *prog          The program to run
+ *  @param[in]          unanchored     Bool flag for the DFA to look for matches
+ *                                     starting at every position
+ *
+ *  @return             The DFA, with no states built yet
+ *
+ * ************************************************************************** */
+
+static REGEX_DFA *
+regex_dfa_new (REGEX *re, REGEX_PROG *prog, int unanchored)
+{
+  REGEX_DFA *dfa = calloc (1, sizeof (*dfa));
+
+  dfa->re = re;
+  dfa->prog = prog;
+  dfa->unanchored = unanchored;
+  dfa->stack = malloc (prog->ninst * sizeof (*dfa->stack));
+  dfa->set = malloc (prog->ninst * sizeof (*dfa->set));
+  dfa->from = malloc (prog->ninst * sizeof (*dfa->from));
+  dfa->seen = calloc (prog->ninst, sizeof (*dfa->seen));
+  dfa->table_size = 1024;
+  dfa->table = malloc (dfa->table_size * sizeof (*dfa->table));
+  memset (dfa->table, -1, dfa->table_size * sizeof (*dfa->table));
+
+  return dfa;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free a DFA
+ *
+ *  @param[in]          *dfa      The DFA to free
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+regex_dfa_free (REGEX_DFA *dfa)
+{
+  if (dfa == NULL)
+    return;
+
+  free (dfa->states);
+  free (dfa->pool);
+  free (dfa->table);
+  free (dfa->stack);
+  free (dfa->set);
+  free (dfa->from);
+  free (dfa->seen);
+  free (dfa);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Throw away every state in the DFA
+ *
+ *  @param[in,out]      *dfa      The DFA to flush
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is how the memory cap is enforced. The states are rebuilt as they are
+ *  needed again, so a pattern with a huge DFA still runs in linear time, just
+ *  with a bigger constant.
+ *
+ * ************************************************************************** */
+
+static void
+regex_dfa_flush (REGEX_DFA *dfa)
+{
+  dfa->nstates = 0;
+  dfa->npool = 0;
+  dfa->memory = 0;
+  memset (dfa->table, -1, dfa->table_size * sizeof (*dfa->table));
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add an instruction and everything reachable from it
+ *                      without consuming a byte to the scratch set
+ *
+ *  @param[in,out]      *dfa      The DFA
+ *  @param[in]          pc        The instruction to start from
+ *  @param[in,out]      *nset     The number of instructions in the set
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Only OP_CLASS and OP_MATCH instructions are kept in the set, as those are
+ *  the only ones which affect what happens next.
+ *
+ * ************************************************************************** */
+
+static void
+regex_dfa_closure (REGEX_DFA *dfa, size_t pc, size_t *nset)
+{
+  size_t nstack;
+  REGEX_INST *inst;
+
+  nstack = 0;
+  dfa->stack[nstack++] = pc;
+
+  while (nstack)
+  {
+    pc = dfa->stack[--nstack];
+    if (dfa->seen[pc] == dfa->generation)
+      continue;
+    dfa->seen[pc] = dfa->generation;
+
+    inst = &dfa->prog->inst[pc];
+    switch (inst->op)
+    {
+      case OP_JMP:
+        dfa->stack[nstack++] = inst->arg;
+        break;
+      case OP_SPLIT:
+        dfa->stack[nstack++] = inst->arg2;
+        dfa->stack[nstack++] = inst->arg;
+        break;
+      default:
+        dfa->set[(*nset)++] = pc;
+        break;
+    }
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Compare two NFA instruction indices for qsort
+ *
+ * ************************************************************************** */
+
+static int
+regex_compare_pc (const void *a, const void *b)
+{
+  size_t x = *(const size_t *) a;
+  size_t y = *(const size_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Hash a set of NFA instructions
+ *
+ * ************************************************************************** */
+
+static size_t
+regex_hash_set (size_t *set, size_t nset)
+{
+  size_t i;
+  size_t hash = 14695981039346656037UL;
+
+  for (i = 0; i < nset; i++)
+    hash = (hash ^ set[i]) * 1099511628211UL;
+
+  return hash;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find or create the DFA state for the scratch set
+ *
+ *  @param[in,out]      *dfa      The DFA
+ *  @param[in]          nset      The number of instructions in the scratch set
+ *
+ *  @return             The index of the state
+ *
+ *  @details
+ *
+ *  The set is sorted so the same set of instructions always maps to the same
+ *  state, then looked up in a hash table. If it's new, it is added to the
+ *  DFA with all of its transitions unknown.
+ *
+ * ************************************************************************** */
+
+static int
+regex_dfa_state (REGEX_DFA *dfa, size_t nset)
+{
+  int *table;
+  size_t i;
+  size_t slot;
+  size_t new_size;
+  DFA_STATE *state;
+
+  qsort (dfa->set, nset, sizeof (*dfa->set), regex_compare_pc);
+
+  slot = regex_hash_set (dfa->set, nset) & (dfa->table_size - 1);
+  while (dfa->table[slot] != -1)
+  {
+    state = &dfa->states[dfa->table[slot]];
+    if (state->npcs == nset && !memcmp (&dfa->pool[state->pcs], dfa->set, nset * sizeof (*dfa->set)))
+      return dfa->table[slot];
+    slot = (slot + 1) & (dfa->table_size - 1);
+  }
+
+  /*
+   * Add the new state, growing the storage and hash table as needed
+   */
+
+  if (dfa->nstates == dfa->capacity)
+  {
+    dfa->capacity = dfa->capacity ? dfa->capacity * 2 : 16;
+    if (!(dfa->states = realloc (dfa->states, dfa->capacity * sizeof (*dfa->states))))
+      util_exit ("Couldn't allocate memory for a regex");
+  }
+  if (dfa->npool + nset > dfa->pool_capacity)
+  {
+    dfa->pool_capacity = (dfa->pool_capacity + nset) * 2;
+    if (!(dfa->pool = realloc (dfa->pool, dfa->pool_capacity * sizeof (*dfa->pool))))
+      util_exit ("Couldn't allocate memory for a regex");
+  }
+
+  state = &dfa->states[dfa->nstates];
+  state->pcs = dfa->npool;
+  state->npcs = nset;
+  state->match = FALSE;
+  memset (state->next, DFA_UNKNOWN, sizeof state->next);
+  memcpy (&dfa->pool[dfa->npool], dfa->set, nset * sizeof (*dfa->set));
+  dfa->npool += nset;
+
+  for (i = 0; i < nset; i++)
+  {
+    if (dfa->prog->inst[dfa->set[i]].op == OP_MATCH)
+      state->match = TRUE;
+  }
+
+  dfa->table[slot] = (int) dfa->nstates;
+  dfa->memory += sizeof (*state) + nset * sizeof (*dfa->set);
+
+  if (2 * (dfa->nstates + 1) > dfa->table_size)
+  {
+    new_size = dfa->table_size * 2;
+    if (!(table = malloc (new_size * sizeof (*table))))
+      util_exit ("Couldn't allocate memory for a regex");
+    memset (table, -1, new_size * sizeof (*table));
+    for (i = 0; i <= dfa->nstates; i++)
+    {
+      state = &dfa->states[i];
+      slot = regex_hash_set (&dfa->pool[state->pcs], state->npcs) & (new_size - 1);
+      while (table[slot] != -1)
+        slot = (slot + 1) & (new_size - 1);
+      table[slot] = (int) i;
+    }
+    free (dfa->table);
+    dfa->table = table;
+    dfa->table_size = new_size;
+  }
+
+  return (int) dfa->nstates++;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the start state of the DFA
+ *
+ *  @param[in,out]      *dfa      The DFA
+ *
+ *  @return             The index of the start state
+ *
+ * ************************************************************************** */
+
+static int
+regex_dfa_start (REGEX_DFA *dfa)
+{
+  size_t nset = 0;
+
+  dfa->generation++;
+  regex_dfa_closure (dfa, 0, &nset);
+
+  return regex_dfa_state (dfa, nset);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Work out the transition from a state on a byte
+ *
+ *  @param[in,out]      *dfa      The DFA
+ *  @param[in]          from      The state to step from
+ *  @param[in]          c         The byte being consumed
+ *
+ *  @return             The index of the next state
+ *
+ *  @details
+ *
+ *  This is only called the first time a transition is taken, after that it's
+ *  cached in the state's next table. If the DFA has hit its memory cap, every
+ *  state is thrown away and the current state is rebuilt first.
+ *
+ * ************************************************************************** */
+
+static int
+regex_dfa_step (REGEX_DFA *dfa, int from, unsigned char c)
+{
+  int to;
+  size_t i;
+  size_t pc;
+  size_t nset;
+  size_t nfrom;
+  REGEX_INST *inst;
+
+  if (dfa->memory > REGEX_DFA_MEMORY_CAP)
+  {
+    nfrom = dfa->states[from].npcs;
+    memcpy (dfa->set, &dfa->pool[dfa->states[from].pcs], nfrom * sizeof (*dfa->set));
+    regex_dfa_flush (dfa);
+    from = regex_dfa_state (dfa, nfrom);
+  }
+
+  /*
+   * The set has to be copied out as the pool may move when the new state is
+   * added
+   */
+
+  nfrom = dfa->states[from].npcs;
+  memcpy (dfa->from, &dfa->pool[dfa->states[from].pcs], nfrom * sizeof (*dfa->from));
+
+  dfa->generation++;
+  nset = 0;
+
+  for (i = 0; i < nfrom; i++)
+  {
+    pc = dfa->from[i];
+    inst = &dfa->prog->inst[pc];
+    if (inst->op == OP_CLASS && dfa->re->classes[inst->arg][c / 8] & (1 << (c % 8)))
+      regex_dfa_closure (dfa, pc + 1, &nset);
+  }
+
+  if (dfa->unanchored)
+    regex_dfa_closure (dfa, 0, &nset);
+
+  to = regex_dfa_state (dfa, nset);
+  dfa->states[from].next[c] = to;
+
+  return to;
+}
+
+/* **************************************************************************
+ *
+ * Matching
+ *
+ * ************************************************************************** */
+
+/** **************************************************************************
+ *
+ *  @brief              Find where the longest match starting at a position
+ *                      ends
+ *
+ *  @param[in,out]      *re       The regex
+ *  @param[in]          *text     The text to match
+ *  @param[in]          len       The length of the text
+ *  @param[in]          start     The position the match starts at
+ *
+ *  @return             The end of the longest match, or NO_MATCH
+ *
+ * ************************************************************************** */
+
+static size_t
+regex_longest_match (REGEX *re, char *text, size_t len, size_t start)
+{
+  int state;
+  int next;
+  size_t i;
+  size_t end;
+  REGEX_DFA *dfa = re->fwd_dfa;
+
+  state = regex_dfa_start (dfa);
+  end = (dfa->states[state].match && (!re->anchor_end || start == len)) ? start : NO_MATCH;
+
+  for (i = start; i < len; i++)
+  {
+    next = dfa->states[state].next[(unsigned char) text[i]];
+    if (next == DFA_UNKNOWN)
+      next = regex_dfa_step (dfa, state, (unsigned char) text[i]);
+    state = next;
+
+    if (dfa->states[state].npcs == 0)
+      break;
+    if (dfa->states[state].match && (!re->anchor_end || i + 1 == len))
+      end = i + 1;
+  }
+
+  re->scanned += i - start;
+
+  return end;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Mark every position in a line where a match starts
+ *
+ *  @param[in,out]      *re       The regex
+ *  @param[in]          *text     The line
+ *  @param[in]          len       The length of the line
+ *  @param[in]          lo        No match can start before this position
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The reversed regex is run backwards from the end of the line. Unless the
+ *  regex ends with a $, the reversed program is restarted at every position,
+ *  so whenever the DFA is in a matching state there's a match which starts at
+ *  the current position.
+ *
+ * ************************************************************************** */
+
+static void
+regex_mark_starts (REGEX *re, char *text, size_t len, size_t lo)
+{
+  int state;
+  int next;
+  size_t i;
+  size_t nbytes;
+  REGEX_DFA *dfa = re->rev_dfa;
+
+  nbytes = len / 8 + 1;
+  if (nbytes > re->starts_size)
+  {
+    re->starts_size = nbytes * 2;
+    if (!(re->starts = realloc (re->starts, re->starts_size)))
+      util_exit ("Couldn't allocate memory for a regex");
+  }
+  memset (re->starts, 0, nbytes);
+  re->starts_lo = lo;
+
+  state = regex_dfa_start (dfa);
+  if (dfa->states[state].match)
+    re->starts[len / 8] |= (unsigned char) (1 << (len % 8));
+
+  for (i = len; i > lo; i--)
+  {
+    next = dfa->states[state].next[(unsigned char) text[i - 1]];
+    if (next == DFA_UNKNOWN)
+      next = regex_dfa_step (dfa, state, (unsigned char) text[i - 1]);
+    state = next;
+
+    if (dfa->states[state].npcs == 0)
+      break;
+    if (dfa->states[state].match)
+      re->starts[(i - 1) / 8] |= (unsigned char) (1 << ((i - 1) % 8));
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add a thread and every thread reachable from it
+ *                      without consuming a byte to a list
+ *
+ *  @param[in,out]      *re       The regex
+ *  @param[in,out]      *list     The list of threads
+ *  @param[in,out]      *nlist    The number of threads in the list
+ *  @param[in]          pc        The instruction to start from
+ *  @param[in]          origin    Where the thread started
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  An instruction which is already in the list isn't added again, so the first
+ *  thread to reach an instruction keeps it.
+ *
+ * ************************************************************************** */
+
+static void
+regex_add_thread (REGEX *re, REGEX_THREAD *list, size_t *nlist, size_t pc, size_t origin)
+{
+  size_t nstack;
+  REGEX_INST *inst;
+
+  nstack = 0;
+  re->stack[nstack++] = pc;
+
+  while (nstack)
+  {
+    pc = re->stack[--nstack];
+    if (re->seen[pc] == re->generation)
+      continue;
+    re->seen[pc] = re->generation;
+
+    inst = &re->reverse.inst[pc];
+    switch (inst->op)
+    {
+      case OP_JMP:
+        re->stack[nstack++] = inst->arg;
+        break;
+      case OP_SPLIT:
+        re->stack[nstack++] = inst->arg2;
+        re->stack[nstack++] = inst->arg;
+        break;
+      default:
+        list[*nlist].pc = pc;
+        list[*nlist].origin = origin;
+        (*nlist)++;
+        break;
+    }
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the end of the longest match from every position
+ *                      in a line
+ *
+ *  @param[in,out]      *re       The regex
+ *  @param[in]          *text     The line
+ *  @param[in]          len       The length of the line
+ *  @param[in]          lo        No match can start before this position
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The reversed program is run backwards from the end of the line as an NFA,
+ *  starting a thread at every position, where each thread remembers the
+ *  position it started at. That is where a match would end. Two threads at
+ *  the same instruction can match the same text from then on, so only the one
+ *  which started furthest along the line is kept. The threads are kept in
+ *  order of where they started, furthest first, so this is the first to reach
+ *  an instruction. Each byte is then handled once for each instruction, so
+ *  this is linear in the length of the line however many matches there are.
+ *
+ * ************************************************************************** */
+
+static void
+regex_find_ends (REGEX *re, char *text, size_t len, size_t lo)
+{
+  size_t i;
+  size_t j;
+  size_t ncur;
+  size_t nnext;
+  unsigned char c;
+  REGEX_INST *inst;
+  REGEX_THREAD *cur;
+  REGEX_THREAD *next;
+  REGEX_THREAD *tmp;
+
+  if (len + 1 > re->ends_size)
+  {
+    re->ends_size = 2 * (len + 1);
+    if (!(re->ends = realloc (re->ends, re->ends_size * sizeof (*re->ends))))
+      util_exit ("Couldn't allocate memory for a regex");
+  }
+
+  if (re->threads == NULL)
+  {
+    re->threads = malloc (2 * re->reverse.ninst * sizeof (*re->threads));
+    re->stack = malloc ((2 * re->reverse.ninst + 1) * sizeof (*re->stack));
+    re->seen = calloc (re->reverse.ninst, sizeof (*re->seen));
+    if (!re->threads || !re->stack || !re->seen)
+      util_exit ("Couldn't allocate memory for a regex");
+  }
+
+  cur = re->threads;
+  next = &re->threads[re->reverse.ninst];
+  ncur = 0;
+  re->generation++;
+
+  for (i = len;; i--)
+  {
+    /*
+     * A match can end anywhere, unless the regex ends with a $
+     */
+
+    if (!re->anchor_end || i == len)
+      regex_add_thread (re, cur, &ncur, 0, i);
+
+    re->ends[i] = NO_MATCH;
+    for (j = 0; j < ncur; j++)
+    {
+      if (re->reverse.inst[cur[j].pc].op == OP_MATCH)
+      {
+        re->ends[i] = cur[j].origin;
+        break;
+      }
+    }
+
+    if (i == lo)
+      break;
+
+    /*
+     * Step every thread back over the previous byte
+     */
+
+    c = (unsigned char) text[i - 1];
+    nnext = 0;
+    re->generation++;
+
+    for (j = 0; j < ncur; j++)
+    {
+      inst = &re->reverse.inst[cur[j].pc];
+      if (inst->op == OP_CLASS && re->classes[inst->arg][c / 8] & (1 << (c % 8)))
+        regex_add_thread (re, next, &nnext, cur[j].pc + 1, cur[j].origin);
+    }
+
+    tmp = cur;
+    cur = next;
+    next = tmp;
+    ncur = nnext;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the next match of a regex in a line
+ *
+ *  @param[in,out]      *re            The compiled regex
+ *  @param[in]          *text          The line to search
+ *  @param[in]          len            The length of the line
+ *  @param[in]          from           The position to search from
+ *  @param[out]         *match_start   The start of the match
+ *  @param[out]         *match_end     The end of the match
+ *
+ *  @return             TRUE if a match was found, otherwise FALSE
+ *
+ *  @details
+ *
+ *  Matches are leftmost-longest. The first call for a line must have from = 0,
+ *  which finds every position where a match starts in one backwards pass over
+ *  the line. Further calls for the same line, with from increasing, reuse
+ *  that. The end of each match is then found by running the regex forwards,
+ *  until the line has been scanned forwards REGEX_SCAN_FACTOR times over, when
+ *  the ends of all of the matches are found at once with regex_find_ends.
+ *
+ *  If the regex starts with a literal string, the search kernel is used to
+ *  reject lines without the literal and to skip to where it first appears.
+ *
+ * ************************************************************************** */
+
+int
+regex_search (REGEX *re, char *text, size_t len, size_t from, size_t *match_start, size_t *match_end)
+{
+  size_t p;
+  size_t end;
+  char *first;
+
+  /*
+   * A leading ^ means only a match at the start of the line counts
+   */
+
+  if (re->anchor_start)
+  {
+    if (from > 0 || (end = regex_longest_match (re, text, len, 0)) == NO_MATCH)
+      return FALSE;
+    *match_start = 0;
+    *match_end = end;
+    return TRUE;
+  }
+
+  if (from == 0)
+  {
+    p = 0;
+    if (re->prefix_len)
+    {
+      if ((first = search_next (&re->prefix_pattern, text, len)) == NULL)
+      {
+        re->starts_lo = len + 1;
+        return FALSE;
+      }
+      p = (size_t) (first - text);
+    }
+    regex_mark_starts (re, text, len, p);
+    re->have_ends = FALSE;
+    re->scanned = 0;
+  }
+
+  for (p = from > re->starts_lo ? from : re->starts_lo; p <= len; p++)
+  {
+    if (re->starts[p / 8] & (1 << (p % 8)))
+    {
+      if (!re->have_ends && re->scanned > REGEX_SCAN_FACTOR * (len + 1))
+      {
+        regex_find_ends (re, text, len, re->starts_lo);
+        re->have_ends = TRUE;
+      }
+
+      end = re->have_ends ? re->ends[p] : regex_longest_match (re, text, len, p);
+      if (end == NO_MATCH)
+        continue;
+      *match_start = p;
+      *match_end = end;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free a compiled regex
+ *
+ *  @param[in]          *re      The regex to free
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+regex_free (REGEX *re)
+{
+  if (re == NULL)
+    return;
+
+  regex_dfa_free (re->fwd_dfa);
+  regex_dfa_free (re->rev_dfa);
+  free (re->forward.inst);
+  free (re->reverse.inst);
+  free (re->classes);
+  free (re->nodes);
+  free (re->prefix);
+  free (re->starts);
+  free (re->ends);
+  free (re->threads);
+  free (re->stack);
+  free (re->seen);
+  free (re);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Compile a regex
+ *
+ *  @param[in]          *pattern    The regex to compile
+ *  @param[in]          icase       Bool flag for ignoring the case of letters
+ *  @param[out]         **error     Set to an error message if the regex can't
+ *                                  be compiled
+ *
+ *  @return             The compiled regex, or NULL on error
+ *
+ *  @details
+ *
+ *  The syntax supported is literal chars, ., [] classes with ranges and ^
+ *  negation, the \d \w \s \D \W \S shorthands, escapes with \, the * + and ?
+ *  repeats, | alternatives and () groups. A ^ at the very start or a $ at the
+ *  very end anchor the regex to the start and end of the line, anywhere else
+ *  they are literal chars. Ignoring case is done by adding both cases of each
+ *  letter to the char classes, so the DFA runs at the same speed either way.
+ *
+ * ************************************************************************** */
+
+REGEX *
+regex_compile (char *pattern, int icase, char **error)
+{
+  size_t len;
+  REGEX *re;
+  REGEX_NODE *root;
+
+  re = calloc (1, sizeof (*re));
+
+  len = strlen (pattern);
+  re->pattern = pattern;
+  re->icase = icase;
+  re->pos = 0;
+  re->end = len;
+
+  if (len > 0 && pattern[0] == '^')
+  {
+    re->anchor_start = TRUE;
+    re->pos = 1;
+  }
+  if (len > re->pos && pattern[len - 1] == '$' && (len < 2 || pattern[len - 2] != '\\'))
+  {
+    re->anchor_end = TRUE;
+    re->end = len - 1;
+  }
+
+  /*
+   * Every char in the pattern creates at most two nodes, plus one for each
+   * empty concatenation
+   */
+
+  re->max_nodes = 3 * len + 2;
+  re->nodes = malloc (re->max_nodes * sizeof (*re->nodes));
+
+  root = regex_parse_alt (re);
+  if (root && re->pos < re->end)
+    re->error = "Unmatched )";
+
+  if (re->error)
+  {
+    *error = re->error;
+    regex_free (re);
+    return NULL;
+  }
+
+  regex_extract_prefix (re, root);
+  regex_compile_prog (&re->forward, root, 2 * re->nnodes + 1, FALSE);
+  regex_compile_prog (&re->reverse, root, 2 * re->nnodes + 1, TRUE);
+  re->fwd_dfa = regex_dfa_new (re, &re->forward, FALSE);
+  re->rev_dfa = regex_dfa_new (re, &re->reverse, !re->anchor_end);
+  re->pattern = NULL;
+  *error = NULL;
+
+  return re;
+}
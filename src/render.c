@@ -0,0 +1,374 @@
+/** **************************************************************************
+ *
+ * @file render.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for rendering the lines of a buffer and drawing them into
+ *        screen rows.
+ *
+ * ************************************************************************** */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Append a string to the end of the screen buffer
+ *
+ *  @param[in,out]      *sb     The screen buffer to append the string to
+ *  @param[in]          *s      The string to append to the screen buffer
+ *  @param[in]          len     The len of the string *s
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This function appends a correctly formatted string to the screen buffer,
+ *  where the string has the number of chars given by len. This is generally
+ *  called to write a line of the render(?) array to the screen buffer.
+ *
+ * ************************************************************************** */
+
+void
+editor_add_to_screen_buf (SCREEN_BUF *sb, char *s, size_t len)
+{
+  char *new;
+
+  /*
+   * Allocate more memory for screen buffer and then append the string s
+   * to the end of the screen buffer
+   */
+
+  if (!(new = realloc (sb->buf, sb->len + len)))
+  {
+    util_exit ("Couldn't allocate memory for screen buffer");
+  }
+  else  // else is used here to stop the compiler for complaining about unint vars
+  {
+    memcpy (&new[sb->len], s, len);
+    sb->buf = new;
+    sb->len += len;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Convert a line into the render array of its buffer
+ *
+ *  @param[in]          *buf      The buffer the line is in
+ *  @param[in]          idx       The index of the line which is being updated
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This function simply copies the text buffer for a line into the render buffer
+ *  for the line, whilst appropriately converting the tab characters into the
+ *  correct number of spaces as defined by the constant TAB_WIDTH. The syntax
+ *  highlighting isn't touched, so this is safe to use on a worker thread on a
+ *  buffer which isn't being edited.
+ *
+ * ************************************************************************** */
+
+void
+editor_render_line (EDITOR_BUFFER *buf, size_t idx)
+{
+  size_t ntabs;
+  size_t i;
+  size_t ii;
+  size_t len;
+
+  char *chars;
+  char *render;
+
+  /*
+   * Count the number of tab characters in the text buffer
+   */
+
+  len = buf->lines.len[idx];
+  chars = buf->lines.chars[idx];
+
+  ntabs = 0;
+  for (i = 0; i < len; i++)
+  {
+    if (chars[i] == '\t')
+    {
+      ntabs++;
+    }
+  }
+  /*
+   * Allocate enough space for render -- note that len already counts 1
+   * space for each tab character, so we only need to account for 7 more spaces
+   * where we are assuming that tabs are 8 spaces
+   *  TODO: allow tab spaces to be changed from 8 to 4, etc
+   */
+
+  free (buf->lines.render[idx]);
+  render = buf->lines.render[idx] = malloc (len + (TAB_WIDTH - 1) * ntabs + 1);
+
+  /*
+   * Copy the characters in the text buffer to the render buffer
+   */
+
+  ii = 0;
+  for (i = 0; i < len; i++)
+  {
+    /*
+     * Now convert tab characters into the appropriate number of spaces
+     */
+
+    if (chars[i] == '\t')
+    {
+      render[ii++] = ' ';
+      while (ii % TAB_WIDTH != 0)
+        render[ii++] = ' ';
+    }
+    else
+    {
+      render[ii++] = chars[i];
+    }
+  }
+
+  /*
+   * Terminate the string
+   */
+
+  render[ii] = '\0';
+  buf->lines.r_len[idx] = ii;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add a line to the render buffer which will be displayed
+ *                      to the screen
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          idx       The index of the line which is being updated
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The line is converted into the render array and then the syntax
+ *  highlighting is updated. Nothing is displayed for a headless buffer, i.e.
+ *  when running a script, so this is skipped then.
+ *
+ * ************************************************************************** */
+
+void
+editor_add_to_render_buffer (EDITOR_BUFFER *buf, size_t idx)
+{
+  if (buf->headless)
+    return;
+
+  editor_render_line (buf, idx);
+  syntax_update_highlighting (buf, idx);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Draw the text buffer of a window into the screen rows
+ *
+ *  @param[in,out]      *rows   The screen buffer of each row of the screen
+ *  @param[in]          *win    The window to draw
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The screen buffer is updated by looping over the number of rows of terminal
+ *  which are being used to render the editor. This function thus indexes to the
+ *  correct level of indexing for the required amount of scroll and then loops
+ *  over each line and appends each line character by character, whilst taking
+ *  into account any possible syntax highlighting. Each line is padded out to
+ *  the width of the window, so a window to the right can carry on from it.
+ *  Only the buffer of the window is used, and the last row of the window is
+ *  left for the status bar.
+ *
+ * ************************************************************************** */
+
+void
+editor_update_screen_buffer (SCREEN_BUF *rows, WINDOW *win)
+{
+  int iline;
+  int padding;
+  int char_colour;
+  int current_colour;
+
+  size_t i;
+  size_t span;
+  size_t nspans;
+  size_t line_len;
+  size_t buf_len;
+  size_t col_len;
+  size_t welcome_len;
+  size_t file_row;
+  size_t ndrawn;
+
+  char *c;
+  char symbol;
+  char welcome[80];
+  char tmpbuf[16];
+  unsigned char *hl;
+  unsigned char char_hl;
+  size_t *span_rx;
+  SCREEN_BUF *sb;
+
+  for (iline = 0; iline < win->height - 1; iline++)
+  {
+    /*
+     * Index the line to offset for the current level of scroll in the file
+     */
+
+    sb = &rows[win->top + iline];
+    file_row = (size_t) iline + win->row_offset;
+    ndrawn = 0;
+
+    /*
+     * If the rendered line is more than the number of lines in the text buffer,
+     * then render a ~ to indicate that the line is empty
+     */
+
+    if (file_row >= win->buf->nlines)
+    {
+      /*
+       * If there are no lines in the text buffer, then write a welcome message
+       */
+
+      if (iline == (win->height - 1) / 5 && win->buf->nlines == 0)
+      {
+        welcome_len = (size_t ) snprintf (welcome, sizeof (welcome), "Kris editor -- version %s", VERSION);
+
+        if (welcome_len > win->width)
+          welcome_len = (size_t) win->width;
+
+        if ((padding = (int) (win->width - welcome_len) / 2))
+        {
+          editor_add_to_screen_buf (sb, "~", 1);
+          padding--;
+        }
+
+        while (padding--)
+          editor_add_to_screen_buf (sb, " ", 1);
+
+        editor_add_to_screen_buf (sb, welcome, (size_t) welcome_len);
+        ndrawn = (size_t) (win->width - (int) welcome_len) / 2 + welcome_len;
+      }
+      else
+      {
+        editor_add_to_screen_buf (sb, "~", 1);
+        ndrawn = 1;
+      }
+    }
+
+    /*
+     * Else, add a line of the text buffer to the screen buffer char by char
+     */
+
+    else
+    {
+      line_len = win->buf->lines.r_len[file_row] > win->col_offset ?
+                 win->buf->lines.r_len[file_row] - win->col_offset : 0;
+
+      if (line_len > win->width)
+        line_len = (size_t) win->width;
+
+      c = &win->buf->lines.render[file_row][win->col_offset];
+      hl = &win->buf->lines.syn_hl[file_row][win->col_offset];
+      current_colour = -1;
+
+      /*
+       * Search matches are drawn over the syntax highlighting, so get the
+       * spans of the matches on this line
+       */
+
+      nspans = find_overlay_spans (win->buf, file_row, (size_t) (win->height - 1), &span_rx);
+      span = 0;
+
+      /*
+       * This loop iterates over each char in the render array, and then processes
+       * each character individually for syntax highlighting or special characters
+       */
+
+      for (i = 0; i < line_len; i++)
+      {
+        while (span < nspans && span_rx[2 * span + 1] <= win->col_offset + i)
+          span++;
+        char_hl = (span < nspans && span_rx[2 * span] <= win->col_offset + i) ? HL_MATCH : hl[i];
+
+        /*
+         * This is to allow the editor to handle control sequences (non-printable
+         * characters) a bit better
+         */
+
+        if ( iscntrl (c[i]))
+        {
+          symbol = (char) ((c[i] <= 26) ? '@' + c[i] : '?');
+          editor_add_to_screen_buf (sb, "\x1b[7m", 4);
+          editor_add_to_screen_buf (sb, &symbol, 1);
+          editor_add_to_screen_buf (sb, "\x1b[m", 3);
+
+          /*
+           * If there is no current colour, renable normal text formatting
+           */
+
+          if (current_colour != -1)
+          {
+            col_len = (size_t) snprintf (tmpbuf, sizeof tmpbuf, "\x1b[%dm", current_colour);
+            editor_add_to_screen_buf (sb, tmpbuf, col_len);
+          }
+        }
+
+        /*
+         * Append normal text escape character to the screen buffer
+         */
+
+        else if (char_hl == HL_NORMAL)
+        {
+          if (current_colour != -1)
+          {
+            editor_add_to_screen_buf (sb, "\x1b[39m", 5);
+            current_colour = -1;
+          }
+
+          editor_add_to_screen_buf (sb, &c[i], 1);
+        }
+
+        /*
+         * Append the syntax highlighting escape characters to the screen buffer
+         */
+
+        else
+        {
+          char_colour = syntax_get_colour (char_hl);
+
+          if (char_colour != current_colour)
+          {
+            current_colour = char_colour;
+            buf_len = (size_t) snprintf (tmpbuf, sizeof tmpbuf, "\x1b[%dm", char_colour);
+            editor_add_to_screen_buf (sb, tmpbuf, buf_len);
+          }
+
+          editor_add_to_screen_buf (sb, &c[i], 1);
+        }
+      }
+
+      editor_add_to_screen_buf (sb, "\x1b[39m", 5);
+      ndrawn = line_len;
+    }
+
+    /*
+     * Pad the line out to the edge of the window
+     */
+
+    for (; ndrawn < (size_t) win->width; ndrawn++)
+      editor_add_to_screen_buf (sb, " ", 1);
+  }
+}
@@ -0,0 +1,582 @@
+/** **************************************************************************
+ *
+ * @file search.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief The substring search kernel used for finding text.
+ *
+ * ************************************************************************** */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "kris.h"
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// Fold an ASCII upper case letter to lower case, if folding is on
+#define FOLD(c, icase) ((c) | ((icase) && (unsigned) ((c) - 'A') < 26) << 5)
+
+/** **************************************************************************
+ *
+ *  @brief              Compute the critical factorisation of a needle for the
+ *                      Two-Way algorithm
+ *
+ *  @param[in,out]      *pattern    The pattern to set up
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Two-Way splits the needle at a critical position, found from the maximal
+ *  suffix of the needle under both byte orderings. The right half is then
+ *  compared left to right and the left half right to left, which guarantees
+ *  linear time whatever the needle and haystack are. A bad char shift table
+ *  on the last byte of the window lets most windows be skipped quickly.
+ *
+ *  This follows the description of the algorithm by Crochemore and Perrin.
+ *
+ * ************************************************************************** */
+
+static void
+search_compile_two_way (SEARCH_PATTERN *pattern)
+{
+  int icase = pattern->icase;
+  size_t i;
+  size_t ip;
+  size_t jp;
+  size_t k;
+  size_t p;
+  size_t p0;
+  size_t ms;
+  size_t len = pattern->len;
+  unsigned char c;
+  unsigned char *n = (unsigned char *) pattern->needle;
+
+  memset (pattern->byteset, 0, sizeof pattern->byteset);
+  for (i = 0; i < len; i++)
+  {
+    pattern->byteset[n[i] / 8] |= (unsigned char) (1 << (n[i] % 8));
+    pattern->shift[n[i]] = i + 1;
+
+    /*
+     * When folding, the other case of a letter shifts the same way, so the
+     * search doesn't have to fold the text to look up the shift
+     */
+
+    c = (unsigned char) (n[i] ^ 0x20);
+    if (icase && (unsigned) ((n[i] | 0x20) - 'a') < 26)
+    {
+      pattern->byteset[c / 8] |= (unsigned char) (1 << (c % 8));
+      pattern->shift[c] = i + 1;
+    }
+  }
+
+  /*
+   * Compute the maximal suffix for the < ordering
+   */
+
+  ip = (size_t) -1;
+  jp = 0;
+  k = p = 1;
+  while (jp + k < len)
+  {
+    if (FOLD (n[ip + k], icase) == FOLD (n[jp + k], icase))
+    {
+      if (k == p)
+      {
+        jp += p;
+        k = 1;
+      }
+      else
+        k++;
+    }
+    else if (FOLD (n[ip + k], icase) > FOLD (n[jp + k], icase))
+    {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    }
+    else
+    {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  ms = ip;
+  p0 = p;
+
+  /*
+   * And for the > ordering, then take the longer of the two suffixes
+   */
+
+  ip = (size_t) -1;
+  jp = 0;
+  k = p = 1;
+  while (jp + k < len)
+  {
+    if (FOLD (n[ip + k], icase) == FOLD (n[jp + k], icase))
+    {
+      if (k == p)
+      {
+        jp += p;
+        k = 1;
+      }
+      else
+        k++;
+    }
+    else if (FOLD (n[ip + k], icase) < FOLD (n[jp + k], icase))
+    {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    }
+    else
+    {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+
+  if (ip + 1 > ms + 1)
+    ms = ip;
+  else
+    p = p0;
+
+  /*
+   * If the needle is not periodic, the shift after a mismatch in the left
+   * half can be larger and there is nothing to remember between windows
+   */
+
+  for (i = 0; i < ms + 1 && FOLD (n[i], icase) == FOLD (n[i + p], icase); i++);
+  if (i < ms + 1)
+  {
+    pattern->mem0 = 0;
+    p = MAX (ms, len - ms - 1) + 1;
+  }
+  else
+  {
+    pattern->mem0 = len - p;
+  }
+
+  pattern->ms = ms;
+  pattern->period = p;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Prepare a search pattern for a needle
+ *
+ *  @param[out]         *pattern    The pattern to set up
+ *  @param[in]          *needle     The string to search for
+ *  @param[in]          len         The length of the needle
+ *  @param[in]          icase       Bool flag for ignoring the case of ASCII
+ *                                  letters
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  All of the work which only depends on the needle is done here, once, so
+ *  searching many short lines does not pay any setup cost per line. The needle
+ *  is not copied, so it must outlive the pattern.
+ *
+ *  Case insensitive needles are not folded up front, as the needle is not
+ *  owned by the pattern. Instead, every compare folds both sides.
+ *
+ * ************************************************************************** */
+
+void
+search_compile (SEARCH_PATTERN *pattern, char *needle, size_t len, int icase)
+{
+  size_t i;
+
+  pattern->needle = needle;
+  pattern->len = len;
+  pattern->icase = FALSE;
+
+  /*
+   * Folding only matters if there is a letter in the needle
+   */
+
+  for (i = 0; icase && i < len && !pattern->icase; i++)
+    pattern->icase = (unsigned) ((needle[i] | 0x20) - 'a') < 26;
+
+  if (len >= SEARCH_TWO_WAY_MIN)
+    search_compile_two_way (pattern);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Search using the Two-Way algorithm
+ *
+ *  @param[in]          *pattern    The compiled pattern
+ *  @param[in]          *hay        The text to search
+ *  @param[in]          hay_len     The length of the text
+ *  @param[in]          icase       Bool flag for folding case, which is a
+ *                                  constant at each call so the compiler can
+ *                                  drop the folding for exact case searches
+ *
+ *  @return             A pointer to the first match, or NULL
+ *
+ * ************************************************************************** */
+
+static inline char *
+search_two_way (SEARCH_PATTERN *pattern, char *hay, size_t hay_len, int icase)
+{
+  size_t k;
+  size_t mem;
+  size_t len = pattern->len;
+  size_t ms = pattern->ms;
+  unsigned char c;
+  unsigned char *h = (unsigned char *) hay;
+  unsigned char *z = h + hay_len;
+  unsigned char *n = (unsigned char *) pattern->needle;
+
+  mem = 0;
+  while ((size_t) (z - h) >= len)
+  {
+    /*
+     * Check the last byte of the window first and shift on a mismatch
+     */
+
+    c = h[len - 1];
+    if (pattern->byteset[c / 8] & (1 << (c % 8)))
+    {
+      k = len - pattern->shift[c];
+      if (k)
+      {
+        if (k < mem)
+          k = mem;
+        h += k;
+        mem = 0;
+        continue;
+      }
+    }
+    else
+    {
+      h += len;
+      mem = 0;
+      continue;
+    }
+
+    /*
+     * Compare the right half, then the left half
+     */
+
+    for (k = MAX (ms + 1, mem); k < len && FOLD (n[k], icase) == FOLD (h[k], icase); k++);
+    if (k < len)
+    {
+      h += k - ms;
+      mem = 0;
+      continue;
+    }
+
+    for (k = ms + 1; k > mem && FOLD (n[k - 1], icase) == FOLD (h[k - 1], icase); k--);
+    if (k <= mem)
+      return (char *) h;
+
+    h += pattern->period;
+    mem = pattern->mem0;
+  }
+
+  return NULL;
+}
+
+#ifdef __SSE2__
+
+/** **************************************************************************
+ *
+ *  @brief              Fold the upper case ASCII letters in a block to lower
+ *                      case
+ *
+ *  @param[in]          block     16 bytes of text
+ *
+ *  @return             The folded block
+ *
+ *  @details
+ *
+ *  Adding 128 - 'A' moves A-Z to the bottom of the signed byte range, so one
+ *  signed compare finds the upper case letters. Their 0x20 bit is then set.
+ *
+ * ************************************************************************** */
+
+static inline __m128i
+search_fold_block (__m128i block)
+{
+  __m128i upper;
+
+  upper = _mm_cmplt_epi8 (_mm_add_epi8 (block, _mm_set1_epi8 ((char) (128 - 'A'))), _mm_set1_epi8 ((char) (-128 + 26)));
+
+  return _mm_or_si128 (block, _mm_and_si128 (upper, _mm_set1_epi8 (0x20)));
+}
+
+#endif
+
+/** **************************************************************************
+ *
+ *  @brief              Compare two strings, ignoring the case of ASCII letters
+ *
+ *  @param[in]          *a      The first string
+ *  @param[in]          *b      The second string
+ *  @param[in]          len     The number of bytes to compare
+ *
+ *  @return             TRUE if the strings are the same, otherwise FALSE
+ *
+ * ************************************************************************** */
+
+static int
+search_equal_icase (char *a, char *b, size_t len)
+{
+  size_t i;
+  unsigned char *ua = (unsigned char *) a;
+  unsigned char *ub = (unsigned char *) b;
+
+  i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= len; i += 16)
+  {
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (search_fold_block (_mm_loadu_si128 ((__m128i *) &ua[i])),
+                                           search_fold_block (_mm_loadu_si128 ((__m128i *) &ub[i])))) != 0xffff)
+      return FALSE;
+  }
+#endif
+
+  for (; i < len; i++)
+  {
+    if (FOLD (ua[i], TRUE) != FOLD (ub[i], TRUE))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the first match of a pattern, ignoring case
+ *
+ *  @param[in]          *pattern    The compiled pattern
+ *  @param[in]          *hay        The text to search
+ *  @param[in]          hay_len     The length of the text
+ *
+ *  @return             A pointer to the first match, or NULL
+ *
+ *  @details
+ *
+ *  This is the same first and last byte filter as search_next, with one extra
+ *  instruction for every 16 windows. When the first or last byte of the needle
+ *  is a letter, its 0x20 bit is set in the text before comparing against the
+ *  lower case letter, which matches exactly the upper and lower case letter.
+ *  The text is never copied or folded as a whole, only the windows which pass
+ *  the filter are compared in full.
+ *
+ * ************************************************************************** */
+
+static char *
+search_next_icase (SEARCH_PATTERN *pattern, char *hay, size_t hay_len)
+{
+  size_t i;
+  size_t len = pattern->len;
+  unsigned char first;
+  unsigned char last;
+  unsigned char *h = (unsigned char *) hay;
+
+#ifdef __SSE2__
+  unsigned int mask;
+  __m128i v_first;
+  __m128i v_last;
+  __m128i v_first_case;
+  __m128i v_last_case;
+  __m128i block_first;
+  __m128i block_last;
+#endif
+
+  first = (unsigned char) FOLD ((unsigned char) pattern->needle[0], TRUE);
+  last = (unsigned char) FOLD ((unsigned char) pattern->needle[len - 1], TRUE);
+  i = 0;
+
+#ifdef __SSE2__
+  v_first = _mm_set1_epi8 ((char) first);
+  v_last = _mm_set1_epi8 ((char) last);
+  v_first_case = _mm_set1_epi8 ((unsigned) (first - 'a') < 26 ? 0x20 : 0);
+  v_last_case = _mm_set1_epi8 ((unsigned) (last - 'a') < 26 ? 0x20 : 0);
+
+  for (; i + len + 15 <= hay_len; i += 16)
+  {
+    block_first = _mm_or_si128 (_mm_loadu_si128 ((__m128i *) &hay[i]), v_first_case);
+    block_last = _mm_or_si128 (_mm_loadu_si128 ((__m128i *) &hay[i + len - 1]), v_last_case);
+    mask = (unsigned int) _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (block_first, v_first),
+                                                            _mm_cmpeq_epi8 (block_last, v_last)));
+
+    while (mask)
+    {
+      if (search_equal_icase (&hay[i + (size_t) __builtin_ctz (mask)], pattern->needle, len))
+        return &hay[i + (size_t) __builtin_ctz (mask)];
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  /*
+   * Deal with whatever is left over which is too short for a full block
+   */
+
+  for (; i + len <= hay_len; i++)
+  {
+    if (FOLD (h[i], TRUE) == first && FOLD (h[i + len - 1], TRUE) == last && search_equal_icase (&hay[i], pattern->needle, len))
+      return &hay[i];
+  }
+
+  return NULL;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the first match of a pattern in some text
+ *
+ *  @param[in]          *pattern    The compiled pattern
+ *  @param[in]          *hay        The text to search, which can contain NUL
+ *                                  bytes
+ *  @param[in]          hay_len     The length of the text
+ *
+ *  @return             A pointer to the first match, or NULL
+ *
+ *  @details
+ *
+ *  Single bytes use memchr and long needles use Two-Way. Otherwise, the first
+ *  and last byte of the needle are compared against 16 windows of the text at
+ *  a time using SSE2, and only the windows where both bytes match are compared
+ *  in full. This rejects almost every window with two loads and a compare,
+ *  which is much faster than strstr for the short needles typed into the
+ *  search prompt. Case insensitive patterns go through search_next_icase, or
+ *  Two-Way with folding, so exact case searches don't pay for folding.
+ *
+ * ************************************************************************** */
+
+char *
+search_next (SEARCH_PATTERN *pattern, char *hay, size_t hay_len)
+{
+  size_t i;
+  size_t len = pattern->len;
+  char first;
+  char last;
+  char *needle = pattern->needle;
+  char *p;
+
+#ifdef __SSE2__
+  unsigned int mask;
+  __m128i v_first;
+  __m128i v_last;
+  __m128i block_first;
+  __m128i block_last;
+#endif
+
+  if (len == 0)
+    return hay;
+  if (len > hay_len)
+    return NULL;
+  if (pattern->icase)
+    return len >= SEARCH_TWO_WAY_MIN ? search_two_way (pattern, hay, hay_len, TRUE)
+                                     : search_next_icase (pattern, hay, hay_len);
+  if (len == 1)
+    return memchr (hay, needle[0], hay_len);
+  if (len >= SEARCH_TWO_WAY_MIN)
+    return search_two_way (pattern, hay, hay_len, FALSE);
+
+  first = needle[0];
+  last = needle[len - 1];
+  i = 0;
+
+#ifdef __SSE2__
+  v_first = _mm_set1_epi8 (first);
+  v_last = _mm_set1_epi8 (last);
+
+  for (; i + len + 15 <= hay_len; i += 16)
+  {
+    block_first = _mm_loadu_si128 ((__m128i *) &hay[i]);
+    block_last = _mm_loadu_si128 ((__m128i *) &hay[i + len - 1]);
+    mask = (unsigned int) _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (block_first, v_first),
+                                                            _mm_cmpeq_epi8 (block_last, v_last)));
+
+    while (mask)
+    {
+      p = &hay[i + (size_t) __builtin_ctz (mask)];
+      if (!memcmp (p + 1, needle + 1, len - 2))
+        return p;
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  /*
+   * Deal with whatever is left over which is too short for a full block
+   */
+
+  for (; i + len <= hay_len; i++)
+  {
+    if (!(p = memchr (&hay[i], first, hay_len - len - i + 1)))
+      return NULL;
+    i = (size_t) (p - hay);
+    if (p[len - 1] == last && !memcmp (p + 1, needle + 1, len - 2))
+      return p;
+  }
+
+  return NULL;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find every match of a pattern in some text
+ *
+ *  @param[in]          *pattern    The compiled pattern
+ *  @param[in]          *hay        The text to search
+ *  @param[in]          hay_len     The length of the text
+ *  @param[in,out]      *matches    The match positions, relative to hay, are
+ *                                  appended to this
+ *
+ *  @return             The number of matches found
+ *
+ *  @details
+ *
+ *  The text can be a single line, or a contiguous block of many lines such as
+ *  a mapped file, as new lines are not treated specially. Matches do not
+ *  overlap, so searching for "aa" in "aaaa" finds two matches.
+ *
+ * ************************************************************************** */
+
+size_t
+search_all (SEARCH_PATTERN *pattern, char *hay, size_t hay_len, SEARCH_MATCHES *matches)
+{
+  size_t nfound;
+  size_t step;
+  char *p;
+  char *start = hay;
+  char *end = hay + hay_len;
+
+  nfound = 0;
+  step = pattern->len ? pattern->len : 1;
+
+  while (hay < end && (p = search_next (pattern, hay, (size_t) (end - hay))))
+  {
+    if (matches->npos == matches->capacity)
+    {
+      matches->capacity = matches->capacity ? matches->capacity * 2 : 64;
+      if (!(matches->pos = realloc (matches->pos, matches->capacity * sizeof (*matches->pos))))
+        util_exit ("Couldn't allocate memory for search matches");
+    }
+
+    matches->pos[matches->npos++] = (size_t) (p - start);
+    nfound++;
+    hay = p + step;
+  }
+
+  return nfound;
+}
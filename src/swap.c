@@ -0,0 +1,789 @@
+/** **************************************************************************
+ *
+ * @file swap.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for autosaving the text buffer to a swap file.
+ *
+ * ************************************************************************** */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kris.h"
+
+/*
+ * A swap file is a header followed by deltas. The header is SWAP_MAGIC and
+ * the size of the file the deltas apply to. Each delta is SWAP_DELTA_MAGIC,
+ * then the number of lines, moves and changed lines as uint64_t. The moves
+ * follow as the dest, src and count given to line_move, then each changed
+ * line as its index, length and text. Last is a hash of the whole delta, so
+ * a delta which was only partly written is ignored
+ */
+
+#define SWAP_MAGIC "KRISSWP1"
+#define SWAP_HEADER_LEN (sizeof SWAP_MAGIC - 1 + sizeof (uint64_t))
+#define SWAP_DELTA_MAGIC "DELT"
+#define SWAP_DELTA_HEADER_LEN (sizeof SWAP_DELTA_MAGIC - 1 + 3 * sizeof (uint64_t))
+
+/** **************************************************************************
+ *
+ *  @brief              Get the time in seconds from a monotonic clock
+ *
+ *  @return             The time in seconds
+ *
+ * ************************************************************************** */
+
+static double
+swap_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Hash some bytes with 64-bit FNV-1a
+ *
+ *  @param[in]          *data     The bytes to hash
+ *  @param[in]          len       The number of bytes
+ *
+ *  @return             The hash
+ *
+ * ************************************************************************** */
+
+static uint64_t
+swap_hash (char *data, size_t len)
+{
+  size_t i;
+  uint64_t hash = 0xcbf29ce484222325;
+
+  for (i = 0; i < len; i++)
+    hash = (hash ^ (unsigned char) data[i]) * 0x100000001b3;
+
+  return hash;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Append bytes to the delta
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          *data     The bytes to append
+ *  @param[in]          len       The number of bytes
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+swap_append (EDITOR_BUFFER *buf, void *data, size_t len)
+{
+  SWAP_FILE *swap = &buf->swap;
+
+  if (swap->delta_len + len > swap->delta_capacity)
+  {
+    swap->delta_capacity = swap->delta_len + len > 2 * swap->delta_capacity ? swap->delta_len + len
+                                                                          : 2 * swap->delta_capacity;
+    if (!(swap->delta = realloc (swap->delta, swap->delta_capacity)))
+      util_exit ("Couldn't allocate memory for the swap file");
+  }
+
+  memcpy (&swap->delta[swap->delta_len], data, len);
+  swap->delta_len += len;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write a buffer to the swap file no faster than
+ *                      SWAP_WRITE_RATE
+ *
+ *  @param[in]          *swap       The swap file
+ *  @param[in]          *buf        The buffer to write
+ *  @param[in]          buf_len     The number of bytes to write
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ *  @details
+ *
+ *  The buffer is written a chunk at a time, sleeping after each chunk, so
+ *  writing a big delta doesn't hog the disk while the user is working.
+ *
+ * ************************************************************************** */
+
+static int
+swap_write_limited (SWAP_FILE *swap, char *buf, size_t buf_len)
+{
+  size_t chunk;
+  struct timespec pause;
+
+  pause.tv_sec = 0;
+  pause.tv_nsec = (long) (1e9 * SWAP_WRITE_CHUNK / SWAP_WRITE_RATE);
+
+  while (buf_len > 0)
+  {
+    chunk = buf_len < SWAP_WRITE_CHUNK ? buf_len : SWAP_WRITE_CHUNK;
+    if (io_write_all (swap->fd, buf, chunk) == FAILURE)
+      return FAILURE;
+
+    buf += chunk;
+    buf_len -= chunk;
+    if (buf_len > 0)
+      nanosleep (&pause, NULL);
+  }
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the header of the swap file
+ *
+ *  @param[in]          *swap     The swap file
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ *  @details
+ *
+ *  The swap file is opened for appending, so once it's been truncated the
+ *  header is written at the start.
+ *
+ * ************************************************************************** */
+
+static int
+swap_write_header (SWAP_FILE *swap)
+{
+  uint64_t size = swap->base_size;
+  char header[SWAP_HEADER_LEN];
+
+  memcpy (header, SWAP_MAGIC, sizeof SWAP_MAGIC - 1);
+  memcpy (&header[sizeof SWAP_MAGIC - 1], &size, sizeof size);
+
+  if (ftruncate (swap->fd, 0) == -1 || io_write_all (swap->fd, header, sizeof header) == FAILURE)
+    return FAILURE;
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the delta to the swap file
+ *
+ *  @param[in]          *arg      The swap file to write
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This runs on a worker thread. The main thread doesn't touch the delta or
+ *  the file until the job has finished.
+ *
+ * ************************************************************************** */
+
+static void
+swap_write (void *arg)
+{
+  SWAP_FILE *swap = arg;
+
+  if ((swap->rewrite && swap_write_header (swap) == FAILURE)
+      || swap_write_limited (swap, swap->delta, swap->delta_len) == FAILURE
+      || fdatasync (swap->fd) == -1)
+    swap->failed = errno;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start the swap file again from an empty header
+ *
+ *  @param[in,out]      *buf         The buffer
+ *  @param[in]          base_size    The size of the file on disk
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+swap_reset (EDITOR_BUFFER *buf, size_t base_size)
+{
+  SWAP_FILE *swap = &buf->swap;
+
+  swap->base_size = base_size;
+  swap->file_size = SWAP_HEADER_LEN;
+  swap->nmoves = 0;
+
+  if (swap_write_header (swap) == FAILURE)
+    swap->failed = errno;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the end of a delta in a swap file
+ *
+ *  @param[in]          *data     The swap file
+ *  @param[in]          len       The length of the swap file
+ *  @param[in]          pos       Where the delta starts
+ *
+ *  @return             Where the delta ends, or NO_MATCH if it's not whole
+ *
+ * ************************************************************************** */
+
+static size_t
+swap_delta_end (char *data, size_t len, size_t pos)
+{
+  size_t i;
+  size_t start;
+  uint64_t hash;
+  uint64_t fields[3];
+  uint64_t entry[2];
+
+  start = pos;
+  if (len - pos < SWAP_DELTA_HEADER_LEN || memcmp (&data[pos], SWAP_DELTA_MAGIC, sizeof SWAP_DELTA_MAGIC - 1))
+    return NO_MATCH;
+
+  memcpy (fields, &data[pos + sizeof SWAP_DELTA_MAGIC - 1], sizeof fields);
+  pos += SWAP_DELTA_HEADER_LEN;
+
+  if (fields[1] > (len - pos) / sizeof (SWAP_MOVE))
+    return NO_MATCH;
+  pos += fields[1] * sizeof (SWAP_MOVE);
+
+  for (i = 0; i < fields[2]; i++)
+  {
+    if (len - pos < sizeof entry)
+      return NO_MATCH;
+    memcpy (entry, &data[pos], sizeof entry);
+    pos += sizeof entry;
+    if (entry[1] > len - pos)
+      return NO_MATCH;
+    pos += entry[1];
+  }
+
+  if (len - pos < sizeof hash)
+    return NO_MATCH;
+  memcpy (&hash, &data[pos], sizeof hash);
+  if (hash != swap_hash (&data[start], pos - start))
+    return NO_MATCH;
+
+  return pos + sizeof hash;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Make sure the recovered lines have space for a line
+ *
+ *  @param[in,out]      ***text       The text of each line
+ *  @param[in,out]      **text_len    The length of each line
+ *  @param[in,out]      *capacity     The number of lines allocated
+ *  @param[in]          nlines        The number of lines needed
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+swap_reserve (char ***text, size_t **text_len, size_t *capacity, size_t nlines)
+{
+  size_t new_capacity;
+
+  if (nlines <= *capacity)
+    return;
+
+  new_capacity = *capacity ? *capacity : 64;
+  while (new_capacity < nlines)
+    new_capacity *= 2;
+
+  if (!(*text = realloc (*text, new_capacity * sizeof (**text)))
+      || !(*text_len = realloc (*text_len, new_capacity * sizeof (**text_len))))
+    util_exit ("Couldn't allocate memory to restore the swap file");
+
+  memset (&(*text)[*capacity], 0, (new_capacity - *capacity) * sizeof (**text));
+  memset (&(*text_len)[*capacity], 0, (new_capacity - *capacity) * sizeof (**text_len));
+  *capacity = new_capacity;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Apply the deltas in a swap file to the text buffer
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          *data     The swap file, after the header
+ *  @param[in]          len       The number of bytes of deltas
+ *
+ *  @return             The number of deltas applied
+ *
+ *  @details
+ *
+ *  The deltas are first played over a list of pointers to the lines, so the
+ *  moves are cheap and the text of each line is only copied once. The text
+ *  buffer is then replaced in one delete and one insert, which also puts the
+ *  restored text into the journal.
+ *
+ * ************************************************************************** */
+
+static size_t
+swap_recover (EDITOR_BUFFER *buf, char *data, size_t len)
+{
+  char *p;
+  char *all;
+  char **text;
+
+  size_t i;
+  size_t pos;
+  size_t end;
+  size_t nlines;
+  size_t all_len;
+  size_t capacity;
+  size_t ndeltas;
+  size_t *text_len;
+
+  uint64_t fields[3];
+  uint64_t entry[2];
+  SWAP_MOVE move;
+
+  /*
+   * Start from the lines of the file, which has just been read in
+   */
+
+  text = NULL;
+  text_len = NULL;
+  capacity = 0;
+  nlines = buf->nlines;
+  swap_reserve (&text, &text_len, &capacity, nlines);
+  for (i = 0; i < nlines; i++)
+  {
+    text[i] = buf->lines.chars[i];
+    text_len[i] = buf->lines.len[i];
+  }
+
+  /*
+   * Play each whole delta: the moves, then the text of the changed lines
+   */
+
+  ndeltas = 0;
+  for (pos = 0; (end = swap_delta_end (data, len, pos)) != NO_MATCH; pos = end)
+  {
+    memcpy (fields, &data[pos + sizeof SWAP_DELTA_MAGIC - 1], sizeof fields);
+    pos += SWAP_DELTA_HEADER_LEN;
+
+    for (i = 0; i < fields[1]; i++, pos += sizeof move)
+    {
+      memcpy (&move, &data[pos], sizeof move);
+      swap_reserve (&text, &text_len, &capacity, (move.dest > move.src ? move.dest : move.src) + move.nmove);
+      memmove (&text[move.dest], &text[move.src], move.nmove * sizeof (*text));
+      memmove (&text_len[move.dest], &text_len[move.src], move.nmove * sizeof (*text_len));
+    }
+
+    nlines = fields[0];
+    swap_reserve (&text, &text_len, &capacity, nlines);
+
+    for (i = 0; i < fields[2]; i++)
+    {
+      memcpy (entry, &data[pos], sizeof entry);
+      pos += sizeof entry;
+      if (entry[0] < nlines)
+      {
+        text[entry[0]] = &data[pos];
+        text_len[entry[0]] = entry[1];
+      }
+      pos += entry[1];
+    }
+
+    ndeltas++;
+  }
+
+  if (ndeltas == 0)
+  {
+    free (text);
+    free (text_len);
+    return 0;
+  }
+
+  /*
+   * Join the lines up and swap them in for the text buffer
+   */
+
+  all_len = 0;
+  for (i = 0; i < nlines; i++)
+    all_len += text_len[i] + 1;
+
+  if (!(p = all = malloc (all_len + 1)))
+    util_exit ("Couldn't allocate memory to restore the swap file");
+
+  for (i = 0; i < nlines; i++)
+  {
+    memcpy (p, text[i], text_len[i]);
+    p += text_len[i];
+    *p++ = '\n';
+  }
+
+  buf->undo.suspended++;
+  if (buf->nlines == 0)
+    line_add_to_text_buffer (buf, 0, "", 0);
+  line_delete_text (buf, 0, 0, SIZE_MAX);
+  line_insert_text (buf, 0, 0, all, all_len > 0 ? all_len - 1 : 0);
+  buf->undo.suspended--;
+  undo_clear (buf);
+  buf->undo.saved = NO_MATCH;
+  buf->cx = buf->cy = 0;
+
+  free (all);
+  free (text);
+  free (text_len);
+
+  return ndeltas;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Open a swap file, creating it if need be
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          *path     The path of the swap file
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ * ************************************************************************** */
+
+static int
+swap_open_file (EDITOR_BUFFER *buf, char *path)
+{
+  SWAP_FILE *swap = &buf->swap;
+
+  swap->path = path;
+  if ((swap->fd = open (swap->path, O_RDWR | O_CREAT | O_APPEND, 0600)) == -1)
+  {
+    util_message ("Couldn't open the swap file %s: %s", swap->path, strerror (errno));
+    free (swap->path);
+    swap->path = NULL;
+    return FAILURE;
+  }
+
+  swap->failed = 0;
+  swap->nmoves = 0;
+  swap->last_save = swap_now ();
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start autosaving the text buffer to a swap file
+ *
+ *  @param[in,out]      *buf          The buffer
+ *  @param[in]          *filename     The file in the text buffer
+ *  @param[in]          *restore (char *, int)    A function to ask whether to
+ *                                                restore an old swap file for
+ *                                                the file, which is told if
+ *                                                the file has changed since,
+ *                                                or NULL to never restore one
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  If there's already a swap file with autosaves in it, the editor died
+ *  before the file was saved, so restore is asked whether to restore it. This
+ *  isn't asked if edits were just recovered from the journal, as the journal
+ *  is never behind the swap file. The swap file's header has the size of the
+ *  file the deltas apply to, so restore is told if the file is now a
+ *  different size.
+ *
+ * ************************************************************************** */
+
+void
+swap_open (EDITOR_BUFFER *buf, char *filename, int (*restore) (char *, int))
+{
+  char *data;
+  size_t ndeltas;
+  uint64_t base_size;
+  struct stat file_stat;
+  struct stat swap_stat;
+  SWAP_FILE *swap = &buf->swap;
+
+  swap_close (buf, FALSE);
+
+  if (swap_open_file (buf, util_hidden_path (filename, SWAP_SUFFIX)) == FAILURE)
+    return;
+
+  if (stat (filename, &file_stat) == -1)
+    file_stat.st_size = 0;
+
+  /*
+   * Read in an old swap file, if there is one with any deltas
+   */
+
+  data = NULL;
+  if (!buf->modified && fstat (swap->fd, &swap_stat) == 0 && (size_t) swap_stat.st_size > SWAP_HEADER_LEN)
+  {
+    if (!(data = malloc ((size_t) swap_stat.st_size)))
+      util_exit ("Couldn't allocate memory for the swap file");
+
+    if (pread (swap->fd, data, (size_t) swap_stat.st_size, 0) != swap_stat.st_size
+        || memcmp (data, SWAP_MAGIC, sizeof SWAP_MAGIC - 1))
+    {
+      free (data);
+      data = NULL;
+    }
+  }
+
+  /*
+   * Ask whether to restore the autosave, saying if the file has changed since
+   * the deltas were written, as they would then be applied to different lines
+   */
+
+  if (data)
+  {
+    memcpy (&base_size, &data[sizeof SWAP_MAGIC - 1], sizeof base_size);
+    if (restore && restore (filename, base_size != (uint64_t) file_stat.st_size))
+    {
+      ndeltas = swap_recover (buf, &data[SWAP_HEADER_LEN], (size_t) swap_stat.st_size - SWAP_HEADER_LEN);
+      util_message ("Restored %zu autosaves from %s", ndeltas, swap->path);
+    }
+
+    free (data);
+  }
+
+  /*
+   * Anything already changed in the text buffer isn't in the swap file, so
+   * the first autosave has to write every line
+   */
+
+  swap_reset (buf, (size_t) file_stat.st_size);
+  swap->full = buf->modified != 0;
+  buf->lines.generation++;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Remember some lines have been moved
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          dest      Where the lines were moved to
+ *  @param[in]          src       Where the lines were moved from
+ *  @param[in]          nmove     The number of lines moved
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is called by line_move, so the next autosave can move the lines in
+ *  the swap file rather than writing them all out again.
+ *
+ * ************************************************************************** */
+
+void
+swap_move_lines (EDITOR_BUFFER *buf, size_t dest, size_t src, size_t nmove)
+{
+  SWAP_FILE *swap = &buf->swap;
+
+  if (swap->fd == -1 || swap->full || nmove == 0)
+    return;
+
+  if (swap->nmoves == swap->moves_capacity)
+  {
+    swap->moves_capacity = swap->moves_capacity ? 2 * swap->moves_capacity : 64;
+    if (!(swap->moves = realloc (swap->moves, swap->moves_capacity * sizeof (*swap->moves))))
+      util_exit ("Couldn't allocate memory for the swap file");
+  }
+
+  swap->moves[swap->nmoves++] = (SWAP_MOVE) {dest, src, nmove};
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Autosave the text buffer if it's time to
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is called while waiting for a key press. Every SWAP_INTERVAL_MS, a
+ *  delta of the lines changed since the last autosave is put together and
+ *  handed to a worker to write out, so the swap file is always made from a
+ *  consistent snapshot of the text buffer. Only the changed lines are copied,
+ *  but the changed_gen of every line is checked to find them. When the swap
+ *  file gets much bigger than the text buffer, it is started again with every
+ *  line in one delta.
+ *
+ * ************************************************************************** */
+
+void
+swap_tick (EDITOR_BUFFER *buf)
+{
+  size_t i;
+  size_t ndirty;
+  size_t text_len;
+  size_t gen;
+  uint64_t fields[3];
+  uint64_t entry[2];
+  uint64_t hash;
+  EDITOR_LINES *lines = &buf->lines;
+  SWAP_FILE *swap = &buf->swap;
+
+  if (swap->fd == -1 || swap_now () - swap->last_save < SWAP_INTERVAL_MS / 1000.0
+      || !pool_group_done (&swap->group))
+    return;
+
+  swap->last_save = swap_now ();
+  if (swap->failed)
+  {
+    util_message ("Couldn't write the swap file %s: %s", swap->path, strerror (swap->failed));
+    swap->failed = 0;
+    swap->full = TRUE;
+  }
+
+  /*
+   * Count the changed lines, and check if it's time to start the file again
+   */
+
+  gen = lines->generation;
+  ndirty = 0;
+  text_len = 0;
+  for (i = 0; i < buf->nlines; i++)
+  {
+    ndirty += lines->changed_gen[i] == gen;
+    text_len += lines->len[i] + 1;
+  }
+
+  if (ndirty == 0 && swap->nmoves == 0 && !swap->full)
+    return;
+
+  if (swap->file_size > 2 * text_len + 16 * SWAP_WRITE_CHUNK)
+    swap->full = TRUE;
+
+  if (swap->full)
+  {
+    swap->nmoves = 0;
+    ndirty = buf->nlines;
+  }
+
+  /*
+   * Put the delta together
+   */
+
+  swap->delta_len = 0;
+  fields[0] = buf->nlines;
+  fields[1] = swap->nmoves;
+  fields[2] = ndirty;
+  swap_append (buf, SWAP_DELTA_MAGIC, sizeof SWAP_DELTA_MAGIC - 1);
+  swap_append (buf, fields, sizeof fields);
+  swap_append (buf, swap->moves, swap->nmoves * sizeof (*swap->moves));
+
+  for (i = 0; i < buf->nlines; i++)
+  {
+    if (swap->full || lines->changed_gen[i] == gen)
+    {
+      entry[0] = i;
+      entry[1] = lines->len[i];
+      swap_append (buf, entry, sizeof entry);
+      swap_append (buf, lines->chars[i], lines->len[i]);
+    }
+  }
+
+  hash = swap_hash (swap->delta, swap->delta_len);
+  swap_append (buf, &hash, sizeof hash);
+
+  /*
+   * Hand it over to the writer. A full delta replaces everything before it
+   */
+
+  swap->rewrite = swap->full;
+  swap->file_size = (swap->full ? SWAP_HEADER_LEN : swap->file_size) + swap->delta_len;
+  swap->full = FALSE;
+  swap->nmoves = 0;
+  lines->generation++;
+
+  pool_submit (&swap->group, swap_write, swap);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start the swap file again after the file is saved
+ *
+ *  @param[in,out]      *buf          The buffer
+ *  @param[in]          *filename     The file which was saved
+ *  @param[in]          file_size     The size of the saved file
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Every line is now in the file, so the swap file is emptied and the lines
+ *  are no longer counted as changed. If the file was saved under a new name,
+ *  the swap file moves with it.
+ *
+ * ************************************************************************** */
+
+void
+swap_saved (EDITOR_BUFFER *buf, char *filename, size_t file_size)
+{
+  char *path;
+  SWAP_FILE *swap = &buf->swap;
+
+  path = util_hidden_path (filename, SWAP_SUFFIX);
+  if (swap->fd == -1 || strcmp (path, swap->path))
+  {
+    swap_close (buf, TRUE);
+    if (swap_open_file (buf, path) == FAILURE)
+      return;
+  }
+  else
+  {
+    free (path);
+    pool_wait (&swap->group);
+  }
+
+  swap_reset (buf, file_size);
+  swap->full = FALSE;
+  buf->lines.generation++;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Stop autosaving the text buffer
+ *
+ *  @param[in,out]      *buf       The buffer
+ *  @param[in]          discard    TRUE to delete the swap file even if there
+ *                                 are unsaved edits
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The swap file is kept if the text buffer has unsaved edits in it, so they
+ *  can be restored from it.
+ *
+ * ************************************************************************** */
+
+void
+swap_close (EDITOR_BUFFER *buf, int discard)
+{
+  SWAP_FILE *swap = &buf->swap;
+
+  if (swap->fd == -1)
+    return;
+
+  pool_wait (&swap->group);
+  if (discard || !buf->modified)
+    unlink (swap->path);
+
+  close (swap->fd);
+  free (swap->path);
+  free (swap->moves);
+  free (swap->delta);
+  *swap = (SWAP_FILE) {-1, NULL, 0, 0, NULL, 0, 0, NULL, 0, 0, FALSE, FALSE, 0, 0, POOL_GROUP_INIT};
+}
@@ -10,6 +10,7 @@
  *
  * ************************************************************************** */
 
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -18,6 +19,8 @@
 
 #include "kris.h"
 
+static volatile sig_atomic_t terminal_resized = FALSE;
+
 /** **************************************************************************
  *
  *  @brief              Set the original terminal flags at exit and clean memory
@@ -44,6 +47,25 @@ terminal_revert (void)
     util_exit ("Can't set terminal attributes");
 }
 
+/** **************************************************************************
+ *
+ *  @brief              Clear the screen before the editor is killed by
+ *                      util_exit
+ *
+ *  @param[in]          *message    The error message, which is printed once
+ *                                  this returns
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+terminal_fatal (const char *message)
+{
+  (void) message;
+  util_reset_display ();
+}
+
 /** **************************************************************************
  *
  *  @brief              Enable raw terminal mode by changing terminal flags
@@ -64,6 +86,8 @@ terminal_init (void)
 {
   struct termios raw_term;
 
+  util_on_fatal (terminal_fatal);
+
   /*
    * Get the original attributes of the terminal before it is changed to raw
    * mode and assign to exit function to run at exit which will re-enable the
@@ -197,7 +221,7 @@ terminal_get_window_size (int *ncols, int *nrows)
 
 /** **************************************************************************
  *
- *  @brief              If a SIGWINCH is sent, update the terminal size
+ *  @brief              Note that a SIGWINCH has been sent
  *
  *  @param[in]          unused    an unused variable which is required for signal
  *
@@ -205,22 +229,113 @@ terminal_get_window_size (int *ncols, int *nrows)
  *
  *  @details
  *
- *  This is called by signal. When signal detects a SIGWINCH signal, then this
- *  function is called and the terminal size is determined again. The screen is
- *  then refreshed.
+ *  This is called by signal when the terminal changes size. The signal can
+ *  arrive part way through drawing the screen, so the frame and windows can't
+ *  be touched here. A flag is set instead, which terminal_resize checks before
+ *  the screen is next refreshed.
+ *
+ * ************************************************************************** */
+
+void
+terminal_on_resize (int unused)
+{
+  (void) unused;
+  terminal_resized = TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the terminal size if a SIGWINCH has been sent
+ *
+ *  @return             TRUE if the size was updated, FALSE otherwise
+ *
+ * ************************************************************************** */
+
+int
+terminal_resize (void)
+{
+  if (!terminal_resized)
+    return FALSE;
+
+  terminal_resized = FALSE;
+  terminal_update_size ();
+
+  return TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the terminal size
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The terminal size is determined again, the windows are laid out to fit it
+ *  and the whole screen is marked to be drawn again at the next refresh.
  *
  * ************************************************************************** */
 
 void
-terminal_update_size (int unused)
+terminal_update_size (void)
 {
   terminal_get_window_size (&editor.screen_cols, &editor.screen_rows);
+  window_layout ();
+  editor_damage_all ();
+
+  if (editor.buf->cy > (size_t) editor.screen_rows)
+    editor.buf->cy = (size_t) editor.screen_rows - 1;
 
-  if (editor.cy > editor.screen_rows)
-    editor.cy = editor.screen_rows - 1;
+  if (editor.buf->cx > (size_t) editor.screen_cols)
+    editor.buf->cx = (size_t) editor.screen_cols - 1;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Refresh the terminal screen
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Resets the terminal display by clearing everything and repositioning the
+ *  cursor or something. Can't quite remember what it's doing exactly.
+ *
+ * ************************************************************************** */
 
-  if (editor.cx > editor.screen_cols)
-    editor.cx = editor.screen_cols - 1;
+void
+util_reset_display (void)
+{
+  /*
+   * \x1b is the escape character
+   * \x1b[ is an escape sequence
+   */
+
+  write (STDOUT_FILENO, "\x1b[2J", 4);   // erase screen
+  write (STDOUT_FILENO, "\x1b[H", 3);    // reposition the cursor
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free memory to avoid any memory leaks at exit
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Frees every buffer, which frees each line in its text buffer, its file name
+ *  and then finally the arrays of the entire text buffer. The windows and the
+ *  rows last drawn to the screen go too.
+ *
+ * ************************************************************************** */
+
+void
+util_clean_memory (void)
+{
+  while (editor.nbuffers > 0)
+    buffer_free (editor.nbuffers - 1, FALSE);
 
-  editor_refresh_screen ();
+  free (editor.buffers);
+  window_free (editor.root);
+  editor_damage_all ();
 }
@@ -0,0 +1,253 @@
+/** **************************************************************************
+ *
+ * @file trace.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for recording trace events and writing them out in the
+ *        Chrome trace event format, for viewing in chrome://tracing or
+ *        Perfetto. Only built with the KRIS_TRACE option.
+ *
+ * @details
+ *
+ * Each thread records its events into its own ring buffer, so recording an
+ * event never takes a lock. When a ring is full the oldest events are
+ * overwritten. The rings are kept in a list which is only ever pushed to,
+ * so they can be walked at any time to write out the trace.
+ *
+ * ************************************************************************** */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kris.h"
+
+typedef struct
+{
+  const char *name;                // Name of the event, which must outlive the trace
+  double ts;                       // When the event happened, in seconds
+  char phase;                      // 'B' for begin or 'E' for end
+} TRACE_EVENT;
+
+typedef struct TRACE_RING
+{
+  TRACE_EVENT events[TRACE_RING_SIZE];
+  _Atomic size_t head;             // Number of events ever recorded
+  int tid;                         // The thread id shown in the trace
+  struct TRACE_RING *next;         // The ring of the thread traced before
+} TRACE_RING;
+
+static struct
+{
+  pthread_once_t once;             // Guards the start time and atexit
+  double start;                    // When tracing started
+  _Atomic (TRACE_RING *) rings;    // The rings of every thread traced
+  atomic_int nthreads;             // Number of threads traced
+} trace = {PTHREAD_ONCE_INIT, 0, NULL, 0};
+
+static _Thread_local TRACE_RING *trace_ring = NULL;
+
+/** **************************************************************************
+ *
+ *  @brief              Get the time from a monotonic clock
+ *
+ *  @return             The time in seconds
+ *
+ * ************************************************************************** */
+
+static double
+trace_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the trace at exit
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+trace_dump_at_exit (void)
+{
+  trace_dump ();
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start tracing, the first time any thread records an
+ *                      event
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+trace_init (void)
+{
+  trace.start = trace_now ();
+  atexit (trace_dump_at_exit);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Create the ring for this thread and add it to the list
+ *                      of rings
+ *
+ *  @return             The ring for this thread
+ *
+ * ************************************************************************** */
+
+static TRACE_RING *
+trace_new_ring (void)
+{
+  TRACE_RING *ring;
+
+  pthread_once (&trace.once, trace_init);
+
+  if (!(ring = calloc (1, sizeof *ring)))
+    util_exit ("Couldn't allocate memory for the trace ring buffer");
+
+  ring->tid = atomic_fetch_add (&trace.nthreads, 1) + 1;
+  ring->next = atomic_load (&trace.rings);
+  while (!atomic_compare_exchange_weak (&trace.rings, &ring->next, ring))
+    ;
+
+  return ring;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Record a trace event for this thread
+ *
+ *  @param[in]          *name     The name of the event
+ *  @param[in]          phase     'B' to begin the event or 'E' to end it
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Only this thread writes to its ring, so the event is filled in first and
+ *  then published by moving the head on.
+ *
+ * ************************************************************************** */
+
+void
+trace_event (const char *name, char phase)
+{
+  size_t head;
+  TRACE_EVENT *event;
+
+  if (trace_ring == NULL)
+    trace_ring = trace_new_ring ();
+
+  head = atomic_load_explicit (&trace_ring->head, memory_order_relaxed);
+  event = &trace_ring->events[head % TRACE_RING_SIZE];
+  event->name = name;
+  event->ts = trace_now ();
+  event->phase = phase;
+  atomic_store_explicit (&trace_ring->head, head + 1, memory_order_release);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Begin an event which is ended by trace_scope_end
+ *
+ *  @param[in]          *name     The name of the event
+ *
+ *  @return             The name, for trace_scope_end
+ *
+ * ************************************************************************** */
+
+const char *
+trace_scope_begin (const char *name)
+{
+  trace_event (name, 'B');
+
+  return name;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              End an event begun by trace_scope_begin, when the
+ *                      variable holding its name goes out of scope
+ *
+ *  @param[in]          **name    The variable holding the name of the event
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+trace_scope_end (const char **name)
+{
+  trace_event (*name, 'E');
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Write the events recorded so far to the trace file
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ *  @details
+ *
+ *  The trace is written to the file named by KRIS_TRACE_FILE, or to
+ *  TRACE_DEFAULT_FILE. Each ring is read up to its head when the dump starts,
+ *  so events recorded by other threads while it is written are left for the
+ *  next dump. Events which have been overwritten may leave an end without
+ *  its begin, which trace viewers ignore.
+ *
+ * ************************************************************************** */
+
+int
+trace_dump (void)
+{
+  int first;
+  int pid;
+  size_t i;
+  size_t head;
+  char *path;
+  FILE *file;
+  TRACE_EVENT *event;
+  TRACE_RING *ring;
+
+  if (!(path = getenv ("KRIS_TRACE_FILE")))
+    path = TRACE_DEFAULT_FILE;
+
+  if (!(file = fopen (path, "w")))
+    return FAILURE;
+
+  pid = getpid ();
+  first = TRUE;
+
+  fprintf (file, "{\"traceEvents\":[");
+
+  for (ring = atomic_load (&trace.rings); ring != NULL; ring = ring->next)
+  {
+    head = atomic_load_explicit (&ring->head, memory_order_acquire);
+    for (i = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0; i < head; i++)
+    {
+      event = &ring->events[i % TRACE_RING_SIZE];
+      fprintf (file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", first ? "" : ",",
+               event->name, event->phase, (event->ts - trace.start) * 1e6, pid, ring->tid);
+      first = FALSE;
+    }
+  }
+
+  fprintf (file, "\n]}\n");
+
+  return fclose (file) ? FAILURE : SUCCESS;
+}
@@ -0,0 +1,612 @@
+/** **************************************************************************
+ *
+ * @file trigram.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief An index of which lines contain each trigram, to speed up searching.
+ *
+ * ************************************************************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+/*
+ * Every line is given an id when it is indexed, and the id is added to the
+ * posting list of each trigram in the line. The trigrams are hashed into a
+ * fixed number of buckets, and are case folded, so a posting list can contain
+ * lines which don't contain the exact trigram. This is fine as every candidate
+ * line is checked by the search kernel anyway.
+ *
+ * When a line is edited it gets a new id, which is appended to the end of the
+ * posting lists so they stay sorted. The old id is retired rather than being
+ * removed from every list it is in, and postings for retired ids are skipped.
+ * Once there are more dead postings than live ones, the index is rebuilt.
+ *
+ * The invariant is that the lines before build_pos are indexed and the lines
+ * from build_pos onwards are not. The index is only used for searches once
+ * every line has been indexed.
+ */
+
+#define TRIGRAM_NBUCKETS ((size_t) 1 << TRIGRAM_BUCKET_BITS)
+
+/** **************************************************************************
+ *
+ *  @brief              Get the time in seconds from a monotonic clock
+ *
+ *  @return             The time in seconds
+ *
+ * ************************************************************************** */
+
+static double
+trigram_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Hash the trigram starting at a char into a bucket
+ *
+ *  @param[in]          *s      The first char of the trigram
+ *
+ *  @return             The bucket for the trigram
+ *
+ *  @details
+ *
+ *  ASCII letters are folded to lower case, so the same index can be used for
+ *  case insensitive searches.
+ *
+ * ************************************************************************** */
+
+static size_t
+trigram_hash (char *s)
+{
+  int i;
+  unsigned char c;
+  uint32_t key = 0;
+
+  for (i = 0; i < 3; i++)
+  {
+    c = (unsigned char) s[i];
+    if (c >= 'A' && c <= 'Z')
+      c = (unsigned char) (c - 'A' + 'a');
+    key = (key << 8) | c;
+  }
+
+  return (size_t) ((key * 2654435761u) >> (32 - TRIGRAM_BUCKET_BITS));
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Throw away everything in the index and start again
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The index is rebuilt from the first line in idle time.
+ *
+ * ************************************************************************** */
+
+static void
+trigram_reset (EDITOR_BUFFER *buf)
+{
+  size_t i;
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  for (i = 0; i < TRIGRAM_NBUCKETS; i++)
+    index->lists[i].nids = 0;
+
+  for (i = 0; i < buf->nlines; i++)
+    buf->lines.trigram_id[i] = 0;
+
+  index->nids = 1;
+  index->build_pos = 0;
+  index->npostings = 0;
+  index->ndead = 0;
+  index->build_time = 0;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Add a line to the index
+ *
+ *  @param[in,out]      *buf    The buffer
+ *  @param[in]          idx     The index of the line
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The line is given a new id, which is appended to the posting list of each
+ *  of its trigrams. As the id is always the largest in the index, a trigram
+ *  which appears more than once in the line is spotted by the id already being
+ *  at the end of the list. If the ids have run out, the index is reset
+ *  instead and the line is indexed again when it is rebuilt.
+ *
+ * ************************************************************************** */
+
+static void
+trigram_index_line (EDITOR_BUFFER *buf, size_t idx)
+{
+  size_t i;
+  size_t len;
+  size_t count;
+  uint32_t id;
+
+  char *chars;
+
+  TRIGRAM_LIST *list;
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (index->nids == UINT32_MAX)
+  {
+    trigram_reset (buf);
+    return;
+  }
+
+  if (index->nids >= index->ids_capacity)
+  {
+    index->memory -= index->ids_capacity * (sizeof (*index->id_line) + sizeof (*index->id_count));
+    index->ids_capacity = index->ids_capacity ? index->ids_capacity * 2 : 1024;
+    index->id_line = realloc (index->id_line, index->ids_capacity * sizeof (*index->id_line));
+    index->id_count = realloc (index->id_count, index->ids_capacity * sizeof (*index->id_count));
+    if (!index->id_line || !index->id_count)
+      util_exit ("Couldn't allocate memory for the trigram index");
+    index->memory += index->ids_capacity * (sizeof (*index->id_line) + sizeof (*index->id_count));
+  }
+
+  id = (uint32_t) index->nids++;
+  index->id_line[id] = idx;
+  buf->lines.trigram_id[idx] = id;
+
+  chars = buf->lines.chars[idx];
+  len = buf->lines.len[idx];
+  count = 0;
+
+  for (i = 0; i + 3 <= len; i++)
+  {
+    list = &index->lists[trigram_hash (&chars[i])];
+    if (list->nids && list->ids[list->nids - 1] == id)
+      continue;
+
+    if (list->nids == list->capacity)
+    {
+      index->memory -= list->capacity * sizeof (*list->ids);
+      list->capacity = list->capacity ? list->capacity * 2 : 4;
+      if (!(list->ids = realloc (list->ids, list->capacity * sizeof (*list->ids))))
+        util_exit ("Couldn't allocate memory for the trigram index");
+      index->memory += list->capacity * sizeof (*list->ids);
+    }
+
+    list->ids[list->nids++] = id;
+    count++;
+  }
+
+  index->id_count[id] = (uint32_t) count;
+  index->npostings += count;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Retire the id of a line, so its postings are ignored
+ *
+ *  @param[in,out]      *buf    The buffer
+ *  @param[in]          idx     The index of the line
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+trigram_retire_line (EDITOR_BUFFER *buf, size_t idx)
+{
+  uint32_t id = buf->lines.trigram_id[idx];
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (id == 0)
+    return;
+
+  index->id_line[id] = NO_MATCH;
+  index->ndead += index->id_count[id];
+  buf->lines.trigram_id[idx] = 0;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start keeping a trigram index of the text buffer
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The index is built in the background by trigram_build_slice.
+ *
+ * ************************************************************************** */
+
+void
+trigram_enable (EDITOR_BUFFER *buf)
+{
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (index->enabled)
+    return;
+
+  if (!(index->lists = calloc (TRIGRAM_NBUCKETS, sizeof (*index->lists))))
+    util_exit ("Couldn't allocate memory for the trigram index");
+
+  index->memory = TRIGRAM_NBUCKETS * sizeof (*index->lists);
+  index->enabled = TRUE;
+  trigram_reset (buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Stop keeping a trigram index and free it
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+trigram_disable (EDITOR_BUFFER *buf)
+{
+  size_t i;
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (!index->enabled)
+    return;
+
+  for (i = 0; i < TRIGRAM_NBUCKETS; i++)
+    free (index->lists[i].ids);
+
+  free (index->lists);
+  free (index->id_line);
+  free (index->id_count);
+  memset (index, 0, sizeof (*index));
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Index lines for a short amount of time
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             TRUE if there are still lines to index, otherwise FALSE
+ *
+ *  @details
+ *
+ *  This is called while the editor is waiting for a key press, so the index is
+ *  built without making the editor unresponsive. Each call does at most
+ *  TRIGRAM_SLICE_MS of work. If too much of the index is taken up by dead
+ *  postings, the rebuild is started here too.
+ *
+ * ************************************************************************** */
+
+int
+trigram_build_slice (EDITOR_BUFFER *buf)
+{
+  size_t n;
+  double start;
+  double slice;
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (!index->enabled)
+    return FALSE;
+
+  if (index->build_pos >= buf->nlines && index->ndead > TRIGRAM_SLICE_LINES && index->ndead > index->npostings / 2)
+    trigram_reset (buf);
+
+  if (index->build_pos >= buf->nlines)
+    return FALSE;
+
+  start = trigram_now ();
+  slice = TRIGRAM_SLICE_MS / 1000.0;
+
+  for (n = 0; index->build_pos < buf->nlines; n++)
+  {
+    if (n % TRIGRAM_SLICE_LINES == 0 && n && trigram_now () - start > slice)
+      break;
+    trigram_index_line (buf, index->build_pos++);
+  }
+
+  index->build_time += trigram_now () - start;
+
+  return index->build_pos < buf->nlines;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the index after a line has been edited
+ *
+ *  @param[in,out]      *buf    The buffer
+ *  @param[in]          idx     The index of the line
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+trigram_update_line (EDITOR_BUFFER *buf, size_t idx)
+{
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (!index->enabled || idx >= index->build_pos)
+    return;
+
+  trigram_retire_line (buf, idx);
+  trigram_index_line (buf, idx);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the index after a line has been inserted
+ *
+ *  @param[in,out]      *buf    The buffer
+ *  @param[in]          idx     The index of the new line
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is called after the lines have been shifted and the new line has been
+ *  added. If the line is before build_pos it's indexed straight away, and
+ *  build_pos moves along with the lines after it.
+ *
+ * ************************************************************************** */
+
+void
+trigram_insert_line (EDITOR_BUFFER *buf, size_t idx)
+{
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  buf->lines.trigram_id[idx] = 0;
+
+  if (!index->enabled || idx >= index->build_pos)
+    return;
+
+  index->build_pos++;
+  trigram_index_line (buf, idx);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the index before a line is deleted
+ *
+ *  @param[in,out]      *buf    The buffer
+ *  @param[in]          idx     The index of the line being deleted
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+trigram_delete_line (EDITOR_BUFFER *buf, size_t idx)
+{
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (!index->enabled || idx >= index->build_pos)
+    return;
+
+  trigram_retire_line (buf, idx);
+  index->build_pos--;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Update the line of each id after lines have moved
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          dest      The index the lines were moved to
+ *  @param[in]          nmove     The number of lines which were moved
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is called by line_move, and costs about the same as moving the lines.
+ *
+ * ************************************************************************** */
+
+void
+trigram_move_lines (EDITOR_BUFFER *buf, size_t dest, size_t nmove)
+{
+  size_t i;
+  uint32_t id;
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (!index->enabled)
+    return;
+
+  for (i = dest; i < dest + nmove; i++)
+  {
+    if ((id = buf->lines.trigram_id[i]))
+      index->id_line[id] = i;
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Check if a posting list contains an id
+ *
+ *  @param[in]          *list     The posting list
+ *  @param[in]          id        The id to look for
+ *
+ *  @return             TRUE if the id is in the list, otherwise FALSE
+ *
+ * ************************************************************************** */
+
+static int
+trigram_list_contains (TRIGRAM_LIST *list, uint32_t id)
+{
+  size_t lo = 0;
+  size_t hi = list->nids;
+  size_t mid;
+
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (list->ids[mid] < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo < list->nids && list->ids[lo] == id;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Compare two line indices for qsort
+ *
+ * ************************************************************************** */
+
+static int
+trigram_compare_lines (const void *a, const void *b)
+{
+  size_t x = *(const size_t *) a;
+  size_t y = *(const size_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the lines which might contain a query
+ *
+ *  @param[in]          *buf              The buffer to search
+ *  @param[in]          *query            The query
+ *  @param[in]          len               The length of the query
+ *  @param[out]         *ncandidates      The number of candidate lines
+ *
+ *  @return             The sorted candidate lines, which must be free'd, or
+ *                      NULL if the index can't be used
+ *
+ *  @details
+ *
+ *  A line which contains the query must be in the posting list of every
+ *  trigram in the query. The shortest list is walked, and each live id is
+ *  looked up in the other lists with a binary search.
+ *
+ * ************************************************************************** */
+
+size_t *
+trigram_candidates (EDITOR_BUFFER *buf, char *query, size_t len, size_t *ncandidates)
+{
+  size_t i;
+  size_t j;
+  size_t n;
+  size_t nbuckets;
+  size_t shortest;
+  size_t buckets[256];
+  size_t *lines;
+  uint32_t id;
+
+  TRIGRAM_LIST *list;
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (!index->enabled || index->build_pos < buf->nlines || len < 3)
+    return NULL;
+
+  /*
+   * Get the distinct buckets for the query, long queries only use the first
+   * few trigrams as they are more than selective enough
+   */
+
+  nbuckets = 0;
+  for (i = 0; i + 3 <= len && nbuckets < sizeof buckets / sizeof buckets[0]; i++)
+  {
+    buckets[nbuckets] = trigram_hash (&query[i]);
+    for (j = 0; j < nbuckets && buckets[j] != buckets[nbuckets]; j++);
+    if (j == nbuckets)
+      nbuckets++;
+  }
+
+  shortest = 0;
+  for (i = 1; i < nbuckets; i++)
+  {
+    if (index->lists[buckets[i]].nids < index->lists[buckets[shortest]].nids)
+      shortest = i;
+  }
+
+  /*
+   * Intersect the posting lists
+   */
+
+  list = &index->lists[buckets[shortest]];
+  if (!(lines = malloc ((list->nids ? list->nids : 1) * sizeof (*lines))))
+    util_exit ("Couldn't allocate memory for search candidates");
+
+  n = 0;
+  for (i = 0; i < list->nids; i++)
+  {
+    id = list->ids[i];
+    if (index->id_line[id] == NO_MATCH)
+      continue;
+
+    for (j = 0; j < nbuckets; j++)
+    {
+      if (j != shortest && !trigram_list_contains (&index->lists[buckets[j]], id))
+        break;
+    }
+
+    if (j == nbuckets)
+      lines[n++] = index->id_line[id];
+  }
+
+  qsort (lines, n, sizeof (*lines), trigram_compare_lines);
+  *ncandidates = n;
+
+  return lines;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Describe the state of the index
+ *
+ *  @param[in]          *buf         The buffer
+ *  @param[out]         *out         The string to write the description to
+ *  @param[in]          out_size     The size of out
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+trigram_stats (EDITOR_BUFFER *buf, char *out, size_t out_size)
+{
+  char lines[32];
+  char postings[32];
+  char dead[32];
+  TRIGRAM_INDEX *index = &buf->trigrams;
+
+  if (!index->enabled)
+  {
+    snprintf (out, out_size, "Index: off");
+    return;
+  }
+
+  util_format_count (lines, sizeof lines, index->build_pos);
+  util_format_count (postings, sizeof postings, index->npostings - index->ndead);
+  util_format_count (dead, sizeof dead, index->ndead);
+
+  snprintf (out, out_size, "Index: %s%s lines, %s postings, %s dead, %.1f MB, %.2f s",
+            index->build_pos < buf->nlines ? "building, " : "", lines, postings, dead,
+            (double) index->memory / (1024.0 * 1024.0), index->build_time);
+}
@@ -0,0 +1,529 @@
+/** **************************************************************************
+ *
+ * @file undo.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for undoing and redoing edits.
+ *
+ * ************************************************************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Find where some text ends once it is in the buffer
+ *
+ *  @param[in]          *text        The text
+ *  @param[in]          len          The length of the text
+ *  @param[in,out]      *line        The line the text starts on, set to the
+ *                                   line it ends on
+ *  @param[in,out]      *col         The column the text starts at, set to the
+ *                                   column it ends at
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+undo_advance (char *text, size_t len, size_t *line, size_t *col)
+{
+  char *nl;
+  char *last;
+
+  last = NULL;
+  for (nl = memchr (text, '\n', len); nl; nl = memchr (nl + 1, '\n', len - (size_t) (nl + 1 - text)))
+  {
+    (*line)++;
+    last = nl;
+  }
+
+  *col = last ? len - (size_t) (last + 1 - text) : *col + len;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Make space in an op's text for more text
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in,out]      *op       The op
+ *  @param[in]          len       The length the text needs to hold
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+undo_reserve_text (EDITOR_BUFFER *buf, UNDO_OP *op, size_t len)
+{
+  if (len <= op->capacity)
+    return;
+
+  buf->undo.memory -= op->capacity;
+  op->capacity = len > 2 * op->capacity ? len : 2 * op->capacity;
+  buf->undo.memory += op->capacity;
+
+  if (!(op->text = realloc (op->text, op->capacity)))
+    util_exit ("Couldn't allocate memory for the undo log");
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free the ops in part of the log
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          start     The first op to free
+ *  @param[in]          end       One past the last op to free
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+undo_free_ops (EDITOR_BUFFER *buf, size_t start, size_t end)
+{
+  size_t i;
+  UNDO_LOG *undo = &buf->undo;
+
+  for (i = start; i < end; i++)
+  {
+    undo->memory -= undo->ops[i].capacity + sizeof (*undo->ops);
+    free (undo->ops[i].text);
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Drop the oldest undo steps until the log fits its cap
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Whole groups are dropped, so no undo step is left half done. The newest
+ *  step is always kept, even if it's bigger than the cap by itself, so the
+ *  last edit can always be undone.
+ *
+ * ************************************************************************** */
+
+static void
+undo_enforce_cap (EDITOR_BUFFER *buf)
+{
+  size_t ndrop;
+  size_t memory;
+  UNDO_LOG *undo = &buf->undo;
+
+  if (undo->memory <= undo->memory_cap)
+    return;
+
+  /*
+   * Count the ops to drop first, so the log only has to be moved once
+   */
+
+  ndrop = 0;
+  memory = undo->memory;
+  while (ndrop < undo->nops && memory > undo->memory_cap && undo->ops[ndrop].group != undo->ops[undo->nops - 1].group)
+  {
+    memory -= undo->ops[ndrop].capacity + sizeof (*undo->ops);
+    ndrop++;
+  }
+  while (ndrop > 0 && ndrop < undo->nops && undo->ops[ndrop].group == undo->ops[ndrop - 1].group)
+    ndrop++;
+
+  undo_free_ops (buf, 0, ndrop);
+  memmove (undo->ops, &undo->ops[ndrop], (undo->nops - ndrop) * sizeof (*undo->ops));
+  undo->nops -= ndrop;
+  undo->current -= ndrop;
+  undo->saved = undo->saved != NO_MATCH && undo->saved >= ndrop ? undo->saved - ndrop : NO_MATCH;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Try to join an edit onto the last op in the log
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          type      UNDO_INSERT or UNDO_DELETE
+ *  @param[in]          line      The line the edit starts on
+ *  @param[in]          col       The column the edit starts at
+ *  @param[in]          *text     The text inserted or deleted
+ *  @param[in]          len       The length of the text
+ *
+ *  @return             TRUE if the edit was joined onto the last op
+ *
+ *  @details
+ *
+ *  Typing inserts text where the last insert ended, backspace deletes text
+ *  which ends where the last delete started and delete removes text from
+ *  where the last delete started. In each case the last op's text can just
+ *  be extended.
+ *
+ * ************************************************************************** */
+
+static int
+undo_coalesce (EDITOR_BUFFER *buf, int type, size_t line, size_t col, char *text, size_t len)
+{
+  size_t end_line;
+  size_t end_col;
+  UNDO_OP *last;
+  UNDO_LOG *undo = &buf->undo;
+
+  if (undo->sealed || undo->nops == 0 || undo->current != undo->nops)
+    return FALSE;
+
+  last = &undo->ops[undo->nops - 1];
+  if (last->type != type)
+    return FALSE;
+
+  end_line = line;
+  end_col = col;
+  undo_advance (text, len, &end_line, &end_col);
+
+  if ((type == UNDO_INSERT && line == last->end_line && col == last->end_col)
+      || (type == UNDO_DELETE && line == last->line && col == last->col))
+  {
+    undo_reserve_text (buf, last, last->len + len);
+    memcpy (&last->text[last->len], text, len);
+    last->len += len;
+    undo_advance (text, len, &last->end_line, &last->end_col);
+  }
+  else if (type == UNDO_DELETE && end_line == last->line && end_col == last->col)
+  {
+    undo_reserve_text (buf, last, last->len + len);
+    memmove (&last->text[len], last->text, last->len);
+    memcpy (last->text, text, len);
+    last->len += len;
+    last->line = line;
+    last->col = col;
+  }
+  else
+  {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Record an edit in the undo log
+ *
+ *  @param[in,out]      *buf      The buffer
+ *  @param[in]          type      UNDO_INSERT or UNDO_DELETE
+ *  @param[in]          line      The line the edit starts on
+ *  @param[in]          col       The column the edit starts at
+ *  @param[in]          *text     The text inserted or deleted, which can
+ *                                contain new lines
+ *  @param[in]          len       The length of the text
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is called by the line functions in lines.c before they change the
+ *  text buffer. A split line is recorded as inserting a new line char and a
+ *  joined line as deleting one, so every edit is an insert or delete of a run
+ *  of text. Consecutive typing is joined onto the last op rather than adding
+ *  a new one. Anything which could be redone is thrown away, as the edit
+ *  starts a new history.
+ *
+ * ************************************************************************** */
+
+void
+undo_record (EDITOR_BUFFER *buf, int type, size_t line, size_t col, char *text, size_t len)
+{
+  UNDO_OP *op;
+  UNDO_LOG *undo = &buf->undo;
+
+  if (undo->suspended || len == 0)
+    return;
+
+  if (undo->current < undo->nops)
+  {
+    undo_free_ops (buf, undo->current, undo->nops);
+    undo->nops = undo->current;
+    if (undo->saved != NO_MATCH && undo->saved > undo->nops)
+      undo->saved = NO_MATCH;
+  }
+
+  if (undo_coalesce (buf, type, line, col, text, len))
+    return;
+
+  if (undo->nops == undo->capacity)
+  {
+    undo->capacity = undo->capacity ? undo->capacity * 2 : 64;
+    if (!(undo->ops = realloc (undo->ops, undo->capacity * sizeof (*undo->ops))))
+      util_exit ("Couldn't allocate memory for the undo log");
+  }
+
+  op = &undo->ops[undo->nops++];
+  op->type = type;
+  op->line = op->end_line = line;
+  op->col = op->end_col = col;
+  op->text = NULL;
+  op->len = len;
+  op->capacity = 0;
+  undo_advance (text, len, &op->end_line, &op->end_col);
+  undo->memory += sizeof (*op);
+  undo_reserve_text (buf, op, len);
+  memcpy (op->text, text, len);
+
+  if (undo->depth == 0)
+    undo->group++;
+  op->group = undo->group;
+
+  undo->current = undo->nops;
+  undo->sealed = undo->depth > 0;
+
+  undo_enforce_cap (buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Start a group of edits which are undone in one go
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Groups can be nested, in which case the outermost group is the one undo
+ *  step. Nothing in a group is joined onto an earlier op.
+ *
+ * ************************************************************************** */
+
+void
+undo_begin_group (EDITOR_BUFFER *buf)
+{
+  if (buf->undo.depth++ == 0)
+    buf->undo.group++;
+  buf->undo.sealed = TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              End a group of edits started by undo_begin_group
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+undo_end_group (EDITOR_BUFFER *buf)
+{
+  buf->undo.depth--;
+  buf->undo.sealed = TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Stop the next edit being joined onto the last op
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is called for every key press which isn't typing, so moving the
+ *  cursor or running a command ends the current undo step.
+ *
+ * ************************************************************************** */
+
+void
+undo_seal (EDITOR_BUFFER *buf)
+{
+  buf->undo.sealed = TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Apply an op, or the inverse of an op, to the buffer
+ *
+ *  @param[in,out]      *buf       The buffer
+ *  @param[in]          *op        The op
+ *  @param[in]          inverse    Bool flag for undoing the op
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The edit is made with the same line functions as the original, so only the
+ *  lines it touches are rendered again, and the offsets and trigram index are
+ *  kept up to date. Recording is suspended so the edit isn't logged again.
+ *
+ * ************************************************************************** */
+
+static void
+undo_apply (EDITOR_BUFFER *buf, UNDO_OP *op, int inverse)
+{
+  buf->undo.suspended++;
+
+  if ((op->type == UNDO_INSERT) != inverse)
+  {
+    line_insert_text (buf, op->line, op->col, op->text, op->len);
+    buf->cy = op->end_line;
+    buf->cx = op->end_col;
+  }
+  else
+  {
+    line_delete_text (buf, op->line, op->col, op->len);
+    buf->cy = op->line;
+    buf->cx = op->col;
+  }
+
+  buf->undo.suspended--;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Undo the last undo step
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Every op in the last group is undone, newest first. The cursor is left
+ *  where the step started. If this returns the buffer to how it was when it
+ *  was saved, it's no longer marked as modified.
+ *
+ * ************************************************************************** */
+
+void
+undo_undo (EDITOR_BUFFER *buf)
+{
+  size_t group;
+  UNDO_LOG *undo = &buf->undo;
+
+  if (undo->current == 0)
+  {
+    util_message ("Nothing to undo");
+    return;
+  }
+
+  group = undo->ops[undo->current - 1].group;
+  while (undo->current > 0 && undo->ops[undo->current - 1].group == group)
+    undo_apply (buf, &undo->ops[--undo->current], TRUE);
+
+  undo->sealed = TRUE;
+  buf->modified = undo->current != undo->saved;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Redo the last undo step which was undone
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+undo_redo (EDITOR_BUFFER *buf)
+{
+  size_t group;
+  UNDO_LOG *undo = &buf->undo;
+
+  if (undo->current == undo->nops)
+  {
+    util_message ("Nothing to redo");
+    return;
+  }
+
+  group = undo->ops[undo->current].group;
+  while (undo->current < undo->nops && undo->ops[undo->current].group == group)
+    undo_apply (buf, &undo->ops[undo->current++], FALSE);
+
+  undo->sealed = TRUE;
+  buf->modified = undo->current != undo->saved;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Remember the buffer has been saved at this point
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+undo_mark_saved (EDITOR_BUFFER *buf)
+{
+  buf->undo.saved = buf->undo.current;
+  buf->undo.sealed = TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Throw away the whole undo log
+ *
+ *  @param[in,out]      *buf      The buffer
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  This is used when a different file is read into the buffer. The memory cap
+ *  is kept.
+ *
+ * ************************************************************************** */
+
+void
+undo_clear (EDITOR_BUFFER *buf)
+{
+  UNDO_LOG *undo = &buf->undo;
+
+  undo_free_ops (buf, 0, undo->nops);
+  free (undo->ops);
+  undo->ops = NULL;
+  undo->nops = undo->capacity = undo->current = 0;
+  undo->saved = 0;
+  undo->memory = 0;
+  undo->sealed = TRUE;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Describe the undo log
+ *
+ *  @param[in]          *buf          The buffer
+ *  @param[out]         *out          The string to write the description to
+ *  @param[in]          out_size      The size of out
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+undo_stats (EDITOR_BUFFER *buf, char *out, size_t out_size)
+{
+  size_t i;
+  size_t nsteps;
+  char steps[32];
+  char redo[32];
+  UNDO_LOG *undo = &buf->undo;
+
+  nsteps = 0;
+  for (i = 0; i < undo->current; i++)
+    nsteps += i == 0 || undo->ops[i].group != undo->ops[i - 1].group;
+
+  util_format_count (steps, sizeof steps, nsteps);
+  util_format_count (redo, sizeof redo, undo->nops - undo->current);
+  snprintf (out, out_size, "Undo: %s steps, %s ops to redo, %.1f of %.1f MB", steps, redo,
+            (double) undo->memory / (1 << 20), (double) undo->memory_cap / (1 << 20));
+}
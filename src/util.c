@@ -11,58 +11,62 @@
  * ************************************************************************** */
 
 #include <errno.h>
+#include <libgen.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
+#include <string.h>
 
 #include "kris.h"
 
+static void (*util_fatal_handler) (const char *message) = NULL;
+static void (*util_message_handler) (const char *message) = NULL;
+
 /** **************************************************************************
  *
- *  @brief              Refresh the terminal screen
+ *  @brief              Kill the program and print an error message and string s
+ *
+ *  @param[in]          *s    An error message to print
  *
  *  @return             void
  *
  *  @details
  *
- *  Resets the terminal display by clearing everything and repositioning the
- *  cursor or something. Can't quite remember what it's doing exactly.
+ *  The handler set with util_on_fatal is called first, i.e. so the editor can
+ *  reset the terminal display, then perror prints the errno error with the
+ *  message and the program exits with the errno error code.
  *
  * ************************************************************************** */
 
 void
-util_reset_display (void)
+util_exit (char *s)
 {
-  /*
-   * \x1b is the escape character
-   * \x1b[ is an escape sequence
-   */
+  int error = errno;
 
-  write (STDOUT_FILENO, "\x1b[2J", 4);   // erase screen
-  write (STDOUT_FILENO, "\x1b[H", 3);    // reposition the cursor
+  if (util_fatal_handler)
+    util_fatal_handler (s);
+
+  errno = error;
+  perror (s);
+  exit (error);
 }
 
 /** **************************************************************************
  *
- *  @brief              Kill the program and print an error message and string s
+ *  @brief              Set the function called before the program is killed
+ *                      by util_exit
  *
- *  @param[in]          *s    An error message to print
+ *  @param[in]          *handler    The function, which is given the error
+ *                                  message, or NULL for none
  *
  *  @return             void
  *
- *  @details
- *
- *  Reset the terminal display, use perror to print the errno error with a
- *  message and then exit with errno error code.
- *
  * ************************************************************************** */
 
 void
-util_exit (char *s)
+util_on_fatal (void (*handler) (const char *message))
 {
-  util_reset_display ();
-  perror (s);
-  exit (errno);
+  util_fatal_handler = handler;
 }
 
 /** **************************************************************************
@@ -70,7 +74,8 @@ util_exit (char *s)
  *  @brief              Convert the cursor pos in chars array to a pos in render
  *                      array
  *
- *  @param[in]          *line     The line in the text buffer
+ *  @param[in]          *buf      The buffer
+ *  @param[in]          idx       The index of the line in the text buffer
  *  @param[in]          cx        The x position of the cursor (col)
  *
  *  @return             rx        The x position of the cursor in the render
@@ -86,11 +91,12 @@ util_exit (char *s)
  *
  * ************************************************************************** */
 
-int
-util_convert_cx_to_rx (EDITOR_LINE *line, int cx)
+size_t
+util_convert_cx_to_rx (EDITOR_BUFFER *buf, size_t idx, size_t cx)
 {
-  int rx;
+  size_t rx;
   size_t i;
+  char *chars = buf->lines.chars[idx];
 
   /*
    * Loop over all of the chars to the left of cx and count how many spaces
@@ -100,7 +106,7 @@ util_convert_cx_to_rx (EDITOR_LINE *line, int cx)
   rx = 0;
   for (i = 0; i < cx; i++)
   {
-    if (line->chars[i] == '\t')
+    if (chars[i] == '\t')
       rx += (TAB_WIDTH - 1) - (rx % TAB_WIDTH);
     rx++;
   }
@@ -113,7 +119,8 @@ util_convert_cx_to_rx (EDITOR_LINE *line, int cx)
  *  @brief              Convert the cursor pos in render array to a pos in the
  *                      char array
  *
- *  @param[in]          *line     The line in the text buffer
+ *  @param[in]          *buf      The buffer
+ *  @param[in]          idx       The index of the line in the text buffer
  *  @param[in]          rx        The x position of the cursor in the render array
  *
  *  @return             cx        The x position of the cursor in the char array
@@ -126,11 +133,13 @@ util_convert_cx_to_rx (EDITOR_LINE *line, int cx)
  *
  * ************************************************************************** */
 
-int
-util_convert_rx_to_cx (EDITOR_LINE *line, int rx)
+size_t
+util_convert_rx_to_cx (EDITOR_BUFFER *buf, size_t idx, size_t rx)
 {
   size_t cx;
-  int cur_rx;
+  size_t cur_rx;
+  size_t len = buf->lines.len[idx];
+  char *chars = buf->lines.chars[idx];
 
   /*
    * Loop over the chars array and increment until cx reaches the same size as
@@ -138,41 +147,149 @@ util_convert_rx_to_cx (EDITOR_LINE *line, int rx)
    */
 
   cur_rx = 0;
-  for (cx = 0; cx < line->len; cx++)
+  for (cx = 0; cx < len; cx++)
   {
-    if (line->chars[cx] == '\t')
+    if (chars[cx] == '\t')
       cur_rx += (TAB_WIDTH - 1) - (cur_rx % TAB_WIDTH);
     cur_rx++;
 
     if (cur_rx > rx)
-      return (int) cx;
+      return cx;
   }
 
-  return (int) cx;
+  return cx;
 }
 
 /** **************************************************************************
  *
- *  @brief              Free memory to avoid any memory leaks at exit
+ *  @brief              Format a count with commas between groups of thousands
+ *
+ *  @param[out]         *buf        The buffer to write the count to
+ *  @param[in]          buf_size    The size of buf
+ *  @param[in]          count       The number to format
  *
  *  @return             void
  *
  *  @details
  *
- *  Loops over each line in the text buffer and frees them from memory. The
- *  file name of the text buffer is also free'd from memory and then finally
- *  the entire text buffer.
+ *  Big numbers are much easier to read as 12,408,112 than 12408112. This is
+ *  done by hand as the thousands separator printf flag depends on the locale.
  *
  * ************************************************************************** */
 
 void
-util_clean_memory (void)
+util_format_count (char *buf, size_t buf_size, size_t count)
 {
   size_t i;
+  size_t j;
+  size_t len;
+  char digits[32];
 
-  for (i = 0; i < editor.nlines; i++)
-    util_free_line (&editor.lines[i]);
+  len = (size_t) snprintf (digits, sizeof digits, "%zu", count);
+
+  for (i = 0, j = 0; i < len && j + 1 < buf_size; i++)
+  {
+    if (i > 0 && (len - i) % 3 == 0)
+    {
+      buf[j++] = ',';
+      if (j + 1 >= buf_size)
+        break;
+    }
+    buf[j++] = digits[i];
+  }
+
+  buf[j] = '\0';
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Work out the path of a hidden file kept next to a file
+ *
+ *  @param[in]          *filename     The file being edited
+ *  @param[in]          *suffix       The suffix of the hidden file
+ *
+ *  @return             The path of the hidden file, which has to be free'd
+ *
+ *  @details
+ *
+ *  The hidden file is in the same directory as the file, so "dir/name.c" with
+ *  the suffix ".kris-journal" gives "dir/.name.c.kris-journal".
+ *
+ * ************************************************************************** */
+
+char *
+util_hidden_path (char *filename, char *suffix)
+{
+  char *dir;
+  char *base;
+  char *dir_copy;
+  char *base_copy;
+  char *path;
+  size_t path_len;
 
-  free (editor.filename);
-  free (editor.lines);
+  if (!(dir_copy = strdup (filename)) || !(base_copy = strdup (filename)))
+    util_exit ("Couldn't allocate memory for a path");
+
+  dir = dirname (dir_copy);
+  base = basename (base_copy);
+  path_len = strlen (dir) + strlen (base) + strlen (suffix) + sizeof "/.";
+  if (!(path = malloc (path_len)))
+    util_exit ("Couldn't allocate memory for a path");
+
+  snprintf (path, path_len, "%s/.%s%s", dir, base, suffix);
+  free (dir_copy);
+  free (base_copy);
+
+  return path;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Show a message to the user
+ *
+ *  @param[in]          *fmt      A printf style format string
+ *  @param[in]          ...       The values for the format string
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The message is given to the handler set with util_on_message, i.e. the
+ *  editor shows it in the message bar. It is dropped if there is no handler,
+ *  as there isn't when Kris is used as a library.
+ *
+ * ************************************************************************** */
+
+void
+util_message (char *fmt, ...)
+{
+  va_list ap;
+  char message[160];
+
+  if (!util_message_handler)
+    return;
+
+  va_start (ap, fmt);
+  vsnprintf (message, sizeof message, fmt, ap);
+  va_end (ap);
+
+  util_message_handler (message);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Set the function which shows the messages from
+ *                      util_message
+ *
+ *  @param[in]          *handler    The function, which is given the message,
+ *                                  or NULL for none
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+util_on_message (void (*handler) (const char *message))
+{
+  util_message_handler = handler;
 }
@@ -0,0 +1,360 @@
+/** **************************************************************************
+ *
+ * @file window.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Functions for splitting the screen into windows.
+ *
+ * ************************************************************************** */
+
+#include <stdlib.h>
+
+#include "kris.h"
+
+/** **************************************************************************
+ *
+ *  @brief              Create a window showing a buffer
+ *
+ *  @param[in]          *parent     The window this is half of, or NULL
+ *  @param[in]          *buf        The buffer to show
+ *
+ *  @return             The new window
+ *
+ * ************************************************************************** */
+
+static WINDOW *
+window_new (WINDOW *parent, EDITOR_BUFFER *buf)
+{
+  WINDOW *win;
+
+  if (!(win = calloc (1, sizeof *win)))
+    util_exit ("Couldn't allocate memory for a window");
+
+  win->buf = buf;
+  win->parent = parent;
+  win->split = WINDOW_LEAF;
+
+  return win;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Work out where a window and its halves go on screen
+ *
+ *  @param[in,out]      *win      The window to place
+ *  @param[in]          top       The first screen row of the window
+ *  @param[in]          left      The first screen column of the window
+ *  @param[in]          height    The number of rows, including status bars
+ *  @param[in]          width     The number of columns
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Windows side by side are separated by a column for the divider, which is
+ *  given to neither half.
+ *
+ * ************************************************************************** */
+
+static void
+window_place (WINDOW *win, int top, int left, int height, int width)
+{
+  int half;
+
+  win->top = top;
+  win->left = left;
+  win->height = height;
+  win->width = width;
+
+  if (win->split == WINDOW_STACKED)
+  {
+    half = height / 2;
+    window_place (win->child[0], top, left, half, width);
+    window_place (win->child[1], top + half, left, height - half, width);
+  }
+  else if (win->split == WINDOW_SIDE_BY_SIDE)
+  {
+    half = (width - 1) / 2;
+    window_place (win->child[0], top, left, height, half);
+    window_place (win->child[1], top, left + half + 1, height, width - half - 1);
+  }
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find the first window showing a buffer inside a window
+ *
+ *  @param[in]          *win      The window to look in
+ *
+ *  @return             The top left window inside win
+ *
+ * ************************************************************************** */
+
+static WINDOW *
+window_first_leaf (WINDOW *win)
+{
+  while (win->split != WINDOW_LEAF)
+    win = win->child[0];
+
+  return win;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Make a window the one being edited
+ *
+ *  @param[in]          *win      The window to edit
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The cursor and scroll of the window are put back into its buffer, which is
+ *  switched to. The buffer may have been edited through another window since,
+ *  so the cursor is kept inside the text.
+ *
+ * ************************************************************************** */
+
+static void
+window_focus (WINDOW *win)
+{
+  size_t i;
+  EDITOR_BUFFER *buf = win->buf;
+
+  editor.win = win;
+
+  buf->cy = win->cy <= buf->nlines ? win->cy : buf->nlines;
+  buf->cx = buf->cy < buf->nlines && win->cx <= buf->lines.len[buf->cy] ? win->cx : 0;
+  buf->row_offset = win->row_offset;
+  buf->col_offset = win->col_offset;
+
+  for (i = 0; i < editor.nbuffers; i++)
+    if (editor.buffers[i] == buf)
+      buffer_switch (i);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Create the first window, which shows the buffer being
+ *                      edited
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+window_init (void)
+{
+  editor.root = editor.win = window_new (NULL, editor.buf);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Fit the windows to the size of the terminal
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The windows cover everything apart from the message bar, so each gets its
+ *  own status bar.
+ *
+ * ************************************************************************** */
+
+void
+window_layout (void)
+{
+  window_place (editor.root, 0, 0, editor.screen_rows + 1, editor.screen_cols);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Get the number of text rows in the window being edited
+ *
+ *  @return             The number of rows, which is at least 1
+ *
+ * ************************************************************************** */
+
+size_t
+window_rows (void)
+{
+  return editor.win->height > 2 ? (size_t) editor.win->height - 1 : 1;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Copy the cursor and scroll of the buffer being edited
+ *                      into its window
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The cursor of the buffer is the one which moves when editing, so this is
+ *  done before drawing and before leaving the window.
+ *
+ * ************************************************************************** */
+
+void
+window_save (void)
+{
+  editor.win->buf = editor.buf;
+  editor.win->cx = editor.buf->cx;
+  editor.win->cy = editor.buf->cy;
+  editor.win->row_offset = editor.buf->row_offset;
+  editor.win->col_offset = editor.buf->col_offset;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Split the window being edited in two
+ *
+ *  @param[in]          split     WINDOW_STACKED or WINDOW_SIDE_BY_SIDE
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Both halves show the same buffer at the same position, and the top or left
+ *  half is edited.
+ *
+ * ************************************************************************** */
+
+void
+window_split (int split)
+{
+  int i;
+  WINDOW *win = editor.win;
+
+  if ((split == WINDOW_STACKED && win->height < 4) || (split == WINDOW_SIDE_BY_SIDE && win->width < 3))
+  {
+    editor_set_status_message ("The window is too small to split");
+    return;
+  }
+
+  window_save ();
+
+  for (i = 0; i < 2; i++)
+  {
+    win->child[i] = window_new (win, win->buf);
+    win->child[i]->cx = win->cx;
+    win->child[i]->cy = win->cy;
+    win->child[i]->row_offset = win->row_offset;
+    win->child[i]->col_offset = win->col_offset;
+  }
+
+  win->split = split;
+  win->buf = NULL;
+  editor.win = win->child[0];
+  window_layout ();
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Close the window being edited
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  The other half of the split takes over the space and the first window in
+ *  it is edited next. The buffer stays open.
+ *
+ * ************************************************************************** */
+
+void
+window_close (void)
+{
+  WINDOW *win = editor.win;
+  WINDOW *parent = win->parent;
+  WINDOW *other;
+
+  if (parent == NULL)
+  {
+    editor_set_status_message ("Can't close the only window");
+    return;
+  }
+
+  /*
+   * Move the other half up into the parent, so the parent's place in the
+   * tree doesn't change
+   */
+
+  other = parent->child[parent->child[0] == win];
+  *parent = (WINDOW) {other->buf, other->cx, other->cy, other->row_offset, other->col_offset, other->split,
+                      parent->parent, {other->child[0], other->child[1]}, 0, 0, 0, 0};
+  if (parent->split != WINDOW_LEAF)
+    parent->child[0]->parent = parent->child[1]->parent = parent;
+
+  free (win);
+  free (other);
+
+  window_layout ();
+  window_focus (window_first_leaf (parent));
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Move to the next window
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Windows are visited top to bottom and left to right, and after the last
+ *  window comes the first again.
+ *
+ * ************************************************************************** */
+
+void
+window_next (void)
+{
+  WINDOW *win = editor.win;
+
+  if (win->parent == NULL)
+  {
+    editor_set_status_message ("There is only one window");
+    return;
+  }
+
+  window_save ();
+
+  /*
+   * Go up until coming from a first half, then down the second half. If the
+   * top is reached then wrap around to the first window
+   */
+
+  while (win->parent && win->parent->child[1] == win)
+    win = win->parent;
+
+  win = win->parent ? win->parent->child[1] : win;
+  window_focus (window_first_leaf (win));
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Free a window and everything it's split into
+ *
+ *  @param[in]          *win      The window to free
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+void
+window_free (WINDOW *win)
+{
+  if (win == NULL)
+    return;
+
+  if (win->split != WINDOW_LEAF)
+  {
+    window_free (win->child[0]);
+    window_free (win->child[1]);
+  }
+
+  free (win);
+}
@@ -0,0 +1,158 @@
+/** **************************************************************************
+ *
+ * @file journal.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Regression tests for recovering edits from the journal after the
+ *        editor dies.
+ *
+ * @details
+ *
+ * Each test types into a file, closes its buffer without discarding the
+ * journal as if the editor had died, then opens the file again and answers
+ * yes to recovering the edits. The answers are read from a pipe put in place
+ * of stdin, and the screen is drawn to /dev/null.
+ *
+ * ************************************************************************** */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "kris.h"
+
+static char test_dir[] = "/tmp/kris-test-XXXXXX";
+
+/** **************************************************************************
+ *
+ *  @brief              Queue up keys to be read from stdin
+ *
+ *  @param[in]          *keys     The keys
+ *
+ *  @return             void
+ *
+ * ************************************************************************** */
+
+static void
+test_queue_keys (char *keys)
+{
+  int fds[2];
+
+  if (pipe (fds) == -1 || write (fds[1], keys, strlen (keys)) != (ssize_t) strlen (keys))
+    util_exit ("Couldn't queue the keys");
+
+  close (fds[1]);
+  dup2 (fds[0], STDIN_FILENO);
+  close (fds[0]);
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Type into a file, die, and recover what was typed
+ *
+ *  @param[in]          *name       The name of the test
+ *  @param[in]          *filename   The file to type into
+ *  @param[in]          *text       The text to type
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ *  @details
+ *
+ *  The autosave is said no to if it's asked about, so only the journal can
+ *  recover the text.
+ *
+ * ************************************************************************** */
+
+static int
+test_recover (char *name, char *filename, char *text)
+{
+  int result;
+  size_t i;
+  char *path;
+
+  if (!io_open_file (filename) || editor.buf->journal.fd == -1)
+  {
+    fprintf (stderr, "%s: no journal was opened for %s\n", name, filename);
+    return FAILURE;
+  }
+
+  for (i = 0; text[i]; i++)
+    editor_insert_char (text[i]);
+
+  buffer_free (editor.current, FALSE);
+  buffer_switch (0);
+
+  test_queue_keys ("y\rn\r");
+  io_open_file (filename);
+
+  result = editor.buf->nlines == 1 && !strcmp (editor.buf->lines.chars[0], text) ? SUCCESS : FAILURE;
+  if (result == FAILURE)
+    fprintf (stderr, "%s: recovered %zu lines, \"%s\"\n", name, editor.buf->nlines,
+             editor.buf->nlines ? editor.buf->lines.chars[0] : "");
+
+  buffer_free (editor.current, TRUE);
+  buffer_switch (0);
+
+  unlink (filename);
+  path = util_hidden_path (filename, SWAP_SUFFIX);
+  unlink (path);
+  free (path);
+
+  return result;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Run the journal tests
+ *
+ *  @return             EXIT_SUCCESS if every test passes, EXIT_FAILURE
+ *                      otherwise
+ *
+ * ************************************************************************** */
+
+int
+main (void)
+{
+  int fd;
+  int result;
+  char empty[64];
+  char missing[64];
+
+  if (!mkdtemp (test_dir))
+  {
+    perror ("Couldn't create the test directory");
+    return EXIT_FAILURE;
+  }
+
+  if ((fd = open ("/dev/null", O_WRONLY)) != -1)
+  {
+    dup2 (fd, STDOUT_FILENO);
+    close (fd);
+  }
+
+  editor.screen_rows = 24;
+  editor.screen_cols = 80;
+  buffer_switch (buffer_new (NULL));
+  window_init ();
+  window_layout ();
+
+  snprintf (empty, sizeof empty, "%s/empty.txt", test_dir);
+  snprintf (missing, sizeof missing, "%s/missing.txt", test_dir);
+  if ((fd = open (empty, O_WRONLY | O_CREAT, 0600)) != -1)
+    close (fd);
+
+  result = SUCCESS;
+  if (test_recover ("empty file", empty, "hi") == FAILURE)
+    result = FAILURE;
+  if (test_recover ("missing file", missing, "hi") == FAILURE)
+    result = FAILURE;
+
+  rmdir (test_dir);
+
+  return result == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
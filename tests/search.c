@@ -0,0 +1,409 @@
+/** **************************************************************************
+ *
+ * @file search.c
+ *
+ * @date 19/10/2026
+ *
+ * @author E. J. Parkinson
+ *
+ * @brief Tests for the regex engine and the substring search kernel.
+ *
+ * @details
+ *
+ * The regex engine is checked against glibc's POSIX extended regexes, which
+ * are also leftmost-longest, by finding every match of random patterns in
+ * random lines with both. The search kernel is checked against a naive scan,
+ * with needles either side of the lengths where it changes algorithm.
+ *
+ * ************************************************************************** */
+
+#include <ctype.h>
+#include <regex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kris.h"
+
+#define TEST_MAX_MATCHES 4096
+#define TEST_LONG_LINE 200000
+
+static uint32_t test_seed = 2026;
+
+/** **************************************************************************
+ *
+ *  @brief              Get a pseudo random number
+ *
+ *  @param[in]          n         The number of values wanted
+ *
+ *  @return             A number from 0 to n - 1
+ *
+ * ************************************************************************** */
+
+static size_t
+test_random (size_t n)
+{
+  test_seed ^= test_seed << 13;
+  test_seed ^= test_seed >> 17;
+  test_seed ^= test_seed << 5;
+
+  return test_seed % n;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find every match of a regex in a line with Kris
+ *
+ *  @param[in]          *pattern   The regex
+ *  @param[in]          icase      Bool flag for ignoring case
+ *  @param[in]          *line      The line
+ *  @param[in]          len        The length of the line
+ *  @param[out]         *out       The start and end of each match
+ *
+ *  @return             The number of matches
+ *
+ * ************************************************************************** */
+
+static size_t
+test_kris_matches (char *pattern, int icase, char *line, size_t len, size_t *out)
+{
+  size_t n;
+  size_t from;
+  size_t match_start;
+  size_t match_end;
+  char *error;
+  REGEX *regex;
+
+  if (!(regex = regex_compile (pattern, icase, &error)))
+    return NO_MATCH;
+
+  n = 0;
+  from = 0;
+  while (n < TEST_MAX_MATCHES && from <= len && regex_search (regex, line, len, from, &match_start, &match_end))
+  {
+    out[2 * n] = match_start;
+    out[2 * n + 1] = match_end;
+    n++;
+    from = match_end > match_start ? match_end : match_end + 1;
+  }
+
+  regex_free (regex);
+
+  return n;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Find every match of a regex in a line with glibc
+ *
+ *  @param[in]          *pattern   The regex
+ *  @param[in]          icase      Bool flag for ignoring case
+ *  @param[in]          *line      The line, which ends in a NUL
+ *  @param[in]          len        The length of the line
+ *  @param[out]         *out       The start and end of each match
+ *
+ *  @return             The number of matches
+ *
+ *  @details
+ *
+ *  Each search after the first starts part way through the line, so the line
+ *  is told it doesn't start there and ^ can't match.
+ *
+ * ************************************************************************** */
+
+static size_t
+test_posix_matches (char *pattern, int icase, char *line, size_t len, size_t *out)
+{
+  size_t n;
+  size_t from;
+  regex_t regex;
+  regmatch_t match;
+
+  if (regcomp (&regex, pattern, REG_EXTENDED | (icase ? REG_ICASE : 0)) != 0)
+    return NO_MATCH;
+
+  n = 0;
+  from = 0;
+  while (n < TEST_MAX_MATCHES && from <= len
+         && regexec (&regex, &line[from], 1, &match, from > 0 ? REG_NOTBOL : 0) == 0)
+  {
+    out[2 * n] = from + (size_t) match.rm_so;
+    out[2 * n + 1] = from + (size_t) match.rm_eo;
+    n++;
+    from = match.rm_eo > match.rm_so ? from + (size_t) match.rm_eo : from + (size_t) match.rm_eo + 1;
+  }
+
+  regfree (&regex);
+
+  return n;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Make a random regex
+ *
+ *  @param[out]         *pattern   The regex
+ *  @param[in]          size       The size of pattern
+ *
+ *  @return             void
+ *
+ *  @details
+ *
+ *  Only syntax which means the same in POSIX extended regexes is used. An
+ *  anchor applies to the whole of a Kris regex, so the rest of the regex is
+ *  put in a group when there is one.
+ *
+ * ************************************************************************** */
+
+static void
+test_random_regex (char *pattern, size_t size)
+{
+  static char *atoms[] = {"a", "b", "C", "x", ".", "[ab]", "[^a]", "[a-c]", "[0-9]", "(ab)", "(a|bC)", "1"};
+  static char *repeats[] = {"", "", "", "*", "+", "?"};
+  int anchor_start;
+  int anchor_end;
+  size_t i;
+  size_t len;
+  size_t natoms;
+
+  anchor_start = test_random (5) == 0;
+  anchor_end = test_random (5) == 0;
+  natoms = 1 + test_random (5);
+
+  len = (size_t) snprintf (pattern, size, "%s", anchor_start ? "^(" : anchor_end ? "(" : "");
+  for (i = 0; i < natoms && len < size; i++)
+  {
+    if (i > 0 && test_random (6) == 0)
+      len += (size_t) snprintf (&pattern[len], size - len, "|");
+    len += (size_t) snprintf (&pattern[len], size - len, "%s%s", atoms[test_random (sizeof atoms / sizeof atoms[0])],
+                              repeats[test_random (sizeof repeats / sizeof repeats[0])]);
+  }
+  if (len < size)
+    snprintf (&pattern[len], size - len, "%s", anchor_end ? ")$" : anchor_start ? ")" : "");
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Check Kris and glibc find the same matches
+ *
+ *  @param[in]          *pattern   The regex
+ *  @param[in]          icase      Bool flag for ignoring case
+ *  @param[in]          *line      The line, which ends in a NUL
+ *  @param[in]          len        The length of the line
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ * ************************************************************************** */
+
+static int
+test_regex_line (char *pattern, int icase, char *line, size_t len)
+{
+  size_t nkris;
+  size_t nposix;
+  static size_t kris[2 * TEST_MAX_MATCHES];
+  static size_t posix[2 * TEST_MAX_MATCHES];
+
+  nkris = test_kris_matches (pattern, icase, line, len, kris);
+  nposix = test_posix_matches (pattern, icase, line, len, posix);
+
+  if (nkris != nposix || (nkris != NO_MATCH && memcmp (kris, posix, 2 * nkris * sizeof *kris)))
+  {
+    fprintf (stderr, "regex: /%s/%s on \"%.60s\" found %zu matches, glibc found %zu\n", pattern, icase ? "i" : "",
+             line, nkris, nposix);
+    return FAILURE;
+  }
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Check the regex engine against glibc
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ *  @details
+ *
+ *  Random patterns are searched for in random lines, with and without
+ *  ignoring case. Then a pattern with an exponential number of DFA states is
+ *  run over long lines, so the DFA is flushed part way through lines. Finally,
+ *  a line where every match could carry on to the end of the line has to be
+ *  searched quickly, which ctest checks with a timeout.
+ *
+ * ************************************************************************** */
+
+static int
+test_regex (void)
+{
+  int result;
+  size_t i;
+  size_t j;
+  size_t len;
+  size_t n;
+  size_t from;
+  size_t match_start;
+  size_t match_end;
+  char pattern[128];
+  char line[256];
+  char *error;
+  char *long_line;
+  REGEX *regex;
+
+  result = SUCCESS;
+
+  for (i = 0; i < 20000 && result == SUCCESS; i++)
+  {
+    test_random_regex (pattern, sizeof pattern);
+    len = test_random (64);
+    for (j = 0; j < len; j++)
+      line[j] = "abcCx1A "[test_random (8)];
+    line[len] = '\0';
+    result = test_regex_line (pattern, (int) (i % 2), line, len);
+  }
+
+  /*
+   * An a eleven chars from the end can't be matched without remembering the
+   * last eleven chars, so the DFA needs thousands of states
+   */
+
+  if (!(long_line = malloc (TEST_LONG_LINE + 1)))
+    util_exit ("Couldn't allocate memory for the long line");
+
+  for (i = 0; i < 10 && result == SUCCESS; i++)
+  {
+    len = 20000;
+    for (j = 0; j < len; j++)
+      long_line[j] = "ab"[test_random (2)];
+    long_line[len] = '\0';
+    result = test_regex_line ("a[ab][ab][ab][ab][ab][ab][ab][ab][ab][ab][ab]b", FALSE, long_line, len);
+  }
+
+  memset (long_line, 'x', TEST_LONG_LINE);
+  long_line[TEST_LONG_LINE] = '\0';
+  regex = regex_compile ("x|x.*c", FALSE, &error);
+
+  n = 0;
+  from = 0;
+  while (from <= TEST_LONG_LINE && regex_search (regex, long_line, TEST_LONG_LINE, from, &match_start, &match_end))
+  {
+    if (match_start != n || match_end != n + 1)
+      break;
+    n++;
+    from = match_end;
+  }
+
+  if (result == SUCCESS && n != TEST_LONG_LINE)
+  {
+    fprintf (stderr, "regex: x|x.*c found %zu one char matches in a line of %d x's\n", n, TEST_LONG_LINE);
+    result = FAILURE;
+  }
+
+  regex_free (regex);
+
+  free (long_line);
+
+  return result;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Check the search kernel against a naive scan
+ *
+ *  @return             SUCCESS or FAILURE
+ *
+ *  @details
+ *
+ *  The needles are from 1 char, which uses memchr, to past
+ *  SEARCH_TWO_WAY_MIN, which uses Two-Way, with the SSE2 filter in between.
+ *  Some needles repeat themselves, which Two-Way handles differently. The
+ *  matches don't overlap, so the naive scan skips past each match it finds.
+ *
+ * ************************************************************************** */
+
+static int
+test_search (void)
+{
+  int icase;
+  size_t i;
+  size_t j;
+  size_t k;
+  size_t n;
+  size_t hay_len;
+  size_t needle_len;
+  char needle[SEARCH_TWO_WAY_MIN + 16];
+  char hay[512];
+  size_t naive[512];
+  SEARCH_PATTERN pattern;
+  SEARCH_MATCHES matches = {NULL, 0, 0};
+
+  for (i = 0; i < 20000; i++)
+  {
+    needle_len = 1 + i % (SEARCH_TWO_WAY_MIN + 8);
+    icase = (int) (i / (SEARCH_TWO_WAY_MIN + 8)) % 2;
+
+    for (j = 0; j < needle_len; j++)
+      needle[j] = i % 3 == 0 ? "ab"[j % 2] : "abAB"[test_random (icase ? 4 : 2)];
+    needle[needle_len] = '\0';
+
+    hay_len = test_random (sizeof hay);
+    for (j = 0; j < hay_len; j++)
+      hay[j] = "abAB"[test_random (icase ? 4 : 2)];
+    if (hay_len > needle_len)
+      memcpy (&hay[test_random (hay_len - needle_len)], needle, needle_len);
+
+    n = 0;
+    for (j = 0; j + needle_len <= hay_len; j++)
+    {
+      for (k = 0; k < needle_len; k++)
+      {
+        if (icase ? tolower ((unsigned char) hay[j + k]) != tolower ((unsigned char) needle[k]) : hay[j + k] != needle[k])
+          break;
+      }
+      if (k == needle_len)
+      {
+        naive[n++] = j;
+        j += needle_len - 1;
+      }
+    }
+
+    search_compile (&pattern, needle, needle_len, icase);
+    matches.npos = 0;
+    search_all (&pattern, hay, hay_len, &matches);
+
+    if (matches.npos != n || (n && memcmp (matches.pos, naive, n * sizeof *naive)))
+    {
+      fprintf (stderr, "search: \"%s\"%s in %zu chars found %zu matches, the naive scan found %zu\n", needle,
+               icase ? " ignoring case" : "", hay_len, matches.npos, n);
+      free (matches.pos);
+      return FAILURE;
+    }
+  }
+
+  free (matches.pos);
+
+  return SUCCESS;
+}
+
+/** **************************************************************************
+ *
+ *  @brief              Run the search tests
+ *
+ *  @return             EXIT_SUCCESS if every test passes, EXIT_FAILURE
+ *                      otherwise
+ *
+ * ************************************************************************** */
+
+int
+main (void)
+{
+  int result;
+
+  result = SUCCESS;
+  if (test_regex () == FAILURE)
+    result = FAILURE;
+  if (test_search () == FAILURE)
+    result = FAILURE;
+
+  return result == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}